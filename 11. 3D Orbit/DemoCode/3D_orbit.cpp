@@ -1,6 +1,8 @@
 // include C++ headers
 #include <cstdio>
 #include <iostream>
+#include <map>
+#include <string>
 #include <vector>
 //using namespace std;	// to avoid having to use std::
 
@@ -13,6 +15,7 @@
 //using namespace glm;	// to avoid having to use glm::
 
 #include "ShaderProgram.h"
+#include "TransformHierarchy.h"
 
 // vertex attribute format
 struct VertexColor
@@ -36,7 +39,10 @@ GLuint gVBO = 0;		// vertex buffer object identifier
 GLuint gIBO = 0;		// index buffer object identifier
 GLuint gVAO = 0;		// vertex array object identifier
 
-std::map<std::string, glm::mat4> gModelMatrix;	// object matrices
+TransformHierarchy gTransforms;	// object transforms (parents precede children)
+uint32_t gObject1;				// object 1 node
+uint32_t gOrbit;				// orbit of object 2 (rotates around object 1)
+uint32_t gObject2;				// object 2 node (child of the orbit)
 glm::mat4 gViewMatrix;			// view matrix
 glm::mat4 gProjectionMatrix;	// projection matrix
 
@@ -63,8 +69,10 @@ static void init(GLFWwindow* window)
 
 	gProjectionMatrix = glm::perspective(glm::radians(45.0f), aspectRatio, 0.1f, 10.0f);
 
-	gModelMatrix["Object1"] = glm::mat4(1.0f);
-	gModelMatrix["Object2"] = glm::mat4(1.0f);
+	// create transform hierarchy
+	gObject1 = gTransforms.addNode(gNoParent);
+	gOrbit = gTransforms.addNode(gNoParent);
+	gObject2 = gTransforms.addNode(gOrbit);
 
 	// vertex positions and colours
 	std::vector<GLfloat> vertices =
@@ -140,14 +148,17 @@ static void update_scene(GLFWwindow* window)
 	rotationAngle[0] += gRotationSpeed[0] * gFrameTime;
 	rotationAngle[1] += gRotationSpeed[1] * gFrameTime;
 
-	// update model matrix
-	gModelMatrix["Object1"] = glm::rotate(rotationAngle[0], glm::vec3(0.0f, 1.0f, 0.0f));
+	// update local matrices
+	gTransforms.setLocalMatrix(gObject1, glm::rotate(rotationAngle[0], glm::vec3(0.0f, 1.0f, 0.0f)));
 
-	gModelMatrix["Object2"] = glm::rotate(orbitAngle, glm::vec3(0.0f, 1.0f, 0.0f))
-		* glm::translate(glm::vec3(2.0f, 0.0f, 0.0f))
+	gTransforms.setLocalMatrix(gOrbit, glm::rotate(orbitAngle, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+	gTransforms.setLocalMatrix(gObject2, glm::translate(glm::vec3(2.0f, 0.0f, 0.0f))
 		* glm::rotate(rotationAngle[1] - orbitAngle, glm::vec3(0.0f, 1.0f, 0.0f))
-		* glm::scale(glm::vec3(0.5f, 0.5f, 0.5f));
+		* glm::scale(glm::vec3(0.5f, 0.5f, 0.5f)));
 
+	// recompute model matrices
+	gTransforms.update();
 }
 
 // function to render the scene
@@ -163,12 +174,12 @@ static void render_scene()
 	glm::mat4 MVP;
 
 	// object 1
-	MVP = gProjectionMatrix * gViewMatrix * gModelMatrix["Object1"];
+	MVP = gProjectionMatrix * gViewMatrix * gTransforms.getWorldMatrix(gObject1);
 	gShader.setUniform("uModelViewProjectionMatrix", MVP);	// set uniform variable
 	glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);	// display vertices based indices and primitive type
 
 	// object 2
-	MVP = gProjectionMatrix * gViewMatrix * gModelMatrix["Object2"];
+	MVP = gProjectionMatrix * gViewMatrix * gTransforms.getWorldMatrix(gObject2);
 	gShader.setUniform("uModelViewProjectionMatrix", MVP);	// set uniform variable
 	glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);	// display vertices based indices and primitive type
 
@@ -176,6 +187,70 @@ static void render_scene()
 	glFlush();
 }
 
+// measure transform update times of a large hierarchy
+static void benchmark_transforms()
+{
+	const size_t numNodes = 100000;
+	const size_t branching = 4;		// children per node
+	const int numUpdates = 100;		// updates per measurement
+
+	// build a tree where node i is the child of node (i - 1) / branching
+	TransformHierarchy transforms;
+	transforms.reserve(numNodes);
+	transforms.addNode(gNoParent);
+	for (size_t i = 1; i < numNodes; i++)
+		transforms.addNode(static_cast<int32_t>((i - 1) / branching), glm::translate(glm::vec3(0.1f, 0.0f, 0.0f)));
+
+	// string-keyed map of matrices recomputed from the parent every frame (previous approach)
+	std::map<std::string, glm::mat4> modelMatrix;
+	std::vector<std::string> names(numNodes);
+	for (size_t i = 0; i < numNodes; i++)
+	{
+		names[i] = "Node" + std::to_string(i);
+		modelMatrix[names[i]] = glm::mat4(1.0f);
+	}
+
+	std::cout << "Transform benchmark (" << numNodes << " nodes)" << std::endl;
+
+	double startTime = glfwGetTime();
+	for (int update = 0; update < numUpdates; update++)
+	{
+		modelMatrix[names[0]] = glm::rotate(update * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f));
+		for (size_t i = 1; i < numNodes; i++)
+			modelMatrix[names[i]] = modelMatrix[names[(i - 1) / branching]] * glm::translate(glm::vec3(0.1f, 0.0f, 0.0f));
+	}
+	double elapsed = (glfwGetTime() - startTime) / numUpdates;
+	std::cout << "  map, all nodes:       " << elapsed * 1000.0 << " ms" << std::endl;
+
+	// root changed: every world matrix is recomputed
+	startTime = glfwGetTime();
+	for (int update = 0; update < numUpdates; update++)
+	{
+		transforms.setLocalMatrix(0, glm::rotate(update * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f)));
+		transforms.update();
+	}
+	elapsed = (glfwGetTime() - startTime) / numUpdates;
+	std::cout << "  hierarchy, root:      " << elapsed * 1000.0 << " ms (" << transforms.getNumUpdated() << " updated)" << std::endl;
+
+	// a leaf near the end changed: only that node is recomputed
+	uint32_t leaf = static_cast<uint32_t>(numNodes - 1);
+	startTime = glfwGetTime();
+	for (int update = 0; update < numUpdates; update++)
+	{
+		transforms.setLocalMatrix(leaf, glm::rotate(update * 0.01f, glm::vec3(0.0f, 1.0f, 0.0f)));
+		transforms.update();
+	}
+	elapsed = (glfwGetTime() - startTime) / numUpdates;
+	std::cout << "  hierarchy, one leaf:  " << elapsed * 1000.0 << " ms (" << transforms.getNumUpdated() << " updated)" << std::endl;
+
+	// nothing changed
+	startTime = glfwGetTime();
+	for (int update = 0; update < numUpdates; update++)
+		transforms.update();
+	elapsed = (glfwGetTime() - startTime) / numUpdates;
+	std::cout << "  hierarchy, unchanged: " << elapsed * 1000.0 << " ms (" << transforms.getNumUpdated() << " updated)" << std::endl;
+}
+
 // key press or release callback function
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
@@ -186,6 +261,13 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 		glfwSetWindowShouldClose(window, GL_TRUE);
 		return;
 	}
+
+	// run the transform benchmark when the B key is pressed
+	if (key == GLFW_KEY_B && action == GLFW_PRESS)
+	{
+		benchmark_transforms();
+		return;
+	}
 }
 
 // mouse movement callback function
@@ -0,0 +1,372 @@
+#include "DeferredRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
+#include "GLStateCache.h"
+#include "LightClusters.h"
+
+// spotlights wider than this are drawn with the sphere (the cone would get too wide)
+const float gMaxConeAngle = 60.0f;
+
+DeferredRenderer::DeferredRenderer()
+{}
+
+DeferredRenderer::~DeferredRenderer()
+{
+	release();
+}
+
+// compile shaders and create the light volumes and a G-buffer of a size
+bool DeferredRenderer::init(int width, int height)
+{
+	release();
+	mWidth = width;
+	mHeight = height;
+
+	mGeometryShader.compileAndLink("phongShading.vert", "deferredGeometry.frag");
+	mLightShader.compileAndLink("deferredLight.vert", "deferredLight.frag");
+
+	// G-buffer textures (read with texelFetch)
+	mDepth.create2D(GL_R32F, width, height, 1);
+	mNormal.create2D(GL_RG16F, width, height, 1);
+	mDiffuse.create2D(GL_RGBA8, width, height, 1);
+	mSpecular.create2D(GL_RGBA8, width, height, 1);
+	mLight.create2D(GL_RGBA16F, width, height, 1);
+	for (GLTexture* texture : { &mDepth, &mNormal, &mDiffuse, &mSpecular, &mLight })
+	{
+		texture->setParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		texture->setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	glGenRenderbuffers(1, &mDepthStencil);
+	glBindRenderbuffer(GL_RENDERBUFFER, mDepthStencil);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+	// geometry pass framebuffer
+	glGenFramebuffers(1, &mGeometryFBO);
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, mGeometryFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mDepth.getID(), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, mNormal.getID(), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, mDiffuse.getID(), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, mSpecular.getID(), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D, mLight.getID(), 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, mDepthStencil);
+	const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3,
+		GL_COLOR_ATTACHMENT4 };
+	glDrawBuffers(5, drawBuffers);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+	// light pass framebuffer (the G-buffer textures it samples are not attached)
+	glGenFramebuffers(1, &mLightFBO);
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, mLightFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mLight.getID(), 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, mDepthStencil);
+	complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (!complete)
+	{
+		std::cerr << "Deferred renderer: G-buffer framebuffer incomplete" << std::endl;
+		release();
+		return false;
+	}
+
+	createVolumes();
+	return true;
+}
+
+void DeferredRenderer::release()
+{
+	if (mGeometryFBO != 0)
+	{
+		glDeleteFramebuffers(1, &mGeometryFBO);
+		GLStateCache::onDeleteFramebuffer(mGeometryFBO);
+		mGeometryFBO = 0;
+	}
+	if (mLightFBO != 0)
+	{
+		glDeleteFramebuffers(1, &mLightFBO);
+		GLStateCache::onDeleteFramebuffer(mLightFBO);
+		mLightFBO = 0;
+	}
+	if (mDepthStencil != 0)
+	{
+		glDeleteRenderbuffers(1, &mDepthStencil);
+		mDepthStencil = 0;
+	}
+
+	mDepth.release();
+	mNormal.release();
+	mDiffuse.release();
+	mSpecular.release();
+	mLight.release();
+	mVolumeVAO.release();
+	mVolumeVertices.release();
+	mVolumeIndices.release();
+}
+
+// unit sphere (a subdivided icosahedron) and cone, scaled so that their faces lie outside the round shapes
+void DeferredRenderer::createVolumes()
+{
+	std::vector<glm::vec3> vertices;
+	std::vector<GLushort> indices;
+
+	// icosahedron with counter-clockwise faces seen from outside
+	const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+	const glm::vec3 corners[] = { { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 }, { 0, -1, t }, { 0, 1, t },
+		{ 0, -1, -t }, { 0, 1, -t }, { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 } };
+	const GLushort faces[] = { 0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6,
+		7, 1, 8, 3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1 };
+	for (const glm::vec3& corner : corners)
+		vertices.push_back(glm::normalize(corner));
+	indices.assign(faces, faces + sizeof(faces) / sizeof(faces[0]));
+
+	// split every triangle into four twice, sharing the edge midpoints
+	for (int level = 0; level < 2; level++)
+	{
+		std::map<uint32_t, GLushort> midpoints;
+		auto midpoint = [&](GLushort a, GLushort b)
+		{
+			uint32_t key = (static_cast<uint32_t>(std::min(a, b)) << 16) | std::max(a, b);
+			auto found = midpoints.find(key);
+			if (found != midpoints.end())
+				return found->second;
+
+			GLushort index = static_cast<GLushort>(vertices.size());
+			vertices.push_back(glm::normalize(vertices[a] + vertices[b]));
+			midpoints[key] = index;
+			return index;
+		};
+
+		std::vector<GLushort> split;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			GLushort a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			GLushort ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+			const GLushort triangles[] = { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca };
+			split.insert(split.end(), triangles, triangles + 12);
+		}
+		indices.swap(split);
+	}
+
+	// push the faces out to the unit sphere
+	float minDistance = 1.0f;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const glm::vec3& a = vertices[indices[i]];
+		glm::vec3 normal = glm::normalize(glm::cross(vertices[indices[i + 1]] - a, vertices[indices[i + 2]] - a));
+		minDistance = std::min(minDistance, glm::dot(normal, a));
+	}
+	for (glm::vec3& vertex : vertices)
+		vertex /= minDistance;
+
+	mSphere.numIndices = static_cast<GLsizei>(indices.size());
+	mSphere.offset = 0;
+
+	// cone: apex, base centre and a ring pushed out to the unit circle
+	const int segments = 16;
+	const GLushort apex = static_cast<GLushort>(vertices.size());
+	const float ringScale = 1.0f / std::cos(glm::pi<float>() / segments);
+	vertices.push_back(glm::vec3(0.0f));
+	vertices.push_back(glm::vec3(0.0f, 0.0f, -1.0f));
+	for (int i = 0; i < segments; i++)
+	{
+		float angle = 2.0f * glm::pi<float>() * i / segments;
+		vertices.push_back(glm::vec3(std::cos(angle) * ringScale, std::sin(angle) * ringScale, -1.0f));
+	}
+
+	mCone.offset = indices.size() * sizeof(GLushort);
+	for (int i = 0; i < segments; i++)
+	{
+		GLushort current = static_cast<GLushort>(apex + 2 + i);
+		GLushort next = static_cast<GLushort>(apex + 2 + (i + 1) % segments);
+		const GLushort triangles[] = { apex, current, next, static_cast<GLushort>(apex + 1), next, current };
+		indices.insert(indices.end(), triangles, triangles + 6);
+	}
+	mCone.numIndices = static_cast<GLsizei>(indices.size() - mCone.offset / sizeof(GLushort));
+
+	// position only vertex stream
+	mVolumeVertices.create(vertices.size() * sizeof(glm::vec3), vertices.data());
+	mVolumeIndices.create(indices.size() * sizeof(GLushort), indices.data());
+	mVolumeVAO.create();
+	mVolumeVAO.setVertexBuffer(0, mVolumeVertices, 0, sizeof(glm::vec3));
+	mVolumeVAO.setIndexBuffer(mVolumeIndices);
+	mVolumeVAO.setAttribute(0, 0, 3, GL_FLOAT, GL_FALSE, 0);
+}
+
+// bind and clear the G-buffer and use the geometry program (draw with its material and matrix uniforms)
+ShaderProgram& DeferredRenderer::beginGeometry(const glm::mat4& view, const glm::vec3& ambient)
+{
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, mGeometryFBO);
+	GLStateCache::viewport(0, 0, mWidth, mHeight);
+
+	// no surface (view depth 0) and the current clear colour as the background light
+	GLfloat background[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, background);
+	const GLfloat zero[4] = {};
+	GLStateCache::depthMask(GL_TRUE);
+	glClearBufferfv(GL_COLOR, 0, zero);
+	glClearBufferfv(GL_COLOR, 1, zero);
+	glClearBufferfv(GL_COLOR, 2, zero);
+	glClearBufferfv(GL_COLOR, 3, zero);
+	glClearBufferfv(GL_COLOR, 4, background);
+	glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+
+	GLStateCache::enable(GL_DEPTH_TEST);
+	GLStateCache::depthFunc(GL_LESS);
+	GLStateCache::disable(GL_BLEND);
+
+	mGeometryShader.use();
+	mGeometryShader.setUniform("uViewMatrix", view);
+	mGeometryShader.setUniform("uAmbient", ambient);
+	return mGeometryShader;
+}
+
+// draw a light volume
+void DeferredRenderer::drawVolume(const Volume& volume, const glm::mat4& modelViewProjection)
+{
+	mLightShader.setUniform("uModelViewProjectionMatrix", modelViewProjection);
+	glDrawElements(GL_TRIANGLES, volume.numIndices, GL_UNSIGNED_SHORT, reinterpret_cast<const void*>(volume.offset));
+}
+
+// add the light of every light (lights of type 0 are skipped) to the accumulation buffer
+void DeferredRenderer::drawLights(const Light* lights, size_t numLights, const glm::mat4& view, const glm::mat4& projection,
+	const glm::vec3& viewpoint)
+{
+	mNumVolumes = 0;
+	mNumFullScreen = 0;
+
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, mLightFBO);
+	GLStateCache::viewport(0, 0, mWidth, mHeight);
+	GLStateCache::polygonMode(GL_FILL);		// (volumes must cover their pixels, also in wireframe mode)
+	GLStateCache::depthMask(GL_FALSE);
+	GLStateCache::enable(GL_BLEND);
+	GLStateCache::blendFunc(GL_ONE, GL_ONE);
+	// volumes cut by the far plane still cover the surfaces behind their front faces
+	GLStateCache::enable(GL_DEPTH_CLAMP);
+
+	mLightShader.use();
+	mDepth.bind(0);
+	mNormal.bind(1);
+	mDiffuse.bind(2);
+	mSpecular.bind(3);
+	mLightShader.setUniform("uDepth", 0);
+	mLightShader.setUniform("uNormal", 1);
+	mLightShader.setUniform("uDiffuse", 2);
+	mLightShader.setUniform("uSpecular", 3);
+	mLightShader.setUniform("uInverseViewMatrix", glm::inverse(view));
+	mLightShader.setUniform("uProjectionScale", glm::vec2(1.0f / projection[0][0], 1.0f / projection[1][1]));
+	mLightShader.setUniform("uProjectionOffset", glm::vec2(projection[2][0], projection[2][1]));
+	mLightShader.setUniform("uScreenSize", glm::vec2(mWidth, mHeight));
+	mLightShader.setUniform("uViewpoint", viewpoint);
+	mVolumeVAO.bind();
+
+	const glm::mat4 viewProjection = projection * view;
+	for (size_t i = 0; i < numLights; i++)
+	{
+		const Light& light = lights[i];
+		if (light.type == 0)
+			continue;
+
+		float radius = (light.type == 2) ? std::numeric_limits<float>::infinity() : LightClusters::getInfluenceRadius(light);
+		if (radius <= 0.0f)
+			continue;
+
+		mLightShader.setUniform("uLight.pos", light.pos);
+		mLightShader.setUniform("uLight.dir", light.type == 1 ? glm::vec3(0.0f) : glm::normalize(light.dir));
+		mLightShader.setUniform("uLight.Ld", light.Ld);
+		mLightShader.setUniform("uLight.Ls", light.Ls);
+		mLightShader.setUniform("uLight.att", light.att);
+		mLightShader.setUniform("uLight.cosInnerAngle", std::cos(glm::radians(light.innerAngle)));
+		mLightShader.setUniform("uLight.cosOuterAngle", std::cos(glm::radians(light.outerAngle)));
+		mLightShader.setUniform("uLight.radius", radius);
+		mLightShader.setUniform("uLight.type", light.type);
+
+		// unbounded lights shade every pixel with a surface
+		if (std::isinf(radius))
+		{
+			GLStateCache::disable(GL_DEPTH_TEST);
+			GLStateCache::disable(GL_STENCIL_TEST);
+			GLStateCache::disable(GL_CULL_FACE);
+			mLightShader.setUniform("uFullScreen", true);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			mNumFullScreen++;
+			continue;
+		}
+
+		// sphere around a point light, or cone along a spotlight's direction
+		glm::mat4 model;
+		const Volume* volume = &mSphere;
+		if (light.type == 3 && light.outerAngle < gMaxConeAngle)
+		{
+			glm::vec3 direction = glm::normalize(light.dir);
+			glm::vec3 up = (std::abs(direction.y) > 0.99f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			float baseRadius = radius * std::tan(glm::radians(light.outerAngle));
+			model = glm::inverse(glm::lookAt(light.pos, light.pos + direction, up)) * glm::scale(glm::vec3(baseRadius, baseRadius, radius));
+			volume = &mCone;
+		}
+		else
+		{
+			model = glm::translate(light.pos) * glm::scale(glm::vec3(radius));
+		}
+		mLightShader.setUniform("uFullScreen", false);
+
+		if (mStencilCulling)
+		{
+			// stencil pass: count back faces behind and front faces in front of the surface, leaving a
+			// non-zero value where the surface is inside the volume
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			GLStateCache::enable(GL_DEPTH_TEST);
+			GLStateCache::depthFunc(GL_LESS);
+			GLStateCache::disable(GL_CULL_FACE);
+			GLStateCache::enable(GL_STENCIL_TEST);
+			glStencilFunc(GL_ALWAYS, 0, 0xFF);
+			glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+			glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+			drawVolume(*volume, viewProjection * model);
+
+			// light pass: shade the marked pixels once (back faces) and clear their marks for the next light
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			GLStateCache::disable(GL_DEPTH_TEST);
+			GLStateCache::enable(GL_CULL_FACE);
+			glCullFace(GL_FRONT);
+			glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+			glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+			drawVolume(*volume, viewProjection * model);
+		}
+		else
+		{
+			// shade every pixel whose surface is in front of the volume's back faces
+			GLStateCache::enable(GL_DEPTH_TEST);
+			GLStateCache::depthFunc(GL_GEQUAL);
+			GLStateCache::disable(GL_STENCIL_TEST);
+			GLStateCache::enable(GL_CULL_FACE);
+			glCullFace(GL_FRONT);
+			drawVolume(*volume, viewProjection * model);
+		}
+		mNumVolumes++;
+	}
+
+	// restore the default state
+	glCullFace(GL_BACK);
+	GLStateCache::disable(GL_CULL_FACE);
+	GLStateCache::disable(GL_STENCIL_TEST);
+	GLStateCache::disable(GL_DEPTH_CLAMP);
+	GLStateCache::disable(GL_BLEND);
+	GLStateCache::enable(GL_DEPTH_TEST);
+	GLStateCache::depthFunc(GL_LESS);
+	GLStateCache::depthMask(GL_TRUE);
+}
+
+// copy the accumulation buffer to a viewport of the default framebuffer (and bind it)
+void DeferredRenderer::resolve(const GLint viewport[4])
+{
+	GLStateCache::bindFramebuffer(GL_READ_FRAMEBUFFER, mLightFBO);
+	GLStateCache::bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, mWidth, mHeight, viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+		GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
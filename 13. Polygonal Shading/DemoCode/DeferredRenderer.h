@@ -0,0 +1,96 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "utilities.h"
+#include "GLResources.h"
+
+/*****************************************************************
+ * deferred shading with light volumes
+ * a geometry pass writes the surface attributes of the nearest
+ * fragment of each pixel to a G-buffer (view depth, octahedral
+ * normal, Kd, Ks and a shininess of up to 255) and its ambient
+ * light to an accumulation buffer; each point light or spotlight
+ * then draws a sphere or cone around the volume it lights and adds
+ * its light to the pixels inside it, so shading cost follows the
+ * lit pixels rather than the rasterised fragments
+ * a stencil pass per light first marks the pixels whose surface
+ * lies inside the volume (back faces behind and front faces in
+ * front of it), so the light pass shades only those; without it
+ * every pixel in front of the volume's back faces is shaded
+ * directional lights and lights without attenuation are drawn as
+ * full screen passes
+ * the shaders are deferredGeometry.frag (with phongShading.vert)
+ * and deferredLight.vert/frag
+ *****************************************************************/
+class DeferredRenderer
+{
+public:
+	DeferredRenderer();
+	~DeferredRenderer();
+	DeferredRenderer(const DeferredRenderer&) = delete;
+	DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+
+	// compile shaders and create the light volumes and a G-buffer of a size
+	bool init(int width, int height);
+	void release();
+
+	// bind and clear the G-buffer and use the geometry program (draw with its material and matrix uniforms)
+	ShaderProgram& beginGeometry(const glm::mat4& view, const glm::vec3& ambient);
+	// add the light of every light (lights of type 0 are skipped) to the accumulation buffer
+	void drawLights(const Light* lights, size_t numLights, const glm::mat4& view, const glm::mat4& projection,
+		const glm::vec3& viewpoint);
+	// copy the accumulation buffer to a viewport of the default framebuffer (and bind it)
+	void resolve(const GLint viewport[4]);
+
+	// mark the pixels inside each light volume with a stencil pass
+	void setStencilCulling(bool enabled) { mStencilCulling = enabled; }
+	bool getStencilCulling() const { return mStencilCulling; }
+
+	int getWidth() const { return mWidth; }
+	int getHeight() const { return mHeight; }
+	// lights drawn as volumes and as full screen passes in the last drawLights
+	uint32_t getNumVolumes() const { return mNumVolumes; }
+	uint32_t getNumFullScreen() const { return mNumFullScreen; }
+
+private:
+	// vertex and index range of a light volume in the shared buffers
+	struct Volume
+	{
+		GLsizei numIndices;
+		size_t offset;		// bytes
+	};
+
+	ShaderProgram mGeometryShader;
+	ShaderProgram mLightShader;
+
+	// G-buffer and accumulated light
+	GLTexture mDepth;		// view depth (0 where there is no surface)
+	GLTexture mNormal;		// octahedral normal
+	GLTexture mDiffuse;		// Kd
+	GLTexture mSpecular;	// Ks and shininess / 255
+	GLTexture mLight;
+	GLuint mDepthStencil = 0;		// renderbuffer
+	GLuint mGeometryFBO = 0;		// all attachments
+	GLuint mLightFBO = 0;			// accumulated light and depth/stencil
+	int mWidth = 0, mHeight = 0;
+
+	// unit sphere and cone (apex at the origin, opening along -z with base radius and height 1)
+	// that enclose the round shapes they approximate
+	GLBuffer mVolumeVertices;
+	GLBuffer mVolumeIndices;
+	GLVertexArray mVolumeVAO;
+	Volume mSphere = {};
+	Volume mCone = {};
+
+	bool mStencilCulling = true;
+	uint32_t mNumVolumes = 0;
+	uint32_t mNumFullScreen = 0;
+
+	void createVolumes();
+	void drawVolume(const Volume& volume, const glm::mat4& modelViewProjection);
+};
+
+#endif
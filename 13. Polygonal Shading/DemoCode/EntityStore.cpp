@@ -0,0 +1,123 @@
+#include "EntityStore.h"
+
+#include <algorithm>
+#include <cmath>
+
+EntityStore::EntityStore()
+{}
+
+EntityStore::~EntityStore()
+{}
+
+// create an entity without components (identifiers of destroyed entities are reused)
+Entity EntityStore::create()
+{
+	mNumEntities++;
+
+	if (!mFreeEntities.empty())
+	{
+		Entity entity = mFreeEntities.back();
+		mFreeEntities.pop_back();
+		return entity;
+	}
+
+	return mNextEntity++;
+}
+
+// remove an entity and all its components
+void EntityStore::destroy(Entity entity)
+{
+	mTransforms.remove(entity);
+	mRenderables.remove(entity);
+	mBounds.remove(entity);
+	mLights.remove(entity);
+
+	mFreeEntities.push_back(entity);
+	mNumEntities--;
+}
+
+// remove all entities
+void EntityStore::clear()
+{
+	mTransforms.clear();
+	mRenderables.clear();
+	mBounds.clear();
+	mLights.clear();
+
+	mFreeEntities.clear();
+	mNextEntity = 0;
+	mNumEntities = 0;
+}
+
+// compute world bounding spheres and boxes of entities with bounds
+void EntityStore::updateBounds()
+{
+	Bounds* bounds = mBounds.data();
+	const Entity* entities = mBounds.entities();
+
+	for (size_t i = 0; i < mBounds.size(); i++)
+	{
+		glm::vec3 boxCenter = (bounds[i].localMin + bounds[i].localMax) * 0.5f;
+		glm::vec3 extent = bounds[i].localMax - boxCenter;
+
+		if (!mTransforms.has(entities[i]))
+		{
+			bounds[i].worldCenter = bounds[i].localCenter;
+			bounds[i].worldRadius = bounds[i].localRadius;
+			bounds[i].worldMin = bounds[i].localMin;
+			bounds[i].worldMax = bounds[i].localMax;
+			continue;
+		}
+
+		// transform the centre and scale the radius by the largest axis scale
+		const glm::mat4& model = mTransforms.get(entities[i]);
+		float scale2 = std::max(std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+			glm::dot(glm::vec3(model[1]), glm::vec3(model[1]))), glm::dot(glm::vec3(model[2]), glm::vec3(model[2])));
+
+		bounds[i].worldCenter = glm::vec3(model * glm::vec4(bounds[i].localCenter, 1.0f));
+		bounds[i].worldRadius = bounds[i].localRadius * std::sqrt(scale2);
+
+		// the box extent along each world axis is the sum of the absolute transformed local extents
+		glm::vec3 worldExtent = glm::abs(glm::vec3(model[0])) * extent.x
+			+ glm::abs(glm::vec3(model[1])) * extent.y + glm::abs(glm::vec3(model[2])) * extent.z;
+		glm::vec3 worldBoxCenter = glm::vec3(model * glm::vec4(boxCenter, 1.0f));
+		bounds[i].worldMin = worldBoxCenter - worldExtent;
+		bounds[i].worldMax = worldBoxCenter + worldExtent;
+	}
+}
+
+// pack the renderables of entities with transforms and their model matrices in matching order
+void EntityStore::gatherRenderables(std::vector<Renderable>& renderables, std::vector<glm::mat4>& modelMatrices) const
+{
+	renderables.clear();
+	modelMatrices.clear();
+
+	const Renderable* components = mRenderables.data();
+	const Entity* entities = mRenderables.entities();
+
+	for (size_t i = 0; i < mRenderables.size(); i++)
+	{
+		if (!mTransforms.has(entities[i]))
+			continue;
+
+		renderables.push_back(components[i]);
+		modelMatrices.push_back(mTransforms.get(entities[i]));
+	}
+}
+
+// as above, but only for the given entities (e.g. the visible list of the frustum culler)
+void EntityStore::gatherRenderables(const std::vector<Entity>& entities, std::vector<Renderable>& renderables,
+	std::vector<glm::mat4>& modelMatrices) const
+{
+	renderables.clear();
+	modelMatrices.clear();
+
+	for (Entity entity : entities)
+	{
+		if (!mRenderables.has(entity) || !mTransforms.has(entity))
+			continue;
+
+		renderables.push_back(mRenderables.get(entity));
+		modelMatrices.push_back(mTransforms.get(entity));
+	}
+}
@@ -0,0 +1,152 @@
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "utilities.h"
+
+class SimpleModel;
+
+// entity identifier (index into the sparse arrays of every component type)
+typedef uint32_t Entity;
+const uint32_t gInvalidIndex = 0xFFFFFFFF;
+
+// part of a model drawn with one material
+struct Renderable
+{
+	SimpleModel* model;		// model containing the mesh
+	GLuint firstIndex;		// first index of the mesh range
+	GLsizei numIndices;		// number of indices of the mesh range
+	uint32_t material;		// index into the scene's material table
+};
+
+// bounding volume of an entity
+struct Bounds
+{
+	glm::vec3 localMin;		// model space axis aligned bounding box
+	glm::vec3 localMax;
+	glm::vec3 localCenter;	// model space bounding sphere
+	float localRadius;
+	glm::vec3 worldCenter;	// world space bounding sphere (computed by updateBounds)
+	float worldRadius;
+	glm::vec3 worldMin;		// world space axis aligned bounding box (computed by updateBounds)
+	glm::vec3 worldMax;
+};
+
+/*****************************************************************
+ * dense component array with sparse-set lookup
+ * components are packed in a contiguous array (in no particular
+ * entity order) for iteration; a sparse array maps each entity to
+ * its component, and removal moves the last component into the gap
+ *****************************************************************/
+template <typename T>
+class ComponentArray
+{
+public:
+	// add a component to an entity (replaces an existing one)
+	T& add(Entity entity, const T& component)
+	{
+		if (entity >= mSparse.size())
+			mSparse.resize(entity + 1, gInvalidIndex);
+
+		if (mSparse[entity] != gInvalidIndex)
+		{
+			mComponents[mSparse[entity]] = component;
+			return mComponents[mSparse[entity]];
+		}
+
+		mSparse[entity] = static_cast<uint32_t>(mEntities.size());
+		mEntities.push_back(entity);
+		mComponents.push_back(component);
+		return mComponents.back();
+	}
+
+	// remove an entity's component (if it has one)
+	void remove(Entity entity)
+	{
+		if (!has(entity))
+			return;
+
+		// move the last component into the removed component's place
+		uint32_t index = mSparse[entity];
+		Entity last = mEntities.back();
+
+		mComponents[index] = mComponents.back();
+		mEntities[index] = last;
+		mSparse[last] = index;
+
+		mComponents.pop_back();
+		mEntities.pop_back();
+		mSparse[entity] = gInvalidIndex;
+	}
+
+	bool has(Entity entity) const { return entity < mSparse.size() && mSparse[entity] != gInvalidIndex; }
+	T& get(Entity entity) { return mComponents[mSparse[entity]]; }
+	const T& get(Entity entity) const { return mComponents[mSparse[entity]]; }
+
+	// packed components and the entity owning each of them
+	size_t size() const { return mComponents.size(); }
+	T* data() { return mComponents.data(); }
+	const T* data() const { return mComponents.data(); }
+	const Entity* entities() const { return mEntities.data(); }
+
+	void clear()
+	{
+		mSparse.clear();
+		mEntities.clear();
+		mComponents.clear();
+	}
+
+private:
+	std::vector<uint32_t> mSparse;	// entity -> index of its component (gInvalidIndex if none)
+	std::vector<Entity> mEntities;	// component index -> entity
+	std::vector<T> mComponents;		// packed components
+};
+
+/*****************************************************************
+ * entity/component store for scene objects
+ * each component type is stored in its own packed array, so
+ * systems (transform, bounds, culling, render list building) only
+ * touch the data they need
+ *****************************************************************/
+class EntityStore
+{
+public:
+	EntityStore();
+	~EntityStore();
+
+	// create an entity without components (identifiers of destroyed entities are reused)
+	Entity create();
+	// remove an entity and all its components
+	void destroy(Entity entity);
+	// remove all entities
+	void clear();
+	size_t getNumEntities() const { return mNumEntities; }
+
+	// component arrays
+	ComponentArray<glm::mat4>& getTransforms() { return mTransforms; }
+	ComponentArray<Renderable>& getRenderables() { return mRenderables; }
+	ComponentArray<Bounds>& getBounds() { return mBounds; }
+	ComponentArray<Light>& getLights() { return mLights; }
+
+	// compute world bounding spheres and boxes of entities with bounds
+	void updateBounds();
+	// pack the renderables of entities with transforms and their model matrices in matching order
+	void gatherRenderables(std::vector<Renderable>& renderables, std::vector<glm::mat4>& modelMatrices) const;
+	// as above, but only for the given entities (e.g. the visible list of the frustum culler)
+	void gatherRenderables(const std::vector<Entity>& entities, std::vector<Renderable>& renderables,
+		std::vector<glm::mat4>& modelMatrices) const;
+
+private:
+	ComponentArray<glm::mat4> mTransforms;		// model matrices
+	ComponentArray<Renderable> mRenderables;
+	ComponentArray<Bounds> mBounds;
+	ComponentArray<Light> mLights;
+
+	std::vector<Entity> mFreeEntities;	// destroyed identifiers available for reuse
+	Entity mNextEntity = 0;
+	size_t mNumEntities = 0;
+};
+
+#endif
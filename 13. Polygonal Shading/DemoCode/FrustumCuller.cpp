@@ -0,0 +1,170 @@
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FRUSTUM_CULLER_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_CULLER_SSE
+#endif
+
+FrustumCuller::FrustumCuller()
+{}
+
+FrustumCuller::~FrustumCuller()
+{}
+
+// extract the frustum planes from a view-projection matrix
+void FrustumCuller::setFrustum(const glm::mat4& viewProjection)
+{
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	// left, right, bottom, top, near, far
+	mPlanes[0] = row[3] + row[0];
+	mPlanes[1] = row[3] - row[0];
+	mPlanes[2] = row[3] + row[1];
+	mPlanes[3] = row[3] - row[1];
+	mPlanes[4] = row[3] + row[2];
+	mPlanes[5] = row[3] - row[2];
+
+	// normalise so that plane distances are in world units (needed for the sphere radius)
+	for (glm::vec4& plane : mPlanes)
+		plane /= glm::length(glm::vec3(plane));
+}
+
+// test one entity's bounds (scalar path)
+bool FrustumCuller::testBounds(size_t i) const
+{
+	for (const glm::vec4& plane : mPlanes)
+	{
+		// sphere entirely behind the plane
+		if (plane.x * mSphereX[i] + plane.y * mSphereY[i] + plane.z * mSphereZ[i] + plane.w < -mSphereRadius[i])
+			return false;
+
+		// box entirely behind the plane (distance of the corner furthest along the normal)
+		float distance = plane.x * mBoxX[i] + plane.y * mBoxY[i] + plane.z * mBoxZ[i] + plane.w
+			+ std::fabs(plane.x) * mExtentX[i] + std::fabs(plane.y) * mExtentY[i] + std::fabs(plane.z) * mExtentZ[i];
+		if (distance < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+// append the entities whose world bounds intersect the frustum (bounds must be up to date)
+void FrustumCuller::cull(const ComponentArray<Bounds>& bounds, std::vector<Entity>& visible)
+{
+	size_t count = bounds.size();
+	const Bounds* data = bounds.data();
+	const Entity* entities = bounds.entities();
+
+	// copy bounds into SoA arrays
+	mSphereX.resize(count); mSphereY.resize(count); mSphereZ.resize(count); mSphereRadius.resize(count);
+	mBoxX.resize(count); mBoxY.resize(count); mBoxZ.resize(count);
+	mExtentX.resize(count); mExtentY.resize(count); mExtentZ.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		mSphereX[i] = data[i].worldCenter.x;
+		mSphereY[i] = data[i].worldCenter.y;
+		mSphereZ[i] = data[i].worldCenter.z;
+		mSphereRadius[i] = data[i].worldRadius;
+
+		glm::vec3 center = (data[i].worldMin + data[i].worldMax) * 0.5f;
+		glm::vec3 extent = data[i].worldMax - center;
+		mBoxX[i] = center.x;
+		mBoxY[i] = center.y;
+		mBoxZ[i] = center.z;
+		mExtentX[i] = extent.x;
+		mExtentY[i] = extent.y;
+		mExtentZ[i] = extent.z;
+	}
+
+	size_t numVisibleBefore = visible.size();
+	size_t i = 0;
+
+#if defined(FRUSTUM_CULLER_AVX)
+	// eight bounds at a time
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 sphereX = _mm256_loadu_ps(&mSphereX[i]), sphereY = _mm256_loadu_ps(&mSphereY[i]);
+		__m256 sphereZ = _mm256_loadu_ps(&mSphereZ[i]);
+		__m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&mSphereRadius[i]));
+		__m256 boxX = _mm256_loadu_ps(&mBoxX[i]), boxY = _mm256_loadu_ps(&mBoxY[i]), boxZ = _mm256_loadu_ps(&mBoxZ[i]);
+		__m256 extentX = _mm256_loadu_ps(&mExtentX[i]), extentY = _mm256_loadu_ps(&mExtentY[i]);
+		__m256 extentZ = _mm256_loadu_ps(&mExtentZ[i]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+		for (const glm::vec4& plane : mPlanes)
+		{
+			__m256 a = _mm256_set1_ps(plane.x), b = _mm256_set1_ps(plane.y), c = _mm256_set1_ps(plane.z);
+			__m256 d = _mm256_set1_ps(plane.w);
+
+			__m256 sphereDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, sphereX), _mm256_mul_ps(b, sphereY)),
+				_mm256_add_ps(_mm256_mul_ps(c, sphereZ), d));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(sphereDistance, negRadius, _CMP_GE_OQ));
+
+			__m256 boxDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, boxX), _mm256_mul_ps(b, boxY)),
+				_mm256_add_ps(_mm256_mul_ps(c, boxZ), d));
+			__m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.x)), extentX),
+				_mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.y)), extentY)), _mm256_mul_ps(_mm256_set1_ps(std::fabs(plane.z)), extentZ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(boxDistance, reach), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (int j = 0; j < 8; j++)
+		{
+			if (mask & (1 << j))
+				visible.push_back(entities[i + j]);
+		}
+	}
+#elif defined(FRUSTUM_CULLER_SSE)
+	// four bounds at a time
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 sphereX = _mm_loadu_ps(&mSphereX[i]), sphereY = _mm_loadu_ps(&mSphereY[i]), sphereZ = _mm_loadu_ps(&mSphereZ[i]);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&mSphereRadius[i]));
+		__m128 boxX = _mm_loadu_ps(&mBoxX[i]), boxY = _mm_loadu_ps(&mBoxY[i]), boxZ = _mm_loadu_ps(&mBoxZ[i]);
+		__m128 extentX = _mm_loadu_ps(&mExtentX[i]), extentY = _mm_loadu_ps(&mExtentY[i]), extentZ = _mm_loadu_ps(&mExtentZ[i]);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (const glm::vec4& plane : mPlanes)
+		{
+			__m128 a = _mm_set1_ps(plane.x), b = _mm_set1_ps(plane.y), c = _mm_set1_ps(plane.z), d = _mm_set1_ps(plane.w);
+
+			__m128 sphereDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, sphereX), _mm_mul_ps(b, sphereY)),
+				_mm_add_ps(_mm_mul_ps(c, sphereZ), d));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(sphereDistance, negRadius));
+
+			__m128 boxDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, boxX), _mm_mul_ps(b, boxY)),
+				_mm_add_ps(_mm_mul_ps(c, boxZ), d));
+			__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::fabs(plane.x)), extentX),
+				_mm_mul_ps(_mm_set1_ps(std::fabs(plane.y)), extentY)), _mm_mul_ps(_mm_set1_ps(std::fabs(plane.z)), extentZ));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(boxDistance, reach), _mm_setzero_ps()));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int j = 0; j < 4; j++)
+		{
+			if (mask & (1 << j))
+				visible.push_back(entities[i + j]);
+		}
+	}
+#endif
+
+	// remaining bounds (or all of them without SIMD)
+	for (; i < count; i++)
+	{
+		if (testBounds(i))
+			visible.push_back(entities[i]);
+	}
+
+	mNumVisible = static_cast<uint32_t>(visible.size() - numVisibleBefore);
+	mNumCulled = static_cast<uint32_t>(count) - mNumVisible;
+}
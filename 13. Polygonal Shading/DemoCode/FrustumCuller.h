@@ -0,0 +1,48 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "EntityStore.h"
+
+/*****************************************************************
+ * view frustum culling of entity bounds
+ * world bounding spheres and boxes are copied into SoA arrays and
+ * tested against the six frustum planes 4 (SSE) or 8 (AVX) at a
+ * time; an entity is visible if both its sphere and its box
+ * intersect the frustum
+ *****************************************************************/
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+	~FrustumCuller();
+
+	// extract the frustum planes from a view-projection matrix
+	void setFrustum(const glm::mat4& viewProjection);
+	// append the entities whose world bounds intersect the frustum (bounds must be up to date)
+	void cull(const ComponentArray<Bounds>& bounds, std::vector<Entity>& visible);
+
+	// normalised planes (a, b, c, d) with normals pointing into the frustum
+	const glm::vec4* getPlanes() const { return mPlanes; }
+
+	// statistics of the last cull
+	uint32_t getNumVisible() const { return mNumVisible; }
+	uint32_t getNumCulled() const { return mNumCulled; }
+
+private:
+	glm::vec4 mPlanes[6];
+
+	// bounds in SoA layout
+	std::vector<float> mSphereX, mSphereY, mSphereZ, mSphereRadius;
+	std::vector<float> mBoxX, mBoxY, mBoxZ;					// box centres
+	std::vector<float> mExtentX, mExtentY, mExtentZ;		// box half sizes
+
+	uint32_t mNumVisible = 0;
+	uint32_t mNumCulled = 0;
+
+	bool testBounds(size_t i) const;
+};
+
+#endif
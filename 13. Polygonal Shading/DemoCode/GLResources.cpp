@@ -0,0 +1,413 @@
+#include "GLResources.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+// whether resources are edited with direct state access (OpenGL 4.5, or ARB_direct_state_access with the
+// immutable storage extensions its create paths use)
+bool hasDirectStateAccess()
+{
+	return GLEW_VERSION_4_5 || (GLEW_ARB_direct_state_access && GLEW_ARB_buffer_storage && GLEW_ARB_texture_storage);
+}
+
+// pixel format for allocating levels of an internal format without data (bind-based path)
+static GLenum get_base_format(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_R8: case GL_R16F: case GL_R32F: return GL_RED;
+	case GL_RG8: case GL_RG16F: case GL_RG32F: return GL_RG;
+	case GL_RGB8: case GL_SRGB8: case GL_RGB16F: case GL_RGB32F: return GL_RGB;
+	case GL_DEPTH_COMPONENT16: case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F: return GL_DEPTH_COMPONENT;
+	case GL_DEPTH24_STENCIL8: case GL_DEPTH32F_STENCIL8: return GL_DEPTH_STENCIL;
+	default: return GL_RGBA;
+	}
+}
+
+/*****************************************************************
+ * GLBuffer
+ *****************************************************************/
+GLBuffer::GLBuffer()
+{}
+
+GLBuffer::~GLBuffer()
+{
+	release();
+}
+
+GLBuffer::GLBuffer(GLBuffer&& other) : mID(other.mID), mSize(other.mSize)
+{
+	other.mID = 0;
+	other.mSize = 0;
+}
+
+GLBuffer& GLBuffer::operator=(GLBuffer&& other)
+{
+	if (this != &other)
+	{
+		release();
+		std::swap(mID, other.mID);
+		std::swap(mSize, other.mSize);
+	}
+	return *this;
+}
+
+// create storage (replacing any previous buffer); only GL_DYNAMIC_STORAGE_BIT buffers can be updated
+void GLBuffer::create(GLsizeiptr size, const void* data, GLbitfield flags)
+{
+	release();
+	mSize = size;
+
+	if (hasDirectStateAccess())
+	{
+		// immutable storage
+		glCreateBuffers(1, &mID);
+		glNamedBufferStorage(mID, size, data, flags);
+	}
+	else
+	{
+		// edit through the copy write target, which no draw state depends on
+		glGenBuffers(1, &mID);
+		GLStateCache::bindBuffer(GL_COPY_WRITE_BUFFER, mID);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, data, (flags & GL_DYNAMIC_STORAGE_BIT) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+	}
+}
+
+// copy data into part of the buffer
+void GLBuffer::update(GLintptr offset, GLsizeiptr size, const void* data)
+{
+	if (hasDirectStateAccess())
+	{
+		glNamedBufferSubData(mID, offset, size, data);
+	}
+	else
+	{
+		GLStateCache::bindBuffer(GL_COPY_WRITE_BUFFER, mID);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+	}
+}
+
+void GLBuffer::release()
+{
+	if (mID != 0)
+	{
+		glDeleteBuffers(1, &mID);
+		GLStateCache::onDeleteBuffer(mID);
+		mID = 0;
+		mSize = 0;
+	}
+}
+
+/*****************************************************************
+ * GLTexture
+ *****************************************************************/
+GLTexture::GLTexture()
+{}
+
+GLTexture::~GLTexture()
+{
+	release();
+}
+
+GLTexture::GLTexture(GLTexture&& other) : mID(other.mID), mTarget(other.mTarget), mWidth(other.mWidth),
+	mHeight(other.mHeight), mNumLevels(other.mNumLevels)
+{
+	other.mID = 0;
+}
+
+GLTexture& GLTexture::operator=(GLTexture&& other)
+{
+	if (this != &other)
+	{
+		release();
+		std::swap(mID, other.mID);
+		mTarget = other.mTarget;
+		mWidth = other.mWidth;
+		mHeight = other.mHeight;
+		mNumLevels = other.mNumLevels;
+	}
+	return *this;
+}
+
+// number of levels of a full mipmap chain
+GLsizei GLTexture::getMaxLevels(GLsizei width, GLsizei height)
+{
+	return 1 + static_cast<GLsizei>(std::floor(std::log2(static_cast<float>(std::max(width, height)))));
+}
+
+// bind to texture unit 0 for editing (bind-based path)
+void GLTexture::bindForEdit() const
+{
+	GLStateCache::bindTexture(0, mTarget, mID);
+}
+
+// create a 2D texture with storage for a number of mipmap levels (replacing any previous texture)
+void GLTexture::create2D(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei levels)
+{
+	release();
+	mTarget = GL_TEXTURE_2D;
+	mWidth = width;
+	mHeight = height;
+	mNumLevels = levels;
+
+	if (hasDirectStateAccess())
+	{
+		// immutable storage
+		glCreateTextures(mTarget, 1, &mID);
+		glTextureStorage2D(mID, levels, internalFormat, width, height);
+	}
+	else
+	{
+		// allocate each level and limit sampling to them
+		glGenTextures(1, &mID);
+		bindForEdit();
+		for (GLint level = 0; level < levels; level++)
+		{
+			glTexImage2D(mTarget, level, internalFormat, std::max(1, width >> level), std::max(1, height >> level), 0,
+				get_base_format(internalFormat), GL_UNSIGNED_BYTE, nullptr);
+		}
+		glTexParameteri(mTarget, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	}
+}
+
+// copy pixels into a whole mipmap level
+void GLTexture::setImage(GLint level, GLenum format, GLenum type, const void* pixels)
+{
+	GLsizei width = std::max(1, mWidth >> level);
+	GLsizei height = std::max(1, mHeight >> level);
+
+	if (hasDirectStateAccess())
+	{
+		glTextureSubImage2D(mID, level, 0, 0, width, height, format, type, pixels);
+	}
+	else
+	{
+		bindForEdit();
+		glTexSubImage2D(mTarget, level, 0, 0, width, height, format, type, pixels);
+	}
+}
+
+// compute levels 1 and up from level 0
+void GLTexture::generateMipmap()
+{
+	if (hasDirectStateAccess())
+	{
+		glGenerateTextureMipmap(mID);
+	}
+	else
+	{
+		bindForEdit();
+		glGenerateMipmap(mTarget);
+	}
+}
+
+// set texture parameters
+void GLTexture::setParameter(GLenum name, GLint value)
+{
+	if (hasDirectStateAccess())
+	{
+		glTextureParameteri(mID, name, value);
+	}
+	else
+	{
+		bindForEdit();
+		glTexParameteri(mTarget, name, value);
+	}
+}
+
+void GLTexture::setParameter(GLenum name, const GLfloat* values)
+{
+	if (hasDirectStateAccess())
+	{
+		glTextureParameterfv(mID, name, values);
+	}
+	else
+	{
+		bindForEdit();
+		glTexParameterfv(mTarget, name, values);
+	}
+}
+
+// bind to a texture unit (0, 1, 2, ...)
+void GLTexture::bind(GLuint unit) const
+{
+	GLStateCache::bindTexture(unit, mTarget, mID);
+}
+
+void GLTexture::release()
+{
+	if (mID != 0)
+	{
+		glDeleteTextures(1, &mID);
+		GLStateCache::onDeleteTexture(mID);
+		mID = 0;
+	}
+}
+
+/*****************************************************************
+ * GLVertexArray
+ *****************************************************************/
+GLVertexArray::GLVertexArray()
+{}
+
+GLVertexArray::~GLVertexArray()
+{
+	release();
+}
+
+GLVertexArray::GLVertexArray(GLVertexArray&& other) : mID(other.mID)
+{
+	std::copy(other.mBindings, other.mBindings + sMaxBindings, mBindings);
+	std::copy(other.mAttributes, other.mAttributes + sMaxBindings, mAttributes);
+	other.mID = 0;
+}
+
+GLVertexArray& GLVertexArray::operator=(GLVertexArray&& other)
+{
+	if (this != &other)
+	{
+		release();
+		std::swap(mID, other.mID);
+		std::copy(other.mBindings, other.mBindings + sMaxBindings, mBindings);
+		std::copy(other.mAttributes, other.mAttributes + sMaxBindings, mAttributes);
+	}
+	return *this;
+}
+
+// create an empty vertex array (replacing any previous one)
+void GLVertexArray::create()
+{
+	release();
+
+	if (hasDirectStateAccess())
+		glCreateVertexArrays(1, &mID);
+	else
+		glGenVertexArrays(1, &mID);
+}
+
+// attach a vertex buffer to a binding point (set before the attributes reading from it)
+void GLVertexArray::setVertexBuffer(GLuint binding, const GLBuffer& buffer, GLintptr offset, GLsizei stride)
+{
+	if (hasDirectStateAccess())
+	{
+		glVertexArrayVertexBuffer(mID, binding, buffer.getID(), offset, stride);
+	}
+	else
+	{
+		// applied when attributes are set, and again to the attributes already reading from it
+		mBindings[binding].buffer = buffer.getID();
+		mBindings[binding].offset = offset;
+		mBindings[binding].stride = stride;
+		for (GLuint attribute = 0; attribute < sMaxBindings; attribute++)
+		{
+			if (mAttributes[attribute].binding == static_cast<GLint>(binding))
+				applyAttribute(attribute);
+		}
+	}
+}
+
+// attach the index buffer
+void GLVertexArray::setIndexBuffer(const GLBuffer& buffer)
+{
+	if (hasDirectStateAccess())
+	{
+		glVertexArrayElementBuffer(mID, buffer.getID());
+	}
+	else
+	{
+		bind();
+		GLStateCache::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.getID());
+	}
+}
+
+// enable an attribute read from a binding point (floating point)
+void GLVertexArray::setAttribute(GLuint attribute, GLuint binding, GLint size, GLenum type, GLboolean normalized,
+	GLuint relativeOffset)
+{
+	if (hasDirectStateAccess())
+	{
+		glEnableVertexArrayAttrib(mID, attribute);
+		glVertexArrayAttribFormat(mID, attribute, size, type, normalized, relativeOffset);
+		glVertexArrayAttribBinding(mID, attribute, binding);
+	}
+	else
+	{
+		mAttributes[attribute] = { static_cast<GLint>(binding), size, type, normalized, false, relativeOffset };
+		applyAttribute(attribute);
+		glEnableVertexAttribArray(attribute);
+	}
+}
+
+// enable an attribute read from a binding point (integer)
+void GLVertexArray::setIntegerAttribute(GLuint attribute, GLuint binding, GLint size, GLenum type, GLuint relativeOffset)
+{
+	if (hasDirectStateAccess())
+	{
+		glEnableVertexArrayAttrib(mID, attribute);
+		glVertexArrayAttribIFormat(mID, attribute, size, type, relativeOffset);
+		glVertexArrayAttribBinding(mID, attribute, binding);
+	}
+	else
+	{
+		mAttributes[attribute] = { static_cast<GLint>(binding), size, type, GL_FALSE, true, relativeOffset };
+		applyAttribute(attribute);
+		glEnableVertexAttribArray(attribute);
+	}
+}
+
+// advance a binding point per instance instead of per vertex
+void GLVertexArray::setBindingDivisor(GLuint binding, GLuint divisor)
+{
+	if (hasDirectStateAccess())
+	{
+		glVertexArrayBindingDivisor(mID, binding, divisor);
+	}
+	else
+	{
+		// divisors are per attribute without vertex attribute bindings
+		mBindings[binding].divisor = divisor;
+		for (GLuint attribute = 0; attribute < sMaxBindings; attribute++)
+		{
+			if (mAttributes[attribute].binding == static_cast<GLint>(binding))
+			{
+				bind();
+				glVertexAttribDivisor(attribute, divisor);
+			}
+		}
+	}
+}
+
+// specify an attribute's pointer from its binding point (bind-based path)
+void GLVertexArray::applyAttribute(GLuint attribute)
+{
+	const Attribute& format = mAttributes[attribute];
+	const Binding& source = mBindings[format.binding];
+	void* pointer = reinterpret_cast<void*>(source.offset + format.relativeOffset);
+
+	bind();
+	GLStateCache::bindBuffer(GL_ARRAY_BUFFER, source.buffer);
+	if (format.integer)
+		glVertexAttribIPointer(attribute, format.size, format.type, source.stride, pointer);
+	else
+		glVertexAttribPointer(attribute, format.size, format.type, format.normalized, source.stride, pointer);
+	glVertexAttribDivisor(attribute, source.divisor);
+}
+
+// make active
+void GLVertexArray::bind() const
+{
+	GLStateCache::bindVertexArray(mID);
+}
+
+void GLVertexArray::release()
+{
+	if (mID != 0)
+	{
+		glDeleteVertexArrays(1, &mID);
+		GLStateCache::onDeleteVertexArray(mID);
+		mID = 0;
+	}
+	std::fill(mBindings, mBindings + sMaxBindings, Binding());
+	std::fill(mAttributes, mAttributes + sMaxBindings, Attribute());
+}
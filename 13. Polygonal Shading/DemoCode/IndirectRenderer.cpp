@@ -0,0 +1,269 @@
+#include "IndirectRenderer.h"
+
+#include "FrustumCuller.h"
+#include "GLStateCache.h"
+#include "MatrixBatch.h"
+
+// work group size of the culling compute shader
+const GLuint gCullGroupSize = 64;
+
+IndirectRenderer::IndirectRenderer()
+{}
+
+IndirectRenderer::~IndirectRenderer()
+{
+	for (GLsync fence : mFences)
+	{
+		if (fence != 0)
+			glDeleteSync(fence);
+	}
+
+	// delete buffers
+	GLuint buffers[] = { mDrawObjectBuffer, mObjectDataBuffer, mMaterialBuffer,
+		mCommandBuffer, mCounterBuffers[0], mCounterBuffers[1] };
+	for (GLuint buffer : buffers)
+	{
+		if (buffer != 0)
+		{
+			glDeleteBuffers(1, &buffer);
+			GLStateCache::onDeleteBuffer(buffer);
+		}
+	}
+}
+
+// whether the current context supports GPU-driven rendering
+// (the shaders are #version 430, so the extensions alone are not enough)
+bool IndirectRenderer::isSupported()
+{
+	return GLEW_VERSION_4_3;
+}
+
+// compile shaders and create buffers for drawing the model
+void IndirectRenderer::init(SimpleModel& model)
+{
+	mModel = &model;
+
+	mCullShader.compileAndLink("cullDraws.comp");
+	mDrawShader.compileAndLink("indirectPhong.vert", "indirectPhong.frag");
+	mPlanesLocation = mCullShader.getUniformLocation("uPlanes");
+
+	glGenBuffers(1, &mDrawObjectBuffer);
+	glGenBuffers(1, &mObjectDataBuffer);
+	glGenBuffers(1, &mMaterialBuffer);
+	glGenBuffers(1, &mCommandBuffer);
+	glGenBuffers(2, mCounterBuffers);
+
+	for (GLuint counter : mCounterBuffers)
+	{
+		GLuint zero = 0;
+		GLStateCache::bindBuffer(GL_SHADER_STORAGE_BUFFER, counter);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_READ);
+	}
+
+	// the VAO is created once the object index buffer exists (see reserve)
+}
+
+// create VAO with the model's buffers and an instanced object index
+void IndirectRenderer::createVertexArray()
+{
+	const Mesh& mesh = mModel->getMesh();
+	mVAO.create();
+	mVAO.setVertexBuffer(0, mesh.VBO, 0, sizeof(VertexNormal));
+	mVAO.setVertexBuffer(1, mObjectIndexVBO, 0, sizeof(GLuint));
+	mVAO.setIndexBuffer(mesh.IBO);
+	mVAO.setAttribute(0, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormal, position));
+	mVAO.setAttribute(1, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormal, normal));
+	mVAO.setIntegerAttribute(2, 1, 1, GL_UNSIGNED_INT, 0);
+	mVAO.setBindingDivisor(1, 1);	// advance once per instance (starting at the base instance)
+}
+
+// upload the material table (indexed by Renderable::material)
+void IndirectRenderer::setMaterials(const std::vector<Material>& materials)
+{
+	std::vector<MaterialData> data(materials.size());
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		data[i].Ka = glm::vec4(materials[i].Ka, 1.0f);
+		data[i].Kd = glm::vec4(materials[i].Kd, 1.0f);
+		data[i].Ks = glm::vec4(materials[i].Ks, materials[i].shininess);
+	}
+
+	GLStateCache::bindBuffer(GL_SHADER_STORAGE_BUFFER, mMaterialBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, data.size() * sizeof(MaterialData), data.data(), GL_STATIC_DRAW);
+}
+
+// grow the per-object buffers
+void IndirectRenderer::reserve(uint32_t numObjects)
+{
+	if (numObjects <= mCapacity)
+		return;
+
+	mCapacity = glm::max(numObjects, mCapacity * 2);
+
+	// object indices 0, 1, 2, ...
+	std::vector<GLuint> indices(mCapacity);
+	for (GLuint i = 0; i < mCapacity; i++)
+		indices[i] = i;
+
+	// the immutable index buffer is replaced, so the VAO is rebuilt to read from it
+	mObjectIndexVBO.create(indices.size() * sizeof(GLuint), indices.data());
+	createVertexArray();
+
+	GLStateCache::bindBuffer(GL_SHADER_STORAGE_BUFFER, mDrawObjectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, mCapacity * sizeof(DrawObject), nullptr, GL_DYNAMIC_DRAW);
+	GLStateCache::bindBuffer(GL_SHADER_STORAGE_BUFFER, mObjectDataBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, mCapacity * sizeof(ObjectData), nullptr, GL_DYNAMIC_DRAW);
+	GLStateCache::bindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, mCapacity * 5 * sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+}
+
+// upload the objects of the scene that use the model (bounds must be up to date)
+void IndirectRenderer::update(EntityStore& scene)
+{
+	mRenderables.clear();
+	mModelMatrices.clear();
+	mDrawObjects.clear();
+
+	// gather objects drawn with the model
+	ComponentArray<Renderable>& renderables = scene.getRenderables();
+	ComponentArray<glm::mat4>& transforms = scene.getTransforms();
+	ComponentArray<Bounds>& bounds = scene.getBounds();
+
+	for (size_t i = 0; i < renderables.size(); i++)
+	{
+		Entity entity = renderables.entities()[i];
+		const Renderable& renderable = renderables.data()[i];
+
+		if (renderable.model != mModel || !transforms.has(entity) || !bounds.has(entity))
+			continue;
+
+		const Bounds& entityBounds = bounds.get(entity);
+		DrawObject object = { glm::vec4(entityBounds.worldCenter, entityBounds.worldRadius),
+			glm::vec4(0.5f * (entityBounds.worldMin + entityBounds.worldMax), 0.0f),
+			glm::vec4(0.5f * (entityBounds.worldMax - entityBounds.worldMin), 0.0f),
+			renderable.firstIndex, static_cast<GLuint>(renderable.numIndices), renderable.material, 0 };
+
+		mDrawObjects.push_back(object);
+		mRenderables.push_back(renderable);
+		mModelMatrices.push_back(transforms.get(entity));
+	}
+
+	mNumObjects = static_cast<uint32_t>(mDrawObjects.size());
+	if (mNumObjects == 0)
+		return;
+
+	// per-object matrices
+	mNormalMatrices.resize(mNumObjects);
+	computeNormalMatrices(mModelMatrices.data(), mNormalMatrices.data(), mNumObjects);
+
+	mObjectData.resize(mNumObjects);
+	for (uint32_t i = 0; i < mNumObjects; i++)
+	{
+		mObjectData[i].modelMatrix = mModelMatrices[i];
+		mObjectData[i].normalMatrix = glm::mat4(mNormalMatrices[i]);
+		mObjectData[i].material = mRenderables[i].material;
+	}
+
+	// copy to the GPU
+	reserve(mNumObjects);
+
+	GLStateCache::bindBuffer(GL_SHADER_STORAGE_BUFFER, mDrawObjectBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, mNumObjects * sizeof(DrawObject), mDrawObjects.data());
+	GLStateCache::bindBuffer(GL_SHADER_STORAGE_BUFFER, mObjectDataBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, mNumObjects * sizeof(ObjectData), mObjectData.data());
+}
+
+// copy a completed visible object count
+void IndirectRenderer::readCounter(int slot)
+{
+	GLStateCache::bindBuffer(GL_SHADER_STORAGE_BUFFER, mCounterBuffers[slot]);
+	const GLuint* data = static_cast<const GLuint*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), GL_MAP_READ_BIT));
+
+	if (data != nullptr)
+	{
+		mNumVisible = *data;
+		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+	}
+}
+
+// frustum cull the objects on the GPU and write the draw commands
+void IndirectRenderer::cull(const glm::mat4& viewProjection)
+{
+	if (mNumObjects == 0)
+		return;
+
+	int slot = static_cast<int>(mFrame++ % 2);
+	GLuint counter = mCounterBuffers[slot];
+
+	// use completed counts without waiting (the slot about to be reused is the older one)
+	for (int i : { slot, 1 - slot })
+	{
+		if (mFences[i] == 0)
+			continue;
+
+		GLenum status = glClientWaitSync(mFences[i], 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			readCounter(i);
+			glDeleteSync(mFences[i]);
+			mFences[i] = 0;
+		}
+	}
+
+	// drop a count that is still being written after two frames
+	if (mFences[slot] != 0)
+	{
+		glDeleteSync(mFences[slot]);
+		mFences[slot] = 0;
+	}
+
+	// reset this frame's counter
+	GLuint zero = 0;
+	GLStateCache::bindBuffer(GL_SHADER_STORAGE_BUFFER, counter);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+
+	// normalised frustum planes
+	FrustumCuller frustum;
+	frustum.setFrustum(viewProjection);
+
+	mCullShader.use();
+	glUniform4fv(mPlanesLocation, 6, &frustum.getPlanes()[0][0]);
+	mCullShader.setUniform("uNumObjects", static_cast<int>(mNumObjects));
+
+	GLStateCache::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mDrawObjectBuffer);
+	GLStateCache::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mCommandBuffer);
+	GLStateCache::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, counter);
+
+	glDispatchCompute((mNumObjects + gCullGroupSize - 1) / gCullGroupSize, 1, 1);
+
+	// make the commands visible to the indirect draw and the count to the readback
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	mFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// draw the visible objects with one call
+void IndirectRenderer::draw(const glm::mat4& viewProjection, const Light& light, const glm::vec3& viewpoint)
+{
+	if (mNumObjects == 0)
+		return;
+
+	mDrawShader.use();
+
+	// set light properties
+	mDrawShader.setUniform("uLight.pos", light.pos);
+	mDrawShader.setUniform("uLight.La", light.La);
+	mDrawShader.setUniform("uLight.Ld", light.Ld);
+	mDrawShader.setUniform("uLight.Ls", light.Ls);
+
+	// set viewing position and view-projection matrix
+	mDrawShader.setUniform("uViewpoint", viewpoint);
+	mDrawShader.setUniform("uViewProjectionMatrix", viewProjection);
+
+	GLStateCache::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, mObjectDataBuffer);
+	GLStateCache::bindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mMaterialBuffer);
+
+	// one command per object (culled objects have no instances)
+	mVAO.bind();
+	GLStateCache::bindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, mNumObjects, 0);
+}
@@ -0,0 +1,107 @@
+#ifndef INDIRECT_RENDERER_H
+#define INDIRECT_RENDERER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "utilities.h"
+#include "EntityStore.h"
+#include "SimpleModel.h"
+
+/*****************************************************************
+ * GPU-driven renderer for the submeshes of one model
+ * a compute shader frustum culls every object (entity with a
+ * renderable, transform and bounds) against its bounding sphere
+ * and box, as FrustumCuller does, and writes one indirect draw
+ * command per object; all objects are then drawn with a single
+ * glMultiDrawElementsIndirect call, where each command's base
+ * instance selects the object's matrices and material
+ * requires OpenGL 4.3 (compute shaders, storage buffers and
+ * multi-draw indirect)
+ *****************************************************************/
+class IndirectRenderer
+{
+public:
+	IndirectRenderer();
+	~IndirectRenderer();
+
+	// whether the current context supports GPU-driven rendering
+	static bool isSupported();
+
+	// compile shaders and create buffers for drawing the model
+	void init(SimpleModel& model);
+	// upload the material table (indexed by Renderable::material)
+	void setMaterials(const std::vector<Material>& materials);
+	// upload the objects of the scene that use the model (bounds must be up to date)
+	void update(EntityStore& scene);
+	// frustum cull the objects on the GPU and write the draw commands
+	void cull(const glm::mat4& viewProjection);
+	// draw the visible objects with one call
+	void draw(const glm::mat4& viewProjection, const Light& light, const glm::vec3& viewpoint);
+
+	uint32_t getNumObjects() const { return mNumObjects; }
+	// number of visible objects (read back a frame or two late, once the culling has finished)
+	uint32_t getNumVisible() const { return mNumVisible; }
+
+private:
+	// matches DrawObject in cullDraws.comp
+	struct DrawObject
+	{
+		glm::vec4 sphere;
+		glm::vec4 boxCenter;
+		glm::vec4 boxExtent;
+		GLuint firstIndex;
+		GLuint numIndices;
+		GLuint material;
+		GLuint padding;
+	};
+
+	// matches ObjectData in indirectPhong.vert
+	struct ObjectData
+	{
+		glm::mat4 modelMatrix;
+		glm::mat4 normalMatrix;
+		GLuint material;
+		GLuint padding[3];
+	};
+
+	// matches Material in indirectPhong.frag
+	struct MaterialData
+	{
+		glm::vec4 Ka;
+		glm::vec4 Kd;
+		glm::vec4 Ks;	// shininess in w
+	};
+
+	SimpleModel* mModel = nullptr;
+	ShaderProgram mCullShader;
+	ShaderProgram mDrawShader;
+
+	GLVertexArray mVAO;				// model buffers plus the per-instance object index
+	GLBuffer mObjectIndexVBO;		// 0, 1, 2, ... (read at the draw's base instance)
+	GLuint mDrawObjectBuffer = 0;	// culling input
+	GLuint mObjectDataBuffer = 0;	// per-object matrices and material
+	GLuint mMaterialBuffer = 0;
+	GLuint mCommandBuffer = 0;		// indirect draw commands
+	GLuint mCounterBuffers[2] = {};	// visible object counts (alternating frames)
+	GLsync mFences[2] = {};			// signalled when a frame's count has been written
+	GLint mPlanesLocation = -1;		// uPlanes in the culling shader
+
+	uint32_t mNumObjects = 0;
+	uint32_t mCapacity = 0;			// objects the buffers can hold
+	uint32_t mNumVisible = 0;
+	uint64_t mFrame = 0;
+
+	// scratch arrays for update
+	std::vector<Renderable> mRenderables;
+	std::vector<glm::mat4> mModelMatrices;
+	std::vector<glm::mat3> mNormalMatrices;
+	std::vector<DrawObject> mDrawObjects;
+	std::vector<ObjectData> mObjectData;
+
+	void reserve(uint32_t numObjects);
+	void readCounter(int slot);
+	void createVertexArray();
+};
+
+#endif
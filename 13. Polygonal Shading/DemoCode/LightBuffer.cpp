@@ -0,0 +1,60 @@
+#include "LightBuffer.h"
+
+#include <cmath>
+
+#include "GLStateCache.h"
+
+// whether the current context supports shader storage buffers
+// (the shaders are #version 430, so the extension alone is not enough)
+bool LightBuffer::isSupported()
+{
+	return GLEW_VERSION_4_3;
+}
+
+// pack lights (lights of type 0 are skipped) and copy them to the buffer, growing it if needed
+void LightBuffer::update(const Light* lights, size_t numLights)
+{
+	mData.clear();
+	for (size_t i = 0; i < numLights; i++)
+	{
+		const Light& light = lights[i];
+		if (light.type == 0)
+			continue;
+
+		LightData data = {};
+		data.pos = glm::vec4(light.pos, static_cast<float>(light.type));
+		data.dir = glm::vec4(light.type == 1 ? glm::vec3(0.0f) : glm::normalize(light.dir), 0.0f);
+		data.La = glm::vec4(light.La, 1.0f);
+		data.Ld = glm::vec4(light.Ld, 1.0f);
+		data.Ls = glm::vec4(light.Ls, 1.0f);
+		data.att = glm::vec4(light.att, 0.0f);
+		data.cosInnerAngle = std::cos(glm::radians(light.innerAngle));
+		data.cosOuterAngle = std::cos(glm::radians(light.outerAngle));
+		mData.push_back(data);
+	}
+	mNumLights = static_cast<uint32_t>(mData.size());
+
+	// the buffer is never empty, so that binding it is always valid
+	if (mNumLights > mCapacity || mBuffer.getID() == 0)
+	{
+		mCapacity = glm::max(glm::max(mNumLights, mCapacity * 2), 16u);
+		mBuffer.create(mCapacity * sizeof(LightData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	// one copy of the whole array
+	if (mNumLights > 0)
+		mBuffer.update(0, mNumLights * sizeof(LightData), mData.data());
+}
+
+// bind the buffer to a storage buffer binding point
+void LightBuffer::bind(GLuint binding) const
+{
+	GLStateCache::bindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, mBuffer.getID());
+}
+
+void LightBuffer::release()
+{
+	mBuffer.release();
+	mCapacity = 0;
+	mNumLights = 0;
+}
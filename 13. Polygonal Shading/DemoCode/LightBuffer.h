@@ -0,0 +1,53 @@
+#ifndef LIGHT_BUFFER_H
+#define LIGHT_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "utilities.h"
+#include "GLResources.h"
+
+/*****************************************************************
+ * array of lights in a shader storage buffer
+ * every light (point, directional or spotlight) is packed into a
+ * fixed size record, so one fragment shader can loop over any
+ * number of lights instead of taking a single uLight uniform; the
+ * whole array is copied with one buffer update per call
+ * requires OpenGL 4.3 (shader storage buffers)
+ *****************************************************************/
+class LightBuffer
+{
+public:
+	// whether the current context supports shader storage buffers
+	static bool isSupported();
+
+	// pack lights (lights of type 0 are skipped) and copy them to the buffer, growing it if needed
+	void update(const Light* lights, size_t numLights);
+	// bind the buffer to a storage buffer binding point
+	void bind(GLuint binding) const;
+	void release();
+
+	uint32_t getNumLights() const { return mNumLights; }
+
+private:
+	// matches Light in multiLightPhong.frag (std430)
+	struct LightData
+	{
+		glm::vec4 pos;			// type in w
+		glm::vec4 dir;			// normalised
+		glm::vec4 La;
+		glm::vec4 Ld;
+		glm::vec4 Ls;
+		glm::vec4 att;			// constant, linear, quadratic
+		float cosInnerAngle;	// spotlight cone
+		float cosOuterAngle;
+		float padding[2];
+	};
+
+	GLBuffer mBuffer;
+	uint32_t mCapacity = 0;		// lights the buffer can hold
+	uint32_t mNumLights = 0;
+	std::vector<LightData> mData;	// scratch array for update
+};
+
+#endif
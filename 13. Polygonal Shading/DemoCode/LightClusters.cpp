@@ -0,0 +1,289 @@
+#include "LightClusters.h"
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include "GLStateCache.h"
+
+// view lights binned per thread (fewer lights are binned on the calling thread)
+const size_t gLightsPerThread = 64;
+
+LightClusters::LightClusters(uint32_t tilesX, uint32_t tilesY, uint32_t numSlices)
+	: mTilesX(tilesX), mTilesY(tilesY), mNumSlices(numSlices)
+{
+	mSlices.resize(mNumSlices);
+	mGridData.resize(getNumClusters() * 2);
+}
+
+// distance beyond which a light's attenuated intensity is below a threshold (infinite without attenuation)
+float LightClusters::getInfluenceRadius(const Light& light, float threshold)
+{
+	// solve constant + linear * d + quadratic * d^2 = intensity / threshold
+	float intensity = glm::max(glm::max(glm::max(light.Ld.r, light.Ld.g), glm::max(light.Ld.b, light.Ls.r)),
+		glm::max(light.Ls.g, light.Ls.b));
+	float c = light.att.x - intensity / threshold;
+	float l = light.att.y;
+	float q = light.att.z;
+
+	if (c >= 0.0f)
+		return 0.0f;		// too dim everywhere
+	if (q > 0.0f)
+		return (-l + std::sqrt(l * l - 4.0f * q * c)) / (2.0f * q);
+	if (l > 0.0f)
+		return -c / l;
+	return std::numeric_limits<float>::infinity();
+}
+
+// world space sphere (centre, radius) around the lit volume of a point light or spotlight
+glm::vec4 LightClusters::getBoundingSphere(const Light& light, float threshold)
+{
+	float radius = getInfluenceRadius(light, threshold);
+	if (light.type != 3 || std::isinf(radius))
+		return glm::vec4(light.pos, radius);
+
+	// cone of the outer angle and the influence radius: a narrow cone is bounded by the sphere through its
+	// apex and base circle, a wide one by the sphere around its base circle
+	float angle = glm::radians(light.outerAngle);
+	if (angle >= glm::radians(90.0f))
+		return glm::vec4(light.pos, radius);
+
+	float cosAngle = std::cos(angle);
+	glm::vec3 axis = glm::normalize(light.dir);
+	if (angle < glm::radians(45.0f))
+	{
+		float sphereRadius = radius / (2.0f * cosAngle);
+		return glm::vec4(light.pos + axis * sphereRadius, sphereRadius);
+	}
+	return glm::vec4(light.pos + axis * (radius * cosAngle), radius * std::sin(angle));
+}
+
+// copy the lights (lights of type 0 are skipped) and bin them into the clusters of a perspective
+// projection on a number of threads (0 = one per hardware thread)
+void LightClusters::update(const Light* lights, size_t numLights, const glm::mat4& view, const glm::mat4& projection,
+	unsigned numThreads)
+{
+	mLights.update(lights, numLights);
+
+	// depth range and slices of the projection
+	mNear = projection[3][2] / (projection[2][2] - 1.0f);
+	mFar = projection[3][2] / (projection[2][2] + 1.0f);
+	mSliceScale = mNumSlices / std::log(mFar / mNear);
+	mSliceBias = -std::log(mNear) * mSliceScale;
+
+	// planes through the eye and the tile edges in normalised device coordinates
+	mColumnPlanes.resize(mTilesX + 1);
+	for (uint32_t x = 0; x <= mTilesX; x++)
+	{
+		float edge = -1.0f + 2.0f * x / mTilesX;
+		mColumnPlanes[x] = glm::normalize(glm::vec3(projection[0][0], 0.0f, projection[2][0] + edge));
+	}
+	mRowPlanes.resize(mTilesY + 1);
+	for (uint32_t y = 0; y <= mTilesY; y++)
+	{
+		float edge = -1.0f + 2.0f * y / mTilesY;
+		mRowPlanes[y] = glm::normalize(glm::vec3(0.0f, projection[1][1], projection[2][1] + edge));
+	}
+
+	// bounding spheres of the lights in view space (in light buffer order)
+	mViewLights.clear();
+	mAmbient = glm::vec3(0.0f);
+	uint32_t index = 0;
+	for (size_t i = 0; i < numLights; i++)
+	{
+		const Light& light = lights[i];
+		if (light.type == 0)
+			continue;
+
+		mAmbient += light.La;
+
+		ViewLight viewLight;
+		viewLight.index = index++;
+		if (light.type == 2)
+		{
+			// directional lights reach every cluster
+			viewLight.center = glm::vec3(0.0f);
+			viewLight.radius = std::numeric_limits<float>::infinity();
+		}
+		else
+		{
+			glm::vec4 sphere = getBoundingSphere(light);
+			viewLight.center = glm::vec3(view * glm::vec4(glm::vec3(sphere), 1.0f));
+			viewLight.radius = sphere.w;
+		}
+		viewLight.depth = -viewLight.center.z;
+
+		// outside the depth range
+		if (viewLight.radius <= 0.0f || viewLight.depth + viewLight.radius < mNear || viewLight.depth - viewLight.radius > mFar)
+			continue;
+
+		mViewLights.push_back(viewLight);
+	}
+
+	// slices are handed out to the threads
+	std::atomic<uint32_t> nextSlice(0);
+	auto binSlices = [&]()
+	{
+		for (uint32_t slice = nextSlice++; slice < mNumSlices; slice = nextSlice++)
+			binSlice(slice);
+	};
+
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	numThreads = std::min(numThreads, static_cast<unsigned>(mViewLights.size() / gLightsPerThread + 1));
+	numThreads = std::min(numThreads, mNumSlices);
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < numThreads; i++)
+		threads.emplace_back(binSlices);
+	binSlices();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	// join the lists of all slices
+	mIndexData.clear();
+	mMaxClusterLights = 0;
+	const uint32_t numTiles = mTilesX * mTilesY;
+	for (uint32_t slice = 0; slice < mNumSlices; slice++)
+	{
+		const Slice& lists = mSlices[slice];
+		GLuint base = static_cast<GLuint>(mIndexData.size());
+		for (uint32_t tile = 0; tile < numTiles; tile++)
+		{
+			size_t cluster = static_cast<size_t>(slice) * numTiles + tile;
+			mGridData[cluster * 2] = base + lists.offsets[tile];
+			mGridData[cluster * 2 + 1] = lists.counts[tile];
+			mMaxClusterLights = std::max(mMaxClusterLights, lists.counts[tile]);
+		}
+		mIndexData.insert(mIndexData.end(), lists.indices.begin(), lists.indices.end());
+	}
+
+	// copy to the GPU (the index buffer grows, and is never empty so that binding it is always valid)
+	if (mGrid.getID() == 0)
+		mGrid.create(mGridData.size() * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	mGrid.update(0, mGridData.size() * sizeof(GLuint), mGridData.data());
+
+	uint32_t numIndices = static_cast<uint32_t>(mIndexData.size());
+	if (numIndices > mIndexCapacity || mIndices.getID() == 0)
+	{
+		mIndexCapacity = std::max(std::max(numIndices, mIndexCapacity * 2), 1024u);
+		mIndices.create(mIndexCapacity * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+	if (numIndices > 0)
+		mIndices.update(0, numIndices * sizeof(GLuint), mIndexData.data());
+}
+
+// first and last tile (columns or rows) overlapped by a view space sphere
+bool LightClusters::getTileRange(const std::vector<glm::vec3>& planes, const glm::vec3& center, float radius,
+	uint32_t& first, uint32_t& last)
+{
+	const uint32_t numTiles = static_cast<uint32_t>(planes.size()) - 1;
+	first = numTiles;
+	last = 0;
+
+	for (uint32_t tile = 0; tile < numTiles; tile++)
+	{
+		// on the inner side of both edges
+		if (glm::dot(planes[tile], center) > -radius && glm::dot(planes[tile + 1], center) < radius)
+		{
+			first = std::min(first, tile);
+			last = tile;
+		}
+	}
+	return first <= last;
+}
+
+// bin the view lights into the clusters of a slice
+void LightClusters::binSlice(uint32_t slice)
+{
+	Slice& lists = mSlices[slice];
+	const uint32_t numTiles = mTilesX * mTilesY;
+	lists.counts.assign(numTiles, 0);
+	lists.offsets.resize(numTiles);
+	lists.ranges.clear();
+
+	// depth range of the slice
+	float sliceNear = std::exp((slice - mSliceBias) / mSliceScale);
+	float sliceFar = std::exp((slice + 1 - mSliceBias) / mSliceScale);
+
+	for (const ViewLight& light : mViewLights)
+	{
+		if (light.depth + light.radius < sliceNear || light.depth - light.radius > sliceFar)
+			continue;
+
+		// the part of the sphere inside the slice lies within a smaller sphere around the point of the
+		// light's axis nearest the slice
+		glm::vec3 center = light.center;
+		float radius = light.radius;
+		float distance = 0.0f;
+		if (light.depth < sliceNear)
+			distance = sliceNear - light.depth;
+		else if (light.depth > sliceFar)
+			distance = sliceFar - light.depth;
+		if (distance != 0.0f)
+		{
+			center.z -= distance;
+			radius = std::sqrt(radius * radius - distance * distance);
+		}
+
+		TileRange range;
+		range.index = light.index;
+		if (!getTileRange(mColumnPlanes, center, radius, range.firstX, range.lastX) ||
+			!getTileRange(mRowPlanes, center, radius, range.firstY, range.lastY))
+			continue;
+
+		lists.ranges.push_back(range);
+		for (uint32_t y = range.firstY; y <= range.lastY; y++)
+		{
+			for (uint32_t x = range.firstX; x <= range.lastX; x++)
+				lists.counts[y * mTilesX + x]++;
+		}
+	}
+
+	// list offsets, then the lists
+	uint32_t numIndices = 0;
+	for (uint32_t tile = 0; tile < numTiles; tile++)
+	{
+		lists.offsets[tile] = numIndices;
+		numIndices += lists.counts[tile];
+	}
+	lists.indices.resize(numIndices);
+
+	std::vector<uint32_t>& cursors = lists.counts;	// counted up again while filling
+	cursors.assign(numTiles, 0);
+	for (const TileRange& range : lists.ranges)
+	{
+		for (uint32_t y = range.firstY; y <= range.lastY; y++)
+		{
+			for (uint32_t x = range.firstX; x <= range.lastX; x++)
+			{
+				uint32_t tile = y * mTilesX + x;
+				lists.indices[lists.offsets[tile] + cursors[tile]++] = range.index;
+			}
+		}
+	}
+}
+
+// bind the buffers and set the uniforms of a program in use (viewport as x, y, width, height)
+void LightClusters::setUniforms(ShaderProgram& shader, const GLint viewport[4]) const
+{
+	mLights.bind(sLightBinding);
+	GLStateCache::bindBufferBase(GL_SHADER_STORAGE_BUFFER, sGridBinding, mGrid.getID());
+	GLStateCache::bindBufferBase(GL_SHADER_STORAGE_BUFFER, sIndexBinding, mIndices.getID());
+
+	shader.setUniform("uViewport", glm::vec4(viewport[0], viewport[1], viewport[2], viewport[3]));
+	shader.setUniform("uClusterTiles", glm::vec2(mTilesX, mTilesY));
+	shader.setUniform("uNumSlices", static_cast<int>(mNumSlices));
+	shader.setUniform("uSliceScale", mSliceScale);
+	shader.setUniform("uSliceBias", mSliceBias);
+	shader.setUniform("uAmbient", mAmbient);
+}
+
+void LightClusters::release()
+{
+	mLights.release();
+	mGrid.release();
+	mIndices.release();
+	mIndexCapacity = 0;
+}
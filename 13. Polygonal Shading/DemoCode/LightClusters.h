@@ -0,0 +1,114 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "utilities.h"
+#include "GLResources.h"
+#include "LightBuffer.h"
+
+/*****************************************************************
+ * clustered light culling
+ * the view frustum is split into a grid of clusters (froxels):
+ * screen tiles times depth slices spaced exponentially between
+ * the near and far planes; every light is bounded by a sphere
+ * (the distance at which its attenuation makes it too dim to see,
+ * and the cone of a spotlight) and listed in the clusters the
+ * sphere overlaps, so a fragment only loops over the lights of
+ * its own cluster
+ * lights are binned on the CPU, a range of depth slices per
+ * thread; the lights, the grid (offset and count of each cluster)
+ * and the light index lists go to storage buffers read by
+ * clusteredPhong.frag
+ * requires OpenGL 4.3 (shader storage buffers)
+ *****************************************************************/
+class LightClusters
+{
+public:
+	// screen tiles across and down, and depth slices
+	LightClusters(uint32_t tilesX = 16, uint32_t tilesY = 9, uint32_t numSlices = 24);
+
+	// distance beyond which a light's attenuated intensity is below a threshold (infinite without attenuation)
+	static float getInfluenceRadius(const Light& light, float threshold = sInfluenceThreshold);
+	// world space sphere (centre, radius) around the lit volume of a point light or spotlight
+	static glm::vec4 getBoundingSphere(const Light& light, float threshold = sInfluenceThreshold);
+
+	// copy the lights (lights of type 0 are skipped) and bin them into the clusters of a perspective
+	// projection on a number of threads (0 = one per hardware thread)
+	void update(const Light* lights, size_t numLights, const glm::mat4& view, const glm::mat4& projection,
+		unsigned numThreads = 0);
+	// bind the buffers and set the uniforms of a program in use (viewport as x, y, width, height)
+	void setUniforms(ShaderProgram& shader, const GLint viewport[4]) const;
+	void release();
+
+	uint32_t getNumClusters() const { return mTilesX * mTilesY * mNumSlices; }
+	uint32_t getNumLights() const { return mLights.getNumLights(); }
+	// light references in all cluster lists
+	uint32_t getNumIndices() const { return static_cast<uint32_t>(mIndexData.size()); }
+	// longest cluster list
+	uint32_t getMaxClusterLights() const { return mMaxClusterLights; }
+
+	// fraction of a light's intensity it is culled at
+	static constexpr float sInfluenceThreshold = 1.0f / 256.0f;
+
+	// storage buffer binding points of clusteredPhong.frag
+	static const GLuint sLightBinding = 5;
+	static const GLuint sGridBinding = 6;
+	static const GLuint sIndexBinding = 7;
+
+private:
+	// light in view space
+	struct ViewLight
+	{
+		glm::vec3 center;
+		float depth;		// -center.z
+		float radius;
+		uint32_t index;		// in the light buffer
+	};
+
+	// tiles overlapped by a light within a slice
+	struct TileRange
+	{
+		uint32_t index;
+		uint32_t firstX, lastX, firstY, lastY;
+	};
+
+	// cluster lists of one depth slice
+	struct Slice
+	{
+		std::vector<uint32_t> counts;	// per tile
+		std::vector<uint32_t> offsets;	// per tile, into indices
+		std::vector<uint32_t> indices;
+		std::vector<TileRange> ranges;	// lights overlapping the slice (scratch)
+	};
+
+	uint32_t mTilesX, mTilesY, mNumSlices;
+
+	// planes through the eye at the tile edges (normals point towards higher columns or rows)
+	std::vector<glm::vec3> mColumnPlanes;
+	std::vector<glm::vec3> mRowPlanes;
+	float mNear = 0.0f, mFar = 0.0f;
+	float mSliceScale = 0.0f;		// slice = log(depth) * scale + bias
+	float mSliceBias = 0.0f;
+
+	std::vector<ViewLight> mViewLights;
+	std::vector<Slice> mSlices;
+	std::vector<GLuint> mGridData;		// offset, count per cluster
+	std::vector<GLuint> mIndexData;
+	uint32_t mMaxClusterLights = 0;
+	glm::vec3 mAmbient = glm::vec3(0.0f);	// ambient light of all lights (not attenuated)
+
+	LightBuffer mLights;
+	GLBuffer mGrid;
+	GLBuffer mIndices;
+	uint32_t mIndexCapacity = 0;
+
+	// bin the view lights into the clusters of a slice
+	void binSlice(uint32_t slice);
+	// first and last tile (columns or rows) overlapped by a view space sphere
+	static bool getTileRange(const std::vector<glm::vec3>& planes, const glm::vec3& center, float radius,
+		uint32_t& first, uint32_t& last);
+};
+
+#endif
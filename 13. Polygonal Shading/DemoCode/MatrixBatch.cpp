@@ -0,0 +1,221 @@
+#include "MatrixBatch.h"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MATRIX_BATCH_AVX2
+#define MATRIX_BATCH_SSE
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MATRIX_BATCH_SSE
+#endif
+
+// relative tolerance for treating a matrix as uniformly scaled without shear
+const float gUniformScaleTolerance = 1.0e-4f;
+
+// name of the instruction set used by the kernels
+const char* getMatrixBatchInstructionSet()
+{
+#if defined(MATRIX_BATCH_AVX2)
+	return "AVX2";
+#elif defined(MATRIX_BATCH_SSE)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+#if defined(MATRIX_BATCH_SSE)
+// result = a * b for column-major matrices (each column of b selects a combination of the columns of a)
+static inline void multiplyMatrix(const __m128 a[4], const float* b, float* result)
+{
+#if defined(MATRIX_BATCH_AVX2)
+	// two result columns per iteration
+	__m256 a0 = _mm256_insertf128_ps(_mm256_castps128_ps256(a[0]), a[0], 1);
+	__m256 a1 = _mm256_insertf128_ps(_mm256_castps128_ps256(a[1]), a[1], 1);
+	__m256 a2 = _mm256_insertf128_ps(_mm256_castps128_ps256(a[2]), a[2], 1);
+	__m256 a3 = _mm256_insertf128_ps(_mm256_castps128_ps256(a[3]), a[3], 1);
+
+	for (int column = 0; column < 4; column += 2)
+	{
+		__m256 bColumns = _mm256_loadu_ps(b + column * 4);
+		__m256 sum = _mm256_mul_ps(a0, _mm256_shuffle_ps(bColumns, bColumns, _MM_SHUFFLE(0, 0, 0, 0)));
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(a1, _mm256_shuffle_ps(bColumns, bColumns, _MM_SHUFFLE(1, 1, 1, 1))));
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(a2, _mm256_shuffle_ps(bColumns, bColumns, _MM_SHUFFLE(2, 2, 2, 2))));
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(a3, _mm256_shuffle_ps(bColumns, bColumns, _MM_SHUFFLE(3, 3, 3, 3))));
+		_mm256_storeu_ps(result + column * 4, sum);
+	}
+#else
+	for (int column = 0; column < 4; column++)
+	{
+		__m128 bColumn = _mm_loadu_ps(b + column * 4);
+		__m128 sum = _mm_mul_ps(a[0], _mm_shuffle_ps(bColumn, bColumn, _MM_SHUFFLE(0, 0, 0, 0)));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a[1], _mm_shuffle_ps(bColumn, bColumn, _MM_SHUFFLE(1, 1, 1, 1))));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a[2], _mm_shuffle_ps(bColumn, bColumn, _MM_SHUFFLE(2, 2, 2, 2))));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a[3], _mm_shuffle_ps(bColumn, bColumn, _MM_SHUFFLE(3, 3, 3, 3))));
+		_mm_storeu_ps(result + column * 4, sum);
+	}
+#endif
+}
+
+static inline void loadMatrix(const float* m, __m128 columns[4])
+{
+	for (int column = 0; column < 4; column++)
+		columns[column] = _mm_loadu_ps(m + column * 4);
+}
+#endif
+
+// result[i] = a * b[i] (e.g. model-view-projection = view-projection * model)
+void multiplyMatrices(const glm::mat4& a, const glm::mat4* b, glm::mat4* result, size_t count)
+{
+#if defined(MATRIX_BATCH_SSE)
+	__m128 aColumns[4];
+	loadMatrix(&a[0][0], aColumns);
+
+	for (size_t i = 0; i < count; i++)
+		multiplyMatrix(aColumns, &b[i][0][0], &result[i][0][0]);
+#else
+	for (size_t i = 0; i < count; i++)
+		result[i] = a * b[i];
+#endif
+}
+
+// result[i] = a[i] * b[i] (e.g. world = parent world * local)
+void multiplyMatrices(const glm::mat4* a, const glm::mat4* b, glm::mat4* result, size_t count)
+{
+#if defined(MATRIX_BATCH_SSE)
+	for (size_t i = 0; i < count; i++)
+	{
+		__m128 aColumns[4];
+		loadMatrix(&a[i][0][0], aColumns);
+		multiplyMatrix(aColumns, &b[i][0][0], &result[i][0][0]);
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+		result[i] = a[i] * b[i];
+#endif
+}
+
+// normal matrix of one model matrix
+static inline glm::mat3 computeNormalMatrix(const glm::mat4& model)
+{
+	glm::vec3 c0(model[0]), c1(model[1]), c2(model[2]);
+
+	// uniform scale s without shear: the columns are orthogonal with equal length,
+	// so the inverse transpose is the upper 3x3 divided by s^2
+	float scale2 = glm::dot(c0, c0);
+	float tolerance = gUniformScaleTolerance * scale2;
+
+	if (std::fabs(glm::dot(c1, c1) - scale2) <= tolerance && std::fabs(glm::dot(c2, c2) - scale2) <= tolerance
+		&& std::fabs(glm::dot(c0, c1)) <= tolerance && std::fabs(glm::dot(c0, c2)) <= tolerance
+		&& std::fabs(glm::dot(c1, c2)) <= tolerance)
+	{
+		return glm::mat3(c0, c1, c2) * (1.0f / scale2);
+	}
+
+	// general case: the inverse transpose is the cofactor matrix divided by the determinant
+	glm::vec3 x0 = glm::cross(c1, c2);
+	glm::vec3 x1 = glm::cross(c2, c0);
+	glm::vec3 x2 = glm::cross(c0, c1);
+
+	return glm::mat3(x0, x1, x2) * (1.0f / glm::dot(c0, x0));
+}
+
+// result[i] = mat3(transpose(inverse(model[i])))
+void computeNormalMatrices(const glm::mat4* model, glm::mat3* result, size_t count)
+{
+	size_t i = 0;
+
+#if defined(MATRIX_BATCH_SSE)
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 tolerance = _mm_set1_ps(gUniformScaleTolerance);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	// four matrices at a time with one matrix per lane
+	for (; i + 4 <= count; i += 4)
+	{
+		// x, y and z components of the first three columns of the four matrices
+		__m128 x[3], y[3], z[3];
+		for (int column = 0; column < 3; column++)
+		{
+			__m128 m0 = _mm_loadu_ps(&model[i][column][0]);
+			__m128 m1 = _mm_loadu_ps(&model[i + 1][column][0]);
+			__m128 m2 = _mm_loadu_ps(&model[i + 2][column][0]);
+			__m128 m3 = _mm_loadu_ps(&model[i + 3][column][0]);
+			_MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+			x[column] = m0;
+			y[column] = m1;
+			z[column] = m2;
+		}
+
+		// squared column lengths and dot products between columns
+		__m128 length0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], x[0]), _mm_mul_ps(y[0], y[0])), _mm_mul_ps(z[0], z[0]));
+		__m128 length1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[1], x[1]), _mm_mul_ps(y[1], y[1])), _mm_mul_ps(z[1], z[1]));
+		__m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[2], x[2]), _mm_mul_ps(y[2], y[2])), _mm_mul_ps(z[2], z[2]));
+		__m128 dot01 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], x[1]), _mm_mul_ps(y[0], y[1])), _mm_mul_ps(z[0], z[1]));
+		__m128 dot02 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], x[2]), _mm_mul_ps(y[0], y[2])), _mm_mul_ps(z[0], z[2]));
+		__m128 dot12 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[1], x[2]), _mm_mul_ps(y[1], y[2])), _mm_mul_ps(z[1], z[2]));
+
+		__m128 limit = _mm_mul_ps(tolerance, length0);
+		__m128 uniform = _mm_and_ps(_mm_cmple_ps(_mm_and_ps(_mm_sub_ps(length1, length0), absMask), limit),
+			_mm_cmple_ps(_mm_and_ps(_mm_sub_ps(length2, length0), absMask), limit));
+		uniform = _mm_and_ps(uniform, _mm_cmple_ps(_mm_and_ps(dot01, absMask), limit));
+		uniform = _mm_and_ps(uniform, _mm_cmple_ps(_mm_and_ps(dot02, absMask), limit));
+		uniform = _mm_and_ps(uniform, _mm_cmple_ps(_mm_and_ps(dot12, absMask), limit));
+
+		__m128 nx[3], ny[3], nz[3];
+
+		if (_mm_movemask_ps(uniform) == 0xF)
+		{
+			// all four have uniform scale: scale the columns by 1 / s^2
+			__m128 inverseScale2 = _mm_div_ps(one, length0);
+			for (int column = 0; column < 3; column++)
+			{
+				nx[column] = _mm_mul_ps(x[column], inverseScale2);
+				ny[column] = _mm_mul_ps(y[column], inverseScale2);
+				nz[column] = _mm_mul_ps(z[column], inverseScale2);
+			}
+		}
+		else
+		{
+			// cofactors (cross products of column pairs) divided by the determinant
+			for (int column = 0; column < 3; column++)
+			{
+				int a = (column + 1) % 3, b = (column + 2) % 3;
+				nx[column] = _mm_sub_ps(_mm_mul_ps(y[a], z[b]), _mm_mul_ps(z[a], y[b]));
+				ny[column] = _mm_sub_ps(_mm_mul_ps(z[a], x[b]), _mm_mul_ps(x[a], z[b]));
+				nz[column] = _mm_sub_ps(_mm_mul_ps(x[a], y[b]), _mm_mul_ps(y[a], x[b]));
+			}
+
+			__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], nx[0]), _mm_mul_ps(y[0], ny[0])), _mm_mul_ps(z[0], nz[0]));
+			__m128 inverseDeterminant = _mm_div_ps(one, determinant);
+			for (int column = 0; column < 3; column++)
+			{
+				nx[column] = _mm_mul_ps(nx[column], inverseDeterminant);
+				ny[column] = _mm_mul_ps(ny[column], inverseDeterminant);
+				nz[column] = _mm_mul_ps(nz[column], inverseDeterminant);
+			}
+		}
+
+		// back to one matrix per register (mat3 columns are not 16-byte aligned)
+		for (int column = 0; column < 3; column++)
+		{
+			__m128 m0 = nx[column], m1 = ny[column], m2 = nz[column], m3 = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+
+			float values[4][4];
+			_mm_storeu_ps(values[0], m0);
+			_mm_storeu_ps(values[1], m1);
+			_mm_storeu_ps(values[2], m2);
+			_mm_storeu_ps(values[3], m3);
+			for (int j = 0; j < 4; j++)
+				result[i + j][column] = glm::vec3(values[j][0], values[j][1], values[j][2]);
+		}
+	}
+#endif
+
+	// remaining matrices (or all of them without SIMD)
+	for (; i < count; i++)
+		result[i] = computeNormalMatrix(model[i]);
+}
@@ -0,0 +1,28 @@
+#ifndef MATRIX_BATCH_H
+#define MATRIX_BATCH_H
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+/*****************************************************************
+ * batch matrix kernels for many objects at once
+ * matrices are stored in contiguous arrays of glm matrices, so the
+ * results can be passed straight to ShaderProgram::setUniform
+ * the kernels use AVX2 or SSE when the compiler targets them
+ * (e.g. -mavx2) and fall back to scalar code otherwise
+ *****************************************************************/
+
+// result[i] = a * b[i] (e.g. model-view-projection = view-projection * model)
+void multiplyMatrices(const glm::mat4& a, const glm::mat4* b, glm::mat4* result, size_t count);
+
+// result[i] = a[i] * b[i] (e.g. world = parent world * local)
+void multiplyMatrices(const glm::mat4* a, const glm::mat4* b, glm::mat4* result, size_t count);
+
+// result[i] = mat3(transpose(inverse(model[i])))
+// uses the rotation scaled by 1 / scale^2 when a matrix has uniform scale and no shear
+void computeNormalMatrices(const glm::mat4* model, glm::mat3* result, size_t count);
+
+// name of the instruction set used by the kernels
+const char* getMatrixBatchInstructionSet();
+
+#endif
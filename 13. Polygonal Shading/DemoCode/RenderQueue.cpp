@@ -0,0 +1,152 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+// field widths
+const int gPassBits = 2;
+const int gViewportBits = 4;
+const int gProgramBits = 8;
+const int gMaterialBits = 12;
+const int gTextureBits = 14;
+const int gDepthBits = 24;
+
+// field positions shared by all passes
+const int gPassShift = 62;
+const int gViewportShift = 58;
+
+// opaque and overlay layout: state before depth
+const int gOpaqueProgramShift = 50;
+const int gOpaqueMaterialShift = 38;
+const int gOpaqueTextureShift = 24;
+const int gOpaqueDepthShift = 0;
+
+// transparent layout: depth before state
+const int gTransparentDepthShift = 34;
+const int gTransparentProgramShift = 26;
+const int gTransparentMaterialShift = 14;
+const int gTransparentTextureShift = 0;
+
+// place a field in a key
+static uint64_t pack(uint32_t value, int bits, int shift)
+{
+	return (static_cast<uint64_t>(value) & ((1ull << bits) - 1)) << shift;
+}
+
+// extract a field from a key
+static uint32_t unpack(uint64_t key, int bits, int shift)
+{
+	return static_cast<uint32_t>((key >> shift) & ((1ull << bits) - 1));
+}
+
+RenderQueue::RenderQueue()
+{}
+
+RenderQueue::~RenderQueue()
+{}
+
+// pack a key (fields are masked to their width; depth is 0 = near to 1 = far)
+uint64_t RenderQueue::makeKey(RenderPass pass, uint32_t viewport, uint32_t program, uint32_t material,
+	uint32_t texture, float depth)
+{
+	const uint32_t maxDepth = (1u << gDepthBits) - 1;
+	uint32_t quantisedDepth = static_cast<uint32_t>(std::min(std::max(depth, 0.0f), 1.0f) * maxDepth);
+
+	uint64_t key = pack(static_cast<uint32_t>(pass), gPassBits, gPassShift) | pack(viewport, gViewportBits, gViewportShift);
+
+	if (pass == RenderPass::TRANSPARENT_PASS)
+	{
+		// back to front
+		key |= pack(maxDepth - quantisedDepth, gDepthBits, gTransparentDepthShift);
+		key |= pack(program, gProgramBits, gTransparentProgramShift);
+		key |= pack(material, gMaterialBits, gTransparentMaterialShift);
+		key |= pack(texture, gTextureBits, gTransparentTextureShift);
+	}
+	else
+	{
+		// front to back within each state group
+		key |= pack(program, gProgramBits, gOpaqueProgramShift);
+		key |= pack(material, gMaterialBits, gOpaqueMaterialShift);
+		key |= pack(texture, gTextureBits, gOpaqueTextureShift);
+		key |= pack(quantisedDepth, gDepthBits, gOpaqueDepthShift);
+	}
+
+	return key;
+}
+
+// unpack key fields
+RenderPass RenderQueue::getPass(uint64_t key)
+{
+	return static_cast<RenderPass>(unpack(key, gPassBits, gPassShift));
+}
+
+uint32_t RenderQueue::getViewport(uint64_t key)
+{
+	return unpack(key, gViewportBits, gViewportShift);
+}
+
+uint32_t RenderQueue::getProgram(uint64_t key)
+{
+	bool transparent = getPass(key) == RenderPass::TRANSPARENT_PASS;
+	return unpack(key, gProgramBits, transparent ? gTransparentProgramShift : gOpaqueProgramShift);
+}
+
+uint32_t RenderQueue::getMaterial(uint64_t key)
+{
+	bool transparent = getPass(key) == RenderPass::TRANSPARENT_PASS;
+	return unpack(key, gMaterialBits, transparent ? gTransparentMaterialShift : gOpaqueMaterialShift);
+}
+
+uint32_t RenderQueue::getTexture(uint64_t key)
+{
+	bool transparent = getPass(key) == RenderPass::TRANSPARENT_PASS;
+	return unpack(key, gTextureBits, transparent ? gTransparentTextureShift : gOpaqueTextureShift);
+}
+
+// sort packets by key (stable LSD radix sort)
+void RenderQueue::sort()
+{
+	const size_t count = mPackets.size();
+	if (count < 2)
+		return;
+
+	// histograms of all eight key bytes in one pass
+	uint32_t histograms[8][256] = {};
+	for (const DrawPacket& packet : mPackets)
+	{
+		for (int byte = 0; byte < 8; byte++)
+			histograms[byte][(packet.key >> (byte * 8)) & 0xFF]++;
+	}
+
+	mScratch.resize(count);
+	DrawPacket* source = mPackets.data();
+	DrawPacket* destination = mScratch.data();
+
+	for (int byte = 0; byte < 8; byte++)
+	{
+		uint32_t* histogram = histograms[byte];
+		int shift = byte * 8;
+
+		// skip bytes that are the same in every key (e.g. unused fields)
+		if (histogram[(source[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		// bucket offsets
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			uint32_t bucketSize = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketSize;
+		}
+
+		// scatter in bucket order (keeps the order of equal bytes)
+		for (size_t i = 0; i < count; i++)
+			destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+
+		std::swap(source, destination);
+	}
+
+	// the sorted packets end up in the scratch buffer after an odd number of passes
+	if (source != mPackets.data())
+		mPackets.swap(mScratch);
+}
@@ -0,0 +1,61 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// passes in execution order (the depth pass lays down depth for the opaque pass to test for equality)
+enum class RenderPass { DEPTH_PASS, OPAQUE_PASS, TRANSPARENT_PASS, OVERLAY_PASS };
+
+// draw submitted to the render queue
+struct DrawPacket
+{
+	uint64_t key;		// sort key (see RenderQueue::makeKey)
+	uint32_t item;		// caller's index of the draw's data
+};
+
+/*****************************************************************
+ * render queue sorted by 64-bit draw keys
+ * key bits (most significant first):
+ *   depth/opaque/overlay:
+ *                   pass 2 | viewport 4 | program 8 | material 12 |
+ *                   texture 14 | depth 24 (front to back)
+ *   transparent:    pass 2 | viewport 4 | depth 24 (back to front) |
+ *                   program 8 | material 12 | texture 14
+ * packets are radix sorted each frame, so executing them in order
+ * only needs state changes where the key fields change
+ *****************************************************************/
+class RenderQueue
+{
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	// pack a key (fields are masked to their width; depth is 0 = near to 1 = far)
+	static uint64_t makeKey(RenderPass pass, uint32_t viewport, uint32_t program, uint32_t material,
+		uint32_t texture, float depth);
+
+	// unpack key fields
+	static RenderPass getPass(uint64_t key);
+	static uint32_t getViewport(uint64_t key);
+	static uint32_t getProgram(uint64_t key);
+	static uint32_t getMaterial(uint64_t key);
+	static uint32_t getTexture(uint64_t key);
+
+	void clear() { mPackets.clear(); }
+	void reserve(size_t numPackets) { mPackets.reserve(numPackets); }
+	void submit(uint64_t key, uint32_t item) { mPackets.push_back({ key, item }); }
+
+	// sort packets by key (stable LSD radix sort)
+	void sort();
+
+	size_t size() const { return mPackets.size(); }
+	const DrawPacket* data() const { return mPackets.data(); }
+
+private:
+	std::vector<DrawPacket> mPackets;
+	std::vector<DrawPacket> mScratch;	// radix sort buffer
+};
+
+#endif
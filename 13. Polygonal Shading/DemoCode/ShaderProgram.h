@@ -17,6 +17,8 @@ public:
 
 	// compile and link a vertex and fragment shader pair
 	void compileAndLink(const std::string vShaderFilename, const std::string fShaderFilename);
+	// compile and link a compute shader (requires OpenGL 4.3)
+	void compileAndLink(const std::string cShaderFilename);
 	// use the shader program
 	void use();
 
@@ -30,11 +32,12 @@ public:
 	void setUniform(const char *name, int value);
 	void setUniform(const char *name, bool value);
 
+	// get uniform variable locations (for setting uniforms with glUniform* directly)
+	GLint getUniformLocation(const char *name);
+
 private:
 	GLuint mProgramID = 0;							// shader program handle
 	std::map<std::string, GLint> mUniformLocations;	// uniform locations
-
-	GLint getUniformLocation(const char *name);		// get uniform variable locations
 };
 
 #endif
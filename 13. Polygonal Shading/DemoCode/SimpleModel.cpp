@@ -1,18 +1,12 @@
 #include "SimpleModel.h"
+#include "GLStateCache.h"
 
 SimpleModel::SimpleModel()
 {}
 
 SimpleModel::~SimpleModel()
 {
-	// delete mesh buffers
-	if (mMesh.VBO != 0)
-		glDeleteBuffers(1, &mMesh.VBO);
-	if (mMesh.IBO != 0)
-		glDeleteBuffers(1, &mMesh.IBO);
-	if (mMesh.VAO != 0)
-		glDeleteVertexArrays(1, &mMesh.VAO);
-
+	// mesh buffers are deleted by their wrappers
 	mIsValid = false;
 }
 
@@ -35,11 +29,11 @@ void SimpleModel::loadModel(const char *filename, bool texture)
 		exit(EXIT_FAILURE);
 	}
 
-	// only loads first mesh
+	// loads all meshes
 	if(!texture)
-		loadMesh(scene->mMeshes[0]);
+		loadMesh(scene);
 	else
-		loadMeshWithTexture(scene->mMeshes[0]);
+		loadMeshWithTexture(scene);
 
 	// importer's destructor will clean up
 }
@@ -48,171 +42,270 @@ void SimpleModel::drawModel()
 {
 	if (mIsValid)
 	{
-		glBindVertexArray(mMesh.VAO);		// make mesh VAO active
+		mMesh.VAO.bind();		// make mesh VAO active
 		glDrawElements(GL_TRIANGLES, mMesh.numOfIndices, GL_UNSIGNED_INT, 0);	// render vertices
 	}
 }
 
-void SimpleModel::loadMesh(const aiMesh *mesh)
+void SimpleModel::drawRange(GLuint firstIndex, GLsizei numIndices)
+{
+	if (mIsValid)
+	{
+		mMesh.VAO.bind();		// make mesh VAO active
+		glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT,
+			reinterpret_cast<void*>(firstIndex * sizeof(GLuint)));	// render range of vertices
+	}
+}
+
+void SimpleModel::drawPositionRange(GLuint firstIndex, GLsizei numIndices)
+{
+	if (mIsValid)
+	{
+		mMesh.positionVAO.bind();	// make position only VAO active
+		glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT,
+			reinterpret_cast<void*>(firstIndex * sizeof(GLuint)));	// render range of vertices
+	}
+}
+
+void SimpleModel::loadMesh(const aiScene *scene)
 {
 	// mesh data
 	std::vector<VertexNormal> vertices;
 	std::vector<GLint> indices;
+	std::vector<glm::vec3> positions;	// copy of the vertex positions for the position only stream
 
-	// check if mesh contains vertex coordinates, normals and faces
-	if (!mesh->HasPositions() || !mesh->HasNormals() || !mesh->HasFaces())
+	for (unsigned int m = 0; m < scene->mNumMeshes; m++)
 	{
-		mIsValid = false;
-		return;
-	}
+		const aiMesh* mesh = scene->mMeshes[m];
 
-	// get vertex data
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
-	{
-		VertexNormal vertex;	// for vertex data
+		// skip meshes without vertex coordinates, normals and faces
+		if (!mesh->HasPositions() || !mesh->HasNormals() || !mesh->HasFaces())
+			continue;
 
-		// get vertex position
-		vertex.position[0] = mesh->mVertices[i].x;
-		vertex.position[1] = mesh->mVertices[i].y;
-		vertex.position[2] = mesh->mVertices[i].z;
+		// submesh indices follow the previous submeshes in the shared buffers
+		GLint baseVertex = static_cast<GLint>(vertices.size());
+		SubMesh subMesh;
+		subMesh.firstIndex = static_cast<GLuint>(indices.size());
 
-		// get vertex normal
-		vertex.normal[0] = mesh->mNormals[i].x;
-		vertex.normal[1] = mesh->mNormals[i].y;
-		vertex.normal[2] = mesh->mNormals[i].z;
+		// get vertex data
+		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+		{
+			VertexNormal vertex;	// for vertex data
 
-		// append vertex data
-		vertices.push_back(vertex);
-	}
+			// get vertex position
+			vertex.position[0] = mesh->mVertices[i].x;
+			vertex.position[1] = mesh->mVertices[i].y;
+			vertex.position[2] = mesh->mVertices[i].z;
 
-	// get face data
-	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
-	{
-		for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
+			// get vertex normal
+			vertex.normal[0] = mesh->mNormals[i].x;
+			vertex.normal[1] = mesh->mNormals[i].y;
+			vertex.normal[2] = mesh->mNormals[i].z;
+
+			// append vertex data
+			vertices.push_back(vertex);
+			positions.push_back(glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]));
+		}
+
+		// get face data
+		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
 		{
-			// append face index
-			indices.push_back(mesh->mFaces[i].mIndices[j]);
+			for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
+			{
+				// append face index
+				indices.push_back(baseVertex + mesh->mFaces[i].mIndices[j]);
+			}
 		}
+
+		// store submesh index range, bounding box and sphere
+		subMesh.numIndices = static_cast<GLsizei>(indices.size() - subMesh.firstIndex);
+		computeBounds(mesh, subMesh);
+		mSubMeshes.push_back(subMesh);
+	}
+
+	if (mSubMeshes.empty())
+	{
+		mIsValid = false;
+		return;
 	}
 
 	// store total number of indices
 	mMesh.numOfIndices = static_cast<int>(indices.size());
 
-	// generate identifier for VBOs and copy data to GPU
-	glGenBuffers(1, &mMesh.VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, mMesh.VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexNormal) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
-
-	// generate identifier for IBO and copy data to GPU
-	glGenBuffers(1, &mMesh.IBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mMesh.IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLint) * indices.size(), &indices[0], GL_STATIC_DRAW);
+	// compute bounds of all submeshes
+	computeMeshBounds();
 
-	// generate identifiers for VAO and supply information
-	glGenVertexArrays(1, &mMesh.VAO);
-	glBindVertexArray(mMesh.VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, mMesh.VBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mMesh.IBO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormal), reinterpret_cast<void*>(offsetof(VertexNormal, position)));
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormal), reinterpret_cast<void*>(offsetof(VertexNormal, normal)));
+	// create VBO and IBO with the data (without binding them)
+	mMesh.VBO.create(sizeof(VertexNormal) * vertices.size(), &vertices[0]);
+	mMesh.IBO.create(sizeof(GLint) * indices.size(), &indices[0]);
 
-	// enable vertex attributes
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
+	// create VAO and supply information
+	mMesh.VAO.create();
+	mMesh.VAO.setVertexBuffer(0, mMesh.VBO, 0, sizeof(VertexNormal));
+	mMesh.VAO.setIndexBuffer(mMesh.IBO);
+	mMesh.VAO.setAttribute(0, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormal, position));
+	mMesh.VAO.setAttribute(1, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormal, normal));
 
-	// unbind VAO
-	glBindVertexArray(0);
+	// create position only VBO and VAO (sharing the IBO)
+	createPositionStream(positions);
 
 	mIsValid = true;
 }
 
-void SimpleModel::loadMeshWithTexture(const aiMesh* mesh)
+void SimpleModel::loadMeshWithTexture(const aiScene* scene)
 {
 	// mesh data
 	std::vector<VertexNormTex> vertices;
 	std::vector<GLint> indices;
+	std::vector<glm::vec3> positions;	// copy of the vertex positions for the position only stream
 
-	// check if mesh contains vertex coordinates, normals and faces
-	if (!mesh->HasPositions() || !mesh->HasNormals() || !mesh->HasFaces())
-	{
-		mIsValid = false;
-		return;
-	}
-	// check if mesh contains texture coordinates (i.e. index 0)
-	if (mesh->HasTextureCoords(0))
+	for (unsigned int m = 0; m < scene->mNumMeshes; m++)
 	{
-		mMesh.hasTexCoords = true;
-	}
+		const aiMesh* mesh = scene->mMeshes[m];
 
-	// get vertex data
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
-	{
-		VertexNormTex vertex;	// for vertex data
+		// skip meshes without vertex coordinates, normals and faces
+		if (!mesh->HasPositions() || !mesh->HasNormals() || !mesh->HasFaces())
+			continue;
 
-		// get vertex position
-		vertex.position[0] = mesh->mVertices[i].x;
-		vertex.position[1] = mesh->mVertices[i].y;
-		vertex.position[2] = mesh->mVertices[i].z;
+		// check if mesh contains texture coordinates (i.e. index 0)
+		bool hasTexCoords = mesh->HasTextureCoords(0);
+		if (hasTexCoords)
+		{
+			mMesh.hasTexCoords = true;
+		}
 
-		// get vertex normal
-		vertex.normal[0] = mesh->mNormals[i].x;
-		vertex.normal[1] = mesh->mNormals[i].y;
-		vertex.normal[2] = mesh->mNormals[i].z;
+		// submesh indices follow the previous submeshes in the shared buffers
+		GLint baseVertex = static_cast<GLint>(vertices.size());
+		SubMesh subMesh;
+		subMesh.firstIndex = static_cast<GLuint>(indices.size());
 
-		// get first vertex texture coordinate (i.e. index 0)
-		if (mMesh.hasTexCoords)
+		// get vertex data
+		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 		{
-			vertex.texCoord[0] = mesh->mTextureCoords[0][i].x;
-			vertex.texCoord[1] = mesh->mTextureCoords[0][i].y;
+			VertexNormTex vertex;	// for vertex data
+
+			// get vertex position
+			vertex.position[0] = mesh->mVertices[i].x;
+			vertex.position[1] = mesh->mVertices[i].y;
+			vertex.position[2] = mesh->mVertices[i].z;
+
+			// get vertex normal
+			vertex.normal[0] = mesh->mNormals[i].x;
+			vertex.normal[1] = mesh->mNormals[i].y;
+			vertex.normal[2] = mesh->mNormals[i].z;
+
+			// get first vertex texture coordinate (i.e. index 0)
+			if (hasTexCoords)
+			{
+				vertex.texCoord[0] = mesh->mTextureCoords[0][i].x;
+				vertex.texCoord[1] = mesh->mTextureCoords[0][i].y;
+			}
+			else
+			{
+				vertex.texCoord[0] = vertex.texCoord[1] = 0.0f;
+			}
+
+			// append vertex data
+			vertices.push_back(vertex);
+			positions.push_back(glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]));
 		}
-		else
+
+		// get face data
+		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
 		{
-			vertex.texCoord[0] = vertex.texCoord[1] = 0.0f;
+			for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
+			{
+				// append face index
+				indices.push_back(baseVertex + mesh->mFaces[i].mIndices[j]);
+			}
 		}
 
-		// append vertex data
-		vertices.push_back(vertex);
+		// store submesh index range, bounding box and sphere
+		subMesh.numIndices = static_cast<GLsizei>(indices.size() - subMesh.firstIndex);
+		computeBounds(mesh, subMesh);
+		mSubMeshes.push_back(subMesh);
 	}
 
-	// get face data
-	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	if (mSubMeshes.empty())
 	{
-		for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
-		{
-			// append face index
-			indices.push_back(mesh->mFaces[i].mIndices[j]);
-		}
+		mIsValid = false;
+		return;
 	}
 
 	// store total number of indices
 	mMesh.numOfIndices = indices.size();
 
-	// generate identifier for VBOs and copy data to GPU
-	glGenBuffers(1, &mMesh.VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, mMesh.VBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VertexNormTex), &vertices[0], GL_STATIC_DRAW);
-
-	// generate identifier for IBO and copy data to GPU
-	glGenBuffers(1, &mMesh.IBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mMesh.IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLint), &indices[0], GL_STATIC_DRAW);
-
-	// generate identifiers for VAO and supply information
-	glGenVertexArrays(1, &mMesh.VAO);
-	glBindVertexArray(mMesh.VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, mMesh.VBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mMesh.IBO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormTex), reinterpret_cast<void*>(offsetof(VertexNormTex, position)));
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormTex), reinterpret_cast<void*>(offsetof(VertexNormTex, normal)));
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexNormTex), reinterpret_cast<void*>(offsetof(VertexNormTex, texCoord)));
-
-	// enable vertex attributes
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-
-	// unbind VAO
-	glBindVertexArray(0);
+	// compute bounds of all submeshes
+	computeMeshBounds();
+
+	// create VBO and IBO with the data (without binding them)
+	mMesh.VBO.create(vertices.size() * sizeof(VertexNormTex), &vertices[0]);
+	mMesh.IBO.create(indices.size() * sizeof(GLint), &indices[0]);
+
+	// create VAO and supply information
+	mMesh.VAO.create();
+	mMesh.VAO.setVertexBuffer(0, mMesh.VBO, 0, sizeof(VertexNormTex));
+	mMesh.VAO.setIndexBuffer(mMesh.IBO);
+	mMesh.VAO.setAttribute(0, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, position));
+	mMesh.VAO.setAttribute(1, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, normal));
+	mMesh.VAO.setAttribute(2, 0, 2, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, texCoord));
+
+	// create position only VBO and VAO (sharing the IBO)
+	createPositionStream(positions);
 
 	mIsValid = true;
 }
+
+void SimpleModel::computeBounds(const aiMesh* mesh, SubMesh& subMesh)
+{
+	if (mesh->mNumVertices == 0)
+		return;
+
+	// axis aligned bounding box
+	subMesh.boundsMin = subMesh.boundsMax = glm::vec3(mesh->mVertices[0].x, mesh->mVertices[0].y, mesh->mVertices[0].z);
+	for (unsigned int i = 1; i < mesh->mNumVertices; i++)
+	{
+		glm::vec3 position(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+		subMesh.boundsMin = glm::min(subMesh.boundsMin, position);
+		subMesh.boundsMax = glm::max(subMesh.boundsMax, position);
+	}
+
+	// bounding sphere centred on the box (radius to the furthest vertex)
+	subMesh.center = (subMesh.boundsMin + subMesh.boundsMax) * 0.5f;
+	float radius2 = 0.0f;
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	{
+		glm::vec3 offset = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z) - subMesh.center;
+		radius2 = glm::max(radius2, glm::dot(offset, offset));
+	}
+	subMesh.radius = std::sqrt(radius2);
+}
+
+void SimpleModel::computeMeshBounds()
+{
+	// box around all submesh boxes
+	mMesh.boundsMin = mSubMeshes[0].boundsMin;
+	mMesh.boundsMax = mSubMeshes[0].boundsMax;
+	for (const SubMesh& subMesh : mSubMeshes)
+	{
+		mMesh.boundsMin = glm::min(mMesh.boundsMin, subMesh.boundsMin);
+		mMesh.boundsMax = glm::max(mMesh.boundsMax, subMesh.boundsMax);
+	}
+
+	// sphere centred on the box that contains all submesh spheres
+	mMesh.center = (mMesh.boundsMin + mMesh.boundsMax) * 0.5f;
+	mMesh.radius = 0.0f;
+	for (const SubMesh& subMesh : mSubMeshes)
+		mMesh.radius = glm::max(mMesh.radius, glm::length(subMesh.center - mMesh.center) + subMesh.radius);
+}
+
+void SimpleModel::createPositionStream(const std::vector<glm::vec3>& positions)
+{
+	// tightly packed positions, so depth-only passes fetch 12 bytes per vertex
+	mMesh.positionVBO.create(positions.size() * sizeof(glm::vec3), &positions[0]);
+
+	mMesh.positionVAO.create();
+	mMesh.positionVAO.setVertexBuffer(0, mMesh.positionVBO, 0, sizeof(glm::vec3));
+	mMesh.positionVAO.setIndexBuffer(mMesh.IBO);
+	mMesh.positionVAO.setAttribute(0, 0, 3, GL_FLOAT, GL_FALSE, 0);
+}
@@ -7,19 +7,42 @@
 
 #include "utilities.h"
 #include "ShaderProgram.h"
+#include "GLResources.h"
+
+// part of the mesh loaded from one model mesh
+struct SubMesh
+{
+    GLuint firstIndex = 0;      // index range in the mesh's IBO
+    GLsizei numIndices = 0;
+
+    // bounds (computed at load)
+    glm::vec3 boundsMin = glm::vec3(0.0f);  // axis aligned bounding box
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);     // bounding sphere
+    float radius = 0.0f;
+};
 
 struct Mesh
 {
     // OpenGL buffer objects
-    GLuint VBO = 0;
-    GLuint IBO = 0;
-    GLuint VAO = 0;
+    GLBuffer VBO;
+    GLBuffer IBO;
+    GLVertexArray VAO;
+    GLBuffer positionVBO;           // positions only (for depth-only passes)
+    GLVertexArray positionVAO;      // positionVBO with the shared IBO
     int numOfIndices = 0;
     bool hasTexCoords = false;
+
+    // bounds of all submeshes (computed at load)
+    glm::vec3 boundsMin = glm::vec3(0.0f);  // axis aligned bounding box
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);     // bounding sphere
+    float radius = 0.0f;
 };
 
 /*****************************************************************
- * simple model class that loads the first mesh of a model
+ * simple model class that loads the meshes of a model into one
+ * vertex and index buffer (one submesh per model mesh)
  *****************************************************************/
 class SimpleModel
 {
@@ -29,13 +52,25 @@ public:
 
     void loadModel(const char *filename, bool texture = false);
     void drawModel();
+    // draw part of the mesh (firstIndex and numIndices select a range of triangles)
+    void drawRange(GLuint firstIndex, GLsizei numIndices);
+    // draw part of the mesh from the position only vertex stream (attribute 0)
+    void drawPositionRange(GLuint firstIndex, GLsizei numIndices);
+
+    int getNumIndices() const { return mMesh.numOfIndices; }
+    const Mesh& getMesh() const { return mMesh; }
+    const std::vector<SubMesh>& getSubMeshes() const { return mSubMeshes; }
 
 private:
     bool mIsValid = false;
     Mesh mMesh;
+    std::vector<SubMesh> mSubMeshes;
  
-    void loadMesh(const aiMesh *mesh);
-    void loadMeshWithTexture(const aiMesh* mesh);
+    void loadMesh(const aiScene *scene);
+    void loadMeshWithTexture(const aiScene* scene);
+    void computeBounds(const aiMesh* mesh, SubMesh& subMesh);
+    void computeMeshBounds();
+    void createPositionStream(const std::vector<glm::vec3>& positions);
 };
 
 #endif
@@ -0,0 +1,114 @@
+#version 430 core
+
+// interpolated values from the vertex shaders
+in vec3 vPosition;
+in vec3 vNormal;
+
+// light properties (type in pos.w: 1=point; 2=directional; 3=spotlight)
+struct Light
+{
+	vec4 pos;
+	vec4 dir;
+	vec4 La;
+	vec4 Ld;
+	vec4 Ls;
+	vec4 att;
+	float cosInnerAngle;
+	float cosOuterAngle;
+};
+
+// material properties
+struct Material
+{
+	vec3 Ka;
+	vec3 Kd;
+	vec3 Ks;
+	float shininess;
+};
+
+layout(std430, binding = 5) readonly buffer Lights
+{
+	Light lights[];
+};
+
+// offset and count of each cluster's list (tile by tile, row by row, slice by slice)
+layout(std430, binding = 6) readonly buffer Clusters
+{
+	uvec2 clusters[];
+};
+
+layout(std430, binding = 7) readonly buffer LightIndices
+{
+	uint lightIndices[];
+};
+
+// uniform input data
+uniform vec3 uViewpoint;
+uniform mat4 uViewMatrix;
+uniform vec4 uViewport;		// x, y, width, height
+uniform vec2 uClusterTiles;
+uniform int uNumSlices;
+uniform float uSliceScale;	// slice = log(depth) * scale + bias
+uniform float uSliceBias;
+uniform vec3 uAmbient;		// ambient light of all lights
+uniform Material uMaterial;
+
+// output data
+out vec3 fColor;
+
+void main()
+{
+	// fragment normal
+	vec3 n = normalize(vNormal);
+
+	// vector toward the viewer
+	vec3 v = normalize(uViewpoint - vPosition);
+
+	// cluster of the fragment
+	float depth = -(uViewMatrix * vec4(vPosition, 1.0f)).z;
+	int slice = clamp(int(log(depth) * uSliceScale + uSliceBias), 0, uNumSlices - 1);
+	ivec2 tile = clamp(ivec2((gl_FragCoord.xy - uViewport.xy) / uViewport.zw * uClusterTiles), ivec2(0), ivec2(uClusterTiles) - 1);
+	uvec2 cluster = clusters[(slice * int(uClusterTiles.y) + tile.y) * int(uClusterTiles.x) + tile.x];
+
+	vec3 color = uAmbient * uMaterial.Ka;
+
+	for(uint i = 0; i < cluster.y; i++)
+	{
+		Light light = lights[lightIndices[cluster.x + i]];
+		int type = int(light.pos.w);
+
+		// vector towards the light and attenuation
+		vec3 l;
+		float attenuation = 1.0f;
+
+		if(type == 2)
+		{
+			l = -light.dir.xyz;
+		}
+		else
+		{
+			l = light.pos.xyz - vPosition;
+			float d = length(l);
+			l /= d;
+			attenuation = 1.0f / (light.att.x + light.att.y * d + light.att.z * d * d);
+
+			// spotlight cone with a smooth edge
+			if(type == 3)
+				attenuation *= smoothstep(light.cosOuterAngle, light.cosInnerAngle, dot(-l, light.dir.xyz));
+		}
+
+		// calculate diffuse and specular intensities
+		float dotLN = max(dot(l, n), 0.0f);
+
+		if(dotLN > 0.0f)
+		{
+			vec3 r = reflect(-l, n);
+			vec3 Id = light.Ld.rgb * uMaterial.Kd * dotLN;
+			vec3 Is = light.Ls.rgb * uMaterial.Ks * pow(max(dot(v, r), 0.0f), uMaterial.shininess);
+			color += attenuation * (Id + Is);
+		}
+	}
+
+	// set output color
+	fColor = color;
+}
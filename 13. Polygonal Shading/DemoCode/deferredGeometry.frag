@@ -0,0 +1,43 @@
+#version 330 core
+
+// interpolated values from the vertex shaders
+in vec3 vPosition;
+in vec3 vNormal;
+
+// material properties
+struct Material
+{
+	vec3 Ka;
+	vec3 Kd;
+	vec3 Ks;
+	float shininess;
+};
+
+// uniform input data
+uniform mat4 uViewMatrix;
+uniform vec3 uAmbient;		// ambient light of all lights
+uniform Material uMaterial;
+
+// output data (G-buffer)
+layout(location = 0) out float fDepth;		// view depth
+layout(location = 1) out vec2 fNormal;		// octahedral normal
+layout(location = 2) out vec4 fDiffuse;
+layout(location = 3) out vec4 fSpecular;	// shininess / 255 in alpha
+layout(location = 4) out vec4 fLight;		// accumulated light
+
+// map a unit vector onto the octahedron and unfold it into [-1, 1] x [-1, 1]
+vec2 encode_normal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 signs = vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return (n.z >= 0.0f) ? n.xy : (1.0f - abs(n.yx)) * signs;
+}
+
+void main()
+{
+	fDepth = -(uViewMatrix * vec4(vPosition, 1.0f)).z;
+	fNormal = encode_normal(normalize(vNormal));
+	fDiffuse = vec4(uMaterial.Kd, 1.0f);
+	fSpecular = vec4(uMaterial.Ks, uMaterial.shininess / 255.0f);
+	fLight = vec4(uAmbient * uMaterial.Ka, 1.0f);
+}
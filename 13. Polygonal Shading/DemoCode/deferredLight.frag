@@ -0,0 +1,105 @@
+#version 330 core
+
+// light properties (type: 1=point; 2=directional; 3=spotlight)
+struct Light
+{
+	vec3 pos;
+	vec3 dir;
+	vec3 Ld;
+	vec3 Ls;
+	vec3 att;
+	float cosInnerAngle;
+	float cosOuterAngle;
+	float radius;		// influence radius (the light volume)
+	int type;
+};
+
+// uniform input data
+uniform sampler2D uDepth;			// view depth
+uniform sampler2D uNormal;			// octahedral normal
+uniform sampler2D uDiffuse;
+uniform sampler2D uSpecular;		// shininess / 255 in alpha
+uniform mat4 uInverseViewMatrix;
+uniform vec2 uProjectionScale;		// 1 / projection[0][0], 1 / projection[1][1]
+uniform vec2 uProjectionOffset;		// projection[2][0], projection[2][1]
+uniform vec2 uScreenSize;
+uniform vec3 uViewpoint;
+uniform Light uLight;
+
+// output data
+out vec3 fColor;
+
+// fold a point of [-1, 1] x [-1, 1] back onto the octahedron
+vec3 decode_normal(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += (n.x >= 0.0f) ? -t : t;
+	n.y += (n.y >= 0.0f) ? -t : t;
+	return normalize(n);
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(uDepth, pixel, 0).r;
+
+	// no surface (not discarded, so that the stencil mark is still cleared)
+	if(depth <= 0.0f)
+	{
+		fColor = vec3(0.0f);
+		return;
+	}
+
+	// world position from the view depth
+	vec2 ndc = gl_FragCoord.xy / uScreenSize * 2.0f - 1.0f;
+	vec3 viewPosition = vec3((ndc + uProjectionOffset) * uProjectionScale * depth, -depth);
+	vec3 position = (uInverseViewMatrix * vec4(viewPosition, 1.0f)).xyz;
+
+	vec3 n = decode_normal(texelFetch(uNormal, pixel, 0).xy);
+	vec3 Kd = texelFetch(uDiffuse, pixel, 0).rgb;
+	vec4 specular = texelFetch(uSpecular, pixel, 0);
+	vec3 Ks = specular.rgb;
+	float shininess = specular.a * 255.0f;
+
+	// vector toward the viewer
+	vec3 v = normalize(uViewpoint - position);
+
+	// vector towards the light and attenuation
+	vec3 l;
+	float attenuation = 1.0f;
+
+	if(uLight.type == 2)
+	{
+		l = -uLight.dir;
+	}
+	else
+	{
+		l = uLight.pos - position;
+		float d = length(l);
+		l /= d;
+		attenuation = 1.0f / (uLight.att.x + uLight.att.y * d + uLight.att.z * d * d);
+
+		// nothing outside the light volume
+		attenuation *= step(d, uLight.radius);
+
+		// spotlight cone with a smooth edge
+		if(uLight.type == 3)
+			attenuation *= smoothstep(uLight.cosOuterAngle, uLight.cosInnerAngle, dot(-l, uLight.dir));
+	}
+
+	// calculate diffuse and specular intensities
+	vec3 color = vec3(0.0f);
+	float dotLN = max(dot(l, n), 0.0f);
+
+	if(dotLN > 0.0f)
+	{
+		vec3 r = reflect(-l, n);
+		vec3 Id = uLight.Ld * Kd * dotLN;
+		vec3 Is = uLight.Ls * Ks * pow(max(dot(v, r), 0.0f), shininess);
+		color = attenuation * (Id + Is);
+	}
+
+	// set output color
+	fColor = color;
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+// input data (light volume)
+layout(location = 0) in vec3 aPosition;
+
+// uniform input data
+uniform mat4 uModelViewProjectionMatrix;
+uniform bool uFullScreen;		// draw a triangle covering the screen instead
+
+void main()
+{
+	if(uFullScreen)
+	{
+		// vertices 0, 1, 2 at (-1, -1), (3, -1), (-1, 3)
+		vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+		gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+	}
+	else
+	{
+		gl_Position = uModelViewProjectionMatrix * vec4(aPosition, 1.0f);
+	}
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+// depth-only pass: no colour output, the fixed function depth test and write do the work
+void main()
+{
+}
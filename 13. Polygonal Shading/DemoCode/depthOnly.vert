@@ -0,0 +1,16 @@
+#version 330 core
+
+// input data (position only vertex stream)
+layout(location = 0) in vec3 aPosition;
+
+// uniform input data
+uniform mat4 uModelViewProjectionMatrix;
+
+// the lighting pass tests against this depth with GL_EQUAL, so both must compute it identically
+invariant gl_Position;
+
+void main()
+{
+	// set vertex position
+	gl_Position = uModelViewProjectionMatrix * vec4(aPosition, 1.0f);
+}
@@ -34,6 +34,9 @@ uniform Material uMaterial;
 out vec3 vColor;
 flat out vec3 vFlatColor;
 
+// match the depth of depthOnly.vert exactly (for the GL_EQUAL test after a depth pre-pass)
+invariant gl_Position;
+
 void main()
 {
 	// set vertex position
@@ -0,0 +1,67 @@
+#version 430 core
+
+// interpolated values from the vertex shaders
+in vec3 vPosition;
+in vec3 vNormal;
+flat in uint vMaterial;
+
+// light properties
+struct Light
+{
+	vec3 pos;
+	vec3 La;
+	vec3 Ld;
+	vec3 Ls;
+};
+
+// material properties (shininess stored in Ks.w)
+struct Material
+{
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+};
+
+layout(std430, binding = 4) readonly buffer Materials
+{
+	Material materials[];
+};
+
+// uniform input data
+uniform vec3 uViewpoint;
+uniform Light uLight;
+
+// output data
+out vec3 fColor;
+
+void main()
+{
+	Material material = materials[vMaterial];
+
+	// fragment normal
+	vec3 n = normalize(vNormal);
+
+	// vector toward the viewer
+	vec3 v = normalize(uViewpoint - vPosition);
+
+	// vector towards the light
+	vec3 l = normalize(uLight.pos - vPosition);
+
+	// reflection vector
+	vec3 r = reflect(-l, n);
+
+	// calculate ambient, diffuse and specular intensities
+	vec3 Ia = uLight.La * material.Ka.rgb;
+	vec3 Id = vec3(0.0f);
+	vec3 Is = vec3(0.0f);
+	float dotLN = max(dot(l, n), 0.0f);
+
+	if(dotLN > 0.0f)
+	{
+		Id = uLight.Ld * material.Kd.rgb * dotLN;
+		Is = uLight.Ls * material.Ks.rgb * pow(max(dot(v, r), 0.0f), material.Ks.w);
+	}
+
+	// set output color (attenuation not implemented)
+	fColor = Ia + Id + Is;
+}
@@ -0,0 +1,42 @@
+#version 430 core
+
+// input data
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in uint aObject;	// per instance (offset by the draw's base instance)
+
+// per-object data
+struct ObjectData
+{
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+	uint material;
+};
+
+layout(std430, binding = 3) readonly buffer Objects
+{
+	ObjectData objects[];
+};
+
+// uniform input data
+uniform mat4 uViewProjectionMatrix;
+
+// output data
+out vec3 vPosition;
+out vec3 vNormal;
+flat out uint vMaterial;
+
+void main()
+{
+	ObjectData object = objects[aObject];
+
+	// set vertex position
+	vec4 position = object.modelMatrix * vec4(aPosition, 1.0f);
+	gl_Position = uViewProjectionMatrix * position;
+
+	// set vertex shader output
+	// will be interpolated for each fragment
+	vPosition = position.xyz;
+	vNormal = mat3(object.normalMatrix) * aNormal;
+	vMaterial = object.material;
+}
@@ -0,0 +1,95 @@
+#version 430 core
+
+// interpolated values from the vertex shaders
+in vec3 vPosition;
+in vec3 vNormal;
+
+// light properties (type in pos.w: 1=point; 2=directional; 3=spotlight)
+struct Light
+{
+	vec4 pos;
+	vec4 dir;
+	vec4 La;
+	vec4 Ld;
+	vec4 Ls;
+	vec4 att;
+	float cosInnerAngle;
+	float cosOuterAngle;
+};
+
+// material properties
+struct Material
+{
+	vec3 Ka;
+	vec3 Kd;
+	vec3 Ks;
+	float shininess;
+};
+
+layout(std430, binding = 5) readonly buffer Lights
+{
+	Light lights[];
+};
+
+// uniform input data
+uniform vec3 uViewpoint;
+uniform int uNumLights;
+uniform Material uMaterial;
+
+// output data
+out vec3 fColor;
+
+void main()
+{
+	// fragment normal
+	vec3 n = normalize(vNormal);
+
+	// vector toward the viewer
+	vec3 v = normalize(uViewpoint - vPosition);
+
+	vec3 color = vec3(0.0f);
+
+	for(int i = 0; i < uNumLights; i++)
+	{
+		Light light = lights[i];
+		int type = int(light.pos.w);
+
+		// vector towards the light and attenuation
+		vec3 l;
+		float attenuation = 1.0f;
+
+		if(type == 2)
+		{
+			l = -light.dir.xyz;
+		}
+		else
+		{
+			l = light.pos.xyz - vPosition;
+			float d = length(l);
+			l /= d;
+			attenuation = 1.0f / (light.att.x + light.att.y * d + light.att.z * d * d);
+
+			// spotlight cone with a smooth edge
+			if(type == 3)
+				attenuation *= smoothstep(light.cosOuterAngle, light.cosInnerAngle, dot(-l, light.dir.xyz));
+		}
+
+		// calculate ambient, diffuse and specular intensities
+		vec3 Ia = light.La.rgb * uMaterial.Ka;
+		vec3 Id = vec3(0.0f);
+		vec3 Is = vec3(0.0f);
+		float dotLN = max(dot(l, n), 0.0f);
+
+		if(dotLN > 0.0f)
+		{
+			vec3 r = reflect(-l, n);
+			Id = light.Ld.rgb * uMaterial.Kd * dotLN;
+			Is = light.Ls.rgb * uMaterial.Ks * pow(max(dot(v, r), 0.0f), uMaterial.shininess);
+		}
+
+		color += Ia + attenuation * (Id + Is);
+	}
+
+	// set output color
+	fColor = color;
+}
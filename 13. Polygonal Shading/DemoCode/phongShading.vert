@@ -13,6 +13,9 @@ uniform mat3 uNormalMatrix;
 out vec3 vPosition;
 out vec3 vNormal;
 
+// match the depth of depthOnly.vert exactly (for the GL_EQUAL test after a depth pre-pass)
+invariant gl_Position;
+
 void main()
 {
 	// set vertex position
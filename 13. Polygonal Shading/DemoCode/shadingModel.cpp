@@ -1,5 +1,17 @@
+#include <algorithm>
+#include <cmath>
+
 #include "utilities.h"
 #include "SimpleModel.h"
+#include "MatrixBatch.h"
+#include "EntityStore.h"
+#include "FrustumCuller.h"
+#include "IndirectRenderer.h"
+#include "LightBuffer.h"
+#include "LightClusters.h"
+#include "DeferredRenderer.h"
+#include "RenderQueue.h"
+#include "GLStateCache.h"
 
 // global variables
 // settings
@@ -13,13 +25,61 @@ float gFrameTime = 1 / gFrameRate;
 // scene content
 std::map<std::string, ShaderProgram> gShaders;	// shader program objects
 
-glm::mat4 gModelMatrix;			// object matrix
 glm::mat4 gViewMatrix;			// view matrix
 glm::mat4 gProjectionMatrix;	// projection matrix
 
-Light gLight;			// light properties
-Material gMaterial;		// material properties
-SimpleModel gModel;		// scene object model
+EntityStore gScene;					// scene entities and their components
+Entity gObject;						// object entity (transform, renderable, bounds)
+Entity gLight;						// light entity
+std::vector<Material> gMaterials;	// material table (indexed by Renderable::material)
+SimpleModel gModel;					// scene object model
+
+// visibility
+FrustumCuller gCuller;				// view frustum culling of entity bounds
+std::vector<Entity> gVisible;		// entities inside the view frustum
+uint32_t gNumVisible = 0;			// culling statistics
+uint32_t gNumCulled = 0;
+
+// GPU-driven rendering (compute shader culling and multi-draw indirect)
+IndirectRenderer gGPURenderer;		// draws the entities using gModel
+bool gGPUSupported = false;			// whether the context supports compute shaders and indirect draws
+bool gGPUCulling = false;			// draw the lower right viewport with the GPU renderer
+uint32_t gNumGPUVisible = 0;		// visible count of the GPU renderer (one frame late)
+
+// multiple lights (every light of the scene in a storage buffer, looped over by one shader)
+LightBuffer gLightBuffer;			// lights of the scene
+const GLuint gLightBinding = 5;		// storage buffer binding point of multiLightPhong.frag
+bool gMultiLightSupported = false;	// whether the context supports storage buffers
+bool gMultiLight = false;			// draw the lower right viewport with all lights
+uint32_t gNumLights = 0;			// lights in the buffer
+
+// clustered lighting (lights binned into a froxel grid, each fragment loops over its cluster's lights)
+LightClusters gLightClusters;		// lights of the scene and their clusters
+bool gClustered = false;			// use clusters when drawing with multiple lights
+uint32_t gNumLightReferences = 0;	// lights listed in all clusters
+
+// deferred shading (G-buffer pass, then one light volume per light)
+DeferredRenderer gDeferredRenderer;	// draws the lower right viewport with all lights
+bool gDeferred = false;
+bool gStencilCulling = true;		// mark the pixels inside each light volume before shading them
+uint32_t gNumLightVolumes = 0;		// lights drawn as volumes
+
+// render list (packed every frame)
+std::vector<Renderable> gRenderList;	// renderables of the entities to draw
+std::vector<glm::mat4> gModelMatrices;	// model matrix of each renderable
+std::vector<glm::mat4> gMVPMatrices;	// model-view-projection matrix of each renderable
+std::vector<glm::mat3> gNormalMatrices;	// normal matrix of each renderable
+
+// render queue
+enum Program { FLAT_PROGRAM, GOURAUD_PROGRAM, PHONG_PROGRAM, DEPTH_PROGRAM };	// shading programs referenced by draw keys
+const GLint gViewports[][4] = { { 400, 300, 400, 300 }, { 0, 0, 400, 300 }, { 400, 0, 400, 300 } };	// viewports referenced by draw keys
+RenderQueue gRenderQueue;			// draws of all viewports sorted by key
+uint32_t gNumPackets = 0;			// render queue stats (per frame)
+uint32_t gNumProgramChanges = 0;
+uint32_t gNumMaterialChanges = 0;
+uint32_t gNumGLCallsIssued = 0;		// state calls issued to and elided by the state cache (per frame)
+uint32_t gNumGLCallsElided = 0;
+bool gDepthPrepass = false;			// draw the depth of every queued draw before lighting them
 
 // controls
 bool gWireframe = false;	// wireframe control
@@ -31,11 +91,12 @@ static void init(GLFWwindow* window)
 	// set the color the color buffer should be cleared to
 	glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
 
-	glEnable(GL_DEPTH_TEST);	// enable depth buffer test
+	GLStateCache::enable(GL_DEPTH_TEST);	// enable depth buffer test
 
 	// compile and link a vertex and fragment shader pair
 	gShaders["GouraudShading"].compileAndLink("gouraudShading.vert", "gouraudShading.frag");
 	gShaders["PhongShading"].compileAndLink("phongShading.vert", "phongShading.frag");
+	gShaders["DepthOnly"].compileAndLink("depthOnly.vert", "depthOnly.frag");
 
 	// initialise view matrix
 	gViewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), 
@@ -46,28 +107,290 @@ static void init(GLFWwindow* window)
 		static_cast<float>(gWindowWidth) / gWindowHeight, 0.1f, 10.0f);
 
 	// initialise light properties
-	gLight.pos = glm::vec3(0.0f, 0.0f, 4.0f);
-	gLight.La = glm::vec3(1.0f, 1.0f, 1.0f);
-	gLight.Ld = glm::vec3(0.0f, 0.5f, 1.0f);
-	gLight.Ls = glm::vec3(0.0f, 0.5f, 1.0f);
+	Light light = {};
+	light.pos = glm::vec3(0.0f, 0.0f, 4.0f);
+	light.La = glm::vec3(1.0f, 1.0f, 1.0f);
+	light.Ld = glm::vec3(0.0f, 0.5f, 1.0f);
+	light.Ls = glm::vec3(0.0f, 0.5f, 1.0f);
+	light.att = glm::vec3(1.0f, 0.0f, 0.0f);
+	light.type = 1;
+
+	gLight = gScene.create();
+	gScene.getLights().add(gLight, light);
+
+	// coloured point lights and a spotlight (only lit with multiple lights)
+	const glm::vec3 colors[] = { glm::vec3(1.0f, 0.2f, 0.2f), glm::vec3(0.2f, 1.0f, 0.2f), glm::vec3(1.0f, 1.0f, 0.2f) };
+	for (int i = 0; i < 3; i++)
+	{
+		float angle = glm::radians(120.0f * i);
+		Light pointLight = {};
+		pointLight.pos = glm::vec3(1.5f * std::cos(angle), 1.5f * std::sin(angle), 1.0f);
+		pointLight.Ld = colors[i];
+		pointLight.Ls = colors[i];
+		pointLight.att = glm::vec3(1.0f, 0.0f, 0.5f);
+		pointLight.type = 1;
+		gScene.getLights().add(gScene.create(), pointLight);
+	}
 
-	// initialise material properties
-	gMaterial.Ka = glm::vec3(0.4f, 0.4f, 0.4f);
-	gMaterial.Kd = glm::vec3(0.2f, 0.7f, 1.0f);
-	gMaterial.Ks = glm::vec3(0.2f, 0.7f, 1.0f);
-	gMaterial.shininess = 40.0f;
+	Light spotLight = {};
+	spotLight.pos = glm::vec3(0.0f, 3.0f, 0.0f);
+	spotLight.dir = glm::vec3(0.0f, -1.0f, 0.0f);
+	spotLight.Ld = glm::vec3(1.0f);
+	spotLight.Ls = glm::vec3(1.0f);
+	spotLight.att = glm::vec3(1.0f, 0.0f, 0.0f);
+	spotLight.innerAngle = 10.0f;
+	spotLight.outerAngle = 15.0f;
+	spotLight.type = 3;
+	gScene.getLights().add(gScene.create(), spotLight);
 
-	// initialise model matrices
-	gModelMatrix = glm::mat4(1.0f);
+	// initialise material properties
+	Material material = {};
+	material.Ka = glm::vec3(0.4f, 0.4f, 0.4f);
+	material.Kd = glm::vec3(0.2f, 0.7f, 1.0f);
+	material.Ks = glm::vec3(0.2f, 0.7f, 1.0f);
+	material.shininess = 40.0f;
+	gMaterials.push_back(material);
 
 	// load models
 	gModel.loadModel("./models/sphere.obj");
+
+	// create object entity (unit sphere)
+	gObject = gScene.create();
+	gScene.getTransforms().add(gObject, glm::mat4(1.0f));
+	gScene.getRenderables().add(gObject, { &gModel, 0, gModel.getNumIndices(), 0 });
+
+	// bounds of the model's mesh (computed at load)
+	const Mesh& mesh = gModel.getMesh();
+	Bounds bounds = {};
+	bounds.localMin = mesh.boundsMin;
+	bounds.localMax = mesh.boundsMax;
+	bounds.localCenter = mesh.center;
+	bounds.localRadius = mesh.radius;
+	gScene.getBounds().add(gObject, bounds);
+
+	// initialise GPU-driven renderer if supported
+	gGPUSupported = IndirectRenderer::isSupported();
+	if (gGPUSupported)
+	{
+		gGPURenderer.init(gModel);
+		gGPURenderer.setMaterials(gMaterials);
+	}
+
+	// initialise deferred shading at the size of the lower right viewport
+	gDeferredRenderer.init(gViewports[2][2], gViewports[2][3]);
+
+	// initialise multiple lights if supported
+	gMultiLightSupported = LightBuffer::isSupported();
+	if (gMultiLightSupported)
+	{
+		gShaders["MultiLightPhong"].compileAndLink("phongShading.vert", "multiLightPhong.frag");
+		gShaders["ClusteredPhong"].compileAndLink("phongShading.vert", "clusteredPhong.frag");
+		gShaders["SingleLightPhong"].compileAndLink("phongShading.vert", "singleLightPhong.frag");
+	}
 }
 
 // function used to update the scene
 static void update_scene(GLFWwindow* window)
 {
-	gModelMatrix = glm::rotate(glm::radians(gRotationAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+	gScene.getTransforms().get(gObject) = glm::rotate(glm::radians(gRotationAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	// update world bounds from the transforms
+	gScene.updateBounds();
+}
+
+// ambient light of all lights of the scene
+static glm::vec3 ambient_light()
+{
+	glm::vec3 ambient(0.0f);
+	const ComponentArray<Light>& lights = gScene.getLights();
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		if (lights.data()[i].type != 0)
+			ambient += lights.data()[i].La;
+	}
+	return ambient;
+}
+
+// set per-object uniforms and draw every renderable of the render list
+static void draw_render_list(ShaderProgram& shader)
+{
+	for (size_t i = 0; i < gRenderList.size(); i++)
+	{
+		const Renderable& renderable = gRenderList[i];
+		const Material& material = gMaterials[renderable.material];
+
+		// set material properties
+		shader.setUniform("uMaterial.Ka", material.Ka);
+		shader.setUniform("uMaterial.Kd", material.Kd);
+		shader.setUniform("uMaterial.Ks", material.Ks);
+		shader.setUniform("uMaterial.shininess", material.shininess);
+
+		// set uniform variables
+		shader.setUniform("uModelViewProjectionMatrix", gMVPMatrices[i]);
+		shader.setUniform("uModelMatrix", gModelMatrices[i]);
+		shader.setUniform("uNormalMatrix", gNormalMatrices[i]);
+
+		// render mesh range
+		renderable.model->drawRange(renderable.firstIndex, renderable.numIndices);
+	}
+}
+
+// draw the depth of every renderable of the render list (position only stream)
+static void draw_render_list_depth(ShaderProgram& shader)
+{
+	for (size_t i = 0; i < gRenderList.size(); i++)
+	{
+		const Renderable& renderable = gRenderList[i];
+		shader.setUniform("uModelViewProjectionMatrix", gMVPMatrices[i]);
+		renderable.model->drawPositionRange(renderable.firstIndex, renderable.numIndices);
+	}
+}
+
+// use a shading program and set its per-program uniforms
+static ShaderProgram& bind_program(uint32_t program, const Light& light)
+{
+	// depth only (no uniforms besides the per-object matrix)
+	if (program == DEPTH_PROGRAM)
+	{
+		ShaderProgram& shader = gShaders["DepthOnly"];
+		shader.use();
+		return shader;
+	}
+
+	// Phong shading with the light clusters
+	if (program == PHONG_PROGRAM && gMultiLight && gClustered)
+	{
+		ShaderProgram& shader = gShaders["ClusteredPhong"];
+		shader.use();
+		gLightClusters.setUniforms(shader, gViewports[2]);	// (Phong shading is drawn in the lower right viewport)
+		shader.setUniform("uViewMatrix", gViewMatrix);
+		shader.setUniform("uViewpoint", glm::vec3(0.0f, 0.0f, 3.0f));
+		return shader;
+	}
+
+	// Phong shading with the light buffer
+	if (program == PHONG_PROGRAM && gMultiLight)
+	{
+		ShaderProgram& shader = gShaders["MultiLightPhong"];
+		shader.use();
+		gLightBuffer.bind(gLightBinding);
+		shader.setUniform("uNumLights", static_cast<int>(gLightBuffer.getNumLights()));
+		shader.setUniform("uViewpoint", glm::vec3(0.0f, 0.0f, 3.0f));
+		return shader;
+	}
+
+	ShaderProgram& shader = (program == PHONG_PROGRAM) ? gShaders["PhongShading"] : gShaders["GouraudShading"];
+	shader.use();
+
+	// set to flat or smooth/Gouraud shading
+	if (program != PHONG_PROGRAM)
+		shader.setUniform("uFlatShading", program == FLAT_PROGRAM);
+
+	// set light properties
+	shader.setUniform("uLight.pos", light.pos);
+	shader.setUniform("uLight.La", light.La);
+	shader.setUniform("uLight.Ld", light.Ld);
+	shader.setUniform("uLight.Ls", light.Ls);
+
+	// set viewing position
+	shader.setUniform("uViewpoint", glm::vec3(0.0f, 0.0f, 3.0f));
+
+	return shader;
+}
+
+// draw the sorted render queue, changing state only where the key fields change
+static void execute_render_queue(const Light& light)
+{
+	const uint32_t none = 0xFFFFFFFF;
+	uint32_t viewport = none, program = none, material = none;
+	RenderPass pass = RenderPass::OPAQUE_PASS;	// (the default state)
+	bool equalDepth = false;	// opaque draws tested against the depth pass
+	ShaderProgram* shader = nullptr;
+
+	gNumPackets = static_cast<uint32_t>(gRenderQueue.size());
+	gNumProgramChanges = 0;
+	gNumMaterialChanges = 0;
+
+	for (size_t i = 0; i < gRenderQueue.size(); i++)
+	{
+		const DrawPacket& packet = gRenderQueue.data()[i];
+
+		// the depth pass writes depth only; the opaque pass after it shades only fragments whose depth equals the
+		// stored one, and later passes (whose depth was never written) test as usual again
+		RenderPass packetPass = RenderQueue::getPass(packet.key);
+		if (packetPass != pass)
+		{
+			if (packetPass == RenderPass::DEPTH_PASS)
+				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			else if (pass == RenderPass::DEPTH_PASS)
+				glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+			if (pass == RenderPass::DEPTH_PASS && packetPass == RenderPass::OPAQUE_PASS)
+			{
+				GLStateCache::depthFunc(GL_EQUAL);
+				GLStateCache::depthMask(GL_FALSE);
+				equalDepth = true;
+			}
+			else if (equalDepth)
+			{
+				GLStateCache::depthFunc(GL_LESS);
+				GLStateCache::depthMask(GL_TRUE);
+				equalDepth = false;
+			}
+			pass = packetPass;
+		}
+
+		uint32_t packetViewport = RenderQueue::getViewport(packet.key);
+		if (packetViewport != viewport)
+		{
+			viewport = packetViewport;
+			GLStateCache::viewport(gViewports[viewport][0], gViewports[viewport][1], gViewports[viewport][2], gViewports[viewport][3]);
+		}
+
+		// material uniforms belong to the program, so they are set again after a program change
+		uint32_t packetProgram = RenderQueue::getProgram(packet.key);
+		if (packetProgram != program)
+		{
+			program = packetProgram;
+			shader = &bind_program(program, light);
+			material = none;
+			gNumProgramChanges++;
+		}
+
+		// depth-only draws use the position only stream and no material or normal uniforms
+		const Renderable& renderable = gRenderList[packet.item];
+		if (pass == RenderPass::DEPTH_PASS)
+		{
+			shader->setUniform("uModelViewProjectionMatrix", gMVPMatrices[packet.item]);
+			renderable.model->drawPositionRange(renderable.firstIndex, renderable.numIndices);
+			continue;
+		}
+
+		// (materials in this demo are untextured, so the key's texture field is unused)
+		uint32_t packetMaterial = RenderQueue::getMaterial(packet.key);
+		if (packetMaterial != material)
+		{
+			material = packetMaterial;
+			shader->setUniform("uMaterial.Ka", gMaterials[material].Ka);
+			shader->setUniform("uMaterial.Kd", gMaterials[material].Kd);
+			shader->setUniform("uMaterial.Ks", gMaterials[material].Ks);
+			shader->setUniform("uMaterial.shininess", gMaterials[material].shininess);
+			gNumMaterialChanges++;
+		}
+
+		// set per-object uniforms and render mesh range
+		shader->setUniform("uModelViewProjectionMatrix", gMVPMatrices[packet.item]);
+		shader->setUniform("uModelMatrix", gModelMatrices[packet.item]);
+		shader->setUniform("uNormalMatrix", gNormalMatrices[packet.item]);
+		renderable.model->drawRange(renderable.firstIndex, renderable.numIndices);
+	}
+
+	// restore the default depth state
+	if (equalDepth)
+	{
+		GLStateCache::depthFunc(GL_LESS);
+		GLStateCache::depthMask(GL_TRUE);
+	}
 }
 
 // function to render the scene
@@ -76,90 +399,715 @@ static void render_scene()
 	// clear colour buffer and depth buffer
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// calculate matrices
-	glm::mat4 MVP = gProjectionMatrix * gViewMatrix * gModelMatrix;
-	glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(gModelMatrix)));
+	// find the entities inside the view frustum
+	gVisible.clear();
+	gCuller.setFrustum(gProjectionMatrix * gViewMatrix);
+	gCuller.cull(gScene.getBounds(), gVisible);
+	gNumVisible = gCuller.getNumVisible();
+	gNumCulled = gCuller.getNumCulled();
 
-	/**************************************
-	* Upper right viewport
-	**************************************/
+	// pack visible renderables and calculate their matrices
+	gScene.gatherRenderables(gVisible, gRenderList, gModelMatrices);
+	gMVPMatrices.resize(gModelMatrices.size());
+	gNormalMatrices.resize(gModelMatrices.size());
+	multiplyMatrices(gProjectionMatrix * gViewMatrix, gModelMatrices.data(), gMVPMatrices.data(), gModelMatrices.size());
+	computeNormalMatrices(gModelMatrices.data(), gNormalMatrices.data(), gModelMatrices.size());
 
-	glViewport(400, 300, 400, 300);
-	
-	// use shaders associated with the shader program
-	gShaders["GouraudShading"].use();
+	const Light& light = gScene.getLights().get(gLight);
 
-	// set to flat shading
-	gShaders["GouraudShading"].setUniform("uFlatShading", true);
+	// copy all lights of the scene to the light buffer, or bin them into clusters
+	if (gMultiLight && gClustered)
+	{
+		gLightClusters.update(gScene.getLights().data(), gScene.getLights().size(), gViewMatrix, gProjectionMatrix);
+		gNumLights = gLightClusters.getNumLights();
+		gNumLightReferences = gLightClusters.getNumIndices();
+	}
+	else if (gMultiLight)
+	{
+		gLightBuffer.update(gScene.getLights().data(), gScene.getLights().size());
+		gNumLights = gLightBuffer.getNumLights();
+	}
 
-	// set light properties
-	gShaders["GouraudShading"].setUniform("uLight.pos", gLight.pos);
-	gShaders["GouraudShading"].setUniform("uLight.La", gLight.La);
-	gShaders["GouraudShading"].setUniform("uLight.Ld", gLight.Ld);
-	gShaders["GouraudShading"].setUniform("uLight.Ls", gLight.Ls);
+	// submit every renderable to each viewport: upper right (flat), lower left (Gouraud), lower right (Phong)
+	const float farPlane = 10.0f;
+	gRenderQueue.clear();
+	for (uint32_t i = 0; i < gRenderList.size(); i++)
+	{
+		// view depth of the object's origin
+		float depth = -(gViewMatrix * gModelMatrices[i][3]).z / farPlane;
+		uint32_t material = gRenderList[i].material;
 
-	// set material properties
-	gShaders["GouraudShading"].setUniform("uMaterial.Ka", gMaterial.Ka);
-	gShaders["GouraudShading"].setUniform("uMaterial.Kd", gMaterial.Kd);
-	gShaders["GouraudShading"].setUniform("uMaterial.Ks", gMaterial.Ks);
-	gShaders["GouraudShading"].setUniform("uMaterial.shininess", gMaterial.shininess);
+		gRenderQueue.submit(RenderQueue::makeKey(RenderPass::OPAQUE_PASS, 0, FLAT_PROGRAM, material, 0, depth), i);
+		gRenderQueue.submit(RenderQueue::makeKey(RenderPass::OPAQUE_PASS, 1, GOURAUD_PROGRAM, material, 0, depth), i);
 
-	// set viewing position
-	gShaders["GouraudShading"].setUniform("uViewpoint", glm::vec3(0.0f, 0.0f, 3.0f));
+		// the lower right viewport is drawn by the GPU renderer when GPU culling is on, or the deferred renderer
+		uint32_t numViewports = 2;
+		if (!gGPUCulling && !gDeferred)
+		{
+			gRenderQueue.submit(RenderQueue::makeKey(RenderPass::OPAQUE_PASS, 2, PHONG_PROGRAM, material, 0, depth), i);
+			numViewports = 3;
+		}
+
+		// depth of the same draws before any of them is shaded (front to back, as the depth pass has no materials)
+		if (gDepthPrepass)
+		{
+			for (uint32_t viewport = 0; viewport < numViewports; viewport++)
+				gRenderQueue.submit(RenderQueue::makeKey(RenderPass::DEPTH_PASS, viewport, DEPTH_PROGRAM, 0, 0, depth), i);
+		}
+	}
+
+	// sort and draw
+	gRenderQueue.sort();
+	execute_render_queue(light);
 
-	// set uniform variables
-	gShaders["GouraudShading"].setUniform("uModelViewProjectionMatrix", MVP);
-	gShaders["GouraudShading"].setUniform("uModelMatrix", gModelMatrix);
-	gShaders["GouraudShading"].setUniform("uNormalMatrix", normalMatrix);
+	if (gGPUCulling)
+	{
+		// cull and draw all objects on the GPU
+		GLStateCache::viewport(gViewports[2][0], gViewports[2][1], gViewports[2][2], gViewports[2][3]);
+		gGPURenderer.update(gScene);
+		gGPURenderer.cull(gProjectionMatrix * gViewMatrix);
+		gGPURenderer.draw(gProjectionMatrix * gViewMatrix, light, glm::vec3(0.0f, 0.0f, 3.0f));
+		gNumGPUVisible = gGPURenderer.getNumVisible();
+	}
+	else if (gDeferred)
+	{
+		// fill the G-buffer, add the light of every light and copy the result to the viewport
+		gDeferredRenderer.setStencilCulling(gStencilCulling);
+		ShaderProgram& shader = gDeferredRenderer.beginGeometry(gViewMatrix, ambient_light());
+		draw_render_list(shader);
+		gDeferredRenderer.drawLights(gScene.getLights().data(), gScene.getLights().size(), gViewMatrix, gProjectionMatrix,
+			glm::vec3(0.0f, 0.0f, 3.0f));
+		gDeferredRenderer.resolve(gViewports[2]);
+		gNumLightVolumes = gDeferredRenderer.getNumVolumes();
+	}
 
-	// render model
-	gModel.drawModel();
+	// flush the graphics pipeline
+	glFlush();
+}
 
-	/**************************************
-	* Lower left viewport
-	**************************************/
+// measure matrix computation times of per-object glm calls and batch kernels
+static void benchmark_matrices()
+{
+	const size_t numObjects = 10000;
+	const int numFrames = 100;		// frames per measurement
 
-	glViewport(0, 0, 400, 300);
+	// random rigid transforms with uniform scale, and the same with non-uniform scale
+	std::vector<glm::mat4> uniformModels(numObjects), nonUniformModels(numObjects);
+	for (size_t i = 0; i < numObjects; i++)
+	{
+		glm::vec3 position(rand() % 100 - 50.0f, rand() % 100 - 50.0f, rand() % 100 - 50.0f);
+		glm::vec3 axis = glm::normalize(glm::vec3(rand() % 100 + 1.0f, rand() % 100 - 50.0f, rand() % 100 - 50.0f));
+		float angle = glm::radians(static_cast<float>(rand() % 360));
+		float scale = 0.5f + (rand() % 100) * 0.01f;
+
+		glm::mat4 rigid = glm::translate(position) * glm::rotate(angle, axis);
+		uniformModels[i] = rigid * glm::scale(glm::vec3(scale));
+		nonUniformModels[i] = rigid * glm::scale(glm::vec3(scale, 1.0f, 2.0f * scale));
+	}
 
-	// set to smooth/Gouraud shading
-	gShaders["GouraudShading"].setUniform("uFlatShading", false);
+	std::vector<glm::mat4> MVPs(numObjects);
+	std::vector<glm::mat3> normalMatrices(numObjects);
 
-	// render model
-	gModel.drawModel();
+	std::cout << "Matrix benchmark (" << numObjects << " objects, " << getMatrixBatchInstructionSet() << ")" << std::endl;
 
-	/**************************************
-	* Lower right viewport
-	**************************************/
-	glViewport(400, 0, 400, 300);
+	const std::vector<glm::mat4>* modelSets[] = { &uniformModels, &nonUniformModels };
+	const char* modelSetNames[] = { "uniform scale    ", "non-uniform scale" };
 
-	// use shaders associated with the shader program
-	gShaders["PhongShading"].use();
+	for (int set = 0; set < 2; set++)
+	{
+		const std::vector<glm::mat4>& models = *modelSets[set];
 
-	// set light properties
-	gShaders["PhongShading"].setUniform("uLight.pos", gLight.pos);
-	gShaders["PhongShading"].setUniform("uLight.La", gLight.La);
-	gShaders["PhongShading"].setUniform("uLight.Ld", gLight.Ld);
-	gShaders["PhongShading"].setUniform("uLight.Ls", gLight.Ls);
+		// per-object glm path
+		double startTime = glfwGetTime();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			for (size_t i = 0; i < numObjects; i++)
+			{
+				MVPs[i] = gProjectionMatrix * gViewMatrix * models[i];
+				normalMatrices[i] = glm::mat3(glm::transpose(glm::inverse(models[i])));
+			}
+		}
+		double glmTime = (glfwGetTime() - startTime) / numFrames;
 
-	// set material properties
-	gShaders["PhongShading"].setUniform("uMaterial.Ka", gMaterial.Ka);
-	gShaders["PhongShading"].setUniform("uMaterial.Kd", gMaterial.Kd);
-	gShaders["PhongShading"].setUniform("uMaterial.Ks", gMaterial.Ks);
-	gShaders["PhongShading"].setUniform("uMaterial.shininess", gMaterial.shininess);
+		// batch kernels
+		startTime = glfwGetTime();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			multiplyMatrices(gProjectionMatrix * gViewMatrix, &models[0], &MVPs[0], numObjects);
+			computeNormalMatrices(&models[0], &normalMatrices[0], numObjects);
+		}
+		double batchTime = (glfwGetTime() - startTime) / numFrames;
 
-	// set viewing position
-	gShaders["PhongShading"].setUniform("uViewpoint", glm::vec3(0.0f, 0.0f, 3.0f));
+		std::cout << "  " << modelSetNames[set] << ": glm " << glmTime * 1000.0 << " ms, batch "
+			<< batchTime * 1000.0 << " ms (" << glmTime / batchTime << "x)" << std::endl;
+	}
+}
 
-	// set uniform variables
-	gShaders["PhongShading"].setUniform("uModelViewProjectionMatrix", MVP);
-	gShaders["PhongShading"].setUniform("uModelMatrix", gModelMatrix);
-	gShaders["PhongShading"].setUniform("uNormalMatrix", normalMatrix);
+// measure frustum culling time of many random entities
+static void benchmark_culling()
+{
+	const size_t numEntities = 100000;
+	const int numFrames = 100;		// culls per measurement
 
-	// render model
-	gModel.drawModel();
+	// random unit spheres inside a cube around the camera
+	EntityStore scene;
+	for (size_t i = 0; i < numEntities; i++)
+	{
+		Entity entity = scene.create();
+		glm::vec3 position(rand() % 200 - 100.0f, rand() % 200 - 100.0f, rand() % 200 - 100.0f);
+		scene.getTransforms().add(entity, glm::translate(position));
+
+		Bounds bounds = {};
+		bounds.localMin = glm::vec3(-1.0f);
+		bounds.localMax = glm::vec3(1.0f);
+		bounds.localRadius = 1.0f;
+		scene.getBounds().add(entity, bounds);
+	}
+	scene.updateBounds();
 
-	// flush the graphics pipeline
-	glFlush();
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), static_cast<float>(gWindowWidth) / gWindowHeight, 0.1f, 100.0f);
+
+	FrustumCuller culler;
+	std::vector<Entity> visible;
+	visible.reserve(numEntities);
+
+	double startTime = glfwGetTime();
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		visible.clear();
+		culler.setFrustum(projection * gViewMatrix);
+		culler.cull(scene.getBounds(), visible);
+	}
+	double elapsed = (glfwGetTime() - startTime) / numFrames;
+
+	std::cout << "Culling benchmark (" << numEntities << " entities): " << elapsed * 1000.0 << " ms, "
+		<< culler.getNumVisible() << " visible, " << culler.getNumCulled() << " culled" << std::endl;
+}
+
+// measure CPU culling with per-object draws against GPU culling with one indirect draw
+static void benchmark_indirect()
+{
+	if (!gGPUSupported)
+	{
+		std::cout << "Indirect benchmark: compute shaders and multi-draw indirect are not supported" << std::endl;
+		return;
+	}
+
+	const size_t numObjects = 10000;
+	const int numFrames = 20;		// frames per measurement
+
+	// random small spheres in front of and around the camera
+	EntityStore scene;
+	const Mesh& mesh = gModel.getMesh();
+	for (size_t i = 0; i < numObjects; i++)
+	{
+		Entity entity = scene.create();
+		glm::vec3 position(rand() % 200 * 0.05f - 5.0f, rand() % 200 * 0.05f - 5.0f, -(rand() % 200 * 0.05f));
+		scene.getTransforms().add(entity, glm::translate(position) * glm::scale(glm::vec3(0.05f)));
+		scene.getRenderables().add(entity, { &gModel, 0, gModel.getNumIndices(), 0 });
+
+		Bounds bounds = {};
+		bounds.localMin = mesh.boundsMin;
+		bounds.localMax = mesh.boundsMax;
+		bounds.localCenter = mesh.center;
+		bounds.localRadius = mesh.radius;
+		scene.getBounds().add(entity, bounds);
+	}
+	scene.updateBounds();
+
+	const glm::mat4 viewProjection = gProjectionMatrix * gViewMatrix;
+	const Light& light = gScene.getLights().get(gLight);
+	const glm::vec3 viewpoint(0.0f, 0.0f, 3.0f);
+	ShaderProgram& shader = gShaders["PhongShading"];
+
+	GLStateCache::viewport(400, 0, 400, 300);
+	glFinish();
+
+	// CPU culling, matrices and one draw per visible object
+	double startTime = glfwGetTime();
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		gVisible.clear();
+		gCuller.setFrustum(viewProjection);
+		gCuller.cull(scene.getBounds(), gVisible);
+
+		scene.gatherRenderables(gVisible, gRenderList, gModelMatrices);
+		gMVPMatrices.resize(gModelMatrices.size());
+		gNormalMatrices.resize(gModelMatrices.size());
+		multiplyMatrices(viewProjection, gModelMatrices.data(), gMVPMatrices.data(), gModelMatrices.size());
+		computeNormalMatrices(gModelMatrices.data(), gNormalMatrices.data(), gModelMatrices.size());
+
+		shader.use();
+		shader.setUniform("uLight.pos", light.pos);
+		shader.setUniform("uLight.La", light.La);
+		shader.setUniform("uLight.Ld", light.Ld);
+		shader.setUniform("uLight.Ls", light.Ls);
+		shader.setUniform("uViewpoint", viewpoint);
+		draw_render_list(shader);
+	}
+	glFinish();
+	double cpuTime = (glfwGetTime() - startTime) / numFrames;
+
+	// upload once (static objects), then GPU culling and one indirect draw per frame
+	gGPURenderer.update(scene);
+	glFinish();
+
+	startTime = glfwGetTime();
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		gGPURenderer.cull(viewProjection);
+		gGPURenderer.draw(viewProjection, light, viewpoint);
+	}
+	glFinish();
+	double gpuTime = (glfwGetTime() - startTime) / numFrames;
+
+	std::cout << "Indirect benchmark (" << numObjects << " objects, " << gCuller.getNumVisible() << " visible): CPU cull + "
+		<< gRenderList.size() << " draws " << cpuTime * 1000.0 << " ms, GPU cull + 1 indirect draw "
+		<< gpuTime * 1000.0 << " ms (" << cpuTime / gpuTime << "x)" << std::endl;
+
+	// restore the renderer's objects
+	gGPURenderer.update(gScene);
+}
+
+// measure one shader looping over a light buffer against one additive pass per light, from 1 to 1000 lights
+static void benchmark_lights()
+{
+	if (!gMultiLightSupported)
+	{
+		std::cout << "Light benchmark: shader storage buffers are not supported" << std::endl;
+		return;
+	}
+
+	const int numFrames = 20;		// frames per measurement
+	const glm::vec3 viewpoint(0.0f, 0.0f, 3.0f);
+	ShaderProgram& multiShader = gShaders["MultiLightPhong"];
+	ShaderProgram& passShader = gShaders["SingleLightPhong"];	// (the same lighting model for one light)
+
+	// random dim point lights and spotlights around the object
+	std::vector<Light> lights(1000);
+	for (Light& light : lights)
+	{
+		light = {};
+		light.pos = glm::vec3(rand() % 100 * 0.04f - 2.0f, rand() % 100 * 0.04f - 2.0f, rand() % 100 * 0.02f + 0.5f);
+		light.dir = glm::normalize(-light.pos);
+		light.Ld = glm::vec3(rand() % 100, rand() % 100, rand() % 100) * 0.0001f;
+		light.Ls = light.Ld;
+		light.att = glm::vec3(1.0f, 0.0f, 0.5f);
+		light.innerAngle = 20.0f;
+		light.outerAngle = 30.0f;
+		light.type = (rand() % 4 == 0) ? 3 : 1;
+	}
+
+	// the whole window, with the object of the last frame
+	GLStateCache::viewport(0, 0, gWindowWidth, gWindowHeight);
+	glFinish();
+
+	std::cout << "Light benchmark (" << gRenderList.size() << " objects, " << gWindowWidth << "x" << gWindowHeight << ")" << std::endl;
+
+	const size_t numLights[] = { 1, 10, 100, 1000 };
+	for (size_t count : numLights)
+	{
+		// light buffer update and one draw
+		double uploadTime = 0.0;
+		double startTime = glfwGetTime();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			double uploadStart = glfwGetTime();
+			gLightBuffer.update(lights.data(), count);
+			uploadTime += glfwGetTime() - uploadStart;
+
+			multiShader.use();
+			gLightBuffer.bind(gLightBinding);
+			multiShader.setUniform("uNumLights", static_cast<int>(gLightBuffer.getNumLights()));
+			multiShader.setUniform("uViewpoint", viewpoint);
+			draw_render_list(multiShader);
+		}
+		glFinish();
+		double bufferTime = (glfwGetTime() - startTime) / numFrames;
+		uploadTime /= numFrames;
+
+		// one pass per light with the single light shader, added up by blending (lights of type 0 are skipped,
+		// as in the light buffer)
+		startTime = glfwGetTime();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			passShader.use();
+			passShader.setUniform("uViewpoint", viewpoint);
+			bool firstPass = true;
+			for (size_t i = 0; i < count; i++)
+			{
+				const Light& light = lights[i];
+				if (light.type == 0)
+					continue;
+
+				if (!firstPass)
+				{
+					GLStateCache::enable(GL_BLEND);
+					GLStateCache::blendFunc(GL_ONE, GL_ONE);
+					GLStateCache::depthFunc(GL_LEQUAL);
+				}
+				firstPass = false;
+
+				passShader.setUniform("uLight.type", light.type);
+				passShader.setUniform("uLight.pos", light.pos);
+				passShader.setUniform("uLight.dir", light.type == 1 ? glm::vec3(0.0f) : glm::normalize(light.dir));
+				passShader.setUniform("uLight.La", light.La);
+				passShader.setUniform("uLight.Ld", light.Ld);
+				passShader.setUniform("uLight.Ls", light.Ls);
+				passShader.setUniform("uLight.att", light.att);
+				passShader.setUniform("uLight.cosInnerAngle", std::cos(glm::radians(light.innerAngle)));
+				passShader.setUniform("uLight.cosOuterAngle", std::cos(glm::radians(light.outerAngle)));
+				draw_render_list(passShader);
+			}
+			GLStateCache::disable(GL_BLEND);
+			GLStateCache::depthFunc(GL_LESS);
+		}
+		glFinish();
+		double passTime = (glfwGetTime() - startTime) / numFrames;
+
+		std::cout << "  " << count << " lights: light buffer " << bufferTime * 1000.0 << " ms (update "
+			<< uploadTime * 1000.0 << " ms), one pass per light " << passTime * 1000.0 << " ms ("
+			<< passTime / bufferTime << "x)" << std::endl;
+	}
+
+	// restore the scene's lights
+	gLightBuffer.update(gScene.getLights().data(), gScene.getLights().size());
+}
+
+// random point lights and spotlights of short range around the object
+static std::vector<Light> random_local_lights(size_t count)
+{
+	std::vector<Light> lights(count);
+	for (Light& light : lights)
+	{
+		light = {};
+		glm::vec3 direction = glm::normalize(glm::vec3(rand() % 200 - 100.0f, rand() % 200 - 100.0f, rand() % 200 - 100.0f) + 0.01f);
+		light.pos = direction * (1.1f + rand() % 100 * 0.01f);
+		light.dir = -direction;
+		light.Ld = glm::vec3(rand() % 100, rand() % 100, rand() % 100) * 0.002f;
+		light.Ls = light.Ld;
+		light.att = glm::vec3(1.0f, 0.0f, 200.0f);
+		light.innerAngle = 20.0f;
+		light.outerAngle = 30.0f;
+		light.type = (rand() % 4 == 0) ? 3 : 1;
+	}
+	return lights;
+}
+
+// measure looping over every light against looping over the lights of each fragment's cluster
+static void benchmark_clusters()
+{
+	if (!gMultiLightSupported)
+	{
+		std::cout << "Cluster benchmark: shader storage buffers are not supported" << std::endl;
+		return;
+	}
+
+	const int numFrames = 20;		// frames per measurement
+	const glm::vec3 viewpoint(0.0f, 0.0f, 3.0f);
+	const GLint viewport[4] = { 0, 0, static_cast<GLint>(gWindowWidth), static_cast<GLint>(gWindowHeight) };
+	ShaderProgram& multiShader = gShaders["MultiLightPhong"];
+	ShaderProgram& clusterShader = gShaders["ClusteredPhong"];
+
+	std::vector<Light> lights = random_local_lights(4000);
+
+	// the whole window, with the object of the last frame
+	GLStateCache::viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glFinish();
+
+	std::cout << "Cluster benchmark (" << gLightClusters.getNumClusters() << " clusters, influence radius "
+		<< LightClusters::getInfluenceRadius(lights[0]) << " to " << LightClusters::getInfluenceRadius(lights[1]) << ")" << std::endl;
+
+	const size_t numLights[] = { 10, 100, 1000, 4000 };
+	for (size_t count : numLights)
+	{
+		// every light for every fragment
+		gLightBuffer.update(lights.data(), count);
+		double startTime = glfwGetTime();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			multiShader.use();
+			gLightBuffer.bind(gLightBinding);
+			multiShader.setUniform("uNumLights", static_cast<int>(gLightBuffer.getNumLights()));
+			multiShader.setUniform("uViewpoint", viewpoint);
+			draw_render_list(multiShader);
+		}
+		glFinish();
+		double allTime = (glfwGetTime() - startTime) / numFrames;
+
+		// binning on one thread and on all threads
+		startTime = glfwGetTime();
+		for (int frame = 0; frame < numFrames; frame++)
+			gLightClusters.update(lights.data(), count, gViewMatrix, gProjectionMatrix, 1);
+		double singleBinTime = (glfwGetTime() - startTime) / numFrames;
+
+		double binTime = 0.0;
+		startTime = glfwGetTime();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			double binStart = glfwGetTime();
+			gLightClusters.update(lights.data(), count, gViewMatrix, gProjectionMatrix);
+			binTime += glfwGetTime() - binStart;
+
+			clusterShader.use();
+			gLightClusters.setUniforms(clusterShader, viewport);
+			clusterShader.setUniform("uViewMatrix", gViewMatrix);
+			clusterShader.setUniform("uViewpoint", viewpoint);
+			draw_render_list(clusterShader);
+		}
+		glFinish();
+		double clusterTime = (glfwGetTime() - startTime) / numFrames;
+		binTime /= numFrames;
+
+		std::cout << "  " << count << " lights: all lights " << allTime * 1000.0 << " ms, clustered " << clusterTime * 1000.0
+			<< " ms (" << allTime / clusterTime << "x; binning " << binTime * 1000.0 << " ms, one thread "
+			<< singleBinTime * 1000.0 << " ms), " << gLightClusters.getNumIndices() << " light references, at most "
+			<< gLightClusters.getMaxClusterLights() << " per cluster" << std::endl;
+	}
+
+	// restore the scene's lights
+	gLightBuffer.update(gScene.getLights().data(), gScene.getLights().size());
+	gLightClusters.update(gScene.getLights().data(), gScene.getLights().size(), gViewMatrix, gProjectionMatrix);
+}
+
+// measure forward shading with all lights against deferred shading with and without stencil culling
+static void benchmark_deferred()
+{
+	const int numFrames = 20;		// frames per measurement
+	const glm::vec3 viewpoint(0.0f, 0.0f, 3.0f);
+	ShaderProgram& multiShader = gShaders["MultiLightPhong"];
+	std::vector<Light> lights = random_local_lights(1000);
+
+	// the deferred renderer's viewport, with the object of the last frame
+	glFinish();
+
+	std::cout << "Deferred benchmark (" << gDeferredRenderer.getWidth() << "x" << gDeferredRenderer.getHeight() << ")" << std::endl;
+
+	const size_t numLights[] = { 10, 100, 1000 };
+	for (size_t count : numLights)
+	{
+		// forward: every light for every fragment
+		double forwardTime = 0.0;
+		if (gMultiLightSupported)
+		{
+			GLStateCache::viewport(gViewports[2][0], gViewports[2][1], gViewports[2][2], gViewports[2][3]);
+			gLightBuffer.update(lights.data(), count);
+			double startTime = glfwGetTime();
+			for (int frame = 0; frame < numFrames; frame++)
+			{
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+				multiShader.use();
+				gLightBuffer.bind(gLightBinding);
+				multiShader.setUniform("uNumLights", static_cast<int>(gLightBuffer.getNumLights()));
+				multiShader.setUniform("uViewpoint", viewpoint);
+				draw_render_list(multiShader);
+			}
+			glFinish();
+			forwardTime = (glfwGetTime() - startTime) / numFrames;
+		}
+
+		// deferred, with and without stencil culling
+		double deferredTimes[2];
+		for (int stencil = 0; stencil < 2; stencil++)
+		{
+			gDeferredRenderer.setStencilCulling(stencil == 1);
+			double startTime = glfwGetTime();
+			for (int frame = 0; frame < numFrames; frame++)
+			{
+				ShaderProgram& shader = gDeferredRenderer.beginGeometry(gViewMatrix, glm::vec3(0.0f));
+				draw_render_list(shader);
+				gDeferredRenderer.drawLights(lights.data(), count, gViewMatrix, gProjectionMatrix, viewpoint);
+				gDeferredRenderer.resolve(gViewports[2]);
+			}
+			glFinish();
+			deferredTimes[stencil] = (glfwGetTime() - startTime) / numFrames;
+		}
+
+		std::cout << "  " << count << " lights: ";
+		if (gMultiLightSupported)
+			std::cout << "forward " << forwardTime * 1000.0 << " ms, ";
+		std::cout << "deferred " << deferredTimes[1] * 1000.0 << " ms with stencil culling, "
+			<< deferredTimes[0] * 1000.0 << " ms without" << std::endl;
+	}
+
+	// restore the scene's lights
+	if (gMultiLightSupported)
+		gLightBuffer.update(gScene.getLights().data(), gScene.getLights().size());
+}
+
+// use Phong shading with the key light, or with every light of the light buffer
+static ShaderProgram& use_phong_shading(bool multiLight, const Light& light, const glm::vec3& viewpoint)
+{
+	if (multiLight)
+	{
+		ShaderProgram& shader = gShaders["MultiLightPhong"];
+		shader.use();
+		gLightBuffer.bind(gLightBinding);
+		shader.setUniform("uNumLights", static_cast<int>(gLightBuffer.getNumLights()));
+		shader.setUniform("uViewpoint", viewpoint);
+		return shader;
+	}
+
+	ShaderProgram& shader = gShaders["PhongShading"];
+	shader.use();
+	shader.setUniform("uLight.pos", light.pos);
+	shader.setUniform("uLight.La", light.La);
+	shader.setUniform("uLight.Ld", light.Ld);
+	shader.setUniform("uLight.Ls", light.Ls);
+	shader.setUniform("uViewpoint", viewpoint);
+	return shader;
+}
+
+// measure shading with and without a depth pre-pass for scenes of increasing overdraw
+static void benchmark_prepass()
+{
+	const int numFrames = 20;		// frames per measurement
+	const glm::vec3 viewpoint(0.0f, 0.0f, 3.0f);
+	const Light& light = gScene.getLights().get(gLight);
+	ShaderProgram& depthShader = gShaders["DepthOnly"];
+
+	// a costly shader: 100 lights in the light buffer
+	std::vector<Light> lights = random_local_lights(100);
+	if (gMultiLightSupported)
+		gLightBuffer.update(lights.data(), lights.size());
+
+	// the whole window
+	GLStateCache::viewport(0, 0, gWindowWidth, gWindowHeight);
+	glFinish();
+
+	std::cout << "Depth pre-pass benchmark (" << gWindowWidth << "x" << gWindowHeight << ")" << std::endl;
+
+	const int numLayers[] = { 1, 2, 4, 8 };
+	for (int layers : numLayers)
+	{
+		// layers of spheres covering the view one behind another, nearest layer first
+		gRenderList.clear();
+		gModelMatrices.clear();
+		for (int layer = 0; layer < layers; layer++)
+		{
+			for (int y = -2; y <= 2; y++)
+			{
+				for (int x = -3; x <= 3; x++)
+				{
+					gRenderList.push_back({ &gModel, 0, gModel.getNumIndices(), 0 });
+					gModelMatrices.push_back(glm::translate(glm::vec3(x * 0.5f, y * 0.5f, -0.4f * layer)) * glm::scale(glm::vec3(0.3f)));
+				}
+			}
+		}
+
+		// front to back (early depth rejection helps without a pre-pass), then back to front (every layer is shaded)
+		const char* orderNames[] = { "front to back", "back to front" };
+		for (int order = 0; order < 2; order++)
+		{
+			if (order == 1)
+			{
+				std::reverse(gRenderList.begin(), gRenderList.end());
+				std::reverse(gModelMatrices.begin(), gModelMatrices.end());
+			}
+			gMVPMatrices.resize(gModelMatrices.size());
+			gNormalMatrices.resize(gModelMatrices.size());
+			multiplyMatrices(gProjectionMatrix * gViewMatrix, gModelMatrices.data(), gMVPMatrices.data(), gModelMatrices.size());
+			computeNormalMatrices(gModelMatrices.data(), gNormalMatrices.data(), gModelMatrices.size());
+
+			for (int multiLight = 0; multiLight < 2; multiLight++)
+			{
+				if (multiLight && !gMultiLightSupported)
+					continue;
+
+				// without, then with the pre-pass
+				double times[2];
+				for (int prepass = 0; prepass < 2; prepass++)
+				{
+					double startTime = glfwGetTime();
+					for (int frame = 0; frame < numFrames; frame++)
+					{
+						glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+						if (prepass)
+						{
+							// depth only, then shade the fragments that are left in the depth buffer
+							glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+							depthShader.use();
+							draw_render_list_depth(depthShader);
+							glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+							GLStateCache::depthFunc(GL_EQUAL);
+							GLStateCache::depthMask(GL_FALSE);
+						}
+
+						draw_render_list(use_phong_shading(multiLight == 1, light, viewpoint));
+
+						GLStateCache::depthFunc(GL_LESS);
+						GLStateCache::depthMask(GL_TRUE);
+					}
+					glFinish();
+					times[prepass] = (glfwGetTime() - startTime) / numFrames;
+				}
+
+				std::cout << "  " << layers << " layers, " << orderNames[order] << ", " << (multiLight ? "100 lights" : "1 light ")
+					<< ": " << times[0] * 1000.0 << " ms without pre-pass, " << times[1] * 1000.0 << " ms with ("
+					<< (times[1] < times[0] ? "pays off, " : "does not pay off, ") << times[0] / times[1] << "x)" << std::endl;
+			}
+		}
+	}
+
+	// restore the scene's lights (the render list is packed again next frame)
+	if (gMultiLightSupported)
+		gLightBuffer.update(gScene.getLights().data(), gScene.getLights().size());
+}
+
+// measure sorting time of many random draw keys
+static void benchmark_sort()
+{
+	const size_t numPackets = 100000;
+	const int numFrames = 20;		// sorts per measurement
+
+	// random state and depth
+	std::vector<DrawPacket> packets(numPackets);
+	for (size_t i = 0; i < numPackets; i++)
+	{
+		RenderPass pass = (rand() % 8 == 0) ? RenderPass::TRANSPARENT_PASS : RenderPass::OPAQUE_PASS;
+		packets[i].key = RenderQueue::makeKey(pass, rand() % 3, rand() % 16, rand() % 256, rand() % 1024, (rand() % 10000) / 10000.0f);
+		packets[i].item = static_cast<uint32_t>(i);
+	}
+
+	// radix sort
+	RenderQueue queue;
+	double startTime = glfwGetTime();
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		queue.clear();
+		for (const DrawPacket& packet : packets)
+			queue.submit(packet.key, packet.item);
+		queue.sort();
+	}
+	double radixTime = (glfwGetTime() - startTime) / numFrames;
+
+	// comparison sort
+	std::vector<DrawPacket> sorted;
+	startTime = glfwGetTime();
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		sorted = packets;
+		std::stable_sort(sorted.begin(), sorted.end(),
+			[](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+	}
+	double stdTime = (glfwGetTime() - startTime) / numFrames;
+
+	std::cout << "Sort benchmark (" << numPackets << " packets): radix " << radixTime * 1000.0 << " ms, std::stable_sort "
+		<< stdTime * 1000.0 << " ms (" << stdTime / radixTime << "x)" << std::endl;
 }
 
 // key press or release callback function
@@ -172,6 +1120,62 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 		glfwSetWindowShouldClose(window, GL_TRUE);
 		return;
 	}
+
+	// run the matrix benchmark when the B key is pressed
+	if (key == GLFW_KEY_B && action == GLFW_PRESS)
+	{
+		benchmark_matrices();
+		return;
+	}
+
+	// run the culling benchmark when the V key is pressed
+	if (key == GLFW_KEY_V && action == GLFW_PRESS)
+	{
+		benchmark_culling();
+		return;
+	}
+
+	// run the sort benchmark when the Q key is pressed
+	if (key == GLFW_KEY_Q && action == GLFW_PRESS)
+	{
+		benchmark_sort();
+		return;
+	}
+
+	// run the indirect draw benchmark when the I key is pressed
+	if (key == GLFW_KEY_I && action == GLFW_PRESS)
+	{
+		benchmark_indirect();
+		return;
+	}
+
+	// run the light benchmark when the L key is pressed
+	if (key == GLFW_KEY_L && action == GLFW_PRESS)
+	{
+		benchmark_lights();
+		return;
+	}
+
+	// run the cluster benchmark when the C key is pressed
+	if (key == GLFW_KEY_C && action == GLFW_PRESS)
+	{
+		benchmark_clusters();
+		return;
+	}
+
+	// run the deferred shading benchmark when the D key is pressed
+	if (key == GLFW_KEY_D && action == GLFW_PRESS)
+	{
+		benchmark_deferred();
+		return;
+	}
+
+	// run the depth pre-pass benchmark when the P key is pressed
+	if (key == GLFW_KEY_P && action == GLFW_PRESS)
+	{
+		benchmark_prepass();
+		return;
+	}
 }
 
 // mouse movement callback function
@@ -205,20 +1209,50 @@ TwBar* create_UI(const std::string name)
 	TwDefine(" TW_HELP visible=false ");	// disable help menu
 	TwDefine(" GLOBAL fontsize=3 ");		// set large font size
 
-	TwDefine(" Main label='User Interface' refresh=0.02 text=light size='250 220' ");
+	TwDefine(" Main label='User Interface' refresh=0.02 text=light size='250 580' ");
 
 	// create frame stat entries
 	TwAddVarRO(twBar, "Frame Rate", TW_TYPE_FLOAT, &gFrameRate, " group='Frame Stats' precision=2 ");
 	TwAddVarRO(twBar, "Frame Time", TW_TYPE_FLOAT, &gFrameTime, " group='Frame Stats' ");
 
+	// culling stats
+	TwAddVarRO(twBar, "Visible", TW_TYPE_UINT32, &gNumVisible, " group='Culling' ");
+	TwAddVarRO(twBar, "Culled", TW_TYPE_UINT32, &gNumCulled, " group='Culling' ");
+	if (gGPUSupported)
+	{
+		TwAddVarRW(twBar, "GPU culling", TW_TYPE_BOOLCPP, &gGPUCulling, " group='Culling' ");
+		TwAddVarRO(twBar, "GPU visible", TW_TYPE_UINT32, &gNumGPUVisible, " group='Culling' ");
+	}
+
+	// render queue stats
+	TwAddVarRO(twBar, "Packets", TW_TYPE_UINT32, &gNumPackets, " group='Render Queue' ");
+	TwAddVarRO(twBar, "Program changes", TW_TYPE_UINT32, &gNumProgramChanges, " group='Render Queue' ");
+	TwAddVarRO(twBar, "Material changes", TW_TYPE_UINT32, &gNumMaterialChanges, " group='Render Queue' ");
+	TwAddVarRO(twBar, "GL calls issued", TW_TYPE_UINT32, &gNumGLCallsIssued, " group='Render Queue' ");
+	TwAddVarRO(twBar, "GL calls elided", TW_TYPE_UINT32, &gNumGLCallsElided, " group='Render Queue' ");
+	TwAddVarRW(twBar, "Depth pre-pass", TW_TYPE_BOOLCPP, &gDepthPrepass, " group='Render Queue' ");
+
+	// deferred shading
+	TwAddVarRW(twBar, "Deferred", TW_TYPE_BOOLCPP, &gDeferred, " group='Deferred Shading' ");
+	TwAddVarRW(twBar, "Stencil culling", TW_TYPE_BOOLCPP, &gStencilCulling, " group='Deferred Shading' ");
+	TwAddVarRO(twBar, "Light volumes", TW_TYPE_UINT32, &gNumLightVolumes, " group='Deferred Shading' ");
+
 	// scene controls
 	TwAddVarRW(twBar, "Wireframe", TW_TYPE_BOOLCPP, &gWireframe, " group='Controls' ");
 	TwAddVarRW(twBar, "RotationY", TW_TYPE_FLOAT, &gRotationAngle, " group='Controls' min=-360 max=360 step=1 ");
 
-	// light controls
-	TwAddVarRW(twBar, "Pos: x", TW_TYPE_FLOAT, &gLight.pos.x, " group='Light' min=-5.0 max=5.0 step=0.1 ");
-	TwAddVarRW(twBar, "Pos: y", TW_TYPE_FLOAT, &gLight.pos.y, " group='Light' min=-5.0 max=5.0 step=0.1 ");
-	TwAddVarRW(twBar, "Pos: z", TW_TYPE_FLOAT, &gLight.pos.z, " group='Light' min=-5.0 max=5.0 step=0.1 ");
+	// light controls (the light component stays in place as no lights are added after init)
+	Light& light = gScene.getLights().get(gLight);
+	TwAddVarRW(twBar, "Pos: x", TW_TYPE_FLOAT, &light.pos.x, " group='Light' min=-5.0 max=5.0 step=0.1 ");
+	TwAddVarRW(twBar, "Pos: y", TW_TYPE_FLOAT, &light.pos.y, " group='Light' min=-5.0 max=5.0 step=0.1 ");
+	TwAddVarRW(twBar, "Pos: z", TW_TYPE_FLOAT, &light.pos.z, " group='Light' min=-5.0 max=5.0 step=0.1 ");
+	if (gMultiLightSupported)
+	{
+		TwAddVarRW(twBar, "Multiple lights", TW_TYPE_BOOLCPP, &gMultiLight, " group='Light' ");
+		TwAddVarRO(twBar, "Lights", TW_TYPE_UINT32, &gNumLights, " group='Light' ");
+		TwAddVarRW(twBar, "Clustered", TW_TYPE_BOOLCPP, &gClustered, " group='Light' ");
+		TwAddVarRO(twBar, "Light references", TW_TYPE_UINT32, &gNumLightReferences, " group='Light' ");
+	}
 
 	return twBar;
 }
@@ -285,16 +1319,20 @@ int main(void)
 	{
 		update_scene(window);	// update the scene
 
-		// if wireframe set polygon render mode to wireframe
-		if (gWireframe)
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		// set polygon render mode to wireframe or fill
+		GLStateCache::polygonMode(gWireframe ? GL_LINE : GL_FILL);
 
 		render_scene();			// render the scene
 
-		// set polygon render mode to fill
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		// state cache stats of the frame
+		gNumGLCallsIssued = GLStateCache::getNumIssued();
+		gNumGLCallsElided = GLStateCache::getNumElided();
+		GLStateCache::resetCounters();
 
+		// tweak bar drawing must be in fill mode and changes state behind the cache
+		GLStateCache::polygonMode(GL_FILL);
 		TwDraw();				// draw tweak bar
+		GLStateCache::invalidate();
 
 		glfwSwapBuffers(window);	// swap buffers
 		glfwPollEvents();			// poll for events
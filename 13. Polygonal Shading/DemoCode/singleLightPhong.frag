@@ -0,0 +1,81 @@
+#version 330 core
+
+// interpolated values from the vertex shaders
+in vec3 vPosition;
+in vec3 vNormal;
+
+// light properties (the lighting model of multiLightPhong.frag for one light)
+struct Light
+{
+	int type;		// 1=point; 2=directional; 3=spotlight
+	vec3 pos;
+	vec3 dir;
+	vec3 La;
+	vec3 Ld;
+	vec3 Ls;
+	vec3 att;
+	float cosInnerAngle;
+	float cosOuterAngle;
+};
+
+// material properties
+struct Material
+{
+	vec3 Ka;
+	vec3 Kd;
+	vec3 Ks;
+	float shininess;
+};
+
+// uniform input data
+uniform vec3 uViewpoint;
+uniform Light uLight;
+uniform Material uMaterial;
+
+// output data
+out vec3 fColor;
+
+void main()
+{
+	// fragment normal
+	vec3 n = normalize(vNormal);
+
+	// vector toward the viewer
+	vec3 v = normalize(uViewpoint - vPosition);
+
+	// vector towards the light and attenuation
+	vec3 l;
+	float attenuation = 1.0f;
+
+	if(uLight.type == 2)
+	{
+		l = -uLight.dir;
+	}
+	else
+	{
+		l = uLight.pos - vPosition;
+		float d = length(l);
+		l /= d;
+		attenuation = 1.0f / (uLight.att.x + uLight.att.y * d + uLight.att.z * d * d);
+
+		// spotlight cone with a smooth edge
+		if(uLight.type == 3)
+			attenuation *= smoothstep(uLight.cosOuterAngle, uLight.cosInnerAngle, dot(-l, uLight.dir));
+	}
+
+	// calculate ambient, diffuse and specular intensities
+	vec3 Ia = uLight.La * uMaterial.Ka;
+	vec3 Id = vec3(0.0f);
+	vec3 Is = vec3(0.0f);
+	float dotLN = max(dot(l, n), 0.0f);
+
+	if(dotLN > 0.0f)
+	{
+		vec3 r = reflect(-l, n);
+		Id = uLight.Ld * uMaterial.Kd * dotLN;
+		Is = uLight.Ls * uMaterial.Ks * pow(max(dot(v, r), 0.0f), uMaterial.shininess);
+	}
+
+	// set output color
+	fColor = Ia + attenuation * (Id + Is);
+}
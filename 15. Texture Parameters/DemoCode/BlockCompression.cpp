@@ -0,0 +1,469 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+// colour with float channels for fitting endpoints
+struct Colour
+{
+	float r, g, b;
+};
+
+// RGB565 packing and expansion to 8 bits per channel
+static uint16_t pack_565(const Colour& colour)
+{
+	int r = static_cast<int>(std::lround(std::min(std::max(colour.r, 0.0f), 255.0f) * 31.0f / 255.0f));
+	int g = static_cast<int>(std::lround(std::min(std::max(colour.g, 0.0f), 255.0f) * 63.0f / 255.0f));
+	int b = static_cast<int>(std::lround(std::min(std::max(colour.b, 0.0f), 255.0f) * 31.0f / 255.0f));
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpack_565(uint16_t value, int* rgb)
+{
+	int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// four colour palette of two endpoints
+static void make_palette(uint16_t colour0, uint16_t colour1, int palette[4][3])
+{
+	unpack_565(colour0, palette[0]);
+	unpack_565(colour1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+}
+
+// nearest palette entry of each texel; returns the squared error
+static int assign_indices(const uint8_t* texels, uint16_t colour0, uint16_t colour1, uint8_t* indices)
+{
+	int palette[4][3];
+	make_palette(colour0, colour1, palette);
+
+	int error = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0, bestDistance = 0x7FFFFFFF;
+		for (int p = 0; p < 4; p++)
+		{
+			int dr = texels[i * 4] - palette[p][0];
+			int dg = texels[i * 4 + 1] - palette[p][1];
+			int db = texels[i * 4 + 2] - palette[p][2];
+			int distance = dr * dr + dg * dg + db * db;
+			if (distance < bestDistance)
+			{
+				best = p;
+				bestDistance = distance;
+			}
+		}
+		indices[i] = static_cast<uint8_t>(best);
+		error += bestDistance;
+	}
+	return error;
+}
+
+// endpoints that minimise the squared error of the texels for their indices
+static bool fit_endpoints(const uint8_t* texels, const uint8_t* indices, Colour& end0, Colour& end1)
+{
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };	// weight of endpoint 0
+
+	// normal equations of sum |w * e0 + (1 - w) * e1 - c|^2
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	Colour ac = { 0.0f, 0.0f, 0.0f }, bc = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		float a = weights[indices[i]], b = 1.0f - a;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		ac.r += a * texels[i * 4];
+		ac.g += a * texels[i * 4 + 1];
+		ac.b += a * texels[i * 4 + 2];
+		bc.r += b * texels[i * 4];
+		bc.g += b * texels[i * 4 + 1];
+		bc.b += b * texels[i * 4 + 2];
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (std::fabs(determinant) < 1e-6f)
+		return false;
+
+	float inverse = 1.0f / determinant;
+	end0 = { (ac.r * bb - bc.r * ab) * inverse, (ac.g * bb - bc.g * ab) * inverse, (ac.b * bb - bc.b * ab) * inverse };
+	end1 = { (bc.r * aa - ac.r * ab) * inverse, (bc.g * aa - ac.g * ab) * inverse, (bc.b * aa - ac.b * ab) * inverse };
+	return true;
+}
+
+// colour block shared by BC1 and BC3 (always four colour mode)
+static void encode_colour_block(const uint8_t* texels, uint8_t* block)
+{
+	// mean and covariance of the colours
+	Colour mean = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		mean.r += texels[i * 4];
+		mean.g += texels[i * 4 + 1];
+		mean.b += texels[i * 4 + 2];
+	}
+	mean = { mean.r / 16.0f, mean.g / 16.0f, mean.b / 16.0f };
+
+	float covariance[6] = {};	// rr, rg, rb, gg, gb, bb
+	for (int i = 0; i < 16; i++)
+	{
+		float r = texels[i * 4] - mean.r, g = texels[i * 4 + 1] - mean.g, b = texels[i * 4 + 2] - mean.b;
+		covariance[0] += r * r;
+		covariance[1] += r * g;
+		covariance[2] += r * b;
+		covariance[3] += g * g;
+		covariance[4] += g * b;
+		covariance[5] += b * b;
+	}
+
+	// principal axis by power iteration
+	Colour axis = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		Colour next = {
+			covariance[0] * axis.r + covariance[1] * axis.g + covariance[2] * axis.b,
+			covariance[1] * axis.r + covariance[3] * axis.g + covariance[4] * axis.b,
+			covariance[2] * axis.r + covariance[4] * axis.g + covariance[5] * axis.b };
+		float length = std::max(std::fabs(next.r), std::max(std::fabs(next.g), std::fabs(next.b)));
+		if (length < 1e-6f)
+			break;
+		axis = { next.r / length, next.g / length, next.b / length };
+	}
+	float axisLength = std::sqrt(axis.r * axis.r + axis.g * axis.g + axis.b * axis.b);
+	axis = { axis.r / axisLength, axis.g / axisLength, axis.b / axisLength };
+
+	// extent of the colours along the axis
+	float minT = 0.0f, maxT = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = (texels[i * 4] - mean.r) * axis.r + (texels[i * 4 + 1] - mean.g) * axis.g + (texels[i * 4 + 2] - mean.b) * axis.b;
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+
+	Colour end0 = { mean.r + axis.r * maxT, mean.g + axis.g * maxT, mean.b + axis.b * maxT };
+	Colour end1 = { mean.r + axis.r * minT, mean.g + axis.g * minT, mean.b + axis.b * minT };
+	uint16_t colour0 = pack_565(end0), colour1 = pack_565(end1);
+	uint8_t indices[16];
+	int error = assign_indices(texels, colour0, colour1, indices);
+
+	// refine the endpoints for the chosen indices, keeping them if better
+	if (error > 0 && fit_endpoints(texels, indices, end0, end1))
+	{
+		uint16_t refined0 = pack_565(end0), refined1 = pack_565(end1);
+		uint8_t refinedIndices[16];
+		int refinedError = assign_indices(texels, refined0, refined1, refinedIndices);
+		if (refinedError < error)
+		{
+			colour0 = refined0;
+			colour1 = refined1;
+			std::memcpy(indices, refinedIndices, 16);
+		}
+	}
+
+	// colour0 > colour1 selects four colour mode in BC1 (swapping reorders the palette)
+	if (colour0 < colour1)
+	{
+		std::swap(colour0, colour1);
+		for (uint8_t& index : indices)
+			index ^= 1;
+	}
+	else if (colour0 == colour1)
+	{
+		std::fill(indices, indices + 16, 0);
+	}
+
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= static_cast<uint32_t>(indices[i]) << (i * 2);
+
+	block[0] = colour0 & 0xFF;
+	block[1] = colour0 >> 8;
+	block[2] = colour1 & 0xFF;
+	block[3] = colour1 >> 8;
+	for (int i = 0; i < 4; i++)
+		block[4 + i] = (bits >> (i * 8)) & 0xFF;
+}
+
+static void decode_colour_block(const uint8_t* block, uint8_t* texels, bool allowThreeColour)
+{
+	uint16_t colour0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+	uint16_t colour1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+	uint32_t bits = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+
+	int palette[4][4];
+	unpack_565(colour0, palette[0]);
+	unpack_565(colour1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+
+	if (colour0 > colour1 || !allowThreeColour)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+	}
+	else
+	{
+		// three colours and transparent black
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+		palette[3][3] = 0;
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		const int* colour = palette[(bits >> (i * 2)) & 3];
+		for (int c = 0; c < 4; c++)
+			texels[i * 4 + c] = static_cast<uint8_t>(colour[c]);
+	}
+}
+
+// bytes per 4x4 block
+size_t BlockCompression::getBlockSize(BlockFormat format)
+{
+	return (format == BlockFormat::BC1) ? 8 : 16;
+}
+
+// bytes of an image in the format (partial blocks are padded)
+size_t BlockCompression::getImageSize(BlockFormat format, int width, int height)
+{
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+}
+
+// compress an image on a number of threads (0 = one per hardware thread)
+std::vector<uint8_t> BlockCompression::compress(const ImageRGBA& image, BlockFormat format, unsigned numThreads)
+{
+	const int blocksX = (image.width + 3) / 4;
+	const int blocksY = (image.height + 3) / 4;
+	const size_t blockSize = getBlockSize(format);
+	std::vector<uint8_t> data(getImageSize(format, image.width, image.height));
+
+	// rows of blocks are handed out to the threads
+	std::atomic<int> nextRow(0);
+	auto encodeRows = [&]()
+	{
+		uint8_t texels[64];
+		for (int by = nextRow++; by < blocksY; by = nextRow++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				// gather the block (clamping partial blocks to the image)
+				for (int y = 0; y < 4; y++)
+				{
+					int sy = std::min(by * 4 + y, image.height - 1);
+					for (int x = 0; x < 4; x++)
+					{
+						int sx = std::min(bx * 4 + x, image.width - 1);
+						std::memcpy(&texels[(y * 4 + x) * 4], &image.pixels[(static_cast<size_t>(sy) * image.width + sx) * 4], 4);
+					}
+				}
+
+				uint8_t* block = &data[(static_cast<size_t>(by) * blocksX + bx) * blockSize];
+				if (format == BlockFormat::BC1)
+					encodeBC1Block(texels, block);
+				else
+					encodeBC3Block(texels, block);
+			}
+		}
+	};
+
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	numThreads = std::min(numThreads, static_cast<unsigned>(blocksY));
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < numThreads; i++)
+		threads.emplace_back(encodeRows);
+	encodeRows();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	return data;
+}
+
+// decompress an image
+ImageRGBA BlockCompression::decompress(const uint8_t* data, BlockFormat format, int width, int height)
+{
+	ImageRGBA image;
+	image.width = width;
+	image.height = height;
+	image.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+	const int blocksX = (width + 3) / 4;
+	const int blocksY = (height + 3) / 4;
+	const size_t blockSize = getBlockSize(format);
+	uint8_t texels[64];
+
+	for (int by = 0; by < blocksY; by++)
+	{
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			const uint8_t* block = &data[(static_cast<size_t>(by) * blocksX + bx) * blockSize];
+			if (format == BlockFormat::BC1)
+				decodeBC1Block(block, texels);
+			else
+				decodeBC3Block(block, texels);
+
+			// scatter the texels inside the image
+			for (int y = 0; y < 4 && by * 4 + y < height; y++)
+			{
+				for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+				{
+					size_t pixel = static_cast<size_t>(by * 4 + y) * width + bx * 4 + x;
+					std::memcpy(&image.pixels[pixel * 4], &texels[(y * 4 + x) * 4], 4);
+				}
+			}
+		}
+	}
+	return image;
+}
+
+// reverse the first rows of a block's colour indices (one byte per row)
+static void flip_colour_block(uint8_t* block, int rows)
+{
+	std::reverse(block + 4, block + 4 + rows);
+}
+
+// reverse the first rows of a block's alpha indices (12 bits per row)
+static void flip_alpha_block(uint8_t* block, int rows)
+{
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; i++)
+		bits |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+
+	uint64_t flipped = bits;
+	for (int y = 0; y < rows; y++)
+	{
+		uint64_t row = (bits >> (y * 12)) & 0xFFF;
+		flipped &= ~(static_cast<uint64_t>(0xFFF) << ((rows - 1 - y) * 12));
+		flipped |= row << ((rows - 1 - y) * 12);
+	}
+
+	for (int i = 0; i < 6; i++)
+		block[2 + i] = static_cast<uint8_t>(flipped >> (i * 8));
+}
+
+// reverse the row order of a compressed image in place (false if the height is
+// above 4 and not a multiple of 4, as rows would then move between blocks)
+bool BlockCompression::flipVertically(uint8_t* data, BlockFormat format, int width, int height)
+{
+	if (height > 4 && height % 4 != 0)
+		return false;
+
+	const int blocksX = (width + 3) / 4;
+	const int blocksY = (height + 3) / 4;
+	const size_t blockSize = getBlockSize(format);
+	const size_t rowSize = blocksX * blockSize;
+	const int rows = std::min(height, 4);	// rows used in each block
+
+	// swap the rows of blocks
+	for (int by = 0; by < blocksY / 2; by++)
+		std::swap_ranges(data + by * rowSize, data + (by + 1) * rowSize, data + (blocksY - 1 - by) * rowSize);
+
+	// and the rows inside each block
+	for (size_t i = 0; i < static_cast<size_t>(blocksX) * blocksY; i++)
+	{
+		uint8_t* block = data + i * blockSize;
+		if (format == BlockFormat::BC1)
+			flip_colour_block(block, rows);
+		else
+		{
+			flip_alpha_block(block, rows);
+			flip_colour_block(block + 8, rows);
+		}
+	}
+	return true;
+}
+
+// single blocks (texels are 16 RGBA8 values in rows)
+void BlockCompression::encodeBC1Block(const uint8_t* texels, uint8_t* block)
+{
+	encode_colour_block(texels, block);
+}
+
+void BlockCompression::encodeBC3Block(const uint8_t* texels, uint8_t* block)
+{
+	// alpha endpoints: the block's range (alpha0 > alpha1 selects 8 interpolated values)
+	uint8_t minAlpha = 255, maxAlpha = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		minAlpha = std::min(minAlpha, texels[i * 4 + 3]);
+		maxAlpha = std::max(maxAlpha, texels[i * 4 + 3]);
+	}
+
+	uint64_t bits = 0;
+	if (maxAlpha > minAlpha)
+	{
+		int palette[8] = { maxAlpha, minAlpha };
+		for (int p = 1; p < 7; p++)
+			palette[p + 1] = ((7 - p) * maxAlpha + p * minAlpha) / 7;
+
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestDistance = 256;
+			for (int p = 0; p < 8; p++)
+			{
+				int distance = std::abs(texels[i * 4 + 3] - palette[p]);
+				if (distance < bestDistance)
+				{
+					best = p;
+					bestDistance = distance;
+				}
+			}
+			bits |= static_cast<uint64_t>(best) << (i * 3);
+		}
+	}
+
+	block[0] = maxAlpha;
+	block[1] = minAlpha;
+	for (int i = 0; i < 6; i++)
+		block[2 + i] = (bits >> (i * 8)) & 0xFF;
+
+	encode_colour_block(texels, block + 8);
+}
+
+void BlockCompression::decodeBC1Block(const uint8_t* block, uint8_t* texels)
+{
+	decode_colour_block(block, texels, true);
+}
+
+void BlockCompression::decodeBC3Block(const uint8_t* block, uint8_t* texels)
+{
+	decode_colour_block(block + 8, texels, false);
+
+	int alpha0 = block[0], alpha1 = block[1];
+	int palette[8] = { alpha0, alpha1 };
+	if (alpha0 > alpha1)
+	{
+		for (int p = 1; p < 7; p++)
+			palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+	}
+	else
+	{
+		for (int p = 1; p < 5; p++)
+			palette[p + 1] = ((5 - p) * alpha0 + p * alpha1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; i++)
+		bits |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+	for (int i = 0; i < 16; i++)
+		texels[i * 4 + 3] = static_cast<uint8_t>(palette[(bits >> (i * 3)) & 7]);
+}
@@ -0,0 +1,43 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ImageRGBA.h"
+
+// block compressed formats (4x4 texel blocks)
+enum class BlockFormat { BC1, BC3 };
+
+/*****************************************************************
+ * BC1 (DXT1) and BC3 (DXT5) block compression
+ * colour endpoints are fitted along the principal axis of each
+ * block's colours and refined once by least squares; BC3 alpha
+ * uses the block's alpha range with 8 interpolated values
+ * the decoders are used where the driver can't sample the formats
+ *****************************************************************/
+class BlockCompression
+{
+public:
+	// bytes per 4x4 block
+	static size_t getBlockSize(BlockFormat format);
+	// bytes of an image in the format (partial blocks are padded)
+	static size_t getImageSize(BlockFormat format, int width, int height);
+
+	// compress an image on a number of threads (0 = one per hardware thread)
+	static std::vector<uint8_t> compress(const ImageRGBA& image, BlockFormat format, unsigned numThreads = 0);
+	// decompress an image
+	static ImageRGBA decompress(const uint8_t* data, BlockFormat format, int width, int height);
+	// reverse the row order of a compressed image in place (false if the height is
+	// above 4 and not a multiple of 4, as rows would then move between blocks)
+	static bool flipVertically(uint8_t* data, BlockFormat format, int width, int height);
+
+	// single blocks (texels are 16 RGBA8 values in rows)
+	static void encodeBC1Block(const uint8_t* texels, uint8_t* block);
+	static void encodeBC3Block(const uint8_t* texels, uint8_t* block);
+	static void decodeBC1Block(const uint8_t* block, uint8_t* texels);
+	static void decodeBC3Block(const uint8_t* block, uint8_t* texels);
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef GL_RESOURCES_H
+#define GL_RESOURCES_H
+
+#include <GLEW/glew.h>
+
+// whether resources are edited with direct state access (OpenGL 4.5, or ARB_direct_state_access with
+// ARB_buffer_storage and ARB_texture_storage)
+bool hasDirectStateAccess();
+
+/*****************************************************************
+ * owning wrappers of OpenGL buffers, textures and vertex arrays
+ * with direct state access, creating and editing an object does
+ * not touch any binding; without it (e.g. the 3.3 context on
+ * macOS) objects are bound through the state cache to be edited
+ * wrappers delete their object when destroyed and can be moved
+ * but not copied
+ *****************************************************************/
+class GLBuffer
+{
+public:
+	GLBuffer();
+	~GLBuffer();
+	GLBuffer(GLBuffer&& other);
+	GLBuffer& operator=(GLBuffer&& other);
+	GLBuffer(const GLBuffer&) = delete;
+	GLBuffer& operator=(const GLBuffer&) = delete;
+
+	// create storage (replacing any previous buffer); only GL_DYNAMIC_STORAGE_BIT buffers can be updated
+	void create(GLsizeiptr size, const void* data, GLbitfield flags = 0);
+	// copy data into part of the buffer
+	void update(GLintptr offset, GLsizeiptr size, const void* data);
+	// map part of the buffer into client memory (the storage needs the matching GL_MAP_* flags)
+	void* map(GLintptr offset, GLsizeiptr length, GLbitfield access);
+	// end a mapping; false if the contents were lost while mapped
+	bool unmap();
+	void release();
+
+	GLuint getID() const { return mID; }
+	GLsizeiptr getSize() const { return mSize; }
+
+private:
+	GLuint mID = 0;
+	GLsizeiptr mSize = 0;
+};
+
+class GLTexture
+{
+public:
+	GLTexture();
+	~GLTexture();
+	GLTexture(GLTexture&& other);
+	GLTexture& operator=(GLTexture&& other);
+	GLTexture(const GLTexture&) = delete;
+	GLTexture& operator=(const GLTexture&) = delete;
+
+	// create a 2D texture with storage for a number of mipmap levels (replacing any previous texture)
+	void create2D(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei levels);
+	// create a 2D array texture of a number of layers (replacing any previous texture)
+	void create2DArray(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei layers, GLsizei levels);
+	// copy pixels into a whole mipmap level
+	void setImage(GLint level, GLenum format, GLenum type, const void* pixels);
+	// copy pixels into a region of a mipmap level (of a layer of array textures)
+	void setSubImage(GLint level, GLint x, GLint y, GLint layer, GLsizei width, GLsizei height,
+		GLenum format, GLenum type, const void* pixels);
+	// copy block compressed data (in the texture's internal format) into a whole mipmap level
+	void setCompressedImage(GLint level, GLsizei imageSize, const void* data);
+	// compute levels 1 and up from level 0
+	void generateMipmap();
+	// set texture parameters
+	void setParameter(GLenum name, GLint value);
+	void setParameter(GLenum name, const GLfloat* values);
+	// bind to a texture unit (0, 1, 2, ...)
+	void bind(GLuint unit) const;
+	void release();
+
+	GLuint getID() const { return mID; }
+	GLenum getTarget() const { return mTarget; }
+	GLenum getInternalFormat() const { return mInternalFormat; }
+	GLsizei getWidth() const { return mWidth; }
+	GLsizei getHeight() const { return mHeight; }
+	GLsizei getNumLevels() const { return mNumLevels; }
+	GLsizei getNumLayers() const { return mNumLayers; }
+
+	// number of levels of a full mipmap chain
+	static GLsizei getMaxLevels(GLsizei width, GLsizei height);
+
+private:
+	GLuint mID = 0;
+	GLenum mTarget = GL_TEXTURE_2D;
+	GLenum mInternalFormat = GL_RGBA8;
+	GLsizei mWidth = 0;
+	GLsizei mHeight = 0;
+	GLsizei mNumLevels = 0;
+	GLsizei mNumLayers = 1;
+
+	void bindForEdit() const;
+};
+
+class GLVertexArray
+{
+public:
+	GLVertexArray();
+	~GLVertexArray();
+	GLVertexArray(GLVertexArray&& other);
+	GLVertexArray& operator=(GLVertexArray&& other);
+	GLVertexArray(const GLVertexArray&) = delete;
+	GLVertexArray& operator=(const GLVertexArray&) = delete;
+
+	// create an empty vertex array (replacing any previous one)
+	void create();
+	// attach a vertex buffer to a binding point (set before the attributes reading from it)
+	void setVertexBuffer(GLuint binding, const GLBuffer& buffer, GLintptr offset, GLsizei stride);
+	// attach the index buffer
+	void setIndexBuffer(const GLBuffer& buffer);
+	// enable an attribute read from a binding point (floating point or integer)
+	void setAttribute(GLuint attribute, GLuint binding, GLint size, GLenum type, GLboolean normalized, GLuint relativeOffset);
+	void setIntegerAttribute(GLuint attribute, GLuint binding, GLint size, GLenum type, GLuint relativeOffset);
+	// advance a binding point per instance instead of per vertex
+	void setBindingDivisor(GLuint binding, GLuint divisor);
+	// make active
+	void bind() const;
+	void release();
+
+	GLuint getID() const { return mID; }
+
+private:
+	static const int sMaxBindings = 16;
+
+	// binding points and the attributes reading from them (kept for the bind-based path)
+	struct Binding
+	{
+		GLuint buffer = 0;
+		GLintptr offset = 0;
+		GLsizei stride = 0;
+		GLuint divisor = 0;
+	};
+
+	struct Attribute
+	{
+		GLint binding = -1;		// -1 if disabled
+		GLint size = 0;
+		GLenum type = GL_FLOAT;
+		GLboolean normalized = GL_FALSE;
+		bool integer = false;
+		GLuint relativeOffset = 0;
+	};
+
+	GLuint mID = 0;
+	Binding mBindings[sMaxBindings];
+	Attribute mAttributes[sMaxBindings];
+
+	// specify an attribute's pointer from its binding point (bind-based path)
+	void applyAttribute(GLuint attribute);
+};
+
+#endif
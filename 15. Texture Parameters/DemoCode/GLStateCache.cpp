@@ -0,0 +1,332 @@
+#include "GLStateCache.h"
+
+// value of state that has not been set through the cache
+const GLuint gUnknown = 0xFFFFFFFF;
+
+// bindings start at their initial OpenGL values (0), other state starts unknown
+GLuint GLStateCache::sProgram = 0;
+GLuint GLStateCache::sVertexArray = 0;
+GLuint GLStateCache::sBuffers[sNumBufferTargets] = {};
+GLuint GLStateCache::sActiveTextureUnit = 0;
+GLuint GLStateCache::sTextures[sMaxTextureUnits][sNumTextureTargets] = {};
+GLuint GLStateCache::sSamplers[sMaxTextureUnits] = {};
+GLuint GLStateCache::sDrawFramebuffer = 0;
+GLuint GLStateCache::sReadFramebuffer = 0;
+GLint GLStateCache::sViewport[4] = { -1, -1, -1, -1 };
+int8_t GLStateCache::sCapabilities[sNumCapabilities] = { -1, -1, -1, -1, -1, -1 };
+GLenum GLStateCache::sPolygonMode = gUnknown;
+GLenum GLStateCache::sDepthFunc = gUnknown;
+int8_t GLStateCache::sDepthMask = -1;
+GLenum GLStateCache::sBlendFunc[2] = { gUnknown, gUnknown };
+
+uint32_t GLStateCache::sNumIssued = 0;
+uint32_t GLStateCache::sNumElided = 0;
+
+// cached buffer binding points (-1 if not cached)
+int GLStateCache::getBufferIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER: return 0;
+	case GL_UNIFORM_BUFFER: return 1;
+	case GL_SHADER_STORAGE_BUFFER: return 2;
+	case GL_DRAW_INDIRECT_BUFFER: return 3;
+	case GL_PIXEL_PACK_BUFFER: return 4;
+	case GL_PIXEL_UNPACK_BUFFER: return 5;
+	case GL_COPY_READ_BUFFER: return 6;
+	case GL_COPY_WRITE_BUFFER: return 7;
+	default: return -1;
+	}
+}
+
+// cached texture targets (-1 if not cached)
+int GLStateCache::getTextureIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_2D_ARRAY: return 1;
+	case GL_TEXTURE_CUBE_MAP: return 2;
+	case GL_TEXTURE_3D: return 3;
+	default: return -1;
+	}
+}
+
+// cached capabilities (-1 if not cached)
+int GLStateCache::getCapabilityIndex(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST: return 0;
+	case GL_BLEND: return 1;
+	case GL_CULL_FACE: return 2;
+	case GL_SCISSOR_TEST: return 3;
+	case GL_STENCIL_TEST: return 4;
+	case GL_POLYGON_OFFSET_FILL: return 5;
+	default: return -1;
+	}
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+	if (change(sProgram != program))
+	{
+		glUseProgram(program);
+		sProgram = program;
+	}
+}
+
+void GLStateCache::bindVertexArray(GLuint vertexArray)
+{
+	if (change(sVertexArray != vertexArray))
+	{
+		glBindVertexArray(vertexArray);
+		sVertexArray = vertexArray;
+	}
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+	int index = getBufferIndex(target);
+
+	if (index < 0)
+	{
+		// e.g. element array buffers, which belong to the bound vertex array
+		change(true);
+		glBindBuffer(target, buffer);
+	}
+	else if (change(sBuffers[index] != buffer))
+	{
+		glBindBuffer(target, buffer);
+		sBuffers[index] = buffer;
+	}
+}
+
+void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	change(true);
+	glBindBufferBase(target, index, buffer);
+
+	int bufferIndex = getBufferIndex(target);
+	if (bufferIndex >= 0)
+		sBuffers[bufferIndex] = buffer;
+}
+
+// select the texture unit
+void GLStateCache::activeTexture(GLuint unit)
+{
+	if (change(sActiveTextureUnit != unit))
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		sActiveTextureUnit = unit;
+	}
+}
+
+// (the unit is also left active, as texture edits apply to the active unit's binding)
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	int index = getTextureIndex(target);
+	activeTexture(unit);
+
+	if (unit >= sMaxTextureUnits || index < 0)
+	{
+		change(true);
+		glBindTexture(target, texture);
+	}
+	else if (change(sTextures[unit][index] != texture))
+	{
+		glBindTexture(target, texture);
+		sTextures[unit][index] = texture;
+	}
+}
+
+void GLStateCache::bindSampler(GLuint unit, GLuint sampler)
+{
+	if (unit >= sMaxTextureUnits)
+	{
+		change(true);
+		glBindSampler(unit, sampler);
+	}
+	else if (change(sSamplers[unit] != sampler))
+	{
+		glBindSampler(unit, sampler);
+		sSamplers[unit] = sampler;
+	}
+}
+
+void GLStateCache::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+
+	if (change((draw && sDrawFramebuffer != framebuffer) || (read && sReadFramebuffer != framebuffer)))
+	{
+		glBindFramebuffer(target, framebuffer);
+		if (draw)
+			sDrawFramebuffer = framebuffer;
+		if (read)
+			sReadFramebuffer = framebuffer;
+	}
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (change(sViewport[0] != x || sViewport[1] != y || sViewport[2] != width || sViewport[3] != height))
+	{
+		glViewport(x, y, width, height);
+		sViewport[0] = x;
+		sViewport[1] = y;
+		sViewport[2] = width;
+		sViewport[3] = height;
+	}
+}
+
+void GLStateCache::enable(GLenum capability)
+{
+	int index = getCapabilityIndex(capability);
+
+	if (index < 0)
+	{
+		change(true);
+		glEnable(capability);
+	}
+	else if (change(sCapabilities[index] != 1))
+	{
+		glEnable(capability);
+		sCapabilities[index] = 1;
+	}
+}
+
+void GLStateCache::disable(GLenum capability)
+{
+	int index = getCapabilityIndex(capability);
+
+	if (index < 0)
+	{
+		change(true);
+		glDisable(capability);
+	}
+	else if (change(sCapabilities[index] != 0))
+	{
+		glDisable(capability);
+		sCapabilities[index] = 0;
+	}
+}
+
+void GLStateCache::polygonMode(GLenum mode)
+{
+	if (change(sPolygonMode != mode))
+	{
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+		sPolygonMode = mode;
+	}
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+	if (change(sDepthFunc != func))
+	{
+		glDepthFunc(func);
+		sDepthFunc = func;
+	}
+}
+
+void GLStateCache::depthMask(GLboolean flag)
+{
+	int8_t value = flag ? 1 : 0;
+
+	if (change(sDepthMask != value))
+	{
+		glDepthMask(flag);
+		sDepthMask = value;
+	}
+}
+
+void GLStateCache::blendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+	if (change(sBlendFunc[0] != sourceFactor || sBlendFunc[1] != destinationFactor))
+	{
+		glBlendFunc(sourceFactor, destinationFactor);
+		sBlendFunc[0] = sourceFactor;
+		sBlendFunc[1] = destinationFactor;
+	}
+}
+
+// a program stays in use after deletion until another one is used, so its binding becomes unknown
+void GLStateCache::onDeleteProgram(GLuint program)
+{
+	if (sProgram == program)
+		sProgram = gUnknown;
+}
+
+// deleting the other objects unbinds them
+void GLStateCache::onDeleteVertexArray(GLuint vertexArray)
+{
+	if (sVertexArray == vertexArray)
+		sVertexArray = 0;
+}
+
+void GLStateCache::onDeleteBuffer(GLuint buffer)
+{
+	for (GLuint& binding : sBuffers)
+	{
+		if (binding == buffer)
+			binding = 0;
+	}
+}
+
+void GLStateCache::onDeleteTexture(GLuint texture)
+{
+	for (int unit = 0; unit < sMaxTextureUnits; unit++)
+	{
+		for (GLuint& binding : sTextures[unit])
+		{
+			if (binding == texture)
+				binding = 0;
+		}
+	}
+}
+
+void GLStateCache::onDeleteSampler(GLuint sampler)
+{
+	for (GLuint& binding : sSamplers)
+	{
+		if (binding == sampler)
+			binding = 0;
+	}
+}
+
+void GLStateCache::onDeleteFramebuffer(GLuint framebuffer)
+{
+	if (sDrawFramebuffer == framebuffer)
+		sDrawFramebuffer = 0;
+	if (sReadFramebuffer == framebuffer)
+		sReadFramebuffer = 0;
+}
+
+// mark all state unknown
+void GLStateCache::invalidate()
+{
+	sProgram = gUnknown;
+	sVertexArray = gUnknown;
+	for (GLuint& binding : sBuffers)
+		binding = gUnknown;
+	sActiveTextureUnit = gUnknown;
+	for (int unit = 0; unit < sMaxTextureUnits; unit++)
+	{
+		for (GLuint& binding : sTextures[unit])
+			binding = gUnknown;
+		sSamplers[unit] = gUnknown;
+	}
+	sDrawFramebuffer = gUnknown;
+	sReadFramebuffer = gUnknown;
+	for (GLint& value : sViewport)
+		value = -1;
+	for (int8_t& value : sCapabilities)
+		value = -1;
+	sPolygonMode = gUnknown;
+	sDepthFunc = gUnknown;
+	sDepthMask = -1;
+	sBlendFunc[0] = gUnknown;
+	sBlendFunc[1] = gUnknown;
+}
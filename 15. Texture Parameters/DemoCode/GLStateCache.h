@@ -0,0 +1,101 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <cstdint>
+
+#include <GLEW/glew.h>
+
+/*****************************************************************
+ * cache of the current OpenGL binding and fixed-function state
+ * state changes go through these functions, which skip calls that
+ * would set a value that is already current and count issued and
+ * elided calls; state is unknown until first set, and must be
+ * invalidated after code that changes it behind the cache's back
+ * (e.g. AntTweakBar's TwDraw)
+ *****************************************************************/
+class GLStateCache
+{
+public:
+	// programs and vertex arrays
+	static void useProgram(GLuint program);
+	static void bindVertexArray(GLuint vertexArray);
+
+	// buffers (element array bindings are vertex array state, so they are always issued)
+	static void bindBuffer(GLenum target, GLuint buffer);
+	// indexed bindings are not cached (but also set the target's generic binding)
+	static void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+	// textures and samplers per texture unit (unit is 0, 1, 2, ... not GL_TEXTURE0 + i);
+	// bindTexture leaves the unit active so that the texture can be edited
+	static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	static void bindSampler(GLuint unit, GLuint sampler);
+
+	// framebuffers and viewport
+	static void bindFramebuffer(GLenum target, GLuint framebuffer);
+	static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// fixed-function state
+	static void enable(GLenum capability);
+	static void disable(GLenum capability);
+	static void polygonMode(GLenum mode);		// front and back faces
+	static void depthFunc(GLenum func);
+	static void depthMask(GLboolean flag);
+	static void blendFunc(GLenum sourceFactor, GLenum destinationFactor);
+
+	// forget cached bindings of deleted objects (names can be reused)
+	static void onDeleteProgram(GLuint program);
+	static void onDeleteVertexArray(GLuint vertexArray);
+	static void onDeleteBuffer(GLuint buffer);
+	static void onDeleteTexture(GLuint texture);
+	static void onDeleteSampler(GLuint sampler);
+	static void onDeleteFramebuffer(GLuint framebuffer);
+
+	// mark all state unknown
+	static void invalidate();
+
+	// calls issued to and elided from OpenGL since the last reset
+	static uint32_t getNumIssued() { return sNumIssued; }
+	static uint32_t getNumElided() { return sNumElided; }
+	static void resetCounters() { sNumIssued = 0; sNumElided = 0; }
+
+private:
+	static const int sMaxTextureUnits = 16;
+	static const int sNumTextureTargets = 4;	// 2D, 2D array, cube map, 3D
+	static const int sNumBufferTargets = 8;		// see getBufferIndex
+	static const int sNumCapabilities = 6;		// see getCapabilityIndex
+
+	static GLuint sProgram;
+	static GLuint sVertexArray;
+	static GLuint sBuffers[sNumBufferTargets];
+	static GLuint sActiveTextureUnit;
+	static GLuint sTextures[sMaxTextureUnits][sNumTextureTargets];
+	static GLuint sSamplers[sMaxTextureUnits];
+	static GLuint sDrawFramebuffer;
+	static GLuint sReadFramebuffer;
+	static GLint sViewport[4];
+	static int8_t sCapabilities[sNumCapabilities];	// 1 = enabled, 0 = disabled, -1 = unknown
+	static GLenum sPolygonMode;
+	static GLenum sDepthFunc;
+	static int8_t sDepthMask;
+	static GLenum sBlendFunc[2];
+
+	static uint32_t sNumIssued;
+	static uint32_t sNumElided;
+
+	static int getBufferIndex(GLenum target);
+	static int getTextureIndex(GLenum target);
+	static int getCapabilityIndex(GLenum capability);
+	static void activeTexture(GLuint unit);
+
+	// count a call; returns whether it has to be issued
+	static bool change(bool changed)
+	{
+		if (changed)
+			sNumIssued++;
+		else
+			sNumElided++;
+		return changed;
+	}
+};
+
+#endif
@@ -0,0 +1,290 @@
+#include "HiZCuller.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// coarsest level size (in texels) read back to the CPU for testing
+const int gMaxReadSize = 128;
+
+HiZCuller::HiZCuller()
+{}
+
+HiZCuller::~HiZCuller()
+{
+	release();
+}
+
+// delete the pyramid and the readback buffers
+void HiZCuller::release()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		if (mFences[i] != 0)
+			glDeleteSync(mFences[i]);
+		mFences[i] = 0;
+	}
+	for (GLuint& pbo : mPBOs)
+	{
+		if (pbo != 0)
+		{
+			glDeleteBuffers(1, &pbo);
+			GLStateCache::onDeleteBuffer(pbo);
+		}
+		pbo = 0;
+	}
+	if (mPyramidTexture != 0)
+	{
+		glDeleteTextures(1, &mPyramidTexture);
+		GLStateCache::onDeleteTexture(mPyramidTexture);
+	}
+	if (mDepthTexture != 0)
+	{
+		glDeleteTextures(1, &mDepthTexture);
+		GLStateCache::onDeleteTexture(mDepthTexture);
+	}
+	if (mFBO != 0)
+	{
+		glDeleteFramebuffers(1, &mFBO);
+		GLStateCache::onDeleteFramebuffer(mFBO);
+	}
+	if (mVAO != 0)
+	{
+		glDeleteVertexArrays(1, &mVAO);
+		GLStateCache::onDeleteVertexArray(mVAO);
+	}
+	mPyramidTexture = 0;
+	mDepthTexture = 0;
+	mFBO = 0;
+	mVAO = 0;
+
+	mHasPyramid = false;
+	mLevels.clear();
+	mFrame = 0;
+}
+
+// compile shaders and create the pyramid for a framebuffer size
+void HiZCuller::init(int width, int height)
+{
+	mWidth = width;
+	mHeight = height;
+	mNumLevels = 1 + static_cast<int>(std::floor(std::log2(static_cast<float>(glm::max(width, height)))));
+
+	// read back the levels no larger than gMaxReadSize
+	mFirstReadLevel = 0;
+	while (mFirstReadLevel < mNumLevels - 1 && glm::max(getLevelWidth(mFirstReadLevel), getLevelHeight(mFirstReadLevel)) > gMaxReadSize)
+		mFirstReadLevel++;
+
+	mCopyShader.compileAndLink("hiZ.vert", "hiZCopy.frag");
+	mReduceShader.compileAndLink("hiZ.vert", "hiZReduce.frag");
+
+	// depth buffer copy
+	glGenTextures(1, &mDepthTexture);
+	GLStateCache::bindTexture(0, GL_TEXTURE_2D, mDepthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	// depth pyramid
+	glGenTextures(1, &mPyramidTexture);
+	GLStateCache::bindTexture(0, GL_TEXTURE_2D, mPyramidTexture);
+	for (int level = 0; level < mNumLevels; level++)
+		glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, getLevelWidth(level), getLevelHeight(level), 0, GL_RED, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenFramebuffers(1, &mFBO);
+	glGenVertexArrays(1, &mVAO);
+
+	// readback buffers
+	size_t readSize = 0;
+	for (int level = mFirstReadLevel; level < mNumLevels; level++)
+		readSize += getLevelWidth(level) * getLevelHeight(level) * sizeof(float);
+
+	glGenBuffers(2, mPBOs);
+	for (GLuint pbo : mPBOs)
+	{
+		GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+		glBufferData(GL_PIXEL_PACK_BUFFER, readSize, nullptr, GL_STREAM_READ);
+	}
+	GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	mLevels.resize(mNumLevels - mFirstReadLevel);
+	for (int level = mFirstReadLevel; level < mNumLevels; level++)
+		mLevels[level - mFirstReadLevel].resize(getLevelWidth(level) * getLevelHeight(level));
+
+	mHasPyramid = false;
+}
+
+// copy a completed readback into the CPU levels
+void HiZCuller::readPyramid(int slot)
+{
+	GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, mPBOs[slot]);
+	const float* data = static_cast<const float*>(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+
+	if (data != nullptr)
+	{
+		for (std::vector<float>& level : mLevels)
+		{
+			std::copy(data, data + level.size(), level.begin());
+			data += level.size();
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+		mViewProjection = mPBOViewProjection[slot];
+		mHasPyramid = true;
+	}
+
+	GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// build the pyramid from the current depth buffer and start reading it back
+void HiZCuller::build(const glm::mat4& viewProjection)
+{
+	int slot = static_cast<int>(mFrame++ % 2);
+
+	// use completed readbacks (the slot about to be reused is the older one)
+	for (int i : { slot, 1 - slot })
+	{
+		if (mFences[i] == 0)
+			continue;
+
+		GLenum status = glClientWaitSync(mFences[i], 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			readPyramid(i);
+			glDeleteSync(mFences[i]);
+			mFences[i] = 0;
+		}
+	}
+
+	// drop a readback that is still in flight after two frames
+	if (mFences[slot] != 0)
+	{
+		glDeleteSync(mFences[slot]);
+		mFences[slot] = 0;
+	}
+
+	// copy the depth buffer of the default framebuffer
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLStateCache::bindTexture(0, GL_TEXTURE_2D, mDepthTexture);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, mWidth, mHeight);
+
+	GLStateCache::disable(GL_DEPTH_TEST);
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	GLStateCache::bindVertexArray(mVAO);
+
+	// level 0
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mPyramidTexture, 0);
+	GLStateCache::viewport(0, 0, mWidth, mHeight);
+	mCopyShader.use();
+	mCopyShader.setUniform("uDepthSampler", 0);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// each level stores the furthest depth of the 2x2 (or 3x3 at odd edges) texels of the previous level
+	GLStateCache::bindTexture(0, GL_TEXTURE_2D, mPyramidTexture);
+	mReduceShader.use();
+	mReduceShader.setUniform("uPyramidSampler", 0);
+	for (int level = 1; level < mNumLevels; level++)
+	{
+		// only the previous levels can be sampled while writing this level
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mPyramidTexture, level);
+		GLStateCache::viewport(0, 0, getLevelWidth(level), getLevelHeight(level));
+		mReduceShader.setUniform("uLevel", level - 1);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mNumLevels - 1);
+
+	// start reading back the coarse levels
+	GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, mPBOs[slot]);
+	size_t offset = 0;
+	for (int level = mFirstReadLevel; level < mNumLevels; level++)
+	{
+		glGetTexImage(GL_TEXTURE_2D, level, GL_RED, GL_FLOAT, reinterpret_cast<void*>(offset));
+		offset += getLevelWidth(level) * getLevelHeight(level) * sizeof(float);
+	}
+	GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	mFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mPBOViewProjection[slot] = viewProjection;
+
+	// back to drawing the scene
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLStateCache::viewport(0, 0, mWidth, mHeight);
+	GLStateCache::enable(GL_DEPTH_TEST);
+}
+
+// whether a box is hidden behind the depth of the last read back pyramid
+bool HiZCuller::isOccluded(const BoundingBox& box) const
+{
+	if (!mHasPyramid)
+		return false;
+
+	// screen rectangle and nearest depth of the box in the pyramid's frame
+	glm::vec3 screenMin(FLT_MAX), screenMax(-FLT_MAX);
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec4 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z, 1.0f);
+		glm::vec4 clip = mViewProjection * corner;
+
+		// box crosses the near plane
+		if (clip.w <= 0.0f)
+			return false;
+
+		glm::vec3 window = glm::vec3(clip) / clip.w * 0.5f + 0.5f;
+		screenMin = glm::min(screenMin, window);
+		screenMax = glm::max(screenMax, window);
+	}
+
+	// outside the screen (left to the frustum culler)
+	if (screenMax.x < 0.0f || screenMax.y < 0.0f || screenMin.x > 1.0f || screenMin.y > 1.0f)
+		return false;
+
+	// covered pixels
+	int x0 = glm::clamp(static_cast<int>(screenMin.x * mWidth), 0, mWidth - 1);
+	int x1 = glm::clamp(static_cast<int>(screenMax.x * mWidth), 0, mWidth - 1);
+	int y0 = glm::clamp(static_cast<int>(screenMin.y * mHeight), 0, mHeight - 1);
+	int y1 = glm::clamp(static_cast<int>(screenMax.y * mHeight), 0, mHeight - 1);
+
+	// level where the rectangle covers at most 2x2 texels
+	int size = glm::max(x1 - x0, y1 - y0) + 1;
+	int level = 0;
+	while ((1 << level) < size)
+		level++;
+	level = glm::clamp(level, mFirstReadLevel, mNumLevels - 1);
+
+	// texels of that level (pixel >> level, with odd edges folded into the last texel)
+	int levelWidth = getLevelWidth(level), levelHeight = getLevelHeight(level);
+	const std::vector<float>& depths = mLevels[level - mFirstReadLevel];
+
+	float furthest = 0.0f;
+	for (int y = glm::min(y0 >> level, levelHeight - 1); y <= glm::min(y1 >> level, levelHeight - 1); y++)
+	{
+		for (int x = glm::min(x0 >> level, levelWidth - 1); x <= glm::min(x1 >> level, levelWidth - 1); x++)
+			furthest = glm::max(furthest, depths[y * levelWidth + x]);
+	}
+
+	// occluded if the box's nearest point is behind everything drawn there
+	return screenMin.z > furthest;
+}
+
+// remove occluded boxes from a list of (e.g. frustum culled) box indices
+void HiZCuller::cull(const std::vector<BoundingBox>& boxes, std::vector<uint32_t>& visible)
+{
+	mNumTested = static_cast<uint32_t>(visible.size());
+
+	size_t numVisible = 0;
+	for (uint32_t index : visible)
+	{
+		if (!isOccluded(boxes[index]))
+			visible[numVisible++] = index;
+	}
+	visible.resize(numVisible);
+
+	mNumOccluded = mNumTested - static_cast<uint32_t>(numVisible);
+}
@@ -0,0 +1,79 @@
+#ifndef HIZ_CULLER_H
+#define HIZ_CULLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "utilities.h"
+
+// world space axis aligned bounding box
+struct BoundingBox
+{
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+/*****************************************************************
+ * hierarchical-Z occlusion culling
+ * after a frame is drawn, its depth buffer is copied into a depth
+ * pyramid whose levels store the furthest depth of the texels
+ * below them; the coarse levels are read back asynchronously and
+ * bounding boxes are tested on the CPU against the most recent
+ * pyramid (reprojected with that frame's view-projection matrix),
+ * so culling lags the depth buffer by a frame or two
+ *****************************************************************/
+class HiZCuller
+{
+public:
+	HiZCuller();
+	~HiZCuller();
+
+	// compile shaders and create the pyramid for a framebuffer size
+	void init(int width, int height);
+	// delete the pyramid and the readback buffers
+	void release();
+	// build the pyramid from the current depth buffer and start reading it back
+	// (leaves the default framebuffer bound with a full viewport and depth testing on)
+	void build(const glm::mat4& viewProjection);
+
+	// whether a box is hidden behind the depth of the last read back pyramid
+	bool isOccluded(const BoundingBox& box) const;
+	// remove occluded boxes from a list of (e.g. frustum culled) box indices
+	void cull(const std::vector<BoundingBox>& boxes, std::vector<uint32_t>& visible);
+
+	// statistics of the last cull
+	uint32_t getNumTested() const { return mNumTested; }
+	uint32_t getNumOccluded() const { return mNumOccluded; }
+
+private:
+	ShaderProgram mCopyShader;		// depth buffer -> pyramid level 0
+	ShaderProgram mReduceShader;	// level i - 1 -> level i
+
+	GLuint mVAO = 0;				// empty VAO for full screen triangles
+	GLuint mFBO = 0;
+	GLuint mDepthTexture = 0;		// copy of the depth buffer
+	GLuint mPyramidTexture = 0;		// furthest depth pyramid (R32F mipmaps)
+	GLuint mPBOs[2] = {};			// readback of the coarse levels (alternating frames)
+	GLsync mFences[2] = {};
+	glm::mat4 mPBOViewProjection[2];
+
+	int mWidth = 0;
+	int mHeight = 0;
+	int mNumLevels = 0;
+	int mFirstReadLevel = 0;		// finest level read back to the CPU
+	uint64_t mFrame = 0;
+
+	// CPU copy of the read back levels
+	bool mHasPyramid = false;
+	glm::mat4 mViewProjection;		// view-projection matrix of the frame the pyramid was built from
+	std::vector<std::vector<float>> mLevels;	// indexed by level - mFirstReadLevel
+
+	uint32_t mNumTested = 0;
+	uint32_t mNumOccluded = 0;
+
+	int getLevelWidth(int level) const { return glm::max(1, mWidth >> level); }
+	int getLevelHeight(int level) const { return glm::max(1, mHeight >> level); }
+	void readPyramid(int slot);
+};
+
+#endif
@@ -0,0 +1,254 @@
+#include "ImageLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+
+#include "stb_image.h"
+#include "KTX2.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_LOADER_SSE
+#endif
+
+// numThreads 0 = one per hardware thread (threads are started on first use)
+ImageLoader::ImageLoader(unsigned numThreads) :
+	mNumThreads(numThreads > 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency()))
+{}
+
+ImageLoader::~ImageLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mJobAdded.notify_all();
+	for (std::thread& thread : mThreads)
+		thread.join();
+}
+
+// decode a file on the pool; pixels go to destination if they fit in capacity bytes
+std::future<DecodedImage> ImageLoader::load(const std::string& path, uint8_t* destination, size_t capacity)
+{
+	auto job = std::make_shared<std::packaged_task<DecodedImage()>>([this, path, destination, capacity]()
+	{
+		DecodedImage result;
+		result.path = path;
+
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "Unable to open " << path << std::endl;
+			return result;
+		}
+		std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		result.hash = hash(contents.data(), contents.size());
+		decode(contents.data(), contents.size(), result, destination, capacity);
+		return result;
+	});
+	std::future<DecodedImage> future = job->get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mThreads.empty())
+		{
+			for (unsigned i = 0; i < mNumThreads; i++)
+				mThreads.emplace_back(&ImageLoader::work, this);
+		}
+		mJobs.push([job]() { (*job)(); });
+	}
+	mJobAdded.notify_one();
+	return future;
+}
+
+// decode file contents on the calling thread
+bool ImageLoader::decode(const uint8_t* data, size_t size, DecodedImage& result, uint8_t* destination, size_t capacity)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	result.format = getFormat(data, size);
+	result.valid = false;
+	result.inDestination = false;
+
+	// native channels, expanded below
+	int channels;
+	uint8_t* pixels = stbi_load_from_memory(data, static_cast<int>(size), &result.image.width, &result.image.height, &channels, 0);
+	if (!pixels)
+		return false;
+
+	const size_t numPixels = static_cast<size_t>(result.image.width) * result.image.height;
+	uint8_t* rgba = destination;
+	if (destination && numPixels * 4 <= capacity)
+	{
+		result.inDestination = true;
+	}
+	else
+	{
+		result.image.pixels.resize(numPixels * 4);
+		rgba = result.image.pixels.data();
+	}
+	expandToRGBA(pixels, channels, numPixels, rgba);
+	stbi_image_free(pixels);
+	result.valid = true;
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	std::lock_guard<std::mutex> lock(mStatsMutex);
+	DecodeStats& stats = mStats[result.format];
+	stats.numImages++;
+	stats.fileBytes += size;
+	stats.pixelBytes += numPixels * 4;
+	stats.seconds += seconds;
+	return true;
+}
+
+// decode statistics by file format
+std::map<std::string, DecodeStats> ImageLoader::getStats() const
+{
+	std::lock_guard<std::mutex> lock(mStatsMutex);
+	return mStats;
+}
+
+void ImageLoader::resetStats()
+{
+	std::lock_guard<std::mutex> lock(mStatsMutex);
+	mStats.clear();
+}
+
+// expand 1 to 4 channel pixels to RGBA8 (grey is replicated, alpha set to 255 if missing)
+void ImageLoader::expandToRGBA(const uint8_t* source, int channels, size_t numPixels, uint8_t* destination)
+{
+	if (channels == 4)
+	{
+		std::memcpy(destination, source, numPixels * 4);
+		return;
+	}
+
+	size_t i = 0;
+
+#ifdef IMAGE_LOADER_SSE
+	const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000));
+	if (channels == 3)
+	{
+		// four pixels at a time: shift pixel n up by n bytes into its 4-byte slot (loads 16 bytes, uses 12)
+		const __m128i mask0 = _mm_srli_si128(_mm_set1_epi32(0x00FFFFFF), 12);	// RGB of pixel 0
+		const __m128i mask1 = _mm_slli_si128(mask0, 4);
+		const __m128i mask2 = _mm_slli_si128(mask0, 8);
+		const __m128i mask3 = _mm_slli_si128(mask0, 12);
+		for (; i * 3 + 16 <= numPixels * 3; i += 4)
+		{
+			__m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+			__m128i rgba = _mm_or_si128(_mm_and_si128(rgb, mask0), opaque);
+			rgba = _mm_or_si128(rgba, _mm_and_si128(_mm_slli_si128(rgb, 1), mask1));
+			rgba = _mm_or_si128(rgba, _mm_and_si128(_mm_slli_si128(rgb, 2), mask2));
+			rgba = _mm_or_si128(rgba, _mm_and_si128(_mm_slli_si128(rgb, 3), mask3));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), rgba);
+		}
+	}
+	else if (channels == 1)
+	{
+		// sixteen pixels at a time: g -> gg and g255 -> ggg255
+		for (; i + 16 <= numPixels; i += 16)
+		{
+			__m128i grey = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+			__m128i gg = _mm_unpacklo_epi8(grey, grey);
+			__m128i ga = _mm_unpacklo_epi8(grey, _mm_set1_epi8(-1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), _mm_unpacklo_epi16(gg, ga));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4 + 16), _mm_unpackhi_epi16(gg, ga));
+			gg = _mm_unpackhi_epi8(grey, grey);
+			ga = _mm_unpackhi_epi8(grey, _mm_set1_epi8(-1));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4 + 32), _mm_unpacklo_epi16(gg, ga));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4 + 48), _mm_unpackhi_epi16(gg, ga));
+		}
+	}
+	else if (channels == 2)
+	{
+		// eight pixels at a time: ga -> gg and ga -> ggga
+		const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+		for (; i + 8 <= numPixels; i += 8)
+		{
+			__m128i ga = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2));
+			__m128i grey = _mm_and_si128(ga, lowBytes);
+			__m128i gg = _mm_or_si128(grey, _mm_slli_epi16(grey, 8));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), _mm_unpacklo_epi16(gg, ga));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4 + 16), _mm_unpackhi_epi16(gg, ga));
+		}
+	}
+#endif
+
+	for (; i < numPixels; i++)
+	{
+		const uint8_t* in = source + i * channels;
+		uint8_t* out = destination + i * 4;
+		if (channels >= 3)
+		{
+			out[0] = in[0];
+			out[1] = in[1];
+			out[2] = in[2];
+		}
+		else
+		{
+			out[0] = out[1] = out[2] = in[0];
+		}
+		out[3] = (channels == 2) ? in[1] : 255;
+	}
+}
+
+// FNV-1a hash of file contents
+uint64_t ImageLoader::hash(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// file format from the leading bytes of a file
+const char* ImageLoader::getFormat(const uint8_t* data, size_t size)
+{
+	auto startsWith = [data, size](const char* signature, size_t length)
+	{
+		return size >= length && std::memcmp(data, signature, length) == 0;
+	};
+
+	if (startsWith("\x89PNG", 4))
+		return "png";
+	if (startsWith("\xFF\xD8", 2))
+		return "jpeg";
+	if (startsWith("BM", 2))
+		return "bmp";
+	if (startsWith("GIF8", 4))
+		return "gif";
+	if (startsWith("8BPS", 4))
+		return "psd";
+	if (startsWith("#?", 2))
+		return "hdr";
+	if (startsWith("P5", 2) || startsWith("P6", 2))
+		return "pnm";
+	if (KTX2::isKTX2(data, size))
+		return "ktx2";
+	return "tga";	// (no signature)
+}
+
+void ImageLoader::work()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mJobAdded.wait(lock, [this]() { return mStop || !mJobs.empty(); });
+			if (mJobs.empty())
+				return;		// stopped with nothing left to do
+			job = std::move(mJobs.front());
+			mJobs.pop();
+		}
+		job();
+	}
+}
@@ -0,0 +1,94 @@
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ImageRGBA.h"
+
+// result of decoding an image file
+struct DecodedImage
+{
+	std::string path;
+	std::string format;				// file format ("png", "jpeg", "bmp", ...)
+	bool valid = false;
+	bool inDestination = false;		// RGBA pixels were written to the destination given (image.pixels is empty)
+	uint64_t hash = 0;				// hash of the file contents (set by load)
+	ImageRGBA image;
+};
+
+// decode statistics of a file format
+struct DecodeStats
+{
+	uint32_t numImages = 0;
+	uint64_t fileBytes = 0;			// compressed input
+	uint64_t pixelBytes = 0;		// RGBA8 output
+	double seconds = 0.0;			// decode time summed over threads
+
+	// RGBA output per second of decode time (i.e. per thread)
+	double getMBPerSecond() const { return seconds > 0.0 ? pixelBytes / (seconds * 1024.0 * 1024.0) : 0.0; }
+};
+
+/*****************************************************************
+ * image file decoding to RGBA8 on a pool of worker threads
+ * files are read and decoded (with stb_image) concurrently, each
+ * job returning a future; images are decoded with their own
+ * number of channels and expanded to RGBA afterwards (with SSE2
+ * where available), which is cheaper than stb_image's scalar
+ * conversion and gives 4-byte texels that upload without the
+ * driver's unaligned RGB path
+ * a job can be given a destination, e.g. a mapped pixel unpack
+ * buffer, which pixels are written straight into if they fit;
+ * mapping and unmapping is left to the caller, on the GL thread
+ * decode times are recorded per file format
+ *****************************************************************/
+class ImageLoader
+{
+public:
+	// numThreads 0 = one per hardware thread (threads are started on first use)
+	explicit ImageLoader(unsigned numThreads = 0);
+	~ImageLoader();
+	ImageLoader(const ImageLoader&) = delete;
+	ImageLoader& operator=(const ImageLoader&) = delete;
+
+	// decode a file on the pool; pixels go to destination if they fit in capacity bytes
+	std::future<DecodedImage> load(const std::string& path, uint8_t* destination = nullptr, size_t capacity = 0);
+	// decode file contents on the calling thread
+	bool decode(const uint8_t* data, size_t size, DecodedImage& result, uint8_t* destination = nullptr, size_t capacity = 0);
+
+	// decode statistics by file format
+	std::map<std::string, DecodeStats> getStats() const;
+	void resetStats();
+	unsigned getNumThreads() const { return mNumThreads; }
+
+	// expand 1 to 4 channel pixels to RGBA8 (grey is replicated, alpha set to 255 if missing)
+	static void expandToRGBA(const uint8_t* source, int channels, size_t numPixels, uint8_t* destination);
+	// FNV-1a hash of file contents
+	static uint64_t hash(const uint8_t* data, size_t size);
+	// file format from the leading bytes of a file
+	static const char* getFormat(const uint8_t* data, size_t size);
+
+private:
+	unsigned mNumThreads;
+	std::vector<std::thread> mThreads;
+	std::queue<std::function<void()>> mJobs;
+	std::mutex mMutex;					// guards the job queue and the stop flag
+	std::condition_variable mJobAdded;
+	bool mStop = false;
+
+	mutable std::mutex mStatsMutex;
+	std::map<std::string, DecodeStats> mStats;
+
+	void work();
+};
+
+#endif
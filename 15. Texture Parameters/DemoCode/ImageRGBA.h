@@ -0,0 +1,15 @@
+#ifndef IMAGE_RGBA_H
+#define IMAGE_RGBA_H
+
+#include <cstdint>
+#include <vector>
+
+// RGBA8 image (rows of width * 4 bytes)
+struct ImageRGBA
+{
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include "KTX2.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// file identifier «KTX 20»\r\n\x1A\n
+static const uint8_t gIdentifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+// header and index sizes
+const size_t gHeaderSize = 12 + 9 * 4;
+const size_t gIndexSize = 4 * 4 + 2 * 8;
+const size_t gLevelIndexEntrySize = 3 * 8;
+
+// little endian fields
+static void put_u32(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+		data[offset + i] = (value >> (i * 8)) & 0xFF;
+}
+
+static void put_u64(std::vector<uint8_t>& data, size_t offset, uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+		data[offset + i] = (value >> (i * 8)) & 0xFF;
+}
+
+static uint32_t get_u32(const uint8_t* data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static uint64_t get_u64(const uint8_t* data)
+{
+	return get_u32(data) | (static_cast<uint64_t>(get_u32(data + 4)) << 32);
+}
+
+static size_t align(size_t offset, size_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+// block size and data format descriptor fields of a format
+struct FormatInfo
+{
+	uint32_t blockSize;
+	uint8_t colourModel;
+	int numSamples;
+	uint8_t sampleChannels[2];	// channel type of each 64 or 128 bit sample
+};
+
+static bool get_format_info(uint32_t format, FormatInfo& info)
+{
+	switch (format)
+	{
+	case KTX2_BC1_RGB_UNORM: info = { 8, 128, 1, { 0 } }; return true;			// BC1A model, colour
+	case KTX2_BC3_UNORM: info = { 16, 130, 2, { 15, 0 } }; return true;			// BC3 model, alpha then colour
+	case KTX2_BC7_UNORM: info = { 16, 134, 1, { 0 } }; return true;			// BC7 model, colour
+	case KTX2_ETC2_RGB8_UNORM: info = { 8, 161, 1, { 2 } }; return true;		// ETC2 model, colour
+	case KTX2_ETC2_RGBA8_UNORM: info = { 16, 161, 2, { 15, 2 } }; return true;	// ETC2 model, alpha then colour
+	default: return false;
+	}
+}
+
+// whether data starts with the KTX2 file identifier
+bool KTX2::isKTX2(const uint8_t* data, size_t size)
+{
+	return size >= sizeof(gIdentifier) && std::memcmp(data, gIdentifier, sizeof(gIdentifier)) == 0;
+}
+
+// bytes per 4x4 block of a format (0 if not supported)
+size_t KTX2::getBlockSize(uint32_t format)
+{
+	FormatInfo info;
+	return get_format_info(format, info) ? info.blockSize : 0;
+}
+
+bool KTX2::read(const uint8_t* data, size_t size, KTX2Image& image)
+{
+	if (!isKTX2(data, size) || size < gHeaderSize + gIndexSize)
+		return false;
+
+	const uint8_t* header = data + 12;
+	image.format = get_u32(header);
+	image.width = get_u32(header + 8);
+	image.height = get_u32(header + 12);
+	uint32_t depth = get_u32(header + 16);
+	uint32_t layerCount = get_u32(header + 20);
+	uint32_t faceCount = get_u32(header + 24);
+	uint32_t levelCount = std::max(1u, get_u32(header + 28));
+	uint32_t supercompression = get_u32(header + 32);
+
+	FormatInfo info;
+	if (!get_format_info(image.format, info) || depth != 0 || layerCount > 1 || faceCount != 1 || supercompression != 0)
+	{
+		std::cerr << "Unsupported KTX2 texture (format " << image.format << ")" << std::endl;
+		return false;
+	}
+
+	const uint8_t* index = data + gHeaderSize;
+	uint32_t kvdOffset = get_u32(index + 8);
+	uint32_t kvdLength = get_u32(index + 12);
+
+	// orientation from the key/value data (rows are top to bottom if not given)
+	image.bottomUp = false;
+	if (static_cast<uint64_t>(kvdOffset) + kvdLength <= size)
+	{
+		size_t offset = kvdOffset, end = kvdOffset + kvdLength;
+		while (offset + 4 <= end)
+		{
+			uint32_t length = get_u32(data + offset);
+			const char* pair = reinterpret_cast<const char*>(data + offset + 4);
+			if (offset + 4 + length > end)
+				break;
+			if (length > 16 && std::strncmp(pair, "KTXorientation", length) == 0)
+				image.bottomUp = pair[15] == 'r' && length > 16 + 1 && pair[16] == 'u';
+			offset = align(offset + 4 + length, 4);
+		}
+	}
+
+	// levels
+	const uint8_t* levelIndex = index + gIndexSize;
+	if (gHeaderSize + gIndexSize + levelCount * gLevelIndexEntrySize > size)
+		return false;
+
+	image.levels.resize(levelCount);
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		uint64_t offset = get_u64(levelIndex + level * gLevelIndexEntrySize);
+		uint64_t length = get_u64(levelIndex + level * gLevelIndexEntrySize + 8);
+		if (offset + length > size)
+			return false;
+		image.levels[level].assign(data + offset, data + offset + length);
+	}
+	return true;
+}
+
+bool KTX2::write(const std::string& path, const KTX2Image& image)
+{
+	FormatInfo info;
+	if (!get_format_info(image.format, info) || image.levels.empty())
+		return false;
+
+	const uint32_t levelCount = static_cast<uint32_t>(image.levels.size());
+
+	// data format descriptor: total size, then one basic descriptor block
+	const uint32_t dfdBlockSize = 24 + 16 * info.numSamples;
+	std::vector<uint8_t> dfd(4 + dfdBlockSize, 0);
+	put_u32(dfd, 0, static_cast<uint32_t>(dfd.size()));
+	put_u32(dfd, 4, 0);								// vendor 0 (Khronos), basic descriptor type
+	put_u32(dfd, 8, 2 | (dfdBlockSize << 16));		// version 2
+	dfd[12] = info.colourModel;
+	dfd[13] = 1;									// BT.709 primaries
+	dfd[14] = 1;									// linear transfer function
+	dfd[15] = 0;									// straight alpha
+	dfd[16] = 3;									// 4x4 texel blocks (dimensions minus one)
+	dfd[17] = 3;
+	dfd[20] = static_cast<uint8_t>(info.blockSize);	// bytes in plane 0
+	for (int sample = 0; sample < info.numSamples; sample++)
+	{
+		size_t offset = 28 + sample * 16;
+		uint32_t bitLength = (info.blockSize * 8) / info.numSamples;
+		put_u32(dfd, offset, (sample * bitLength) | ((bitLength - 1) << 16) | (info.sampleChannels[sample] << 24));
+		put_u32(dfd, offset + 12, 0xFFFFFFFF);		// sample upper
+	}
+
+	// key/value data: row order
+	const char orientation[] = "KTXorientation\0rd";
+	std::vector<uint8_t> kvd(align(4 + sizeof(orientation), 4), 0);
+	put_u32(kvd, 0, sizeof(orientation));
+	std::memcpy(&kvd[4], orientation, sizeof(orientation));
+	if (image.bottomUp)
+		kvd[4 + 16] = 'u';
+
+	// layout: header, index, level index, descriptor, key/value data, levels (smallest first)
+	size_t dfdOffset = gHeaderSize + gIndexSize + levelCount * gLevelIndexEntrySize;
+	size_t kvdOffset = dfdOffset + dfd.size();
+	size_t end = kvdOffset + kvd.size();
+
+	std::vector<uint64_t> levelOffsets(levelCount);
+	for (int level = levelCount - 1; level >= 0; level--)
+	{
+		end = align(end, info.blockSize);
+		levelOffsets[level] = end;
+		end += image.levels[level].size();
+	}
+
+	std::vector<uint8_t> data(end, 0);
+	std::memcpy(&data[0], gIdentifier, sizeof(gIdentifier));
+	put_u32(data, 12, image.format);
+	put_u32(data, 16, 1);				// type size of block compressed formats
+	put_u32(data, 20, image.width);
+	put_u32(data, 24, image.height);
+	put_u32(data, 28, 0);				// depth
+	put_u32(data, 32, 0);				// layers (not an array)
+	put_u32(data, 36, 1);				// faces
+	put_u32(data, 40, levelCount);
+	put_u32(data, 44, 0);				// no supercompression
+
+	put_u32(data, gHeaderSize, static_cast<uint32_t>(dfdOffset));
+	put_u32(data, gHeaderSize + 4, static_cast<uint32_t>(dfd.size()));
+	put_u32(data, gHeaderSize + 8, static_cast<uint32_t>(kvdOffset));
+	put_u32(data, gHeaderSize + 12, static_cast<uint32_t>(kvd.size()));
+	put_u64(data, gHeaderSize + 16, 0);	// no supercompression global data
+	put_u64(data, gHeaderSize + 24, 0);
+
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		size_t entry = gHeaderSize + gIndexSize + level * gLevelIndexEntrySize;
+		put_u64(data, entry, levelOffsets[level]);
+		put_u64(data, entry + 8, image.levels[level].size());
+		put_u64(data, entry + 16, image.levels[level].size());
+		std::memcpy(&data[levelOffsets[level]], image.levels[level].data(), image.levels[level].size());
+	}
+
+	std::memcpy(&data[dfdOffset], dfd.data(), dfd.size());
+	std::memcpy(&data[kvdOffset], kvd.data(), kvd.size());
+
+	std::ofstream file(path, std::ios::out | std::ios::binary);
+	if (!file)
+		return false;
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return static_cast<bool>(file);
+}
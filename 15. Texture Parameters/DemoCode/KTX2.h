@@ -0,0 +1,48 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Vulkan formats of the block compressed images KTX2 files can hold here
+enum KTX2Format : uint32_t
+{
+	KTX2_BC1_RGB_UNORM = 131,
+	KTX2_BC3_UNORM = 137,
+	KTX2_BC7_UNORM = 145,
+	KTX2_ETC2_RGB8_UNORM = 147,
+	KTX2_ETC2_RGBA8_UNORM = 151
+};
+
+// 2D texture with a mipmap chain (level 0 first)
+struct KTX2Image
+{
+	uint32_t format = 0;		// KTX2Format
+	uint32_t width = 0;
+	uint32_t height = 0;
+	bool bottomUp = true;		// rows stored bottom to top (as OpenGL expects)
+	std::vector<std::vector<uint8_t>> levels;
+};
+
+/*****************************************************************
+ * minimal KTX2 container reading and writing
+ * only single-layer, single-face 2D block compressed textures
+ * without supercompression are supported; the data format
+ * descriptor is written for other tools but not interpreted, and
+ * the KTXorientation key records the row order
+ *****************************************************************/
+class KTX2
+{
+public:
+	// whether data starts with the KTX2 file identifier
+	static bool isKTX2(const uint8_t* data, size_t size);
+	// bytes per 4x4 block of a format (0 if not supported)
+	static size_t getBlockSize(uint32_t format);
+
+	static bool read(const uint8_t* data, size_t size, KTX2Image& image);
+	static bool write(const std::string& path, const KTX2Image& image);
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "MipmapGenerator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIPMAP_GENERATOR_SSE
+#endif
+
+// rows handed to a thread at a time
+const int gRowsPerTask = 16;
+
+// Kaiser filter: taps per direction, window radius (in destination texels) and shape
+const int gKaiserTaps = 12;
+const float gKaiserRadius = 3.0f;
+const float gKaiserAlpha = 4.0f;
+
+// run a function over ranges of rows on a number of threads (0 = one per hardware thread)
+static void parallel_rows(int numRows, unsigned numThreads, const std::function<void(int, int)>& function)
+{
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	numThreads = std::min(numThreads, static_cast<unsigned>((numRows + gRowsPerTask - 1) / gRowsPerTask));
+
+	std::atomic<int> nextRow(0);
+	auto work = [&]()
+	{
+		for (int row = nextRow.fetch_add(gRowsPerTask); row < numRows; row = nextRow.fetch_add(gRowsPerTask))
+			function(row, std::min(row + gRowsPerTask, numRows));
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < numThreads; i++)
+		threads.emplace_back(work);
+	work();
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+// sRGB 8-bit to linear
+static const float* srgb_to_linear_table()
+{
+	static const std::vector<float> table = []()
+	{
+		std::vector<float> values(256);
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			values[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return values;
+	}();
+	return table.data();
+}
+
+// linear (quantised to 12 bits) to sRGB 8-bit
+static const uint8_t* linear_to_srgb_table()
+{
+	static const std::vector<uint8_t> table = []()
+	{
+		std::vector<uint8_t> values(4096);
+		for (int i = 0; i < 4096; i++)
+		{
+			float c = i / 4095.0f;
+			float s = (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+			values[i] = static_cast<uint8_t>(std::lround(std::min(std::max(s, 0.0f), 1.0f) * 255.0f));
+		}
+		return values;
+	}();
+	return table.data();
+}
+
+// zeroth order modified Bessel function of the first kind
+static float bessel_i0(float x)
+{
+	float sum = 1.0f, term = 1.0f;
+	for (int k = 1; k < 20; k++)
+	{
+		term *= (x / (2.0f * k)) * (x / (2.0f * k));
+		sum += term;
+	}
+	return sum;
+}
+
+// normalised filter weights for source texels 2x + first ... 2x + first + count - 1
+static std::vector<float> make_weights(MipFilter filter, int& first)
+{
+	if (filter == MipFilter::BOX)
+	{
+		first = 0;
+		return { 0.5f, 0.5f };
+	}
+
+	const float pi = 3.14159265f;
+	first = 1 - gKaiserTaps / 2;
+	std::vector<float> weights(gKaiserTaps);
+	float total = 0.0f;
+	for (int i = 0; i < gKaiserTaps; i++)
+	{
+		// distance from the destination texel centre (in destination texels)
+		float distance = (first + i - 0.5f) * 0.5f;
+		float sinc = std::sin(pi * distance) / (pi * distance);
+		float t = distance / gKaiserRadius;
+		float window = bessel_i0(gKaiserAlpha * std::sqrt(std::max(0.0f, 1.0f - t * t))) / bessel_i0(gKaiserAlpha);
+		weights[i] = sinc * window;
+		total += weights[i];
+	}
+	for (float& weight : weights)
+		weight /= total;
+	return weights;
+}
+
+// weighted sum of four-channel float texels at offsets into data
+static void weighted_sum(const float* data, const size_t* offsets, const float* weights, int numTaps, float* result)
+{
+#ifdef MIPMAP_GENERATOR_SSE
+	__m128 sum = _mm_setzero_ps();
+	for (int tap = 0; tap < numTaps; tap++)
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(data + offsets[tap]), _mm_set1_ps(weights[tap])));
+	_mm_storeu_ps(result, sum);
+#else
+	for (int c = 0; c < 4; c++)
+		result[c] = 0.0f;
+	for (int tap = 0; tap < numTaps; tap++)
+	{
+		for (int c = 0; c < 4; c++)
+			result[c] += data[offsets[tap] + c] * weights[tap];
+	}
+#endif
+}
+
+// 2x2 box filter of 8-bit texels (linear data, both dimensions at least 2)
+static void box_rows(const ImageRGBA& image, ImageRGBA& half, int rowBegin, int rowEnd)
+{
+	for (int y = rowBegin; y < rowEnd; y++)
+	{
+		const uint8_t* row0 = &image.pixels[static_cast<size_t>(y * 2) * image.width * 4];
+		const uint8_t* row1 = row0 + static_cast<size_t>(image.width) * 4;
+		uint8_t* out = &half.pixels[static_cast<size_t>(y) * half.width * 4];
+		int x = 0;
+
+#ifdef MIPMAP_GENERATOR_SSE
+		// two destination texels from four source texels of each row
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i rounding = _mm_set1_epi16(2);
+		for (; x + 2 <= half.width; x += 2)
+		{
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+			__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));	// texels 0, 1
+			__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));	// texels 2, 3
+			__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+			sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(sum, sum));
+		}
+#endif
+
+		for (; x < half.width; x++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				int sum = row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c];
+				out[x * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+// levels 1 and up of an image (level 0 is the image itself)
+std::vector<ImageRGBA> MipmapGenerator::generate(const ImageRGBA& image, MipFilter filter, bool sRGB, unsigned numThreads)
+{
+	std::vector<ImageRGBA> levels;
+	const ImageRGBA* previous = &image;
+	while (previous->width > 1 || previous->height > 1)
+	{
+		levels.push_back(downsample(*previous, filter, sRGB, numThreads));
+		previous = &levels.back();
+	}
+	return levels;
+}
+
+// half size image (numThreads 0 = one per hardware thread)
+ImageRGBA MipmapGenerator::downsample(const ImageRGBA& image, MipFilter filter, bool sRGB, unsigned numThreads)
+{
+	ImageRGBA half;
+	half.width = std::max(1, image.width / 2);
+	half.height = std::max(1, image.height / 2);
+	half.pixels.resize(static_cast<size_t>(half.width) * half.height * 4);
+
+	// 8-bit box filter (the last row and column of odd sizes are dropped)
+	if (filter == MipFilter::BOX && !sRGB && image.width >= 2 && image.height >= 2)
+	{
+		parallel_rows(half.height, numThreads, [&](int rowBegin, int rowEnd)
+		{
+			box_rows(image, half, rowBegin, rowEnd);
+		});
+		return half;
+	}
+
+	// separable float filter (edges are clamped)
+	int first;
+	const std::vector<float> weights = make_weights(filter, first);
+	const int numTaps = static_cast<int>(weights.size());
+	const float* toLinear = srgb_to_linear_table();
+	const uint8_t* toSRGB = linear_to_srgb_table();
+
+	// horizontal pass: every source row to destination width
+	std::vector<float> rows(static_cast<size_t>(half.width) * image.height * 4);
+	parallel_rows(image.height, numThreads, [&](int rowBegin, int rowEnd)
+	{
+		std::vector<float> source(static_cast<size_t>(image.width) * 4);
+		for (int y = rowBegin; y < rowEnd; y++)
+		{
+			const uint8_t* in = &image.pixels[static_cast<size_t>(y) * image.width * 4];
+			for (int i = 0; i < image.width * 4; i++)
+				source[i] = (sRGB && (i & 3) != 3) ? toLinear[in[i]] : in[i] / 255.0f;
+
+			float* out = &rows[static_cast<size_t>(y) * half.width * 4];
+			size_t offsets[gKaiserTaps];
+			for (int x = 0; x < half.width; x++)
+			{
+				for (int tap = 0; tap < numTaps; tap++)
+					offsets[tap] = std::min(std::max(x * 2 + first + tap, 0), image.width - 1) * 4;
+				weighted_sum(source.data(), offsets, weights.data(), numTaps, out + x * 4);
+			}
+		}
+	});
+
+	// vertical pass: destination rows, converted back to 8 bits
+	parallel_rows(half.height, numThreads, [&](int rowBegin, int rowEnd)
+	{
+		size_t offsets[gKaiserTaps];
+		for (int y = rowBegin; y < rowEnd; y++)
+		{
+			// source rows of the destination row (advanced by one texel per x)
+			for (int tap = 0; tap < numTaps; tap++)
+				offsets[tap] = static_cast<size_t>(std::min(std::max(y * 2 + first + tap, 0), image.height - 1)) * half.width * 4;
+
+			uint8_t* out = &half.pixels[static_cast<size_t>(y) * half.width * 4];
+			for (int x = 0; x < half.width; x++)
+			{
+				float sum[4];
+				weighted_sum(&rows[static_cast<size_t>(x) * 4], offsets, weights.data(), numTaps, sum);
+				for (int c = 0; c < 4; c++)
+				{
+					float value = std::min(std::max(sum[c], 0.0f), 1.0f);	// (negative lobes can overshoot)
+					if (sRGB && c != 3)
+						out[x * 4 + c] = toSRGB[static_cast<int>(value * 4095.0f + 0.5f)];
+					else
+						out[x * 4 + c] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+				}
+			}
+		}
+	});
+
+	return half;
+}
@@ -0,0 +1,31 @@
+#ifndef MIPMAP_GENERATOR_H
+#define MIPMAP_GENERATOR_H
+
+#include <vector>
+
+#include "ImageRGBA.h"
+
+// downsampling filters
+enum class MipFilter { BOX, KAISER };
+
+/*****************************************************************
+ * CPU mipmap chain generation for RGBA8 images
+ * each level is half the size of the previous one (clamped to 1),
+ * filtered with a 2x2 box or a separable Kaiser-windowed sinc
+ * (12 taps per direction, sharper than a box); with sRGB set,
+ * colour channels are filtered in linear space and alpha as is
+ * rows are split across threads and the inner loops use SSE
+ * where available
+ *****************************************************************/
+class MipmapGenerator
+{
+public:
+	// levels 1 and up of an image (level 0 is the image itself)
+	static std::vector<ImageRGBA> generate(const ImageRGBA& image, MipFilter filter, bool sRGB = false,
+		unsigned numThreads = 0);
+
+	// half size image (numThreads 0 = one per hardware thread)
+	static ImageRGBA downsample(const ImageRGBA& image, MipFilter filter, bool sRGB = false, unsigned numThreads = 0);
+};
+
+#endif
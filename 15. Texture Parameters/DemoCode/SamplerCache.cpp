@@ -0,0 +1,65 @@
+#include "SamplerCache.h"
+#include "GLStateCache.h"
+
+#include <cstdint>
+#include <cstring>
+
+bool SamplerDesc::operator==(const SamplerDesc& other) const
+{
+	return magFilter == other.magFilter && minFilter == other.minFilter && wrapS == other.wrapS
+		&& wrapT == other.wrapT && wrapR == other.wrapR && borderColor == other.borderColor;
+}
+
+// FNV-1a hash of the description's fields
+size_t SamplerDescHash::operator()(const SamplerDesc& desc) const
+{
+	uint32_t words[9] = { desc.magFilter, desc.minFilter, desc.wrapS, desc.wrapT, desc.wrapR };
+	std::memcpy(&words[5], &desc.borderColor[0], 4 * sizeof(float));
+
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t word : words)
+	{
+		hash ^= word;
+		hash *= 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+SamplerCache::SamplerCache()
+{}
+
+SamplerCache::~SamplerCache()
+{
+	clear();
+}
+
+// sampler with the description (created if not cached yet)
+GLuint SamplerCache::get(const SamplerDesc& desc)
+{
+	auto found = mSamplers.find(desc);
+	if (found != mSamplers.end())
+		return found->second;
+
+	GLuint sampler = 0;
+	glGenSamplers(1, &sampler);
+	glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, desc.magFilter);
+	glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, desc.minFilter);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, desc.wrapS);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, desc.wrapT);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, desc.wrapR);
+	glSamplerParameterfv(sampler, GL_TEXTURE_BORDER_COLOR, &desc.borderColor[0]);
+
+	mSamplers.emplace(desc, sampler);
+	return sampler;
+}
+
+// delete all samplers
+void SamplerCache::clear()
+{
+	for (const auto& entry : mSamplers)
+	{
+		glDeleteSamplers(1, &entry.second);
+		GLStateCache::onDeleteSampler(entry.second);
+	}
+	mSamplers.clear();
+}
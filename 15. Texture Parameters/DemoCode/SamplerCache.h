@@ -0,0 +1,53 @@
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include <cstddef>
+#include <unordered_map>
+
+#include "utilities.h"
+
+// sampling state of a sampler object
+struct SamplerDesc
+{
+	GLenum magFilter = GL_LINEAR;
+	GLenum minFilter = GL_NEAREST_MIPMAP_LINEAR;
+	GLenum wrapS = GL_REPEAT;
+	GLenum wrapT = GL_REPEAT;
+	GLenum wrapR = GL_REPEAT;
+	glm::vec4 borderColor = glm::vec4(0.0f);
+
+	bool operator==(const SamplerDesc& other) const;
+	bool operator!=(const SamplerDesc& other) const { return !(*this == other); }
+};
+
+// FNV-1a hash of the description's fields
+struct SamplerDescHash
+{
+	size_t operator()(const SamplerDesc& desc) const;
+};
+
+/*****************************************************************
+ * cache of sampler objects keyed by their description
+ * a sampler is created the first time a description is requested
+ * and never modified afterwards, so changing sampling state means
+ * binding another sampler (glBindSampler) instead of editing the
+ * texture's parameters
+ *****************************************************************/
+class SamplerCache
+{
+public:
+	SamplerCache();
+	~SamplerCache();
+
+	// sampler with the description (created if not cached yet)
+	GLuint get(const SamplerDesc& desc);
+	// delete all samplers
+	void clear();
+
+	size_t size() const { return mSamplers.size(); }
+
+private:
+	std::unordered_map<SamplerDesc, GLuint, SamplerDescHash> mSamplers;
+};
+
+#endif
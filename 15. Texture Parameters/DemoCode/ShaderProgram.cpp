@@ -1,4 +1,5 @@
 #include "ShaderProgram.h"
+#include "GLStateCache.h"
 
 ShaderProgram::ShaderProgram() : mProgramID(0)
 {}
@@ -10,6 +11,7 @@ ShaderProgram::~ShaderProgram()
 	{
 		// delete the shader program
 		glDeleteProgram(mProgramID);
+		GLStateCache::onDeleteProgram(mProgramID);
 	}
 }
 
@@ -152,7 +154,7 @@ void ShaderProgram::compileAndLink(const std::string vShaderFilename, const std:
 void ShaderProgram::use()
 {
 	// use the shader program
-	glUseProgram(mProgramID);
+	GLStateCache::useProgram(mProgramID);
 }
 
 void ShaderProgram::setUniform(const char *name, const glm::vec2& vector)
@@ -0,0 +1,348 @@
+#include "Terrain.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// pack a unit vector into GL_INT_2_10_10_10_REV
+static GLuint pack_normal(const glm::vec3& normal)
+{
+	auto pack = [](float value)
+	{
+		return static_cast<GLuint>(static_cast<int>(std::round(glm::clamp(value, -1.0f, 1.0f) * 511.0f)) & 0x3ff);
+	};
+	return pack(normal.x) | (pack(normal.y) << 10) | (pack(normal.z) << 20);
+}
+
+// quads per chunk side (a power of two of at most 128), units between samples, and height of a sample value
+Terrain::Terrain(uint32_t chunkSize, float spacing, float heightScale, float heightOffset) :
+	mChunkSize(std::min(chunkSize, 128u)), mSpacing(spacing), mHeightScale(heightScale), mHeightOffset(heightOffset)
+{}
+
+Terrain::~Terrain()
+{
+	release();
+}
+
+// open a heightmap of (size + 1) x (size + 1) samples, row by row (size a multiple of the chunk size)
+bool Terrain::init(const std::string& path, uint32_t size)
+{
+	release();
+	mFile.open(path, std::ios::in | std::ios::binary);
+	if (!mFile || size % mChunkSize != 0)
+	{
+		std::cerr << "Failed to open terrain heightmap " << path << std::endl;
+		mFile.close();
+		return false;
+	}
+
+	mSize = size;
+	mChunksPerSide = size / mChunkSize;
+	mChunks = std::vector<Chunk>(mChunksPerSide * mChunksPerSide);
+	mBounds.resize(mChunks.size());
+	for (uint32_t i = 0; i < mChunks.size(); i++)
+		mBounds[i] = getUnloadedBounds(i);
+	createIndices();
+
+	mStop = false;
+	mThread = std::thread(&Terrain::loaderThread, this);
+	return true;
+}
+
+// stop loading and delete the GL objects
+void Terrain::release()
+{
+	if (mThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+		mCondition.notify_all();
+		mThread.join();
+	}
+	mQueue.clear();
+	mLoaded.clear();
+	mFile.close();
+
+	mChunks.clear();	// buffers are deleted by their wrappers
+	mBounds.clear();
+	mIndices.release();
+	mLevels.clear();
+	mNumLoaded = mNumPendingLoads = mNumDrawn = mNumTriangles = 0;
+}
+
+// queue loads of chunks within a radius of the viewpoint (nearest first), unload those well outside it
+void Terrain::update(const glm::vec3& viewpoint, float loadRadius)
+{
+	if (mChunks.empty())
+		return;
+
+	// buffers for a few loaded chunks (so a burst of loads is spread over frames)
+	for (int i = 0; i < sMaxCreatesPerUpdate; i++)
+	{
+		LoadedChunk loaded;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mLoaded.empty())
+				break;
+			loaded = std::move(mLoaded.front());
+			mLoaded.pop_front();
+		}
+
+		Chunk& chunk = mChunks[loaded.chunk];
+		chunk.pending = false;
+		mNumPendingLoads--;
+
+		chunk.vertices.create(sizeof(Vertex) * loaded.vertices.size(), loaded.vertices.data());
+		chunk.vertexArray.create();
+		chunk.vertexArray.setVertexBuffer(0, chunk.vertices, 0, sizeof(Vertex));
+		chunk.vertexArray.setIndexBuffer(mIndices);
+		chunk.vertexArray.setAttribute(0, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+		chunk.vertexArray.setAttribute(1, 0, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(Vertex, normal));
+		chunk.vertexArray.setAttribute(2, 0, 2, GL_UNSIGNED_BYTE, GL_FALSE, offsetof(Vertex, texCoord));
+		chunk.errors = std::move(loaded.errors);
+		mBounds[loaded.chunk] = loaded.bounds;
+		mNumLoaded++;
+	}
+
+	// horizontal distance to each chunk; unload beyond the radius (with some slack, so chunks
+	// at the edge don't load and unload repeatedly) and collect the missing ones inside it
+	const float unloadRadius = loadRadius * 1.25f;
+	std::vector<std::pair<float, uint32_t>> missing;
+	for (uint32_t i = 0; i < mChunks.size(); i++)
+	{
+		glm::vec2 nearest = glm::clamp(glm::vec2(viewpoint.x, viewpoint.z), glm::vec2(mBounds[i].min.x, mBounds[i].min.z),
+			glm::vec2(mBounds[i].max.x, mBounds[i].max.z));
+		float distance = glm::length(nearest - glm::vec2(viewpoint.x, viewpoint.z));
+
+		if (isLoaded(i) && distance > unloadRadius)
+			unloadChunk(i);
+		else if (!isLoaded(i) && !mChunks[i].pending && distance <= loadRadius)
+			missing.push_back({ distance, i });
+	}
+	std::sort(missing.begin(), missing.end());
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		// forget queued chunks that went out of range
+		mQueue.erase(std::remove_if(mQueue.begin(), mQueue.end(), [&](uint32_t i)
+		{
+			glm::vec2 centre = glm::vec2(mBounds[i].min.x + mBounds[i].max.x, mBounds[i].min.z + mBounds[i].max.z) * 0.5f;
+			if (glm::length(centre - glm::vec2(viewpoint.x, viewpoint.z)) <= unloadRadius)
+				return false;
+			mChunks[i].pending = false;
+			mNumPendingLoads--;
+			return true;
+		}), mQueue.end());
+
+		for (const auto& chunk : missing)
+		{
+			if (mNumPendingLoads >= static_cast<uint32_t>(sMaxPendingLoads))
+				break;
+			mChunks[chunk.second].pending = true;
+			mNumPendingLoads++;
+			mQueue.push_back(chunk.second);
+		}
+	}
+	mCondition.notify_one();
+}
+
+// draw (loaded) chunks at the coarsest level of detail whose height error stays under a number of pixels
+void Terrain::draw(const std::vector<uint32_t>& chunks, const glm::vec3& viewpoint, float pixelsPerUnit, float maxPixelError)
+{
+	mNumDrawn = 0;
+	mNumTriangles = 0;
+	for (uint32_t i : chunks)
+	{
+		if (!isLoaded(i))
+			continue;
+
+		// error seen from the nearest point of the chunk
+		const Chunk& chunk = mChunks[i];
+		glm::vec3 nearest = glm::clamp(viewpoint, mBounds[i].min, mBounds[i].max);
+		float distance = std::max(glm::length(viewpoint - nearest), 0.001f);
+
+		size_t level = 0;
+		while (level + 1 < mLevels.size() && chunk.errors[level + 1] * pixelsPerUnit / distance <= maxPixelError)
+			level++;
+
+		chunk.vertexArray.bind();
+		glDrawElements(GL_TRIANGLES, mLevels[level].count, GL_UNSIGNED_SHORT, reinterpret_cast<const void*>(mLevels[level].offset));
+
+		mNumDrawn++;
+		mNumTriangles += mLevels[level].count / 3;
+	}
+}
+
+// bounds of a chunk before its heights are known
+BoundingBox Terrain::getUnloadedBounds(uint32_t chunk) const
+{
+	const float half = mSize * 0.5f;
+	glm::vec3 min(((chunk % mChunksPerSide) * mChunkSize - half) * mSpacing, mHeightOffset,
+		((chunk / mChunksPerSide) * mChunkSize - half) * mSpacing);
+	glm::vec3 max(min.x + mChunkSize * mSpacing, mHeightOffset + 65535.0f * mHeightScale, min.z + mChunkSize * mSpacing);
+	return { min, max };
+}
+
+void Terrain::createIndices()
+{
+	const uint32_t rowSize = mChunkSize + 1;
+	auto grid = [rowSize](uint32_t x, uint32_t z) { return static_cast<GLushort>(z * rowSize + x); };
+	auto skirt = [rowSize](uint32_t edge, uint32_t i) { return static_cast<GLushort>(rowSize * rowSize + edge * rowSize + i); };
+
+	// levels down to a single quad (every step-th sample)
+	std::vector<GLushort> indices;
+	for (uint32_t step = 1; step <= mChunkSize; step *= 2)
+	{
+		Level level;
+		level.offset = indices.size() * sizeof(GLushort);
+
+		for (uint32_t z = 0; z < mChunkSize; z += step)
+		{
+			for (uint32_t x = 0; x < mChunkSize; x += step)
+			{
+				indices.insert(indices.end(), { grid(x, z), grid(x, z + step), grid(x + step, z + step),
+					grid(x, z), grid(x + step, z + step), grid(x + step, z) });
+			}
+		}
+
+		// skirts: a strip down from each edge (front, back, left and right)
+		for (uint32_t i = 0; i < mChunkSize; i += step)
+		{
+			const GLushort edges[4][2] = {
+				{ grid(i, 0), grid(i + step, 0) },
+				{ grid(i, mChunkSize), grid(i + step, mChunkSize) },
+				{ grid(0, i), grid(0, i + step) },
+				{ grid(mChunkSize, i), grid(mChunkSize, i + step) }
+			};
+			for (uint32_t edge = 0; edge < 4; edge++)
+			{
+				indices.insert(indices.end(), { edges[edge][0], edges[edge][1], skirt(edge, i + step),
+					edges[edge][0], skirt(edge, i + step), skirt(edge, i) });
+			}
+		}
+
+		level.count = static_cast<GLsizei>(indices.size() - level.offset / sizeof(GLushort));
+		mLevels.push_back(level);
+	}
+
+	mIndices.create(sizeof(GLushort) * indices.size(), indices.data());
+}
+
+void Terrain::loaderThread()
+{
+	for (;;)
+	{
+		LoadedChunk loaded;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this] { return mStop || !mQueue.empty(); });
+			if (mStop)
+				return;
+			loaded.chunk = mQueue.front();
+			mQueue.pop_front();
+		}
+
+		loadChunk(loaded);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mLoaded.push_back(std::move(loaded));
+	}
+}
+
+// read a chunk's samples (and a ring around them for normals) and build its vertices
+void Terrain::loadChunk(LoadedChunk& loaded)
+{
+	const int n = static_cast<int>(mChunkSize);
+	const int windowSize = n + 3;
+	const int x0 = static_cast<int>((loaded.chunk % mChunksPerSide) * mChunkSize);
+	const int z0 = static_cast<int>((loaded.chunk / mChunksPerSide) * mChunkSize);
+	const int last = static_cast<int>(mSize);
+
+	// heights of samples x0 - 1 to x0 + n + 1 (clamped at the map's edges)
+	std::vector<float> heights(static_cast<size_t>(windowSize) * windowSize);
+	std::vector<uint16_t> row(windowSize);
+	const int first = std::max(x0 - 1, 0);
+	const int count = std::min(x0 + n + 1, last) - first + 1;
+	for (int wz = 0; wz < windowSize; wz++)
+	{
+		int z = std::min(std::max(z0 - 1 + wz, 0), last);
+		mFile.clear();
+		mFile.seekg((static_cast<std::streamoff>(z) * (last + 1) + first) * sizeof(uint16_t));
+		if (!mFile.read(reinterpret_cast<char*>(row.data()), count * sizeof(uint16_t)))
+			std::fill(row.begin(), row.end(), 0);	// (reported by the map looking flat)
+
+		for (int wx = 0; wx < windowSize; wx++)
+		{
+			int x = std::min(std::max(x0 - 1 + wx, 0), last);
+			heights[wz * windowSize + wx] = row[x - first] * mHeightScale + mHeightOffset;
+		}
+	}
+	auto height = [&](int x, int z) { return heights[(z + 1) * windowSize + x + 1]; };
+
+	// error of each level: the largest difference between a sample and the coarser surface (bilinear
+	// within its quads) drawn in its place, kept increasing with the level
+	for (int step = 1; step <= n; step *= 2)
+	{
+		float error = loaded.errors.empty() ? 0.0f : loaded.errors.back();
+		for (int z = 0; step > 1 && z <= n; z++)
+		{
+			for (int x = 0; x <= n; x++)
+			{
+				int qx = std::min(x / step * step, n - step), qz = std::min(z / step * step, n - step);
+				float fx = static_cast<float>(x - qx) / step, fz = static_cast<float>(z - qz) / step;
+				float front = height(qx, qz) + (height(qx + step, qz) - height(qx, qz)) * fx;
+				float back = height(qx, qz + step) + (height(qx + step, qz + step) - height(qx, qz + step)) * fx;
+				error = std::max(error, std::abs(height(x, z) - (front + (back - front) * fz)));
+			}
+		}
+		loaded.errors.push_back(error);
+	}
+
+	// surface vertices
+	const float half = mSize * 0.5f;
+	loaded.vertices.resize(getNumVertices());
+	float minHeight = height(0, 0), maxHeight = minHeight;
+	for (int z = 0; z <= n; z++)
+	{
+		for (int x = 0; x <= n; x++)
+		{
+			Vertex& vertex = loaded.vertices[z * (n + 1) + x];
+			vertex.position = glm::vec3((x0 + x - half) * mSpacing, height(x, z), (z0 + z - half) * mSpacing);
+			vertex.normal = pack_normal(glm::normalize(glm::vec3(height(x - 1, z) - height(x + 1, z), 2.0f * mSpacing,
+				height(x, z - 1) - height(x, z + 1))));
+			vertex.texCoord[0] = static_cast<GLubyte>(x);
+			vertex.texCoord[1] = static_cast<GLubyte>(z);
+			vertex.padding[0] = vertex.padding[1] = 0;
+			minHeight = std::min(minHeight, vertex.position.y);
+			maxHeight = std::max(maxHeight, vertex.position.y);
+		}
+	}
+
+	// skirt vertices: the edge vertices lowered by more than any level's error
+	const float skirtDepth = loaded.errors.back() + mSpacing;
+	for (int i = 0; i <= n; i++)
+	{
+		const int edges[4] = { i, n * (n + 1) + i, i * (n + 1), i * (n + 1) + n };
+		for (int edge = 0; edge < 4; edge++)
+		{
+			Vertex& vertex = loaded.vertices[(n + 1) * (n + 1) + edge * (n + 1) + i];
+			vertex = loaded.vertices[edges[edge]];
+			vertex.position.y -= skirtDepth;
+		}
+	}
+
+	loaded.bounds.min = glm::vec3((x0 - half) * mSpacing, minHeight - skirtDepth, (z0 - half) * mSpacing);
+	loaded.bounds.max = glm::vec3((x0 + n - half) * mSpacing, maxHeight, (z0 + n - half) * mSpacing);
+}
+
+void Terrain::unloadChunk(uint32_t chunk)
+{
+	mChunks[chunk].vertexArray.release();
+	mChunks[chunk].vertices.release();
+	mChunks[chunk].errors.clear();
+	mBounds[chunk] = getUnloadedBounds(chunk);
+	mNumLoaded--;
+}
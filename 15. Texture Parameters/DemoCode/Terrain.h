@@ -0,0 +1,140 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utilities.h"
+#include "GLResources.h"
+#include "HiZCuller.h"
+
+/*****************************************************************
+ * chunked heightmap terrain with geomipmapping
+ * the heightmap (a raw file of 16 bit samples) is split into
+ * square chunks that are read and turned into vertices on a loader
+ * thread when they come within a radius of the viewpoint, and
+ * released again when they are well outside it
+ * every chunk has the same vertex layout, so each level of detail
+ * (every 2nd, 4th, ... sample) is one index range in an index
+ * buffer shared by all chunks; a chunk is drawn at the coarsest
+ * level whose height error projects to at most a few pixels, and
+ * a skirt hanging below its edges hides the cracks where it meets
+ * a neighbour at another level
+ * vertices are in world space (position, normal and texture
+ * coordinates of one repeat per sample) for lightingAndTexture.vert
+ *****************************************************************/
+class Terrain
+{
+public:
+	// quads per chunk side (a power of two of at most 128), units between samples, and height of a sample value
+	// (height = value * heightScale + heightOffset)
+	Terrain(uint32_t chunkSize = 64, float spacing = 1.0f, float heightScale = 1.0f, float heightOffset = 0.0f);
+	~Terrain();
+	Terrain(const Terrain&) = delete;
+	Terrain& operator=(const Terrain&) = delete;
+
+	// open a heightmap of (size + 1) x (size + 1) samples, row by row (size a multiple of the chunk size);
+	// the terrain is centred on the origin
+	bool init(const std::string& path, uint32_t size);
+	// stop loading and delete the GL objects
+	void release();
+
+	// queue loads of chunks within a radius of the viewpoint (nearest first), unload those well outside it
+	// and create the buffers of a few loaded chunks
+	void update(const glm::vec3& viewpoint, float loadRadius);
+	// draw (loaded) chunks at the coarsest level of detail whose height error stays under a number of pixels
+	// (pixelsPerUnit: pixels covered by a unit at distance 1); set the program's matrices for world space first
+	void draw(const std::vector<uint32_t>& chunks, const glm::vec3& viewpoint, float pixelsPerUnit, float maxPixelError);
+
+	uint32_t getNumChunks() const { return static_cast<uint32_t>(mChunks.size()); }
+	bool isLoaded(uint32_t chunk) const { return mChunks[chunk].vertexArray.getID() != 0; }
+	// world bounds of each chunk (including the skirt; spanning all heights until loaded)
+	const std::vector<BoundingBox>& getBounds() const { return mBounds; }
+
+	// statistics
+	uint32_t getNumLoaded() const { return mNumLoaded; }
+	uint32_t getNumPendingLoads() const { return mNumPendingLoads; }
+	uint32_t getNumDrawn() const { return mNumDrawn; }			// chunks in the last draw
+	uint32_t getNumTriangles() const { return mNumTriangles; }
+	size_t getMemoryUsed() const { return static_cast<size_t>(mNumLoaded) * getNumVertices() * sizeof(Vertex); }
+
+	// loaded chunks turned into buffers per update, and chunks loaded at most at once
+	static const int sMaxCreatesPerUpdate = 4;
+	static const int sMaxPendingLoads = 16;
+
+private:
+	struct Vertex
+	{
+		glm::vec3 position;
+		GLuint normal;			// GL_INT_2_10_10_10_REV
+		GLubyte texCoord[2];	// sample within the chunk
+		GLubyte padding[2];
+	};
+
+	struct Chunk
+	{
+		GLBuffer vertices;
+		GLVertexArray vertexArray;
+		std::vector<float> errors;	// largest height difference to the full resolution at each level
+		bool pending = false;		// queued or loading
+	};
+
+	struct LoadedChunk
+	{
+		uint32_t chunk;
+		std::vector<Vertex> vertices;
+		std::vector<float> errors;
+		BoundingBox bounds;
+	};
+
+	// index range of a level of detail
+	struct Level
+	{
+		GLsizei count;
+		size_t offset;		// bytes
+	};
+
+	uint32_t mChunkSize;
+	float mSpacing;
+	float mHeightScale;
+	float mHeightOffset;
+	uint32_t mSize = 0;				// quads per side
+	uint32_t mChunksPerSide = 0;
+
+	std::vector<Chunk> mChunks;		// row by row
+	std::vector<BoundingBox> mBounds;
+	GLBuffer mIndices;				// all levels of detail
+	std::vector<Level> mLevels;
+
+	// loader thread
+	std::ifstream mFile;			// (only read by the loader)
+	std::thread mThread;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	std::deque<uint32_t> mQueue;		// chunks to load
+	std::deque<LoadedChunk> mLoaded;	// chunks read and waiting for buffers
+	bool mStop = false;
+
+	uint32_t mNumLoaded = 0;
+	uint32_t mNumPendingLoads = 0;
+	uint32_t mNumDrawn = 0;
+	uint32_t mNumTriangles = 0;
+
+	uint32_t getNumVertices() const { return (mChunkSize + 1) * (mChunkSize + 1) + 4 * (mChunkSize + 1); }
+	// bounds of a chunk before its heights are known
+	BoundingBox getUnloadedBounds(uint32_t chunk) const;
+	void createIndices();
+	void loaderThread();
+	// read a chunk's samples (and a ring around them for normals) and build its vertices
+	void loadChunk(LoadedChunk& chunk);
+	void unloadChunk(uint32_t chunk);
+};
+
+#endif
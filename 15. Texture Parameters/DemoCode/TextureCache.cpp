@@ -0,0 +1,338 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include "BlockCompression.h"
+#include "KTX2.h"
+
+// OpenGL format of a KTX2 format; returns whether the driver can sample it
+static bool get_compressed_format(uint32_t format, GLenum& internalFormat)
+{
+	switch (format)
+	{
+	case KTX2_BC1_RGB_UNORM:
+		internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		return GLEW_EXT_texture_compression_s3tc;
+	case KTX2_BC3_UNORM:
+		internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		return GLEW_EXT_texture_compression_s3tc;
+	case KTX2_BC7_UNORM:
+		internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+		return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+	case KTX2_ETC2_RGB8_UNORM:
+		internalFormat = GL_COMPRESSED_RGB8_ETC2;
+		return GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility;
+	case KTX2_ETC2_RGBA8_UNORM:
+		internalFormat = GL_COMPRESSED_RGBA8_ETC2_EAC;
+		return GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility;
+	default:
+		return false;
+	}
+}
+
+TextureCache::TextureCache(size_t memoryBudget) : mMemoryBudget(memoryBudget)
+{}
+
+TextureCache::~TextureCache()
+{
+	clear();
+}
+
+// texture of an image file (loaded on first use) with a reference added; 0 if it can't be loaded
+GLuint TextureCache::acquire(const std::string& path)
+{
+	// path seen before
+	auto knownPath = mPaths.find(path);
+	if (knownPath != mPaths.end())
+	{
+		mNumHits++;
+		return use(knownPath->second);
+	}
+
+	// read the file
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Unable to open " << path << std::endl;
+		return 0;
+	}
+	std::vector<unsigned char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	uint64_t hash = ImageLoader::hash(contents.data(), contents.size());
+
+	return add(path, hash, [&](Entry& entry)
+	{
+		return load(contents, entry);
+	});
+}
+
+// textures of several image files (as above), decoding the files not cached yet concurrently
+std::vector<GLuint> TextureCache::acquire(const std::vector<std::string>& paths)
+{
+	// start decoding each unknown path once
+	std::unordered_map<std::string, std::future<DecodedImage>> decodes;
+	for (const std::string& path : paths)
+	{
+		if (mPaths.find(path) == mPaths.end() && decodes.find(path) == decodes.end())
+			decodes.emplace(path, mLoader.load(path));
+	}
+
+	// create textures in order as the images arrive
+	std::vector<GLuint> textures;
+	for (const std::string& path : paths)
+	{
+		auto decode = decodes.find(path);
+		if (decode == decodes.end() || !decode->second.valid())
+		{
+			textures.push_back(acquire(path));	// cached (or added earlier in the list)
+			continue;
+		}
+
+		DecodedImage decoded = decode->second.get();
+		if (!decoded.valid)
+		{
+			textures.push_back(acquire(path));	// KTX2 files (and failures) are loaded on their own
+			continue;
+		}
+
+		textures.push_back(add(path, decoded.hash, [&](Entry& entry)
+		{
+			upload(decoded.image, entry);
+			return true;
+		}));
+	}
+	return textures;
+}
+
+// issue queued texture uploads within the per-frame budget (call once a frame)
+void TextureCache::update()
+{
+	mUploader.update(mUploadBudget);
+}
+
+// remove a reference added by acquire
+void TextureCache::release(GLuint texture)
+{
+	auto found = mTextures.find(texture);
+	if (found == mTextures.end() || found->second->references == 0)
+		return;
+
+	found->second->references--;
+	evict();
+}
+
+// bytes of texture memory to keep unreferenced textures within (evicts if exceeded)
+void TextureCache::setMemoryBudget(size_t bytes)
+{
+	mMemoryBudget = bytes;
+	evict();
+}
+
+// delete all textures (references become invalid)
+void TextureCache::clear()
+{
+	mUploader.release();
+	mPaths.clear();
+	mHashes.clear();
+	mTextures.clear();
+	mEntries.clear();	// textures are deleted by their wrappers
+	mMemoryUsed = 0;
+}
+
+// texture of new contents (or of the same contents under another path) with a reference added
+GLuint TextureCache::add(const std::string& path, uint64_t hash, const std::function<bool(Entry&)>& create)
+{
+	// same contents under another path
+	auto knownHash = mHashes.find(hash);
+	if (knownHash != mHashes.end())
+	{
+		mNumHits++;
+		knownHash->second->paths.push_back(path);
+		mPaths[path] = knownHash->second;
+		return use(knownHash->second);
+	}
+
+	// new image
+	mEntries.emplace_front();
+	EntryIterator entry = mEntries.begin();
+	if (!create(*entry))
+	{
+		std::cerr << "Unable to load image " << path << std::endl;
+		mEntries.erase(entry);
+		return 0;
+	}
+
+	entry->hash = hash;
+	entry->paths.push_back(path);
+	mPaths[path] = entry;
+	mHashes[hash] = entry;
+	mTextures[entry->texture.getID()] = entry;
+	mMemoryUsed += entry->bytes;
+	mNumDecodes++;
+
+	GLuint texture = use(entry);
+	evict();	// make room by deleting unreferenced textures
+	return texture;
+}
+
+// add a reference and mark as most recently used
+GLuint TextureCache::use(EntryIterator entry)
+{
+	entry->references++;
+	mEntries.splice(mEntries.begin(), mEntries, entry);
+	return entry->texture.getID();
+}
+
+// decode an image and create its texture
+bool TextureCache::load(const std::vector<unsigned char>& contents, Entry& entry)
+{
+	if (KTX2::isKTX2(contents.data(), contents.size()))
+		return loadCompressed(contents, entry);
+
+	DecodedImage decoded;
+	if (!mLoader.decode(contents.data(), contents.size(), decoded))
+		return false;
+
+	upload(decoded.image, entry);
+	return true;
+}
+
+// create a mipmapped texture from an RGBA8 image and queue its levels for upload (the pixels are moved)
+void TextureCache::upload(ImageRGBA& image, Entry& entry)
+{
+	GLsizei levels = GLTexture::getMaxLevels(image.width, image.height);
+	entry.texture.create2D(GL_RGBA8, image.width, image.height, levels);
+	entry.bytes = image.pixels.size();
+
+	std::vector<ImageRGBA> mipmaps;
+	std::function<void()> done;
+	if (mMipmapSource == MipmapSource::DRIVER)
+	{
+		// generated once level 0 has been issued (entries stay put in the list, and erase cancels pending uploads)
+		GLTexture* texture = &entry.texture;
+		done = [texture]() { texture->generateMipmap(); };
+		for (GLsizei level = 1; level < levels; level++)
+			entry.bytes += 4 * std::max(1, image.width >> level) * std::max(1, image.height >> level);
+	}
+	else
+	{
+		MipFilter filter = (mMipmapSource == MipmapSource::CPU_KAISER) ? MipFilter::KAISER : MipFilter::BOX;
+		mipmaps = MipmapGenerator::generate(image, filter);
+	}
+
+	GLuint id = entry.texture.getID();
+	mUploader.enqueue(id, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE, 4, std::move(image.pixels), done);
+	for (size_t level = 0; level < mipmaps.size(); level++)
+	{
+		entry.bytes += mipmaps[level].pixels.size();
+		mUploader.enqueue(id, static_cast<GLint>(level + 1), 0, 0, mipmaps[level].width, mipmaps[level].height,
+			GL_RGBA, GL_UNSIGNED_BYTE, 4, std::move(mipmaps[level].pixels));
+	}
+}
+
+// create a texture from the precomputed levels of a KTX2 file
+// (top to bottom BC1 and BC3 files are flipped to match the decoded images)
+bool TextureCache::loadCompressed(const std::vector<unsigned char>& contents, Entry& entry)
+{
+	KTX2Image image;
+	if (!KTX2::read(contents.data(), contents.size(), image))
+		return false;
+
+	const GLsizei width = static_cast<GLsizei>(image.width);
+	const GLsizei height = static_cast<GLsizei>(image.height);
+	const GLsizei levels = static_cast<GLsizei>(image.levels.size());
+	entry.bytes = 0;
+
+	// the levels must form (part of) a mipmap chain of whole blocks
+	if (width <= 0 || height <= 0 || levels > GLTexture::getMaxLevels(width, height))
+	{
+		std::cerr << "Invalid compressed texture size or level count" << std::endl;
+		return false;
+	}
+	const size_t blockSize = KTX2::getBlockSize(image.format);
+	for (GLsizei level = 0; level < levels; level++)
+	{
+		size_t blocksX = (std::max(1, width >> level) + 3) / 4;
+		size_t blocksY = (std::max(1, height >> level) + 3) / 4;
+		if (image.levels[level].size() != blocksX * blocksY * blockSize)
+		{
+			std::cerr << "Invalid compressed texture level " << level << std::endl;
+			return false;
+		}
+	}
+
+	// rows are uploaded bottom to top, as the decoded images are
+	if (!image.bottomUp)
+	{
+		bool flipped = image.format == KTX2_BC1_RGB_UNORM || image.format == KTX2_BC3_UNORM;
+		BlockFormat format = (image.format == KTX2_BC1_RGB_UNORM) ? BlockFormat::BC1 : BlockFormat::BC3;
+		for (GLsizei level = 0; level < levels && flipped; level++)
+			flipped = BlockCompression::flipVertically(image.levels[level].data(), format,
+				std::max(1, width >> level), std::max(1, height >> level));
+		if (!flipped)
+		{
+			std::cerr << "Top to bottom compressed texture (format " << image.format << ") can't be flipped" << std::endl;
+			return false;
+		}
+	}
+
+	GLenum internalFormat = 0;
+	if (get_compressed_format(image.format, internalFormat))
+	{
+		// upload the blocks as they are
+		entry.texture.create2D(internalFormat, width, height, levels);
+		for (GLsizei level = 0; level < levels; level++)
+		{
+			const std::vector<uint8_t>& data = image.levels[level];
+			entry.texture.setCompressedImage(level, static_cast<GLsizei>(data.size()), data.data());
+			entry.bytes += data.size();
+		}
+		return true;
+	}
+
+	// without driver support, BC1 and BC3 are decompressed to RGBA8
+	if (image.format != KTX2_BC1_RGB_UNORM && image.format != KTX2_BC3_UNORM)
+	{
+		std::cerr << "Compressed texture format " << image.format << " is not supported" << std::endl;
+		return false;
+	}
+
+	BlockFormat format = (image.format == KTX2_BC1_RGB_UNORM) ? BlockFormat::BC1 : BlockFormat::BC3;
+	entry.texture.create2D(GL_RGBA8, width, height, levels);
+	for (GLsizei level = 0; level < levels; level++)
+	{
+		GLsizei levelWidth = std::max(1, width >> level);
+		GLsizei levelHeight = std::max(1, height >> level);
+		ImageRGBA pixels = BlockCompression::decompress(image.levels[level].data(), format, levelWidth, levelHeight);
+		entry.texture.setImage(level, GL_RGBA, GL_UNSIGNED_BYTE, pixels.pixels.data());
+		entry.bytes += pixels.pixels.size();
+	}
+	return true;
+}
+
+// delete least recently used unreferenced textures until within the budget
+void TextureCache::evict()
+{
+	auto entry = mEntries.end();
+	while (mMemoryUsed > mMemoryBudget && entry != mEntries.begin())
+	{
+		--entry;
+		if (entry->references == 0)
+		{
+			EntryIterator unused = entry++;
+			erase(unused);
+		}
+	}
+}
+
+void TextureCache::erase(EntryIterator entry)
+{
+	for (const std::string& path : entry->paths)
+		mPaths.erase(path);
+	mHashes.erase(entry->hash);
+	mTextures.erase(entry->texture.getID());
+	mUploader.cancel(entry->texture.getID());
+	mMemoryUsed -= entry->bytes;
+	mEntries.erase(entry);
+}
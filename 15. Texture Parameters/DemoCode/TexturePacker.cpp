@@ -0,0 +1,163 @@
+#include "TexturePacker.h"
+
+#include <algorithm>
+#include <cstring>
+
+// round up to a multiple of a power of two
+static GLsizei align(GLsizei value, GLsizei alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// size of atlas layers and of the gutter around images in them (a power of two)
+TexturePacker::TexturePacker(GLsizei atlasSize, GLsizei padding) :
+	mAtlasSize(atlasSize), mPadding(std::max(1, padding))
+{}
+
+// add an image to be packed; returns its index
+uint32_t TexturePacker::add(ImageRGBA image)
+{
+	mImages.resize(mPacked.size());
+	mImages.push_back(std::move(image));
+	mPacked.emplace_back();
+	return static_cast<uint32_t>(mPacked.size() - 1);
+}
+
+// pack the images added so far into textures (the pixels are released)
+void TexturePacker::build()
+{
+	// group by size (images added after a previous build only)
+	std::map<std::pair<GLsizei, GLsizei>, std::vector<uint32_t>> sizes;
+	for (uint32_t i = 0; i < mImages.size(); i++)
+	{
+		if (!mImages[i].pixels.empty())
+			sizes[{ mImages[i].width, mImages[i].height }].push_back(i);
+	}
+
+	// shared sizes (and images too big for the atlas) get arrays, the rest go to the atlas
+	std::vector<uint32_t> atlasImages;
+	for (const auto& size : sizes)
+	{
+		bool fits = size.first.first + 2 * mPadding <= mAtlasSize && size.first.second + 2 * mPadding <= mAtlasSize;
+		if (size.second.size() > 1 || !fits)
+			buildArray(size.second);
+		else
+			atlasImages.push_back(size.second[0]);
+	}
+	if (!atlasImages.empty())
+		buildAtlas(atlasImages);
+
+	mImages.clear();
+}
+
+// delete the textures and forget all images
+void TexturePacker::clear()
+{
+	mImages.clear();
+	mPacked.clear();
+	mTextures.clear();	// textures are deleted by their wrappers
+	mNumAtlasLayers = 0;
+}
+
+void TexturePacker::buildArray(const std::vector<uint32_t>& images)
+{
+	const GLsizei width = mImages[images[0]].width;
+	const GLsizei height = mImages[images[0]].height;
+
+	GLTexture texture;
+	texture.create2DArray(GL_RGBA8, width, height, static_cast<GLsizei>(images.size()), GLTexture::getMaxLevels(width, height));
+	for (GLuint layer = 0; layer < images.size(); layer++)
+	{
+		texture.setSubImage(0, 0, 0, layer, width, height, GL_RGBA, GL_UNSIGNED_BYTE, mImages[images[layer]].pixels.data());
+
+		PackedImage& packed = mPacked[images[layer]];
+		packed.texture = texture.getID();
+		packed.layer = layer;
+	}
+	texture.generateMipmap();
+	mTextures.push_back(std::move(texture));
+}
+
+void TexturePacker::buildAtlas(std::vector<uint32_t> images)
+{
+	// tallest first, so shelves waste little height
+	std::sort(images.begin(), images.end(), [this](uint32_t a, uint32_t b)
+	{
+		return mImages[a].height > mImages[b].height;
+	});
+
+	// shelf positions; padded sizes are kept multiples of the padding, so texels of
+	// different images don't meet in a 2x2 footprint until the padding is used up
+	struct Placement { GLsizei layer, x, y; };
+	std::vector<Placement> placements;
+	GLsizei layer = 0, x = 0, y = 0, shelfHeight = 0;
+	for (uint32_t image : images)
+	{
+		GLsizei width = align(mImages[image].width + 2 * mPadding, mPadding);
+		GLsizei height = align(mImages[image].height + 2 * mPadding, mPadding);
+		if (x + width > mAtlasSize)
+		{
+			// next shelf
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+		if (y + height > mAtlasSize)
+		{
+			// next layer
+			layer++;
+			x = y = 0;
+			shelfHeight = 0;
+		}
+		placements.push_back({ layer, x, y });
+		x += width;
+		shelfHeight = std::max(shelfHeight, height);
+	}
+	const GLsizei numLayers = layer + 1;
+
+	// a mipmap level per halving of the gutter
+	GLsizei levels = 1;
+	while ((mPadding >> levels) > 0)
+		levels++;
+
+	GLTexture texture;
+	texture.create2DArray(GL_RGBA8, mAtlasSize, mAtlasSize, numLayers, levels);
+
+	std::vector<uint8_t> pixels(static_cast<size_t>(mAtlasSize) * mAtlasSize * 4);
+	for (layer = 0; layer < numLayers; layer++)
+	{
+		std::fill(pixels.begin(), pixels.end(), 0);
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			if (placements[i].layer != layer)
+				continue;
+
+			// copy the image with its edges clamped into the gutter
+			const ImageRGBA& image = mImages[images[i]];
+			for (GLsizei row = -mPadding; row < image.height + mPadding; row++)
+			{
+				GLsizei sourceRow = std::min(std::max(row, 0), image.height - 1);
+				uint8_t* out = &pixels[(static_cast<size_t>(placements[i].y + mPadding + row) * mAtlasSize + placements[i].x) * 4];
+				const uint8_t* in = &image.pixels[static_cast<size_t>(sourceRow) * image.width * 4];
+				for (GLsizei column = 0; column < mPadding; column++)
+				{
+					std::memcpy(out + column * 4, in, 4);
+					std::memcpy(out + (mPadding + image.width + column) * 4, in + (image.width - 1) * 4, 4);
+				}
+				std::memcpy(out + mPadding * 4, in, static_cast<size_t>(image.width) * 4);
+			}
+
+			PackedImage& packed = mPacked[images[i]];
+			packed.texture = texture.getID();
+			packed.layer = layer;
+			packed.uvTransform = glm::vec4(image.width, image.height, placements[i].x + mPadding, placements[i].y + mPadding) /
+				static_cast<float>(mAtlasSize);
+			packed.inAtlas = true;
+		}
+		texture.setSubImage(0, 0, 0, layer, mAtlasSize, mAtlasSize, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	}
+	texture.generateMipmap();
+
+	mNumAtlasLayers += numLayers;
+	mTextures.push_back(std::move(texture));
+}
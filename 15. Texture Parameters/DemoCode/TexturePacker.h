@@ -0,0 +1,62 @@
+#ifndef TEXTURE_PACKER_H
+#define TEXTURE_PACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "utilities.h"
+#include "GLResources.h"
+#include "ImageRGBA.h"
+
+// where a packed image ended up
+struct PackedImage
+{
+	GLuint texture = 0;		// 2D array texture
+	GLuint layer = 0;
+	glm::vec4 uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);	// texture coordinate scale (xy) and offset (zw)
+	bool inAtlas = false;	// shares its layer, so texture coordinates can't wrap
+};
+
+/*****************************************************************
+ * packing of many small RGBA8 images into few array textures
+ * images of the same size (at least two of them) become the layers
+ * of a 2D array texture; the remaining odd sizes are packed into
+ * the layers of an atlas array, in shelves, with each image's
+ * edges repeated into a gutter around it so filtering and the
+ * atlas' few mipmap levels don't bleed between neighbours
+ * objects then select their image with a layer index and a
+ * texture coordinate transform, so objects with different images
+ * can be drawn without binding another texture and batched
+ *****************************************************************/
+class TexturePacker
+{
+public:
+	// size of atlas layers and of the gutter around images in them (a power of two)
+	TexturePacker(GLsizei atlasSize = 1024, GLsizei padding = 4);
+
+	// add an image to be packed; returns its index
+	uint32_t add(ImageRGBA image);
+	// pack the images added so far into textures (the pixels are released)
+	void build();
+	// delete the textures and forget all images
+	void clear();
+
+	const PackedImage& get(uint32_t index) const { return mPacked[index]; }
+	size_t getNumImages() const { return mPacked.size(); }
+	size_t getNumTextures() const { return mTextures.size(); }
+	GLsizei getNumAtlasLayers() const { return mNumAtlasLayers; }
+
+private:
+	GLsizei mAtlasSize;
+	GLsizei mPadding;
+	GLsizei mNumAtlasLayers = 0;
+	std::vector<ImageRGBA> mImages;		// pixels until built
+	std::vector<PackedImage> mPacked;
+	std::vector<GLTexture> mTextures;
+
+	void buildArray(const std::vector<uint32_t>& images);
+	void buildAtlas(std::vector<uint32_t> images);
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef TEXTURE_UPLOADER_H
+#define TEXTURE_UPLOADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "GLResources.h"
+
+/*****************************************************************
+ * asynchronous texture uploads through pixel unpack buffers
+ * queued pixels are copied, a band of rows at a time, into a ring
+ * of staging buffers, and glTexSubImage2D reads them from the
+ * buffer, so the driver can return at once and transfer the data
+ * later instead of copying it from client memory in the call
+ * each staging buffer is fenced after use and only refilled once
+ * the GPU has finished with it; update() skips buffers that are
+ * still in use and issues at most a given number of bytes, so a
+ * large texture is spread over several frames rather than adding
+ * one long stall (textures show their previous contents until
+ * their rows arrive)
+ * only 2D textures with storage already allocated are supported;
+ * rows of queued pixels are tightly packed
+ *****************************************************************/
+class TextureUploader
+{
+public:
+	TextureUploader(size_t bufferSize = 4 * 1024 * 1024, int numBuffers = 3);
+	~TextureUploader();
+	TextureUploader(const TextureUploader&) = delete;
+	TextureUploader& operator=(const TextureUploader&) = delete;
+
+	// queue pixels for a region of a texture level; done is called once all rows have been issued
+	void enqueue(GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+		GLenum format, GLenum type, GLsizei bytesPerPixel, std::vector<uint8_t> pixels,
+		std::function<void()> done = nullptr);
+	// issue queued rows into free staging buffers, up to a number of bytes (0 = no limit); returns bytes issued
+	size_t update(size_t maxBytes);
+	// issue everything queued (waiting for staging buffers as needed)
+	void flush();
+	// drop queued uploads to a texture (e.g. before deleting it)
+	void cancel(GLuint texture);
+	// drop queued uploads and delete the staging buffers
+	void release();
+
+	size_t getNumPending() const { return mUploads.size(); }
+	size_t getPendingBytes() const;
+	uint32_t getNumStalls() const { return mNumStalls; }		// waits for the GPU in flush
+
+private:
+	struct Upload
+	{
+		GLuint texture;
+		GLint level, x, y;
+		GLsizei width, height;
+		GLenum format, type;
+		size_t rowBytes;
+		std::vector<uint8_t> pixels;
+		GLsizei rowsIssued;
+		std::function<void()> done;
+	};
+
+	struct Staging
+	{
+		GLBuffer buffer;
+		GLsync fence = nullptr;		// signalled once the GPU has read the buffer
+	};
+
+	std::deque<Upload> mUploads;
+	std::vector<Staging> mStaging;
+	size_t mBufferSize;
+	int mNumBuffers;
+	size_t mNextBuffer = 0;
+	uint32_t mNumStalls = 0;
+
+	size_t issue(size_t maxBytes, bool wait);
+	// whether a staging buffer's previous upload has completed
+	bool isFree(Staging& staging, bool wait);
+	// copy rows into a texture from client memory or (with pixels an offset) the bound unpack buffer
+	static void texSubImage(const Upload& upload, GLsizei numRows, const void* pixels);
+};
+
+#endif
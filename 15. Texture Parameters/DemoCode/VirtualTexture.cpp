@@ -0,0 +1,461 @@
+#include "VirtualTexture.h"
+#include "GLStateCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// bytes of the physical cache, pages loaded at most at once and bytes uploaded per update
+VirtualTexture::VirtualTexture(size_t cacheBudget, uint32_t maxPendingLoads, size_t uploadBudget) :
+	mCacheBudget(cacheBudget), mUploader(uploadBudget), mUploadBudget(uploadBudget), mMaxPendingLoads(std::max(1u, maxPendingLoads))
+{}
+
+VirtualTexture::~VirtualTexture()
+{
+	release();
+}
+
+// open a tiled file and create the textures and feedback buffer for a framebuffer size
+bool VirtualTexture::init(const std::string& path, int width, int height)
+{
+	release();
+	if (!mFile.open(path))
+	{
+		std::cerr << "Failed to open virtual texture " << path << std::endl;
+		return false;
+	}
+
+	// (page coordinates are fed back as bytes)
+	const VirtualTextureLayout& layout = mFile.getLayout();
+	if (layout.getPagesX(0) > 256 || layout.getPagesY(0) > 256)
+	{
+		std::cerr << "Virtual texture " << path << " has more than 256 pages per row" << std::endl;
+		return false;
+	}
+
+	for (uint32_t level = 0; level < layout.numLevels; level++)
+	{
+		for (uint32_t y = 0; y < layout.getPagesY(level); y++)
+		{
+			for (uint32_t x = 0; x < layout.getPagesX(level); x++)
+			{
+				Page page;
+				page.level = level;
+				page.x = x;
+				page.y = y;
+				mPages.push_back(page);
+			}
+		}
+	}
+
+	// as many slots as fit the budget (but at least room for the coarsest level and a few more)
+	const uint32_t coarsest = layout.numLevels - 1;
+	const uint32_t numCoarsest = layout.getPagesX(coarsest) * layout.getPagesY(coarsest);
+	const GLsizei tileSize = layout.getTileSize();
+	mSlotsPerRow = static_cast<uint32_t>(std::sqrt(static_cast<double>(mCacheBudget / layout.getTileBytes())));
+	mSlotsPerRow = std::min(std::max(mSlotsPerRow, static_cast<uint32_t>(std::ceil(std::sqrt(numCoarsest))) + 1), 256u);
+	mCacheSize = mSlotsPerRow * tileSize;
+	mSlots.assign(mSlotsPerRow * mSlotsPerRow, Slot());
+
+	// physical cache, filtered within pages (the borders cover the filter footprint)
+	mCache.create2D(GL_RGBA8, mCacheSize, mCacheSize, 1);
+	mCache.setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	mCache.setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	mCache.setParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	mCache.setParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// page table (read with texelFetch)
+	mPageTable.create2D(GL_RGBA8, layout.getPagesX(0), layout.getPagesY(0), layout.numLevels);
+	mPageTable.setParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	mPageTable.setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	mTable.resize(layout.numLevels);
+	for (uint32_t level = 0; level < layout.numLevels; level++)
+		mTable[level].assign(static_cast<size_t>(layout.getPagesX(level)) * layout.getPagesY(level) * 4, 0);
+
+	// the coarsest level is loaded now and pinned, so every lookup finds some page
+	std::vector<uint8_t> pixels;
+	for (uint32_t i = 0; i < numCoarsest; i++)
+	{
+		uint32_t pageIndex = layout.getPageIndex(coarsest, 0, 0) + i;
+		Page& page = mPages[pageIndex];
+		if (!mFile.readTile(page.level, page.x, page.y, pixels))
+		{
+			std::cerr << "Failed to read virtual texture " << path << std::endl;
+			release();
+			return false;
+		}
+		mCache.setSubImage(0, (i % mSlotsPerRow) * tileSize, (i / mSlotsPerRow) * tileSize, 0, tileSize, tileSize,
+			GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		page.slot = static_cast<int32_t>(i);
+		mSlots[i].page = static_cast<int32_t>(pageIndex);
+		mSlots[i].pinned = true;
+	}
+	mNumResident = numCoarsest;
+	updatePageTable();
+
+	// feedback framebuffer
+	mWidth = width;
+	mHeight = height;
+	mFeedbackWidth = std::max(1, width / sFeedbackScale);
+	mFeedbackHeight = std::max(1, height / sFeedbackScale);
+
+	glGenRenderbuffers(1, &mFeedbackBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, mFeedbackBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8UI, mFeedbackWidth, mFeedbackHeight);
+	glGenRenderbuffers(1, &mDepthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, mDepthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mFeedbackWidth, mFeedbackHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &mFBO);
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mFeedbackBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "Virtual texture feedback framebuffer incomplete" << std::endl;
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for (GLBuffer& buffer : mReadBuffers)
+		buffer.create(static_cast<GLsizeiptr>(mFeedbackWidth) * mFeedbackHeight * 4, nullptr, GL_MAP_READ_BIT);
+
+	// start loading
+	mStop = false;
+	mThread = std::thread(&VirtualTexture::loaderThread, this);
+	return true;
+}
+
+// stop loading and delete the GL objects
+void VirtualTexture::release()
+{
+	if (mThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mStop = true;
+		}
+		mCondition.notify_all();
+		mThread.join();
+	}
+	mQueue.clear();
+	mLoaded.clear();
+
+	for (GLsync& fence : mFences)
+	{
+		if (fence != 0)
+			glDeleteSync(fence);
+		fence = 0;
+	}
+	for (GLBuffer& buffer : mReadBuffers)
+		buffer.release();
+	if (mFBO != 0)
+	{
+		glDeleteFramebuffers(1, &mFBO);
+		GLStateCache::onDeleteFramebuffer(mFBO);
+		mFBO = 0;
+	}
+	for (GLuint* renderbuffer : { &mFeedbackBuffer, &mDepthBuffer })
+	{
+		if (*renderbuffer != 0)
+			glDeleteRenderbuffers(1, renderbuffer);
+		*renderbuffer = 0;
+	}
+
+	mUploader.release();
+	mCache.release();
+	mPageTable.release();
+	mPages.clear();
+	mSlots.clear();
+	mTable.clear();
+	mTableChanged = false;
+	mNumResident = mNumPendingLoads = mNumVisible = 0;
+}
+
+// bind the feedback framebuffer (draw with the feedback shader and setUniforms)
+void VirtualTexture::beginFeedback()
+{
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	GLStateCache::viewport(0, 0, mFeedbackWidth, mFeedbackHeight);
+	GLStateCache::depthMask(GL_TRUE);
+
+	// alpha 0 where nothing virtually textured is drawn
+	const GLuint none[4] = { 0, 0, 0, 0 };
+	const GLfloat depth = 1.0f;
+	glClearBufferuiv(GL_COLOR, 0, none);
+	glClearBufferfv(GL_DEPTH, 0, &depth);
+}
+
+// start reading back the page requests
+void VirtualTexture::endFeedback()
+{
+	int slot = static_cast<int>(mFrame++ % 2);
+
+	// drop a readback that is still in flight after two frames
+	if (mFences[slot] != 0)
+	{
+		glDeleteSync(mFences[slot]);
+		mFences[slot] = 0;
+	}
+
+	GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, mReadBuffers[slot].getID());
+	glReadPixels(0, 0, mFeedbackWidth, mFeedbackHeight, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+	GLStateCache::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	mFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	// back to drawing the scene
+	GLStateCache::bindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLStateCache::viewport(0, 0, mWidth, mHeight);
+}
+
+// take in read back requests and loaded pages, upload them and update the page table
+void VirtualTexture::update()
+{
+	if (!isValid())
+		return;
+
+	// completed readbacks (older slot first)
+	for (int i : { static_cast<int>(mFrame % 2), static_cast<int>((mFrame + 1) % 2) })
+	{
+		if (mFences[i] == 0)
+			continue;
+
+		GLenum status = glClientWaitSync(mFences[i], 0, 0);
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			readFeedback(i);
+			glDeleteSync(mFences[i]);
+			mFences[i] = 0;
+		}
+	}
+
+	// place the pages read since the last update
+	std::vector<LoadedTile> loaded;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		loaded.swap(mLoaded);
+	}
+	for (LoadedTile& tile : loaded)
+	{
+		if (tile.pixels.empty())
+		{
+			// (left pending, so it isn't requested again)
+			std::cerr << "Failed to read virtual texture page " << tile.page << std::endl;
+			mNumPendingLoads--;
+		}
+		else if (!place(tile))
+		{
+			// every slot is in view; requested again by a later feedback
+			mPages[tile.page].pending = false;
+			mNumPendingLoads--;
+		}
+	}
+
+	// stream the pages in (marking them resident as they are issued)
+	mUploader.update(mUploadBudget);
+	if (mTableChanged)
+		updatePageTable();
+}
+
+// bind the page table and cache to texture units and set the uniforms of a program in use
+void VirtualTexture::setUniforms(ShaderProgram& shader, GLuint pageTableUnit, GLuint cacheUnit)
+{
+	const VirtualTextureLayout& layout = getLayout();
+
+	// (sampled with their own parameters)
+	GLStateCache::bindTexture(pageTableUnit, GL_TEXTURE_2D, mPageTable.getID());
+	GLStateCache::bindSampler(pageTableUnit, 0);
+	GLStateCache::bindTexture(cacheUnit, GL_TEXTURE_2D, mCache.getID());
+	GLStateCache::bindSampler(cacheUnit, 0);
+
+	shader.setUniform("uPageTable", static_cast<int>(pageTableUnit));
+	shader.setUniform("uPageCache", static_cast<int>(cacheUnit));
+	shader.setUniform("uVirtualSize", glm::vec2(layout.width, layout.height));
+	shader.setUniform("uPageSize", static_cast<float>(layout.pageSize));
+	shader.setUniform("uPageBorder", static_cast<float>(layout.border));
+	shader.setUniform("uCacheSize", static_cast<float>(mCacheSize));
+	shader.setUniform("uMaxLevel", static_cast<int>(layout.numLevels - 1));
+}
+
+void VirtualTexture::loaderThread()
+{
+	for (;;)
+	{
+		LoadedTile tile;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this] { return mStop || !mQueue.empty(); });
+			if (mStop)
+				return;
+			tile.page = mQueue.front();
+			mQueue.pop_front();
+		}
+
+		// (a page's position never changes once created)
+		const Page& page = mPages[tile.page];
+		if (!mFile.readTile(page.level, page.x, page.y, tile.pixels))
+			tile.pixels.clear();
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mLoaded.push_back(std::move(tile));
+	}
+}
+
+// mark the pages seen in a read back feedback buffer as used and request the missing ones
+void VirtualTexture::readFeedback(int slot)
+{
+	const uint8_t* texels = static_cast<const uint8_t*>(mReadBuffers[slot].map(0, mReadBuffers[slot].getSize(), GL_MAP_READ_BIT));
+	if (texels == nullptr)
+		return;
+
+	const VirtualTextureLayout& layout = getLayout();
+	mFeedbackCount++;
+	mNumVisible = 0;
+
+	// each page seen and its coarser ancestors (which stand in for it until it arrives)
+	std::vector<uint32_t> requests;
+	for (size_t i = 0; i < static_cast<size_t>(mFeedbackWidth) * mFeedbackHeight; i++)
+	{
+		const uint8_t* texel = texels + i * 4;
+		if (texel[3] != 255 || texel[2] >= layout.numLevels || texel[0] >= layout.getPagesX(texel[2]) ||
+			texel[1] >= layout.getPagesY(texel[2]))
+			continue;
+
+		uint32_t pageIndex = layout.getPageIndex(texel[2], texel[0], texel[1]);
+		for (;;)
+		{
+			Page& page = mPages[pageIndex];
+			if (page.lastUsed == mFeedbackCount)
+				break;	// (and so were its ancestors)
+
+			page.lastUsed = mFeedbackCount;
+			mNumVisible++;
+			if (page.slot < 0 && !page.pending)
+				requests.push_back(pageIndex);
+			if (page.level + 1 >= layout.numLevels)
+				break;
+			pageIndex = getParent(pageIndex);
+		}
+	}
+	mReadBuffers[slot].unmap();
+
+	// coarse levels first, so a close fallback arrives before the detail
+	std::stable_sort(requests.begin(), requests.end(), [this](uint32_t a, uint32_t b)
+	{
+		return mPages[a].level > mPages[b].level;
+	});
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		// forget queued pages that went out of view
+		mQueue.erase(std::remove_if(mQueue.begin(), mQueue.end(), [this](uint32_t pageIndex)
+		{
+			Page& page = mPages[pageIndex];
+			if (page.lastUsed == mFeedbackCount)
+				return false;
+			page.pending = false;
+			mNumPendingLoads--;
+			return true;
+		}), mQueue.end());
+
+		for (uint32_t pageIndex : requests)
+		{
+			if (mNumPendingLoads >= mMaxPendingLoads)
+				break;
+			mPages[pageIndex].pending = true;
+			mNumPendingLoads++;
+			mQueue.push_back(pageIndex);
+		}
+	}
+	mCondition.notify_one();
+}
+
+// put a loaded page into a free or least recently used slot; false if every slot is in use
+bool VirtualTexture::place(LoadedTile& tile)
+{
+	// a free slot, or else the resident page least recently seen (and not in the last feedback)
+	int32_t best = -1;
+	uint64_t bestLastUsed = mFeedbackCount;
+	for (int32_t i = 0; i < static_cast<int32_t>(mSlots.size()); i++)
+	{
+		const Slot& slot = mSlots[i];
+		if (slot.page < 0)
+		{
+			best = i;
+			break;
+		}
+
+		// (pages still uploading aren't resident yet)
+		const Page& page = mPages[slot.page];
+		if (!slot.pinned && page.slot == i && page.lastUsed < bestLastUsed)
+		{
+			best = i;
+			bestLastUsed = page.lastUsed;
+		}
+	}
+	if (best < 0)
+		return false;
+
+	// evict (the page table is updated before the slot is overwritten)
+	Slot& slot = mSlots[best];
+	if (slot.page >= 0)
+	{
+		mPages[slot.page].slot = -1;
+		mNumResident--;
+		mTableChanged = true;
+	}
+	slot.page = static_cast<int32_t>(tile.page);
+
+	const GLsizei tileSize = getLayout().getTileSize();
+	const uint32_t pageIndex = tile.page;
+	mUploader.enqueue(mCache.getID(), 0, (best % mSlotsPerRow) * tileSize, (best / mSlotsPerRow) * tileSize, tileSize, tileSize,
+		GL_RGBA, GL_UNSIGNED_BYTE, 4, std::move(tile.pixels), [this, pageIndex, best]()
+	{
+		Page& page = mPages[pageIndex];
+		page.slot = best;
+		page.pending = false;
+		mNumResident++;
+		mNumPendingLoads--;
+		mTableChanged = true;
+	});
+	return true;
+}
+
+// rebuild and upload the page table (pages without a resident copy point to their nearest resident ancestor)
+void VirtualTexture::updatePageTable()
+{
+	const VirtualTextureLayout& layout = getLayout();
+	for (int level = static_cast<int>(layout.numLevels) - 1; level >= 0; level--)
+	{
+		const uint32_t pagesX = layout.getPagesX(level);
+		const uint32_t firstPage = layout.getPageIndex(level, 0, 0);
+		std::vector<uint8_t>& table = mTable[level];
+		for (uint32_t y = 0; y < layout.getPagesY(level); y++)
+		{
+			for (uint32_t x = 0; x < pagesX; x++)
+			{
+				uint8_t* texel = &table[(static_cast<size_t>(y) * pagesX + x) * 4];
+				const Page& page = mPages[firstPage + y * pagesX + x];
+				if (page.slot >= 0)
+				{
+					texel[0] = static_cast<uint8_t>(page.slot % mSlotsPerRow);
+					texel[1] = static_cast<uint8_t>(page.slot / mSlotsPerRow);
+					texel[2] = static_cast<uint8_t>(level);
+					texel[3] = 255;
+				}
+				else if (level + 1 < static_cast<int>(layout.numLevels))
+				{
+					std::memcpy(texel, &mTable[level + 1][((y / 2) * static_cast<size_t>(layout.getPagesX(level + 1)) + x / 2) * 4], 4);
+				}
+			}
+		}
+		mPageTable.setImage(level, GL_RGBA, GL_UNSIGNED_BYTE, table.data());
+	}
+	mTableChanged = false;
+}
+
+uint32_t VirtualTexture::getParent(uint32_t pageIndex) const
+{
+	const Page& page = mPages[pageIndex];
+	return getLayout().getPageIndex(page.level + 1, page.x / 2, page.y / 2);
+}
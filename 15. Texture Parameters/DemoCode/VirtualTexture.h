@@ -0,0 +1,137 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utilities.h"
+#include "GLResources.h"
+#include "TextureUploader.h"
+#include "VirtualTextureFile.h"
+
+/*****************************************************************
+ * virtual texturing
+ * only the pages of a tiled texture file (see VirtualTextureFile)
+ * that are actually visible are kept in memory, in the slots of a
+ * fixed size physical cache texture; a page table texture (one
+ * texel per page and level) tells the fragment shader which slot
+ * holds the page it needs, or the coarser page standing in for it
+ * visible pages are found by a feedback pass drawing page ids into
+ * a small integer framebuffer, read back a frame later; missing
+ * pages are read from the file on a loader thread (coarse levels
+ * first) and streamed into free or least recently used slots,
+ * while the coarsest level stays resident as the last fallback
+ * the shaders are virtualTexture.frag and virtualTextureFeedback.frag
+ *****************************************************************/
+class VirtualTexture
+{
+public:
+	// bytes of the physical cache, pages loaded at most at once and bytes uploaded per update
+	VirtualTexture(size_t cacheBudget = 16 * 1024 * 1024, uint32_t maxPendingLoads = 32, size_t uploadBudget = 1024 * 1024);
+	~VirtualTexture();
+	VirtualTexture(const VirtualTexture&) = delete;
+	VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+	// open a tiled file and create the textures and feedback buffer for a framebuffer size
+	bool init(const std::string& path, int width, int height);
+	// stop loading and delete the GL objects
+	void release();
+
+	// bind the feedback framebuffer (draw with the feedback shader and setUniforms)
+	void beginFeedback();
+	// start reading back the page requests (leaves the default framebuffer bound with a full viewport)
+	void endFeedback();
+	// take in read back requests and loaded pages, upload them and update the page table
+	void update();
+
+	// bind the page table and cache to texture units and set the uniforms of a program in use
+	void setUniforms(ShaderProgram& shader, GLuint pageTableUnit, GLuint cacheUnit);
+
+	bool isValid() const { return mPageTable.getID() != 0; }
+	const VirtualTextureLayout& getLayout() const { return mFile.getLayout(); }
+	uint32_t getNumSlots() const { return static_cast<uint32_t>(mSlots.size()); }
+	uint32_t getNumResident() const { return mNumResident; }
+	uint32_t getNumPendingLoads() const { return mNumPendingLoads; }
+	uint32_t getNumVisible() const { return mNumVisible; }		// pages (and fallbacks) seen in the last feedback
+	size_t getCacheBytes() const { return static_cast<size_t>(mCacheSize) * mCacheSize * 4; }
+
+	// the feedback framebuffer is this many times smaller than the screen on each axis
+	static const int sFeedbackScale = 8;
+
+private:
+	struct Page
+	{
+		uint32_t level, x, y;
+		int32_t slot = -1;			// cache slot if resident
+		bool pending = false;		// queued, loading or uploading
+		uint64_t lastUsed = 0;		// last feedback that saw it (or a finer page it stands in for)
+	};
+
+	struct Slot
+	{
+		int32_t page = -1;
+		bool pinned = false;		// coarsest level pages are never evicted
+	};
+
+	struct LoadedTile
+	{
+		uint32_t page;
+		std::vector<uint8_t> pixels;
+	};
+
+	VirtualTextureFile mFile;
+	std::vector<Page> mPages;			// indexed by the file's page index
+	std::vector<Slot> mSlots;			// row by row in the cache texture
+
+	// physical cache and page table (texel = slot x, slot y, resident level, 255 if any)
+	GLTexture mCache;
+	GLTexture mPageTable;
+	std::vector<std::vector<uint8_t>> mTable;	// CPU copy of each page table level
+	bool mTableChanged = false;
+	GLsizei mCacheSize = 0;				// texels per side
+	uint32_t mSlotsPerRow = 0;
+	size_t mCacheBudget;
+	TextureUploader mUploader;
+	size_t mUploadBudget;
+
+	// feedback framebuffer and its readback (alternating frames)
+	GLuint mFBO = 0;
+	GLuint mFeedbackBuffer = 0;			// RGBA8UI: page x, page y, level, 255 where drawn
+	GLuint mDepthBuffer = 0;
+	GLBuffer mReadBuffers[2];
+	GLsync mFences[2] = {};
+	int mWidth = 0, mHeight = 0;		// screen size
+	int mFeedbackWidth = 0, mFeedbackHeight = 0;
+	uint64_t mFrame = 0;
+	uint64_t mFeedbackCount = 0;		// feedback buffers read so far
+
+	// loader thread
+	std::thread mThread;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	std::deque<uint32_t> mQueue;		// pages to load, in request order
+	std::vector<LoadedTile> mLoaded;	// pages read and waiting to be uploaded
+	bool mStop = false;
+	uint32_t mMaxPendingLoads;
+
+	uint32_t mNumResident = 0;
+	uint32_t mNumPendingLoads = 0;
+	uint32_t mNumVisible = 0;
+
+	void loaderThread();
+	// mark the pages seen in a read back feedback buffer as used and request the missing ones
+	void readFeedback(int slot);
+	// put a loaded page into a free or least recently used slot; false if every slot is in use
+	bool place(LoadedTile& tile);
+	// rebuild and upload the page table (pages without a resident copy point to their nearest resident ancestor)
+	void updatePageTable();
+	uint32_t getParent(uint32_t page) const;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "VirtualTextureFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "MipmapGenerator.h"
+
+// file identifier and header size (identifier, then width, height, page size, border and levels)
+static const char gIdentifier[4] = { 'V', 'T', 'E', 'X' };
+const size_t gHeaderSize = 4 + 5 * 4;
+
+static bool is_power_of_two(uint32_t value)
+{
+	return value != 0 && (value & (value - 1)) == 0;
+}
+
+// index of a page among the pages of all levels (finest level first)
+uint32_t VirtualTextureLayout::getPageIndex(uint32_t level, uint32_t x, uint32_t y) const
+{
+	uint32_t index = 0;
+	for (uint32_t finer = 0; finer < level; finer++)
+		index += getPagesX(finer) * getPagesY(finer);
+	return index + y * getPagesX(level) + x;
+}
+
+// write an image (level 0) and its box filtered mipmaps
+bool VirtualTextureFile::write(const std::string& path, const ImageRGBA& image, uint32_t pageSize, uint32_t border)
+{
+	VirtualTextureLayout layout;
+	layout.width = image.width;
+	layout.height = image.height;
+	layout.pageSize = pageSize;
+	layout.border = border;
+	if (!is_power_of_two(layout.width) || !is_power_of_two(layout.height) || !is_power_of_two(pageSize) ||
+		layout.width < pageSize || layout.height < pageSize)
+	{
+		std::cerr << "Virtual texture sizes must be powers of two of at least a page" << std::endl;
+		return false;
+	}
+	while ((std::min(layout.width, layout.height) >> layout.numLevels) >= pageSize)
+		layout.numLevels++;
+
+	std::ofstream file(path, std::ios::out | std::ios::binary);
+	if (!file)
+		return false;
+
+	uint32_t header[5] = { layout.width, layout.height, layout.pageSize, layout.border, layout.numLevels };
+	file.write(gIdentifier, sizeof(gIdentifier));
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));	// (little endian hosts)
+
+	std::vector<ImageRGBA> mipmaps = MipmapGenerator::generate(image, MipFilter::BOX);
+	const uint32_t tileSize = layout.getTileSize();
+	std::vector<uint8_t> tile(layout.getTileBytes());
+	for (uint32_t level = 0; level < layout.numLevels; level++)
+	{
+		const ImageRGBA& source = (level == 0) ? image : mipmaps[level - 1];
+		for (uint32_t y = 0; y < layout.getPagesY(level); y++)
+		{
+			for (uint32_t x = 0; x < layout.getPagesX(level); x++)
+			{
+				// page texels and border (clamped at the image edges)
+				for (uint32_t row = 0; row < tileSize; row++)
+				{
+					int sourceY = std::min(std::max(static_cast<int>(y * pageSize + row) - static_cast<int>(border), 0), source.height - 1);
+					for (uint32_t column = 0; column < tileSize; column++)
+					{
+						int sourceX = std::min(std::max(static_cast<int>(x * pageSize + column) - static_cast<int>(border), 0), source.width - 1);
+						std::memcpy(&tile[(static_cast<size_t>(row) * tileSize + column) * 4],
+							&source.pixels[(static_cast<size_t>(sourceY) * source.width + sourceX) * 4], 4);
+					}
+				}
+				file.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+			}
+		}
+	}
+	return static_cast<bool>(file);
+}
+
+bool VirtualTextureFile::open(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mFile.close();
+	mFile.open(path, std::ios::in | std::ios::binary);
+
+	char identifier[sizeof(gIdentifier)];
+	uint32_t header[5];
+	if (!mFile.read(identifier, sizeof(identifier)) || std::memcmp(identifier, gIdentifier, sizeof(gIdentifier)) != 0 ||
+		!mFile.read(reinterpret_cast<char*>(header), sizeof(header)))
+	{
+		mFile.close();
+		return false;
+	}
+
+	mLayout.width = header[0];
+	mLayout.height = header[1];
+	mLayout.pageSize = header[2];
+	mLayout.border = header[3];
+	mLayout.numLevels = header[4];
+	return mLayout.pageSize > 0 && mLayout.numLevels > 0;
+}
+
+// read the RGBA8 texels of a page and its border (can be called from any thread)
+bool VirtualTextureFile::readTile(uint32_t level, uint32_t x, uint32_t y, std::vector<uint8_t>& pixels)
+{
+	pixels.resize(mLayout.getTileBytes());
+	uint64_t offset = gHeaderSize + static_cast<uint64_t>(mLayout.getPageIndex(level, x, y)) * pixels.size();
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mFile.clear();
+	mFile.seekg(offset);
+	return static_cast<bool>(mFile.read(reinterpret_cast<char*>(pixels.data()), pixels.size()));
+}
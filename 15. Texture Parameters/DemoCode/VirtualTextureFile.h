@@ -0,0 +1,57 @@
+#ifndef VIRTUAL_TEXTURE_FILE_H
+#define VIRTUAL_TEXTURE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ImageRGBA.h"
+
+// size and paging of a virtual texture
+struct VirtualTextureLayout
+{
+	uint32_t width = 0;			// texels of level 0
+	uint32_t height = 0;
+	uint32_t pageSize = 0;		// texels per page side (without border)
+	uint32_t border = 0;		// texels repeated from neighbouring pages on each side
+	uint32_t numLevels = 0;		// the last level is the coarsest with whole pages
+
+	uint32_t getTileSize() const { return pageSize + 2 * border; }
+	size_t getTileBytes() const { return static_cast<size_t>(getTileSize()) * getTileSize() * 4; }
+	uint32_t getPagesX(uint32_t level) const { return (width >> level) / pageSize; }
+	uint32_t getPagesY(uint32_t level) const { return (height >> level) / pageSize; }
+	// index of a page among the pages of all levels (finest level first)
+	uint32_t getPageIndex(uint32_t level, uint32_t x, uint32_t y) const;
+	uint32_t getNumPages() const { return getPageIndex(numLevels, 0, 0); }
+};
+
+/*****************************************************************
+ * tiled virtual texture files
+ * an RGBA8 image and its mipmaps are cut into square pages, each
+ * stored with a border of texels from its neighbours (so pages can
+ * be filtered in isolation) as one contiguous tile, level by level
+ * and row by row; a tile can then be read with one seek
+ * image sizes must be powers of two and multiples of the page size
+ *****************************************************************/
+class VirtualTextureFile
+{
+public:
+	// write an image (level 0) and its box filtered mipmaps
+	static bool write(const std::string& path, const ImageRGBA& image, uint32_t pageSize, uint32_t border);
+
+	bool open(const std::string& path);
+	// read the RGBA8 texels of a page and its border (can be called from any thread)
+	bool readTile(uint32_t level, uint32_t x, uint32_t y, std::vector<uint8_t>& pixels);
+
+	const VirtualTextureLayout& getLayout() const { return mLayout; }
+
+private:
+	std::ifstream mFile;
+	std::mutex mMutex;		// guards the file position
+	VirtualTextureLayout mLayout;
+};
+
+#endif
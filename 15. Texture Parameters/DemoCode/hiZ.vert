@@ -0,0 +1,9 @@
+#version 330 core
+
+// full screen triangle (no vertex input)
+void main()
+{
+	// vertex 0: (-1, -1), vertex 1: (3, -1), vertex 2: (-1, 3)
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0f - 1.0f, 0.0f, 1.0f);
+}
@@ -0,0 +1,13 @@
+#version 330 core
+
+// uniform input data
+uniform sampler2D uDepthSampler;	// depth buffer copy
+
+// output data
+out float fDepth;
+
+void main()
+{
+	// one texel per pixel
+	fDepth = texelFetch(uDepthSampler, ivec2(gl_FragCoord.xy), 0).r;
+}
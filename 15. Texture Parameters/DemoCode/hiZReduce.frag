@@ -0,0 +1,38 @@
+#version 330 core
+
+// uniform input data
+uniform sampler2D uPyramidSampler;
+uniform int uLevel;		// level to read (the one before the level being written)
+
+// output data
+out float fDepth;
+
+// depth of a texel of the level being read (clamped to its edge)
+float fetchDepth(ivec2 coord, ivec2 offset, ivec2 last)
+{
+	return texelFetch(uPyramidSampler, min(coord + offset, last), uLevel).r;
+}
+
+void main()
+{
+	ivec2 size = textureSize(uPyramidSampler, uLevel);
+	ivec2 last = size - 1;
+	ivec2 coord = ivec2(gl_FragCoord.xy) * 2;
+
+	// furthest depth of the 2x2 texels below this texel
+	float depth = max(max(fetchDepth(coord, ivec2(0, 0), last), fetchDepth(coord, ivec2(1, 0), last)),
+		max(fetchDepth(coord, ivec2(0, 1), last), fetchDepth(coord, ivec2(1, 1), last)));
+
+	// odd sized levels: the last texel also covers the extra column/row
+	bool extraX = (size.x & 1) != 0 && coord.x + 2 == last.x;
+	bool extraY = (size.y & 1) != 0 && coord.y + 2 == last.y;
+
+	if (extraX)
+		depth = max(depth, max(fetchDepth(coord, ivec2(2, 0), last), fetchDepth(coord, ivec2(2, 1), last)));
+	if (extraY)
+		depth = max(depth, max(fetchDepth(coord, ivec2(0, 2), last), fetchDepth(coord, ivec2(1, 2), last)));
+	if (extraX && extraY)
+		depth = max(depth, fetchDepth(coord, ivec2(2, 2), last));
+
+	fDepth = depth;
+}
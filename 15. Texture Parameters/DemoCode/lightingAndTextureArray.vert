@@ -0,0 +1,34 @@
+#version 330 core
+
+// input data
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoord;
+
+// per instance data
+layout(location = 3) in mat4 aModelMatrix;		// (locations 3 to 6; uniform scale only)
+layout(location = 7) in vec4 aTexTransform;		// texture coordinate scale (xy) and offset (zw)
+layout(location = 8) in float aTexLayer;
+
+// uniform input data
+uniform mat4 uViewProjectionMatrix;
+
+// output data
+out vec3 vPosition;
+out vec3 vNormal;
+out vec2 vTexCoord;
+flat out float vTexLayer;
+
+void main()
+{
+	// set vertex position
+	vec4 position = aModelMatrix * vec4(aPosition, 1.0f);
+    gl_Position = uViewProjectionMatrix * position;
+
+	// set vertex shader output
+	// will be interpolated for each fragment
+	vPosition = position.xyz;
+	vNormal = mat3(aModelMatrix) * aNormal;
+	vTexCoord = aTexCoord * aTexTransform.xy + aTexTransform.zw;
+	vTexLayer = aTexLayer;
+}
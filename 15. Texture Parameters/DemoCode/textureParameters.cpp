@@ -1,4 +1,18 @@
 #include "utilities.h"
+#include "HiZCuller.h"
+#include "GLStateCache.h"
+#include "GLResources.h"
+#include "SamplerCache.h"
+#include "TextureCache.h"
+#include "ImageLoader.h"
+#include "MipmapGenerator.h"
+#include "TextureUploader.h"
+#include "TexturePacker.h"
+#include "VirtualTexture.h"
+#include "Terrain.h"
+
+#include <cmath>
+#include <fstream>
 
 #define STB_IMAGE_IMPLEMENTATION   
 #include "stb_image.h"
@@ -10,20 +24,99 @@ unsigned int gWindowHeight = 600;
 
 // scene content
 ShaderProgram gShader;	// shader program object
-GLuint gVBO = 0;		// vertex buffer object identifier
-GLuint gVAO = 0;		// vertex array object identifier
-GLuint gTextureID;		// texture id
+GLBuffer gVBO;			// vertex buffer object
+GLVertexArray gVAO;		// vertex array object
+TextureCache gTextureCache;	// textures shared by path and contents
+GLuint gTextureID = 0;		// texture id (referenced from the cache)
+bool gTextureIsCompressed = false;	// whether gTextureID is the block compressed version
+
+// sampling state (samplers are bound to the scene's texture unit;
+// unit 0 is left to the depth pyramid and the tweak bar, which expect the texture's own parameters)
+const GLuint gSceneTextureUnit = 1;
+SamplerCache gSamplerCache;		// one immutable sampler per filter/wrap combination used
+SamplerDesc gSamplerDesc;		// description of the current sampler
+GLuint gSampler = 0;			// current sampler
 
 glm::mat4 gModelMatrix;			// object matrix
 glm::mat4 gViewMatrix;			// view matrix
+glm::vec3 gViewpoint(-5.5f, 2.0f, 8.0f);	// camera position (moved with the keys, see update_camera)
+float gViewYaw = 0.0f;			// camera direction in radians (towards the origin at start)
+float gViewPitch = 0.0f;
 glm::mat4 gProjectionMatrix;	// projection matrix
 
 Light gLight;			// light properties
 Material gMaterial;		// material properties
 
+// boxes above and below the ground plane
+GLBuffer gCubeVBO;						// cube vertex buffer object
+GLBuffer gCubeIBO;						// cube index buffer object
+GLVertexArray gCubeVAO;					// cube vertex array object
+std::vector<glm::mat4> gBoxMatrices;	// model matrix of each box
+std::vector<BoundingBox> gBoxBounds;	// world bounds of each box
+
+// box images (one per box material), as separate textures or packed into array textures
+struct BoxInstance
+{
+	glm::mat4 model;
+	glm::vec4 texTransform;		// texture coordinate scale (xy) and offset (zw)
+	GLfloat texLayer;
+};
+const int gNumBoxImages = 20;			// the last few have odd sizes and go to the atlas
+std::vector<GLTexture> gBoxTextures;	// separate 2D textures
+TexturePacker gBoxPacker;				// the same images in arrays
+ShaderProgram gArrayShader;				// instanced boxes sampling array textures
+GLBuffer gBoxInstanceVBO;				// per instance data of the visible boxes
+GLVertexArray gBoxInstancedVAO;			// cube vertices and instance data
+std::vector<BoxInstance> gBoxInstances;
+
+// virtual texture for the ground plane (pages streamed in from a tiled file as they come into view)
+const std::string gVirtualTexturePath = "./images/terrain.vtex";	// generated on first run
+const float gVirtualTexCoordScale = 0.1f;	// the plane's texture coordinates run to 10
+const GLuint gPageTableUnit = 2;
+const GLuint gPageCacheUnit = 3;
+VirtualTexture gVirtualTexture;
+ShaderProgram gVirtualShader;			// lit plane sampling the virtual texture
+ShaderProgram gFeedbackShader;			// pages the plane needs
+
+// heightmap terrain in place of the plane (4 km square, flat around the boxes)
+const std::string gHeightmapPath = "./images/terrain.r16";	// generated on first run
+const uint32_t gHeightmapSize = 4096;	// quads per side (samples are 1 unit apart)
+const float gTerrainLoadRadius = 768.0f;
+Terrain gTerrain(64, 1.0f, 0.01f, -100.0f);	// heights of -100 to 555 units
+std::vector<uint32_t> gVisibleChunks;	// chunks to draw
+
+// visibility
+HiZCuller gHiZ;							// occlusion culling against the previous frames' depth
+std::vector<uint32_t> gVisibleBoxes;	// boxes to draw
+bool gOcclusionCulling = true;			// occlusion culling control
+uint32_t gNumBoxes = 0;					// culling statistics (per frame)
+uint32_t gNumFrustumCulled = 0;
+uint32_t gNumOccluded = 0;
+uint32_t gNumDrawn = 0;
+uint32_t gNumGLCallsIssued = 0;			// state calls issued to and elided by the state cache (per frame)
+uint32_t gNumGLCallsElided = 0;
+uint32_t gNumSamplers = 0;				// samplers created so far
+uint32_t gNumTextureLoads = 0;			// texture cache statistics
+uint32_t gNumTextureHits = 0;
+uint32_t gTextureMemory = 0;			// KB
+uint32_t gNumBoxDraws = 0;				// box draw calls (per frame)
+uint32_t gNumBoxTextures = 0;			// box textures bound (separate textures or arrays)
+uint32_t gNumVisiblePages = 0;			// virtual texture statistics
+uint32_t gNumResidentPages = 0;
+uint32_t gNumLoadingPages = 0;
+uint32_t gNumChunksLoaded = 0;			// terrain statistics
+uint32_t gNumChunksDrawn = 0;
+uint32_t gNumTerrainTriangles = 0;
+
 // controls
 bool gWireframe = false;	// wireframe control
+bool gTerrainEnabled = false;	// draw the terrain instead of the plane
+float gTerrainError = 2.0f;		// largest height error of terrain levels of detail (pixels)
 bool gReplace = false;		// replace color with texture
+bool gCompressedTexture = false;	// use the BC1 version of the texture (see Tools/encodeTexture.cpp)
+bool gTextureArrays = true;		// draw boxes in instanced batches per array texture
+bool gVirtualTexturing = false;	// texture the plane with the virtual texture
+float gCameraSpeed = 5.0f;		// camera movement (units per second)
 
 // texture wrap selection
 enum class TexWrap { REPEAT, MIRROR, CLAMP, BORDER };
@@ -35,20 +128,157 @@ enum class TexFilter { NEAREST, LINEAR, NEAREST_MIPMAP_NEAREST, LINEAR_MIPMAP_NE
 TexFilter gMagFilter = TexFilter::NEAREST;
 TexFilter gMinFilter = TexFilter::NEAREST;
 
+// switch to the uncompressed or compressed texture
+static void load_texture()
+{
+	// acquire before releasing, so a texture being switched back to can stay cached
+	GLuint texture = gTextureCache.acquire(gCompressedTexture ? "./images/check.ktx2" : "./images/check.bmp");
+	gTextureCache.release(gTextureID);
+	gTextureID = texture;
+	gTextureIsCompressed = gCompressedTexture;
+
+	gNumTextureLoads = gTextureCache.getNumDecodes();
+	gNumTextureHits = gTextureCache.getNumHits();
+	gTextureMemory = static_cast<uint32_t>(gTextureCache.getMemoryUsed() / 1024);
+}
+
+// procedural box image: checks of a colour that varies with the index
+static ImageRGBA make_box_image(int index, int width, int height)
+{
+	glm::vec3 colour;
+	for (int c = 0; c < 3; c++)
+		colour[c] = 0.5f + 0.5f * std::cos(6.2832f * (index / static_cast<float>(gNumBoxImages) + c / 3.0f));
+	ImageRGBA image;
+	image.width = width;
+	image.height = height;
+	image.pixels.resize(static_cast<size_t>(width) * height * 4);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			glm::vec3 texel = (((x / 8) + (y / 8)) % 2) ? colour : colour * 0.5f;
+			uint8_t* out = &image.pixels[(static_cast<size_t>(y) * width + x) * 4];
+			out[0] = static_cast<uint8_t>(texel.r * 255.0f);
+			out[1] = static_cast<uint8_t>(texel.g * 255.0f);
+			out[2] = static_cast<uint8_t>(texel.b * 255.0f);
+			out[3] = 255;
+		}
+	}
+	return image;
+}
+
+// value noise: smoothly interpolated random values (0 to 1) at integer positions
+static float value_noise(float x, float y)
+{
+	auto hash = [](int x, int y)
+	{
+		uint32_t h = static_cast<uint32_t>(x) * 73856093u ^ static_cast<uint32_t>(y) * 19349663u;
+		h = (h ^ (h >> 13)) * 1274126177u;
+		return static_cast<float>(h ^ (h >> 16)) / 4294967295.0f;
+	};
+	int ix = static_cast<int>(std::floor(x)), iy = static_cast<int>(std::floor(y));
+	float fx = x - ix, fy = y - iy;
+	fx = fx * fx * (3.0f - 2.0f * fx);
+	fy = fy * fy * (3.0f - 2.0f * fy);
+	float top = hash(ix, iy) + (hash(ix + 1, iy) - hash(ix, iy)) * fx;
+	float bottom = hash(ix, iy + 1) + (hash(ix + 1, iy + 1) - hash(ix, iy + 1)) * fx;
+	return top + (bottom - top) * fy;
+}
+
+// procedural terrain for the virtual texture: layered value noise coloured by height,
+// with lines at page edges (and every 16 texels) to show the detail drawn
+static ImageRGBA make_terrain_image(int size, int pageSize)
+{
+	ImageRGBA image;
+	image.width = image.height = size;
+	image.pixels.resize(static_cast<size_t>(size) * size * 4);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			float height = 0.0f, amplitude = 0.5f, frequency = 1.0f / 512.0f;
+			for (int octave = 0; octave < 4; octave++)
+			{
+				height += amplitude * value_noise(x * frequency, y * frequency);
+				amplitude *= 0.5f;
+				frequency *= 4.0f;
+			}
+
+			// water, sand, grass, rock and snow
+			glm::vec3 colour = (height < 0.45f) ? glm::vec3(0.1f, 0.3f, 0.6f) :
+				(height < 0.5f) ? glm::vec3(0.8f, 0.75f, 0.5f) :
+				(height < 0.65f) ? glm::vec3(0.2f, 0.5f, 0.15f) :
+				(height < 0.75f) ? glm::vec3(0.45f, 0.4f, 0.35f) : glm::vec3(0.95f);
+			colour *= 0.7f + 0.6f * height;
+			if (x % pageSize == 0 || y % pageSize == 0)
+				colour *= 0.3f;
+			else if (x % 16 == 0 || y % 16 == 0)
+				colour *= 0.8f;
+
+			uint8_t* out = &image.pixels[(static_cast<size_t>(y) * size + x) * 4];
+			out[0] = static_cast<uint8_t>(std::min(colour.r, 1.0f) * 255.0f);
+			out[1] = static_cast<uint8_t>(std::min(colour.g, 1.0f) * 255.0f);
+			out[2] = static_cast<uint8_t>(std::min(colour.b, 1.0f) * 255.0f);
+			out[3] = 255;
+		}
+	}
+	return image;
+}
+
+// procedural heightmap for the terrain: (size + 1)^2 16 bit samples of layered value noise
+// (hills sharpened with height), flattened to height 0 around the centre where the boxes stand
+static bool write_heightmap(const std::string& path, int size, float heightScale, float heightOffset)
+{
+	std::ofstream file(path, std::ios::out | std::ios::binary);
+	if (!file)
+		return false;
+
+	std::vector<uint16_t> row(size + 1);
+	for (int y = 0; y <= size; y++)
+	{
+		for (int x = 0; x <= size; x++)
+		{
+			float height = 0.0f, amplitude = 0.5f, frequency = 1.0f / 1024.0f;
+			for (int octave = 0; octave < 8; octave++)
+			{
+				height += amplitude * value_noise(x * frequency, y * frequency);
+				amplitude *= 0.45f;
+				frequency *= 2.0f;
+			}
+			height = height * height * 600.0f - 60.0f;
+
+			float distance = glm::length(glm::vec2(x, y) - glm::vec2(size * 0.5f));
+			float flatness = glm::clamp((distance - 16.0f) / 96.0f, 0.0f, 1.0f);
+			height *= flatness * flatness * (3.0f - 2.0f * flatness);
+
+			float value = (height - heightOffset) / heightScale;
+			row[x] = static_cast<uint16_t>(glm::clamp(value, 0.0f, 65535.0f));
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(uint16_t));
+	}
+	return static_cast<bool>(file);
+}
+
 // function initialise scene and render settings
 static void init(GLFWwindow* window)
 {
 	// set the color the color buffer should be cleared to
 	glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
 
-	glEnable(GL_DEPTH_TEST);	// enable depth buffer test
+	GLStateCache::enable(GL_DEPTH_TEST);	// enable depth buffer test
 
 	// compile and link a vertex and fragment shader pair
 	gShader.compileAndLink("lightingAndTexture.vert", "pointLightTexture.frag");
+	gArrayShader.compileAndLink("lightingAndTextureArray.vert", "pointLightTextureArray.frag");
+	gVirtualShader.compileAndLink("lightingAndTexture.vert", "virtualTexture.frag");
+	gFeedbackShader.compileAndLink("lightingAndTexture.vert", "virtualTextureFeedback.frag");
 
-	// initialise view matrix
-	gViewMatrix = glm::lookAt(glm::vec3(-5.5f, 2.0f, 8.0f), 
-		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	// initialise view direction (towards the origin) and view matrix
+	glm::vec3 direction = glm::normalize(-gViewpoint);
+	gViewYaw = std::atan2(direction.x, -direction.z);
+	gViewPitch = std::asin(direction.y);
+	gViewMatrix = glm::lookAt(gViewpoint, 
+		gViewpoint + direction, glm::vec3(0.0f, 1.0f, 0.0f));
 
 	// initialise projection matrix
 	gProjectionMatrix = glm::perspective(glm::radians(45.0f), 
@@ -67,33 +297,13 @@ static void init(GLFWwindow* window)
 	gMaterial.Ks = glm::vec3(0.2f, 0.5f, 0.8f);
 	gMaterial.shininess = 40.0f;
 
-	// load image data
+	// load texture (decoded once and shared with any other users of the image)
 	stbi_set_flip_vertically_on_load(true); // flip image about y-axis
-	int imageWidth, imageHeight, imageChannels;
-	unsigned char* imageData = stbi_load("./images/check.bmp", &imageWidth, &imageHeight, &imageChannels, 0);
-
-	if(!imageData)
-		std::cerr << "Unable to load image." << std::endl;	// output error description
-
-	// generate texture
-	glGenTextures(1, &gTextureID);
-	glBindTexture(GL_TEXTURE_2D, gTextureID);
+	gTextureCache.setMipmapSource(MipmapSource::CPU_BOX);
+	load_texture();
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	// set texture parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	// set clamp to border colour
-	glm::vec4 borderColor(1.0f, 0.0f, 0.0f, 1.0f);
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, &borderColor[0]);
-
-	// free image data
-	stbi_image_free(imageData);
+	// set clamp to border colour (filters and wraps are set in update_scene)
+	gSamplerDesc.borderColor = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
 
 	// initialise model matrices
 	gModelMatrix = glm::mat4(1.0f);
@@ -116,118 +326,619 @@ static void init(GLFWwindow* window)
 	};
 
 	// create VBO
-	glGenBuffers(1, &gVBO);					// generate unused VBO identifier
-	glBindBuffer(GL_ARRAY_BUFFER, gVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+	gVBO.create(sizeof(GLfloat) * vertices.size(), &vertices[0]);
 
 	// create VAO, specify VBO data and format of the data
-	glGenVertexArrays(1, &gVAO);			// generate unused VAO identifier
-	glBindVertexArray(gVAO);				// create VAO
-	glBindBuffer(GL_ARRAY_BUFFER, gVBO);	// bind the VBO
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormTex),
-		reinterpret_cast<void*>(offsetof(VertexNormTex, position)));	// specify format of position data
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormTex),
-		reinterpret_cast<void*>(offsetof(VertexNormTex, normal)));		// specify format of colour data
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexNormTex),
-		reinterpret_cast<void*>(offsetof(VertexNormTex, texCoord)));	// specify format of texture coordinate data
-
-	glEnableVertexAttribArray(0);	// enable vertex attributes
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
+	gVAO.create();
+	gVAO.setVertexBuffer(0, gVBO, 0, sizeof(VertexNormTex));
+	gVAO.setAttribute(0, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, position));	// specify format of position data
+	gVAO.setAttribute(1, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, normal));		// specify format of normal data
+	gVAO.setAttribute(2, 0, 2, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, texCoord));	// specify format of texture coordinate data
+
+	// unit cube: 4 vertices per face (position, normal, texture coordinate)
+	std::vector<GLfloat> cubeVertices;
+	std::vector<GLuint> cubeIndices;
+	for (int face = 0; face < 6; face++)
+	{
+		int axis = face / 2;						// x, y or z
+		float sign = (face % 2) ? -1.0f : 1.0f;		// positive or negative side
+		glm::vec3 normal(0.0f), u(0.0f), v(0.0f);
+		normal[axis] = sign;
+		u[(axis + 1) % 3] = sign;
+		v[(axis + 2) % 3] = 1.0f;
+
+		GLuint first = static_cast<GLuint>(cubeVertices.size() / 8);
+		for (int corner = 0; corner < 4; corner++)
+		{
+			float s = (corner & 1) ? 1.0f : 0.0f;
+			float t = (corner & 2) ? 1.0f : 0.0f;
+			glm::vec3 position = (normal + u * (s * 2.0f - 1.0f) + v * (t * 2.0f - 1.0f)) * 0.5f;
+			cubeVertices.insert(cubeVertices.end(), { position.x, position.y, position.z, normal.x, normal.y, normal.z, s, t });
+		}
+		cubeIndices.insert(cubeIndices.end(), { first, first + 1, first + 3, first, first + 3, first + 2 });
+	}
+
+	// create cube buffers and VAO
+	gCubeVBO.create(sizeof(GLfloat) * cubeVertices.size(), &cubeVertices[0]);
+	gCubeIBO.create(sizeof(GLuint) * cubeIndices.size(), &cubeIndices[0]);
+
+	gCubeVAO.create();
+	gCubeVAO.setVertexBuffer(0, gCubeVBO, 0, sizeof(VertexNormTex));
+	gCubeVAO.setIndexBuffer(gCubeIBO);
+	gCubeVAO.setAttribute(0, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, position));
+	gCubeVAO.setAttribute(1, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, normal));
+	gCubeVAO.setAttribute(2, 0, 2, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, texCoord));
+
+	// grid of boxes above the plane and a grid below it (hidden by the plane)
+	for (float y : { 0.25f, -1.0f })
+	{
+		for (int z = 0; z < 10; z++)
+		{
+			for (int x = 0; x < 10; x++)
+			{
+				glm::vec3 position(x - 4.5f, y, z - 4.5f);
+				gBoxMatrices.push_back(glm::translate(position) * glm::scale(glm::vec3(0.5f)));
+				gBoxBounds.push_back({ position - 0.25f, position + 0.25f });
+			}
+		}
+	}
+	gNumBoxes = static_cast<uint32_t>(gBoxMatrices.size());
+
+	// box images: most share a size (packed into an array), a few don't (packed into the atlas)
+	const int oddSizes[][2] = { { 40, 56 }, { 96, 48 }, { 24, 24 }, { 80, 72 } };
+	for (int i = 0; i < gNumBoxImages; i++)
+	{
+		int oddSize = i - (gNumBoxImages - 4);
+		ImageRGBA image = (oddSize >= 0) ? make_box_image(i, oddSizes[oddSize][0], oddSizes[oddSize][1]) : make_box_image(i, 64, 64);
+
+		GLTexture texture;
+		texture.create2D(GL_RGBA8, image.width, image.height, GLTexture::getMaxLevels(image.width, image.height));
+		texture.setImage(0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+		texture.generateMipmap();
+		gBoxTextures.push_back(std::move(texture));
+		gBoxPacker.add(std::move(image));
+	}
+	gBoxPacker.build();
+
+	// instanced boxes: cube vertices and a per instance matrix, texture transform and layer
+	gBoxInstanceVBO.create(sizeof(BoxInstance) * gNumBoxes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	gBoxInstancedVAO.create();
+	gBoxInstancedVAO.setVertexBuffer(0, gCubeVBO, 0, sizeof(VertexNormTex));
+	gBoxInstancedVAO.setIndexBuffer(gCubeIBO);
+	gBoxInstancedVAO.setAttribute(0, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, position));
+	gBoxInstancedVAO.setAttribute(1, 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, normal));
+	gBoxInstancedVAO.setAttribute(2, 0, 2, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, texCoord));
+	gBoxInstancedVAO.setVertexBuffer(1, gBoxInstanceVBO, 0, sizeof(BoxInstance));
+	for (GLuint column = 0; column < 4; column++)
+	{
+		gBoxInstancedVAO.setAttribute(3 + column, 1, 4, GL_FLOAT, GL_FALSE,
+			static_cast<GLuint>(offsetof(BoxInstance, model) + sizeof(glm::vec4) * column));
+	}
+	gBoxInstancedVAO.setAttribute(7, 1, 4, GL_FLOAT, GL_FALSE, offsetof(BoxInstance, texTransform));
+	gBoxInstancedVAO.setAttribute(8, 1, 1, GL_FLOAT, GL_FALSE, offsetof(BoxInstance, texLayer));
+	gBoxInstancedVAO.setBindingDivisor(1, 1);
+
+	// initialise occlusion culling for the framebuffer size
+	int framebufferWidth, framebufferHeight;
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	gHiZ.init(framebufferWidth, framebufferHeight);
+
+	// virtual texture (4096x4096 texels in 128x128 pages, written once)
+	if (!std::ifstream(gVirtualTexturePath))
+	{
+		std::cout << "Writing " << gVirtualTexturePath << std::endl;
+		VirtualTextureFile::write(gVirtualTexturePath, make_terrain_image(4096, 128), 128, 4);
+	}
+	gVirtualTexture.init(gVirtualTexturePath, framebufferWidth, framebufferHeight);
+
+	// terrain heightmap (streamed in chunks around the viewpoint)
+	if (!std::ifstream(gHeightmapPath))
+	{
+		std::cout << "Writing " << gHeightmapPath << std::endl;
+		write_heightmap(gHeightmapPath, gHeightmapSize, 0.01f, -100.0f);
+	}
+	gTerrain.init(gHeightmapPath, gHeightmapSize);
 }
 
 // function used to update the scene
+// move the camera with W/A/S/D (R/F up and down, shift for ten times the speed) and turn it with the arrow keys
+static void update_camera(GLFWwindow* window)
+{
+	static double lastTime = glfwGetTime();
+	double time = glfwGetTime();
+	float elapsed = static_cast<float>(time - lastTime);
+	lastTime = time;
+
+	const float turnRate = glm::radians(60.0f);		// per second
+	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+		gViewYaw -= turnRate * elapsed;
+	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+		gViewYaw += turnRate * elapsed;
+	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+		gViewPitch += turnRate * elapsed;
+	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+		gViewPitch -= turnRate * elapsed;
+	gViewPitch = glm::clamp(gViewPitch, glm::radians(-89.0f), glm::radians(89.0f));
+
+	glm::vec3 forward(std::cos(gViewPitch) * std::sin(gViewYaw), std::sin(gViewPitch), -std::cos(gViewPitch) * std::cos(gViewYaw));
+	glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+	float distance = gCameraSpeed * elapsed;
+	if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS)
+		distance *= 10.0f;
+
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+		gViewpoint += forward * distance;
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+		gViewpoint -= forward * distance;
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+		gViewpoint += right * distance;
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+		gViewpoint -= right * distance;
+	if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+		gViewpoint.y += distance;
+	if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
+		gViewpoint.y -= distance;
+
+	gViewMatrix = glm::lookAt(gViewpoint, gViewpoint + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
 static void update_scene(GLFWwindow* window)
 {
-	// set magnification filter
-	if (gMagFilter == TexFilter::NEAREST)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	else
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// set minification filter
-	if (gMinFilter == TexFilter::NEAREST)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	else if (gMinFilter == TexFilter::LINEAR)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	else if (gMinFilter == TexFilter::NEAREST_MIPMAP_NEAREST)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-	else if (gMinFilter == TexFilter::LINEAR_MIPMAP_NEAREST)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-	else if (gMinFilter == TexFilter::NEAREST_MIPMAP_LINEAR)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-	else if (gMinFilter == TexFilter::LINEAR_MIPMAP_LINEAR)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-
-	// set wrap in S
-	if (gWrapS == TexWrap::REPEAT)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	else if (gWrapS == TexWrap::MIRROR)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-	else if (gWrapS == TexWrap::CLAMP)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	else if (gWrapS == TexWrap::BORDER)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-
-	// set wrap in T
-	if (gWrapT == TexWrap::REPEAT)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	else if (gWrapT == TexWrap::MIRROR)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-	else if (gWrapT == TexWrap::CLAMP)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	else if (gWrapT == TexWrap::BORDER)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	update_camera(window);
+
+	if (gCompressedTexture != gTextureIsCompressed)
+		load_texture();
+	gTextureCache.update();	// stream in queued texture levels
+
+	// stream terrain chunks in and out around the viewpoint (the far plane moves out to show them)
+	gProjectionMatrix = glm::perspective(glm::radians(45.0f), static_cast<float>(gWindowWidth) / gWindowHeight,
+		0.1f, gTerrainEnabled ? gTerrainLoadRadius : 100.0f);
+	if (gTerrainEnabled)
+	{
+		gTerrain.update(gViewpoint, gTerrainLoadRadius);
+		gNumChunksLoaded = gTerrain.getNumLoaded();
+	}
+
+	// stream in the pages the last feedback asked for
+	if (gVirtualTexturing && !gTerrainEnabled)
+	{
+		gVirtualTexture.update();
+		gNumVisiblePages = gVirtualTexture.getNumVisible();
+		gNumResidentPages = gVirtualTexture.getNumResident();
+		gNumLoadingPages = gVirtualTexture.getNumPendingLoads();
+	}
+
+	// OpenGL values of the filter and wrap selections (in enum order)
+	static const GLenum filters[] = { GL_NEAREST, GL_LINEAR, GL_NEAREST_MIPMAP_NEAREST, GL_LINEAR_MIPMAP_NEAREST,
+		GL_NEAREST_MIPMAP_LINEAR, GL_LINEAR_MIPMAP_LINEAR };
+	static const GLenum wraps[] = { GL_REPEAT, GL_MIRRORED_REPEAT, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_BORDER };
+
+	SamplerDesc desc = gSamplerDesc;
+	desc.magFilter = filters[static_cast<int>(gMagFilter)];
+	desc.minFilter = filters[static_cast<int>(gMinFilter)];
+	desc.wrapS = wraps[static_cast<int>(gWrapS)];
+	desc.wrapT = wraps[static_cast<int>(gWrapT)];
+
+	// look up another sampler only when the selection changes
+	if (gSampler == 0 || desc != gSamplerDesc)
+	{
+		gSamplerDesc = desc;
+		gSampler = gSamplerCache.get(desc);
+		gNumSamplers = static_cast<uint32_t>(gSamplerCache.size());
+	}
 }
 
-// function to render the scene
-static void render_scene()
+// whether a box intersects the view frustum of a view-projection matrix
+static bool in_frustum(const glm::mat4& viewProjection, const BoundingBox& box)
 {
-	// clear colour buffer and depth buffer
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	for (int i = 0; i < 6; i++)
+	{
+		// left, right, bottom, top, near, far planes
+		int row = i / 2;
+		float sign = (i % 2) ? -1.0f : 1.0f;
+		glm::vec4 plane;
+		for (int column = 0; column < 4; column++)
+			plane[column] = viewProjection[column][3] + sign * viewProjection[column][row];
+
+		// box corner furthest along the plane normal
+		glm::vec3 corner(plane.x > 0.0f ? box.max.x : box.min.x, plane.y > 0.0f ? box.max.y : box.min.y,
+			plane.z > 0.0f ? box.max.z : box.min.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+			return false;
+	}
 
-	gShader.use();						// use the shaders associated with the shader program
+	return true;
+}
 
+// set the light, material and texture unit of a program in use
+static void set_shading_uniforms(ShaderProgram& shader)
+{
 	// set light properties
-	gShader.setUniform("uLight.pos", gLight.pos);
-	gShader.setUniform("uLight.La", gLight.La);
-	gShader.setUniform("uLight.Ld", gLight.Ld);
-	gShader.setUniform("uLight.Ls", gLight.Ls);
-	gShader.setUniform("uLight.att", gLight.att);
+	shader.setUniform("uLight.pos", gLight.pos);
+	shader.setUniform("uLight.La", gLight.La);
+	shader.setUniform("uLight.Ld", gLight.Ld);
+	shader.setUniform("uLight.Ls", gLight.Ls);
+	shader.setUniform("uLight.att", gLight.att);
 
 	// set material properties
-	gShader.setUniform("uMaterial.Ka", gMaterial.Ka);
-	gShader.setUniform("uMaterial.Kd", gMaterial.Kd);
-	gShader.setUniform("uMaterial.Ks", gMaterial.Ks);
-	gShader.setUniform("uMaterial.shininess", gMaterial.shininess);
+	shader.setUniform("uMaterial.Ka", gMaterial.Ka);
+	shader.setUniform("uMaterial.Kd", gMaterial.Kd);
+	shader.setUniform("uMaterial.Ks", gMaterial.Ks);
+	shader.setUniform("uMaterial.shininess", gMaterial.shininess);
 
 	// whether to replace with texture
-	gShader.setUniform("uReplace", gReplace);
+	shader.setUniform("uReplace", gReplace);
 
-	// set texture
-	gShader.setUniform("uTextureSampler", 0);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureID);
+	// set texture unit
+	shader.setUniform("uTextureSampler", static_cast<int>(gSceneTextureUnit));
 
 	// set viewing position
-	gShader.setUniform("uViewpoint", glm::vec3(-5.5f, 2.0f, 8.0f));
+	shader.setUniform("uViewpoint", gViewpoint);
+}
+
+// render visible boxes one at a time, each binding its own texture
+static void render_boxes_separately(const glm::mat4& viewProjection)
+{
+	gShader.use();
+	set_shading_uniforms(gShader);
+
+	gCubeVAO.bind();
+	for (uint32_t i : gVisibleBoxes)
+	{
+		glm::mat4 MVP = viewProjection * gBoxMatrices[i];
+		glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(gBoxMatrices[i])));
+
+		gShader.setUniform("uModelViewProjectionMatrix", MVP);
+		gShader.setUniform("uModelMatrix", gBoxMatrices[i]);
+		gShader.setUniform("uNormalMatrix", normalMatrix);
+		gBoxTextures[i % gNumBoxImages].bind(gSceneTextureUnit);
+
+		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+	}
+	gNumBoxDraws = static_cast<uint32_t>(gVisibleBoxes.size());
+	gNumBoxTextures = std::min(gNumBoxDraws, static_cast<uint32_t>(gNumBoxImages));
+}
+
+// render visible boxes in one instanced draw per array texture, selecting images by layer
+static void render_boxes_packed(const glm::mat4& viewProjection)
+{
+	// instances grouped by texture
+	std::vector<uint32_t> boxes = gVisibleBoxes;
+	std::sort(boxes.begin(), boxes.end(), [](uint32_t a, uint32_t b)
+	{
+		return gBoxPacker.get(a % gNumBoxImages).texture < gBoxPacker.get(b % gNumBoxImages).texture;
+	});
+
+	gBoxInstances.clear();
+	for (uint32_t i : boxes)
+	{
+		const PackedImage& image = gBoxPacker.get(i % gNumBoxImages);
+		gBoxInstances.push_back({ gBoxMatrices[i], image.uvTransform, static_cast<GLfloat>(image.layer) });
+	}
+	if (!gBoxInstances.empty())
+		gBoxInstanceVBO.update(0, sizeof(BoxInstance) * gBoxInstances.size(), gBoxInstances.data());
+
+	gArrayShader.use();
+	set_shading_uniforms(gArrayShader);
+	gArrayShader.setUniform("uViewProjectionMatrix", viewProjection);
+
+	gNumBoxDraws = 0;
+	gNumBoxTextures = 0;
+	for (size_t first = 0; first < boxes.size(); )
+	{
+		GLuint texture = gBoxPacker.get(boxes[first] % gNumBoxImages).texture;
+		size_t last = first;
+		while (last < boxes.size() && gBoxPacker.get(boxes[last] % gNumBoxImages).texture == texture)
+			last++;
+
+		// (instance data offset per batch, as base instances need OpenGL 4.2)
+		gBoxInstancedVAO.setVertexBuffer(1, gBoxInstanceVBO, sizeof(BoxInstance) * first, sizeof(BoxInstance));
+		gBoxInstancedVAO.bind();
+		GLStateCache::bindTexture(gSceneTextureUnit, GL_TEXTURE_2D_ARRAY, texture);
+		glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(last - first));
+
+		gNumBoxDraws++;
+		gNumBoxTextures++;
+		first = last;
+	}
+}
+
+// render the loaded terrain chunks that are in the view frustum and not occluded
+// (with the plane's shader, texture and matrices already set)
+static void render_terrain(const glm::mat4& viewProjection)
+{
+	const std::vector<BoundingBox>& bounds = gTerrain.getBounds();
+	gVisibleChunks.clear();
+	for (uint32_t i = 0; i < gTerrain.getNumChunks(); i++)
+	{
+		if (gTerrain.isLoaded(i) && in_frustum(viewProjection, bounds[i]))
+			gVisibleChunks.push_back(i);
+	}
+	if (gOcclusionCulling)
+		gHiZ.cull(bounds, gVisibleChunks);
+
+	// pixels per unit at distance 1 (from the vertical field of view)
+	float pixelsPerUnit = gWindowHeight / (2.0f * std::tan(glm::radians(45.0f) * 0.5f));
+	gTerrain.draw(gVisibleChunks, gViewpoint, pixelsPerUnit, gTerrainError);
+
+	gNumChunksDrawn = gTerrain.getNumDrawn();
+	gNumTerrainTriangles = gTerrain.getNumTriangles();
+}
+
+// draw the pages of the virtual texture the plane needs into the (small) feedback buffer
+static void render_feedback()
+{
+	gVirtualTexture.beginFeedback();
+
+	gFeedbackShader.use();
+	gVirtualTexture.setUniforms(gFeedbackShader, gPageTableUnit, gPageCacheUnit);
+	gFeedbackShader.setUniform("uTexCoordScale", gVirtualTexCoordScale);
+	gFeedbackShader.setUniform("uLevelBias", -std::log2(static_cast<float>(VirtualTexture::sFeedbackScale)));
+	gFeedbackShader.setUniform("uModelViewProjectionMatrix", gProjectionMatrix * gViewMatrix * gModelMatrix);
+
+	gVAO.bind();
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	gVirtualTexture.endFeedback();
+}
+
+// function to render the scene
+static void render_scene()
+{
+	// clear colour buffer and depth buffer
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// the plane samples the virtual texture or the check texture (as does the terrain)
+	ShaderProgram& planeShader = (gVirtualTexturing && gVirtualTexture.isValid() && !gTerrainEnabled) ? gVirtualShader : gShader;
+	planeShader.use();						// use the shaders associated with the shader program
+	set_shading_uniforms(planeShader);
+
+	// set texture
+	if (&planeShader == &gVirtualShader)
+	{
+		gVirtualTexture.setUniforms(planeShader, gPageTableUnit, gPageCacheUnit);
+		planeShader.setUniform("uTexCoordScale", gVirtualTexCoordScale);
+	}
+	else
+	{
+		GLStateCache::bindTexture(gSceneTextureUnit, GL_TEXTURE_2D, gTextureID);
+		GLStateCache::bindSampler(gSceneTextureUnit, gSampler);
+	}
 
 	// calculate matrices
 	glm::mat4 MVP = gProjectionMatrix * gViewMatrix * gModelMatrix;
 	glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(gModelMatrix)));
 
 	// set matrices
-	gShader.setUniform("uModelViewProjectionMatrix", MVP);
-	gShader.setUniform("uModelMatrix", gModelMatrix);
-	gShader.setUniform("uNormalMatrix", normalMatrix);
+	planeShader.setUniform("uModelViewProjectionMatrix", MVP);
+	planeShader.setUniform("uModelMatrix", gModelMatrix);
+	planeShader.setUniform("uNormalMatrix", normalMatrix);
+
+	glm::mat4 viewProjection = gProjectionMatrix * gViewMatrix;
+	if (gTerrainEnabled)
+	{
+		render_terrain(viewProjection);
+	}
+	else
+	{
+		gVAO.bind();							// make VAO active
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);	// render the vertices
+	}
+
+	// frustum cull the boxes, then remove the ones hidden in the depth pyramid
+	gVisibleBoxes.clear();
+	for (uint32_t i = 0; i < gNumBoxes; i++)
+	{
+		if (in_frustum(viewProjection, gBoxBounds[i]))
+			gVisibleBoxes.push_back(i);
+	}
+	gNumFrustumCulled = gNumBoxes - static_cast<uint32_t>(gVisibleBoxes.size());
+
+	if (gOcclusionCulling)
+	{
+		gHiZ.cull(gBoxBounds, gVisibleBoxes);
+		gNumOccluded = gHiZ.getNumOccluded();
+	}
+	else
+	{
+		gNumOccluded = 0;
+	}
+	gNumDrawn = static_cast<uint32_t>(gVisibleBoxes.size());
 
-	glBindVertexArray(gVAO);				// make VAO active
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);	// render the vertices
+	// render boxes
+	if (gTextureArrays)
+		render_boxes_packed(viewProjection);
+	else
+		render_boxes_separately(viewProjection);
 
 	// flush the graphics pipeline
 	glFlush();
 }
 
+// time mipmap generation of a large texture by the driver and on the CPU (levels generated and uploaded)
+static void benchmark_mipmaps()
+{
+	const int size = 2048;
+	const int numRuns = 5;		// runs per measurement
+
+	// random texels (worst case for caches, same work as any image)
+	ImageRGBA image;
+	image.width = image.height = size;
+	image.pixels.resize(static_cast<size_t>(size) * size * 4);
+	for (uint8_t& value : image.pixels)
+		value = static_cast<uint8_t>(rand());
+
+	GLTexture texture;
+	texture.create2D(GL_RGBA8, size, size, GLTexture::getMaxLevels(size, size));
+	texture.setImage(0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+	glFinish();
+
+	// driver
+	double startTime = glfwGetTime();
+	for (int run = 0; run < numRuns; run++)
+	{
+		texture.generateMipmap();
+		glFinish();
+	}
+	double driverTime = (glfwGetTime() - startTime) / numRuns;
+	std::cout << "Mipmap benchmark (" << size << "x" << size << "): glGenerateMipmap " << driverTime * 1000.0 << " ms" << std::endl;
+
+	// CPU filters on one thread and on all hardware threads
+	struct Variant { const char* name; MipFilter filter; bool sRGB; unsigned numThreads; };
+	const Variant variants[] = {
+		{ "box, 1 thread", MipFilter::BOX, false, 1 },
+		{ "box", MipFilter::BOX, false, 0 },
+		{ "box sRGB", MipFilter::BOX, true, 0 },
+		{ "Kaiser, 1 thread", MipFilter::KAISER, false, 1 },
+		{ "Kaiser", MipFilter::KAISER, false, 0 },
+		{ "Kaiser sRGB", MipFilter::KAISER, true, 0 }
+	};
+	for (const Variant& variant : variants)
+	{
+		double generateTime = 0.0, uploadTime = 0.0;
+		for (int run = 0; run < numRuns; run++)
+		{
+			startTime = glfwGetTime();
+			std::vector<ImageRGBA> mipmaps = MipmapGenerator::generate(image, variant.filter, variant.sRGB, variant.numThreads);
+			double uploadStartTime = glfwGetTime();
+			for (size_t level = 0; level < mipmaps.size(); level++)
+				texture.setImage(static_cast<GLint>(level + 1), GL_RGBA, GL_UNSIGNED_BYTE, mipmaps[level].pixels.data());
+			glFinish();
+			generateTime += uploadStartTime - startTime;
+			uploadTime += glfwGetTime() - uploadStartTime;
+		}
+		std::cout << "  CPU " << variant.name << ": " << generateTime * 1000.0 / numRuns << " ms + upload "
+			<< uploadTime * 1000.0 / numRuns << " ms" << std::endl;
+	}
+}
+
+// print decode rates by file format
+static void print_decode_stats(const std::map<std::string, DecodeStats>& stats)
+{
+	for (const auto& format : stats)
+	{
+		std::cout << "    " << format.first << ": " << format.second.numImages << " images, "
+			<< format.second.getMBPerSecond() << " MB/s per thread" << std::endl;
+	}
+}
+
+// time decoding and uploading many image files on one thread and on the loader's pool
+// (with the pool also decoding straight into a mapped pixel unpack buffer)
+static void benchmark_decoding()
+{
+	const std::string path = "./images/check.bmp";
+	const int numFiles = 256;	// decodes per measurement
+
+	std::cout << "Decode benchmark (" << numFiles << " x " << path << "), texture cache so far:" << std::endl;
+	print_decode_stats(gTextureCache.getDecodeStats());
+
+	struct Variant { const char* name; unsigned numThreads; bool unpackBuffer; };
+	const Variant variants[] = {
+		{ "1 thread", 1, false },
+		{ "pool", 0, false },
+		{ "pool, into unpack buffer", 0, true }
+	};
+	for (const Variant& variant : variants)
+	{
+		// start the threads and warm the file cache
+		ImageLoader loader(variant.numThreads);
+		DecodedImage first = loader.load(path).get();
+		if (!first.valid)
+			return;
+		loader.resetStats();
+
+		const size_t imageBytes = first.image.pixels.size();
+		GLTexture texture;
+		texture.create2D(GL_RGBA8, first.image.width, first.image.height, 1);
+
+		// one image's worth of the buffer per file
+		GLBuffer buffer;
+		if (variant.unpackBuffer)
+			buffer.create(imageBytes * numFiles, nullptr, GL_MAP_WRITE_BIT);
+		glFinish();
+
+		double startTime = glfwGetTime();
+		uint8_t* mapped = nullptr;
+		if (variant.unpackBuffer)
+			mapped = static_cast<uint8_t*>(buffer.map(0, buffer.getSize(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+
+		std::vector<std::future<DecodedImage>> decodes;
+		for (int i = 0; i < numFiles; i++)
+			decodes.push_back(loader.load(path, mapped ? mapped + i * imageBytes : nullptr, mapped ? imageBytes : 0));
+
+		for (std::future<DecodedImage>& decode : decodes)
+		{
+			DecodedImage image = decode.get();
+			if (!mapped)
+				texture.setImage(0, GL_RGBA, GL_UNSIGNED_BYTE, image.image.pixels.data());
+		}
+
+		if (mapped)
+		{
+			// upload from buffer offsets (unbound again, so client memory uploads work as before)
+			buffer.unmap();
+			GLStateCache::bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.getID());
+			for (int i = 0; i < numFiles; i++)
+				texture.setImage(0, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(i * imageBytes));
+			GLStateCache::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+		glFinish();
+
+		double time = glfwGetTime() - startTime;
+		std::cout << "  " << variant.name;
+		if (variant.numThreads == 0)
+			std::cout << " (" << loader.getNumThreads() << " threads)";
+		std::cout << ": " << time * 1000.0 << " ms, " << imageBytes * numFiles / (time * 1024.0 * 1024.0) << " MB/s decoded and uploaded" << std::endl;
+		print_decode_stats(loader.getStats());
+	}
+}
+
+// time uploading a large texture with one glTexSubImage2D from client memory and through
+// staging buffers spread over updates (as frames would), measuring the CPU time of each call
+static void benchmark_upload()
+{
+	const int size = 4096;
+	const size_t budget = 4 * 1024 * 1024;	// bytes per update
+
+	std::vector<uint8_t> pixels(static_cast<size_t>(size) * size * 4);
+	for (uint8_t& value : pixels)
+		value = static_cast<uint8_t>(rand());
+
+	GLTexture texture;
+	texture.create2D(GL_RGBA8, size, size, 1);
+	glFinish();
+
+	// one synchronous copy
+	double startTime = glfwGetTime();
+	texture.setImage(0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	double callTime = glfwGetTime() - startTime;
+	glFinish();
+	double totalTime = glfwGetTime() - startTime;
+	std::cout << "Upload benchmark (" << size << "x" << size << " RGBA8): glTexSubImage2D call " << callTime * 1000.0
+		<< " ms, complete " << totalTime * 1000.0 << " ms" << std::endl;
+
+	// staged in budgeted updates
+	TextureUploader uploader;
+	uploader.enqueue(texture.getID(), 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, 4, pixels);
+	uploader.update(1);		// create the staging buffers outside the measurement
+	glFinish();
+
+	int numUpdates = 0;
+	double longestUpdate = 0.0;
+	startTime = glfwGetTime();
+	while (uploader.getNumPending() > 0)
+	{
+		double updateStartTime = glfwGetTime();
+		if (uploader.update(budget) > 0)
+			numUpdates++;	// (updates that find every staging buffer busy issue nothing)
+		longestUpdate = std::max(longestUpdate, glfwGetTime() - updateStartTime);
+	}
+	glFinish();
+	totalTime = glfwGetTime() - startTime;
+	std::cout << "  staged, " << budget / 1024 << " KB per update: " << numUpdates << " updates, longest "
+		<< longestUpdate * 1000.0 << " ms, complete " << totalTime * 1000.0 << " ms" << std::endl;
+}
+
 // key press or release callback function
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
@@ -238,6 +949,27 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 		glfwSetWindowShouldClose(window, GL_TRUE);
 		return;
 	}
+
+	// run the mipmap generation benchmark when the M key is pressed
+	if (key == GLFW_KEY_M && action == GLFW_PRESS)
+	{
+		benchmark_mipmaps();
+		return;
+	}
+
+	// run the image decoding benchmark when the L key is pressed
+	if (key == GLFW_KEY_L && action == GLFW_PRESS)
+	{
+		benchmark_decoding();
+		return;
+	}
+
+	// run the texture upload benchmark when the U key is pressed
+	if (key == GLFW_KEY_U && action == GLFW_PRESS)
+	{
+		benchmark_upload();
+		return;
+	}
 }
 
 // mouse movement callback function
@@ -271,10 +1003,41 @@ TwBar* create_UI(const std::string name)
 	TwDefine(" TW_HELP visible=false ");	// disable help menu
 	TwDefine(" GLOBAL fontsize=3 ");		// set large font size
 
-	TwDefine(" Main label='User Interface' refresh=0.02 text=light size='250 250' ");
+	TwDefine(" Main label='User Interface' refresh=0.02 text=light size='250 760' ");
 
 	// scene controls
 	TwAddVarRW(twBar, "Wireframe", TW_TYPE_BOOLCPP, &gWireframe, " group='Controls' ");
+	TwAddVarRW(twBar, "Terrain", TW_TYPE_BOOLCPP, &gTerrainEnabled, " group='Controls' ");
+	TwAddVarRW(twBar, "Terrain error (px)", TW_TYPE_FLOAT, &gTerrainError, " group='Controls' min=0.5 max=16.0 step=0.5 ");
+
+	// camera (also moved with W/A/S/D/R/F and turned with the arrow keys)
+	TwAddVarRW(twBar, "Camera: x", TW_TYPE_FLOAT, &gViewpoint.x, " group='Camera' min=-2048 max=2048 step=1.0 ");
+	TwAddVarRW(twBar, "Camera: y", TW_TYPE_FLOAT, &gViewpoint.y, " group='Camera' min=-100 max=1000 step=1.0 ");
+	TwAddVarRW(twBar, "Camera: z", TW_TYPE_FLOAT, &gViewpoint.z, " group='Camera' min=-2048 max=2048 step=1.0 ");
+	TwAddVarRW(twBar, "Camera speed", TW_TYPE_FLOAT, &gCameraSpeed, " group='Camera' min=1 max=500 step=1 ");
+
+	// culling controls and stats
+	TwAddVarRW(twBar, "Occlusion", TW_TYPE_BOOLCPP, &gOcclusionCulling, " group='Culling' ");
+	TwAddVarRO(twBar, "Boxes", TW_TYPE_UINT32, &gNumBoxes, " group='Culling' ");
+	TwAddVarRO(twBar, "Frustum culled", TW_TYPE_UINT32, &gNumFrustumCulled, " group='Culling' ");
+	TwAddVarRO(twBar, "Occluded", TW_TYPE_UINT32, &gNumOccluded, " group='Culling' ");
+	TwAddVarRO(twBar, "Drawn", TW_TYPE_UINT32, &gNumDrawn, " group='Culling' ");
+	TwAddVarRO(twBar, "Box draw calls", TW_TYPE_UINT32, &gNumBoxDraws, " group='Culling' ");
+	TwAddVarRO(twBar, "Box textures bound", TW_TYPE_UINT32, &gNumBoxTextures, " group='Culling' ");
+	TwAddVarRO(twBar, "Chunks loaded", TW_TYPE_UINT32, &gNumChunksLoaded, " group='Culling' ");
+	TwAddVarRO(twBar, "Chunks drawn", TW_TYPE_UINT32, &gNumChunksDrawn, " group='Culling' ");
+	TwAddVarRO(twBar, "Terrain triangles", TW_TYPE_UINT32, &gNumTerrainTriangles, " group='Culling' ");
+
+	// state cache stats
+	TwAddVarRO(twBar, "GL calls issued", TW_TYPE_UINT32, &gNumGLCallsIssued, " group='State' ");
+	TwAddVarRO(twBar, "GL calls elided", TW_TYPE_UINT32, &gNumGLCallsElided, " group='State' ");
+	TwAddVarRO(twBar, "Samplers", TW_TYPE_UINT32, &gNumSamplers, " group='State' ");
+	TwAddVarRO(twBar, "Texture loads", TW_TYPE_UINT32, &gNumTextureLoads, " group='State' ");
+	TwAddVarRO(twBar, "Texture cache hits", TW_TYPE_UINT32, &gNumTextureHits, " group='State' ");
+	TwAddVarRO(twBar, "Texture memory (KB)", TW_TYPE_UINT32, &gTextureMemory, " group='State' ");
+	TwAddVarRO(twBar, "Visible pages", TW_TYPE_UINT32, &gNumVisiblePages, " group='State' ");
+	TwAddVarRO(twBar, "Resident pages", TW_TYPE_UINT32, &gNumResidentPages, " group='State' ");
+	TwAddVarRO(twBar, "Loading pages", TW_TYPE_UINT32, &gNumLoadingPages, " group='State' ");
 
 	// light controls
 	TwAddVarRW(twBar, "Pos: x", TW_TYPE_FLOAT, &gLight.pos.x, " group='Light' min=-5.0 max=5.0 step=0.1 ");
@@ -283,6 +1046,9 @@ TwBar* create_UI(const std::string name)
 
 	// texture controls
 	TwAddVarRW(twBar, "Replace", TW_TYPE_BOOLCPP, &gReplace, " group='Texture' ");
+	TwAddVarRW(twBar, "Compressed", TW_TYPE_BOOLCPP, &gCompressedTexture, " group='Texture' ");
+	TwAddVarRW(twBar, "Texture arrays", TW_TYPE_BOOLCPP, &gTextureArrays, " group='Texture' ");
+	TwAddVarRW(twBar, "Virtual texture", TW_TYPE_BOOLCPP, &gVirtualTexturing, " group='Texture' ");
 
 	// define the enum text
 	TwEnumVal filterValue[] = {
@@ -377,25 +1143,51 @@ int main(void)
 	{
 		update_scene(window);	// update the scene
 
-		// if wireframe set polygon render mode to wireframe
-		if (gWireframe)
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		// find the virtual texture pages in view (read back in a later update)
+		if (gVirtualTexturing && gVirtualTexture.isValid() && !gTerrainEnabled)
+			render_feedback();
+
+		// set polygon render mode to wireframe or fill
+		GLStateCache::polygonMode(gWireframe ? GL_LINE : GL_FILL);
 
 		render_scene();			// render the scene
 
 		// set polygon render mode to fill
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		GLStateCache::polygonMode(GL_FILL);
+
+		// build the depth pyramid for the next frames' occlusion culling
+		if (gOcclusionCulling)
+			gHiZ.build(gProjectionMatrix * gViewMatrix);
+
+		// state cache stats of the frame
+		gNumGLCallsIssued = GLStateCache::getNumIssued();
+		gNumGLCallsElided = GLStateCache::getNumElided();
+		GLStateCache::resetCounters();
 
 		TwDraw();				// draw tweak bar
+		GLStateCache::invalidate();	// (tweak bar drawing changes state behind the cache)
 
 		glfwSwapBuffers(window);	// swap buffers
 		glfwPollEvents();			// poll for events
 	}
 
 	// clean up
-	glDeleteBuffers(1, &gVBO);
-	glDeleteVertexArrays(1, &gVAO);
-	glDeleteTextures(1, &gTextureID);
+	// (the globals would only be destroyed after the context is gone)
+	gVBO.release();
+	gVAO.release();
+	gTextureCache.release(gTextureID);
+	gTextureCache.clear();
+	gSamplerCache.clear();
+	gCubeVBO.release();
+	gCubeIBO.release();
+	gCubeVAO.release();
+	gBoxTextures.clear();
+	gBoxPacker.clear();
+	gBoxInstanceVBO.release();
+	gBoxInstancedVAO.release();
+	gVirtualTexture.release();
+	gTerrain.release();
+	gHiZ.release();
 
 	// uninitialise tweak bar
 	TwDeleteBar(tweakBar);
@@ -0,0 +1,105 @@
+#version 330 core
+
+// interpolated values from the vertex shaders
+in vec3 vPosition;
+in vec3 vNormal;
+in vec2 vTexCoord;
+
+// light properties
+struct Light
+{
+	vec3 pos;
+	vec3 La;
+	vec3 Ld;
+	vec3 Ls;
+	vec3 att;	// constant, linear, quadratic
+};
+
+// material properties
+struct Material
+{
+	vec3 Ka;
+	vec3 Kd;
+	vec3 Ks;
+	float shininess;
+};
+
+// uniform input data
+uniform bool uReplace;
+uniform vec3 uViewpoint;
+uniform Light uLight;
+uniform Material uMaterial;
+uniform float uTexCoordScale;		// texture coordinates to the virtual texture's 0 to 1
+
+// virtual texture (see VirtualTexture)
+uniform sampler2D uPageTable;		// per page and level: cache slot (xy) and level (z) of the resident page to use
+uniform sampler2D uPageCache;		// resident pages with their borders
+uniform vec2 uVirtualSize;			// texels of level 0
+uniform float uPageSize;			// texels per page side (without border)
+uniform float uPageBorder;
+uniform float uCacheSize;			// texels per cache side
+uniform int uMaxLevel;
+
+// sample the virtual texture at the level the texel footprint asks for (or the nearest resident coarser one)
+vec3 sample_virtual(vec2 uv)
+{
+	vec2 texel = min(clamp(uv, 0.0f, 1.0f) * uVirtualSize, uVirtualSize - 1.0f);
+
+	// mip level from the footprint of a pixel in level 0 texels
+	vec2 dx = dFdx(uv * uVirtualSize);
+	vec2 dy = dFdy(uv * uVirtualSize);
+	float lod = 0.5f * log2(max(dot(dx, dx), dot(dy, dy)));
+	int level = clamp(int(floor(lod)), 0, uMaxLevel);
+
+	// page table entry of the page
+	ivec2 page = ivec2(texel / uPageSize) >> level;
+	vec3 entry = floor(texelFetch(uPageTable, page, level).xyz * 255.0f + 0.5f);
+
+	// position within the resident page, then within its cache slot (past the border)
+	float residentPageSize = uPageSize * exp2(entry.z);
+	vec2 inPage = fract(texel / residentPageSize) * uPageSize;
+	vec2 cacheTexel = entry.xy * (uPageSize + 2.0f * uPageBorder) + uPageBorder + inPage;
+	return textureLod(uPageCache, cacheTexel / uCacheSize, 0.0f).rgb;
+}
+
+// output data
+out vec3 fColor;
+
+void main()
+{
+	// fragment normal
+    vec3 n = normalize(vNormal);
+
+	// vector toward the viewer
+	vec3 v = normalize(uViewpoint - vPosition);
+
+	// vector towards the light
+    vec3 l = normalize(uLight.pos - vPosition);
+
+	// halfway vector
+	vec3 h = normalize(l + v);
+
+	// calculate ambient, diffuse and specular intensities
+	vec3 Ia = uLight.La * uMaterial.Ka;
+	vec3 Id = vec3(0.0f);
+	vec3 Is = vec3(0.0f);
+	float dotLN = max(dot(l, n), 0.0f);
+
+	if(dotLN > 0.0f)
+	{
+		// attenuation
+		float dist = length(uLight.pos - vPosition);
+		float attenuation = 1.0f / (uLight.att.x + dist * uLight.att.y + dist * dist * uLight.att.z);
+
+		Id = uLight.Ld * uMaterial.Kd * dotLN * attenuation;
+		Is = uLight.Ls * uMaterial.Ks * pow(max(dot(n, h), 0.0f), uMaterial.shininess) * attenuation;
+	}
+	
+	// set output color
+	fColor = Ia + Id + Is;
+
+	if(uReplace)
+		fColor = sample_virtual(vTexCoord * uTexCoordScale);
+	else
+		fColor *= sample_virtual(vTexCoord * uTexCoordScale);
+}
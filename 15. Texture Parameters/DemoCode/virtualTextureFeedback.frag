@@ -0,0 +1,32 @@
+#version 330 core
+
+// interpolated values from the vertex shaders
+in vec2 vTexCoord;
+
+// uniform input data
+uniform float uTexCoordScale;		// texture coordinates to the virtual texture's 0 to 1
+uniform float uLevelBias;			// -log2 of the feedback buffer's downscale
+
+// virtual texture (see VirtualTexture)
+uniform vec2 uVirtualSize;			// texels of level 0
+uniform float uPageSize;			// texels per page side (without border)
+uniform int uMaxLevel;
+
+// output data
+out uvec4 fPage;
+
+void main()
+{
+	vec2 uv = vTexCoord * uTexCoordScale;
+	vec2 texel = min(clamp(uv, 0.0f, 1.0f) * uVirtualSize, uVirtualSize - 1.0f);
+
+	// mip level as virtualTexture.frag selects it at full resolution
+	vec2 dx = dFdx(uv * uVirtualSize);
+	vec2 dy = dFdy(uv * uVirtualSize);
+	float lod = 0.5f * log2(max(dot(dx, dx), dot(dy, dy))) + uLevelBias;
+	int level = clamp(int(floor(lod)), 0, uMaxLevel);
+
+	// page x, page y, level and 255 to mark a request
+	ivec2 page = ivec2(texel / uPageSize) >> level;
+	fPage = uvec4(uvec2(page), uint(level), 255u);
+}
@@ -0,0 +1,93 @@
+// offline texture encoder: converts an image to a block compressed KTX2 file with a full mipmap chain
+// build (from this directory):
+//   c++ -std=c++11 -O2 -pthread -I../DemoCode encodeTexture.cpp ../DemoCode/BlockCompression.cpp ../DemoCode/KTX2.cpp
+//       ../DemoCode/MipmapGenerator.cpp -o encodeTexture
+// usage:
+//   encodeTexture <input image> <output.ktx2> [bc1|bc3] [-kaiser] [-threads n] [-topdown]
+// rows are stored bottom to top by default, matching the demos' stbi_set_flip_vertically_on_load(true)
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "BlockCompression.h"
+#include "KTX2.h"
+#include "MipmapGenerator.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: encodeTexture <input image> <output.ktx2> [bc1|bc3] [-kaiser] [-threads n] [-topdown]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// options
+	BlockFormat format = BlockFormat::BC1;
+	MipFilter filter = MipFilter::BOX;
+	unsigned numThreads = 0;
+	bool bottomUp = true;
+	for (int i = 3; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "bc1") == 0)
+			format = BlockFormat::BC1;
+		else if (std::strcmp(argv[i], "bc3") == 0)
+			format = BlockFormat::BC3;
+		else if (std::strcmp(argv[i], "-kaiser") == 0)
+			filter = MipFilter::KAISER;
+		else if (std::strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			numThreads = static_cast<unsigned>(std::stoi(argv[++i]));
+		else if (std::strcmp(argv[i], "-topdown") == 0)
+			bottomUp = false;
+		else
+		{
+			std::cerr << "Unknown option " << argv[i] << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// load image data as RGBA
+	stbi_set_flip_vertically_on_load(bottomUp);
+	ImageRGBA image;
+	int channels;
+	unsigned char* pixels = stbi_load(argv[1], &image.width, &image.height, &channels, 4);
+	if (!pixels)
+	{
+		std::cerr << "Unable to load image " << argv[1] << std::endl;
+		return EXIT_FAILURE;
+	}
+	image.pixels.assign(pixels, pixels + static_cast<size_t>(image.width) * image.height * 4);
+	stbi_image_free(pixels);
+
+	KTX2Image ktx;
+	ktx.format = (format == BlockFormat::BC1) ? KTX2_BC1_RGB_UNORM : KTX2_BC3_UNORM;
+	ktx.width = image.width;
+	ktx.height = image.height;
+	ktx.bottomUp = bottomUp;
+
+	// compute the mipmap chain and compress each level
+	auto start = std::chrono::steady_clock::now();
+	std::vector<ImageRGBA> mipmaps = MipmapGenerator::generate(image, filter, false, numThreads);
+	ktx.levels.push_back(BlockCompression::compress(image, format, numThreads));
+	for (const ImageRGBA& mipmap : mipmaps)
+		ktx.levels.push_back(BlockCompression::compress(mipmap, format, numThreads));
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	if (!KTX2::write(argv[2], ktx))
+	{
+		std::cerr << "Unable to write " << argv[2] << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	size_t compressedSize = 0;
+	for (const std::vector<uint8_t>& level : ktx.levels)
+		compressedSize += level.size();
+	std::cout << argv[2] << ": " << ktx.width << "x" << ktx.height << ", " << ktx.levels.size() << " levels, "
+		<< compressedSize << " bytes, encoded in " << milliseconds << " ms" << std::endl;
+
+	return EXIT_SUCCESS;
+}
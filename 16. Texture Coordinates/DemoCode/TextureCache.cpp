@@ -0,0 +1,191 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include "stb_image.h"
+
+// FNV-1a hash of a file's contents
+static uint64_t hash_contents(const std::vector<unsigned char>& contents)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned char byte : contents)
+	{
+		hash ^= byte;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+TextureCache::TextureCache(size_t memoryBudget) : mMemoryBudget(memoryBudget)
+{}
+
+TextureCache::~TextureCache()
+{
+	clear();
+}
+
+// texture of an image file (loaded on first use) with a reference added; 0 if it can't be loaded
+GLuint TextureCache::acquire(const std::string& path)
+{
+	// path seen before
+	auto knownPath = mPaths.find(path);
+	if (knownPath != mPaths.end())
+	{
+		mNumHits++;
+		return use(knownPath->second);
+	}
+
+	// read the file
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Unable to open " << path << std::endl;
+		return 0;
+	}
+	std::vector<unsigned char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	uint64_t hash = hash_contents(contents);
+
+	// same contents under another path
+	auto knownHash = mHashes.find(hash);
+	if (knownHash != mHashes.end())
+	{
+		mNumHits++;
+		knownHash->second->paths.push_back(path);
+		mPaths[path] = knownHash->second;
+		return use(knownHash->second);
+	}
+
+	// new image
+	mEntries.emplace_front();
+	EntryIterator entry = mEntries.begin();
+	if (!load(contents, *entry))
+	{
+		std::cerr << "Unable to load image " << path << std::endl;
+		mEntries.erase(entry);
+		return 0;
+	}
+
+	entry->hash = hash;
+	entry->paths.push_back(path);
+	mPaths[path] = entry;
+	mHashes[hash] = entry;
+	mTextures[entry->texture] = entry;
+	mMemoryUsed += entry->bytes;
+	mNumDecodes++;
+
+	GLuint texture = use(entry);
+	evict();	// make room by deleting unreferenced textures
+	return texture;
+}
+
+// remove a reference added by acquire
+void TextureCache::release(GLuint texture)
+{
+	auto found = mTextures.find(texture);
+	if (found == mTextures.end() || found->second->references == 0)
+		return;
+
+	found->second->references--;
+	evict();
+}
+
+// issue queued texture uploads within the per-frame budget (call once a frame)
+void TextureCache::update()
+{
+	mUploader.update(mUploadBudget);
+}
+
+// bytes of texture memory to keep unreferenced textures within (evicts if exceeded)
+void TextureCache::setMemoryBudget(size_t bytes)
+{
+	mMemoryBudget = bytes;
+	evict();
+}
+
+// delete all textures (references become invalid)
+void TextureCache::clear()
+{
+	mUploader.release();
+	mPaths.clear();
+	mHashes.clear();
+	mTextures.clear();
+	for (const Entry& entry : mEntries)
+		glDeleteTextures(1, &entry.texture);
+	mEntries.clear();
+	mMemoryUsed = 0;
+}
+
+// add a reference and mark as most recently used
+GLuint TextureCache::use(EntryIterator entry)
+{
+	entry->references++;
+	mEntries.splice(mEntries.begin(), mEntries, entry);
+	return entry->texture;
+}
+
+// decode an image and create its texture
+bool TextureCache::load(const std::vector<unsigned char>& contents, Entry& entry)
+{
+	int width, height, channels;
+	unsigned char* data = stbi_load_from_memory(contents.data(), static_cast<int>(contents.size()),
+		&width, &height, &channels, 0);
+	if (!data)
+		return false;
+
+	static const GLenum internalFormats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+
+	// allocate level 0 (the mipmaps are generated once its pixels have been uploaded)
+	glGenTextures(1, &entry.texture);
+	glBindTexture(GL_TEXTURE_2D, entry.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[channels - 1], width, height, 0, formats[channels - 1],
+		GL_UNSIGNED_BYTE, nullptr);
+
+	// stream the pixels in through the uploader's staging buffers
+	GLuint texture = entry.texture;
+	std::vector<uint8_t> pixels(data, data + static_cast<size_t>(width) * height * channels);
+	stbi_image_free(data);
+	mUploader.enqueue(texture, 0, 0, 0, width, height, formats[channels - 1], GL_UNSIGNED_BYTE, channels,
+		std::move(pixels), [texture]()
+	{
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	});
+
+	// estimate memory with 3-channel formats padded to 4 bytes per texel (as drivers usually store them)
+	size_t texelSize = (channels == 3) ? 4 : channels;
+	entry.bytes = 0;
+	for (int level = 0; (width >> level) > 0 || (height >> level) > 0; level++)
+		entry.bytes += texelSize * std::max(1, width >> level) * std::max(1, height >> level);
+
+	return true;
+}
+
+// delete least recently used unreferenced textures until within the budget
+void TextureCache::evict()
+{
+	auto entry = mEntries.end();
+	while (mMemoryUsed > mMemoryBudget && entry != mEntries.begin())
+	{
+		--entry;
+		if (entry->references == 0)
+		{
+			EntryIterator unused = entry++;
+			erase(unused);
+		}
+	}
+}
+
+void TextureCache::erase(EntryIterator entry)
+{
+	for (const std::string& path : entry->paths)
+		mPaths.erase(path);
+	mHashes.erase(entry->hash);
+	mTextures.erase(entry->texture);
+	mUploader.cancel(entry->texture);
+	glDeleteTextures(1, &entry->texture);
+	mMemoryUsed -= entry->bytes;
+	mEntries.erase(entry);
+}
@@ -0,0 +1,88 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "utilities.h"
+#include "TextureUploader.h"
+
+/*****************************************************************
+ * cache of mipmapped 2D textures loaded from image files
+ * textures are keyed by path and by a hash of the file's contents,
+ * so an image is decoded and uploaded once however many users (or
+ * paths) refer to it; users share the texture through reference
+ * counts, and textures nobody references stay cached until the
+ * memory budget is exceeded, when the least recently used ones are
+ * deleted (referenced textures are never evicted)
+ * decoded pixels are streamed in through pixel unpack buffers over
+ * the following frames (see TextureUploader.h), a budgeted number
+ * of bytes per update(), and mipmaps are generated once they are in
+ * textures are shared, so users that need different filtering or
+ * wrapping should use sampler objects rather than the texture's
+ * parameters; files are assumed not to change while cached
+ *****************************************************************/
+class TextureCache
+{
+public:
+	TextureCache(size_t memoryBudget = 64 * 1024 * 1024);
+	~TextureCache();
+
+	// texture of an image file (loaded on first use) with a reference added; 0 if it can't be loaded
+	GLuint acquire(const std::string& path);
+	// remove a reference added by acquire
+	void release(GLuint texture);
+	// issue queued texture uploads within the per-frame budget (call once a frame)
+	void update();
+	// finish queued texture uploads now
+	void flushUploads() { mUploader.flush(); }
+
+	// bytes of texture memory to keep unreferenced textures within (evicts if exceeded)
+	void setMemoryBudget(size_t bytes);
+	// delete all textures (references become invalid)
+	void clear();
+	// bytes of texture data uploaded per update (0 = no limit)
+	void setUploadBudget(size_t bytes) { mUploadBudget = bytes; }
+
+	size_t getMemoryBudget() const { return mMemoryBudget; }
+	size_t getMemoryUsed() const { return mMemoryUsed; }
+	size_t getNumTextures() const { return mEntries.size(); }
+	uint32_t getNumDecodes() const { return mNumDecodes; }		// images decoded and uploaded
+	uint32_t getNumHits() const { return mNumHits; }			// acquires served from the cache
+
+private:
+	struct Entry
+	{
+		uint64_t hash = 0;				// hash of the file contents
+		GLuint texture = 0;
+		size_t bytes = 0;				// estimated texture memory (all levels)
+		uint32_t references = 0;
+		std::vector<std::string> paths;	// paths known to have these contents
+	};
+	typedef std::list<Entry>::iterator EntryIterator;
+
+	std::list<Entry> mEntries;		// most recently used first
+	std::unordered_map<std::string, EntryIterator> mPaths;
+	std::unordered_map<uint64_t, EntryIterator> mHashes;
+	std::unordered_map<GLuint, EntryIterator> mTextures;
+
+	TextureUploader mUploader;
+	size_t mUploadBudget = 4 * 1024 * 1024;
+	size_t mMemoryBudget;
+	size_t mMemoryUsed = 0;
+	uint32_t mNumDecodes = 0;
+	uint32_t mNumHits = 0;
+
+	// add a reference and mark as most recently used
+	GLuint use(EntryIterator entry);
+	// decode an image and create its texture
+	bool load(const std::vector<unsigned char>& contents, Entry& entry);
+	// delete least recently used unreferenced textures until within the budget
+	void evict();
+	void erase(EntryIterator entry);
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "TextureUploader.h"
+
+#include <algorithm>
+#include <cstring>
+
+TextureUploader::TextureUploader(size_t bufferSize, int numBuffers) :
+	mBufferSize(bufferSize), mNumBuffers(std::max(1, numBuffers))
+{}
+
+TextureUploader::~TextureUploader()
+{
+	release();
+}
+
+// queue pixels for a region of a texture level; done is called once all rows have been issued
+void TextureUploader::enqueue(GLuint texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+	GLenum format, GLenum type, GLsizei bytesPerPixel, std::vector<uint8_t> pixels, std::function<void()> done)
+{
+	Upload upload;
+	upload.texture = texture;
+	upload.level = level;
+	upload.x = x;
+	upload.y = y;
+	upload.width = width;
+	upload.height = height;
+	upload.format = format;
+	upload.type = type;
+	upload.rowBytes = static_cast<size_t>(width) * bytesPerPixel;
+	upload.pixels = std::move(pixels);
+	upload.rowsIssued = 0;
+	upload.done = std::move(done);
+	mUploads.push_back(std::move(upload));
+}
+
+// issue queued rows into free staging buffers, up to a number of bytes (0 = no limit); returns bytes issued
+size_t TextureUploader::update(size_t maxBytes)
+{
+	return issue(maxBytes, false);
+}
+
+// issue everything queued (waiting for staging buffers as needed)
+void TextureUploader::flush()
+{
+	issue(0, true);
+}
+
+// drop queued uploads to a texture (e.g. before deleting it)
+void TextureUploader::cancel(GLuint texture)
+{
+	mUploads.erase(std::remove_if(mUploads.begin(), mUploads.end(), [texture](const Upload& upload)
+	{
+		return upload.texture == texture;
+	}), mUploads.end());
+}
+
+// drop queued uploads and delete the staging buffers
+void TextureUploader::release()
+{
+	mUploads.clear();
+	for (Staging& staging : mStaging)
+	{
+		if (staging.fence)
+			glDeleteSync(staging.fence);
+		glDeleteBuffers(1, &staging.buffer);
+	}
+	mStaging.clear();
+	mNextBuffer = 0;
+}
+
+size_t TextureUploader::getPendingBytes() const
+{
+	size_t bytes = 0;
+	for (const Upload& upload : mUploads)
+		bytes += (upload.height - upload.rowsIssued) * upload.rowBytes;
+	return bytes;
+}
+
+size_t TextureUploader::issue(size_t maxBytes, bool wait)
+{
+	// staging buffers are created on first use (when there is a context)
+	if (mStaging.empty())
+	{
+		mStaging.resize(mNumBuffers);
+		for (Staging& staging : mStaging)
+		{
+			glGenBuffers(1, &staging.buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, mBufferSize, nullptr, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	size_t issued = 0;
+	while (!mUploads.empty() && (maxBytes == 0 || issued < maxBytes))
+	{
+		Upload& upload = mUploads.front();
+		GLsizei numRows = upload.height - upload.rowsIssued;
+		const uint8_t* rows = upload.pixels.data() + upload.rowsIssued * upload.rowBytes;
+
+		if (upload.rowBytes > mBufferSize)
+		{
+			// rows too long to stage are copied from client memory
+			texSubImage(upload, numRows, rows);
+		}
+		else
+		{
+			Staging& staging = mStaging[mNextBuffer];
+			if (!isFree(staging, wait))
+				break;	// try again next update
+
+			// as many rows as fit in the buffer and the byte limit (at least one)
+			numRows = std::min(numRows, static_cast<GLsizei>(mBufferSize / upload.rowBytes));
+			if (maxBytes > 0)
+				numRows = std::min(numRows, std::max(1, static_cast<GLsizei>((maxBytes - issued) / upload.rowBytes)));
+			size_t bytes = numRows * upload.rowBytes;
+
+			// the fence guarantees the GPU is done with the buffer, so no implicit synchronisation is needed
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+			void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+			if (!mapped)
+			{
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				break;
+			}
+			std::memcpy(mapped, rows, bytes);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+			// unbound again afterwards, so client memory uploads elsewhere work as before
+			texSubImage(upload, numRows, nullptr);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			mNextBuffer = (mNextBuffer + 1) % mStaging.size();
+		}
+
+		upload.rowsIssued += numRows;
+		issued += numRows * upload.rowBytes;
+
+		if (upload.rowsIssued == upload.height)
+		{
+			std::function<void()> done = std::move(upload.done);
+			mUploads.pop_front();
+			if (done)
+				done();
+		}
+	}
+	return issued;
+}
+
+// whether a staging buffer's previous upload has completed
+bool TextureUploader::isFree(Staging& staging, bool wait)
+{
+	if (!staging.fence)
+		return true;
+
+	GLenum status = glClientWaitSync(staging.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED && wait)
+	{
+		mNumStalls++;
+		do
+		{
+			status = glClientWaitSync(staging.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);	// 1 ms
+		} while (status == GL_TIMEOUT_EXPIRED);
+	}
+	if (status == GL_TIMEOUT_EXPIRED)
+		return false;
+
+	// signalled (or failed, in which case waiting longer won't help)
+	glDeleteSync(staging.fence);
+	staging.fence = nullptr;
+	return true;
+}
+
+// copy rows into a texture from client memory or (with pixels an offset) the bound unpack buffer
+void TextureUploader::texSubImage(const Upload& upload, GLsizei numRows, const void* pixels)
+{
+	// rows are tightly packed
+	if (upload.rowBytes % 4 != 0)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glBindTexture(GL_TEXTURE_2D, upload.texture);
+	glTexSubImage2D(GL_TEXTURE_2D, upload.level, upload.x, upload.y + upload.rowsIssued, upload.width, numRows,
+		upload.format, upload.type, pixels);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (upload.rowBytes % 4 != 0)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
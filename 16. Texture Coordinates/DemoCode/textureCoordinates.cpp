@@ -1,4 +1,5 @@
 #include "utilities.h"
+#include "TextureCache.h"
 
 #define STB_IMAGE_IMPLEMENTATION   
 #include "stb_image.h"
@@ -19,7 +20,9 @@ unsigned int gWindowHeight = 800;
 ShaderProgram gShader;	// shader program object
 GLuint gVBO = 0;		// vertex buffer object identifier
 GLuint gVAO = 0;		// vertex array object identifier
-GLuint gTextureID;		// texture id
+TextureCache gTextureCache;	// textures shared by path and contents
+GLuint gTextureID = 0;		// texture id (referenced from the cache)
+GLuint gSampler = 0;		// sampler object (the cached texture's own parameters are left alone)
 
 // vertex positions, normals and texture coordinates
 std::vector<GLfloat> gVertices =
@@ -46,29 +49,16 @@ static void init(GLFWwindow* window)
 	// compile and link a vertex and fragment shader pair
 	gShader.compileAndLink("textureCoords.vert", "textureCoords.frag");
 
-	// load image data
+	// load texture (decoded once and shared with any other users of the image)
 	stbi_set_flip_vertically_on_load(true); // flip image about y-axis
-	int imageWidth, imageHeight, imageChannels;
-	unsigned char* imageData = stbi_load("./images/check.bmp", &imageWidth, &imageHeight, &imageChannels, 0);
+	gTextureID = gTextureCache.acquire("./images/check.bmp");
 
-	if(!imageData)
-		std::cerr << "Unable to load image." << std::endl;	// output error description
-
-	// generate texture
-	glGenTextures(1, &gTextureID);
-	glBindTexture(GL_TEXTURE_2D, gTextureID);
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	// set texture parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	// free image data
-	stbi_image_free(imageData);
+	// set texture parameters in a sampler (other users of the shared texture keep theirs)
+	glGenSamplers(1, &gSampler);
+	glSamplerParameteri(gSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glSamplerParameteri(gSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glSamplerParameteri(gSampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glSamplerParameteri(gSampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
 	// create VBO
 	glGenBuffers(1, &gVBO);					// generate unused VBO identifier
@@ -91,6 +81,8 @@ static void init(GLFWwindow* window)
 // function used to update the scene
 static void update_scene(GLFWwindow* window)
 {
+	gTextureCache.update();	// stream in queued texture data
+
 	glBindBuffer(GL_ARRAY_BUFFER, gVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * gVertices.size(), &gVertices[0], GL_DYNAMIC_DRAW);
 }
@@ -107,6 +99,7 @@ static void render_scene()
 	gShader.setUniform("uTextureSampler", 0);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, gTextureID);
+	glBindSampler(0, gSampler);
 
 	glBindVertexArray(gVAO);				// make VAO active
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);	// render the vertices
@@ -258,7 +251,9 @@ int main(void)
 	// clean up
 	glDeleteBuffers(1, &gVBO);
 	glDeleteVertexArrays(1, &gVAO);
-	glDeleteTextures(1, &gTextureID);
+	gTextureCache.release(gTextureID);
+	gTextureCache.clear();
+	glDeleteSamplers(1, &gSampler);
 
 	// uninitialise tweak bar
 	TwDeleteBar(tweakBar);
@@ -12,6 +12,7 @@
 //using namespace glm;	// to avoid having to use glm::
 
 #include "ShaderProgram.h"
+#include "TransformHierarchy.h"
 
 // vertex attribute format
 struct VertexColor
@@ -36,7 +37,11 @@ ShaderProgram gShader;	// shader program object
 GLuint gVBO = 0;		// vertex buffer object identifier
 GLuint gVAO = 0;		// vertex array object identifier
 
-std::map<std::string, glm::mat4> gModelMatrix;	// object model matrices
+TransformHierarchy gTransforms;		// object transforms (parents precede children)
+uint32_t gBase, gArm1, gArm2;		// arm nodes
+uint32_t gReflection;				// root of the reflected copy
+uint32_t gRefBase, gRefArm1, gRefArm2;
+std::vector<uint32_t> gDrawNodes;	// nodes rendered with the arm triangle
 
 // function initialise scene and render settings
 static void init(GLFWwindow* window)
@@ -47,13 +52,18 @@ static void init(GLFWwindow* window)
 	// compile and link a vertex and fragment shader pair
 	gShader.compileAndLink("modelTransform.vert", "color.frag");
 
-	// initialise model matrices to the identity matrix
-	gModelMatrix["Base"] = glm::mat4(1.0f);
-	gModelMatrix["Arm1"] = glm::mat4(1.0f);
-	gModelMatrix["Arm2"] = glm::mat4(1.0f);
-	gModelMatrix["RefBase"] = glm::mat4(1.0f);
-	gModelMatrix["RefArm1"] = glm::mat4(1.0f);
-	gModelMatrix["RefArm2"] = glm::mat4(1.0f);
+	// create transform hierarchy (Base -> Arm 1 -> Arm 2)
+	gBase = gTransforms.addNode(gNoParent);
+	gArm1 = gTransforms.addNode(gBase);
+	gArm2 = gTransforms.addNode(gArm1);
+
+	// reflected copy of the arm under a node that reflects in the x-axis
+	gReflection = gTransforms.addNode(gNoParent, glm::scale(glm::vec3(-1.0f, 1.0f, 1.0f)));
+	gRefBase = gTransforms.addNode(gReflection);
+	gRefArm1 = gTransforms.addNode(gRefBase);
+	gRefArm2 = gTransforms.addNode(gRefArm1);
+
+	gDrawNodes = { gBase, gArm1, gArm2, gRefBase, gRefArm1, gRefArm2 };
 
 	// vertex positions and colours
 	std::vector<GLfloat> vertices = {
@@ -91,56 +101,101 @@ static void update_scene(GLFWwindow* window)
 	static float rotateAngle2 = 0.0f;
 	static float rotateAngle3 = 0.0f;
 	static glm::vec3 basePos = glm::vec3(-0.1f, -0.6f, 0.0f);
+	static bool firstUpdate = true;
+
+	// only transforms affected by input are updated (all of them the first time)
+	bool baseChanged = firstUpdate, arm1Changed = firstUpdate, arm2Changed = firstUpdate;
+	firstUpdate = false;
 
 	// update the variables based on keyboard input
 	// update rotation angles
 	if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS)
+	{
 		rotateAngle1 += gRotateSensitivity * gFrameTime;
+		baseChanged = true;
+	}
 	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
+	{
 		rotateAngle1 -= gRotateSensitivity * gFrameTime;
+		baseChanged = true;
+	}
 
 	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+	{
 		rotateAngle2 += gRotateSensitivity * gFrameTime;
+		arm1Changed = true;
+	}
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+	{
 		rotateAngle2 -= gRotateSensitivity * gFrameTime;
+		arm1Changed = true;
+	}
 
 	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+	{
 		rotateAngle3 += gRotateSensitivity * gFrameTime;
+		arm2Changed = true;
+	}
 	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+	{
 		rotateAngle3 -= gRotateSensitivity * gFrameTime;
+		arm2Changed = true;
+	}
 
 	// update move vector
 	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+	{
 		basePos.y += gTranslateSensitivity * gFrameTime;
+		baseChanged = true;
+	}
 	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+	{
 		basePos.y -= gTranslateSensitivity * gFrameTime;
+		baseChanged = true;
+	}
 	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+	{
 		basePos.x -= gTranslateSensitivity * gFrameTime;
+		baseChanged = true;
+	}
 	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+	{
 		basePos.x += gTranslateSensitivity * gFrameTime;
+		baseChanged = true;
+	}
+
+	// update Base's local matrix (the reflected copy shares the local matrices)
+	if (baseChanged)
+	{
+		glm::mat4 base = glm::translate(basePos)
+			* glm::rotate(rotateAngle1, glm::vec3(0.0f, 0.0f, 1.0f))
+			* glm::translate(glm::vec3(0.0f, 0.2f, 0.0f));
+		gTransforms.setLocalMatrix(gBase, base);
+		gTransforms.setLocalMatrix(gRefBase, base);
+	}
 
-	// update Base's model matrix
-	gModelMatrix["Base"] = glm::translate(basePos)
-		* glm::rotate(rotateAngle1, glm::vec3(0.0f, 0.0f, 1.0f))
-		* glm::translate(glm::vec3(0.0f, 0.2f, 0.0f));
-
-	// update Arm 1's model matrix based on Base's model matrix
-	gModelMatrix["Arm1"] = gModelMatrix["Base"]
-		* glm::translate(glm::vec3(0.0f, 0.2f, 0.0f))
-		* glm::rotate(rotateAngle2, glm::vec3(0.0f, 0.0f, 1.0f))
-		* glm::translate(glm::vec3(0.0f, 0.2f, 0.0f));
-
-	// update Arm 2's model matrix based on Arm 1's model matrix
-	gModelMatrix["Arm2"] = gModelMatrix["Arm1"]
-		* glm::translate(glm::vec3(0.0f, 0.2f, 0.0f))
-		* glm::rotate(rotateAngle3, glm::vec3(0.0f, 0.0f, 1.0f))
-		* glm::translate(glm::vec3(0.0f, 0.2f, 0.0f));
-
-	// reflections
-	glm::mat4 reflectX = glm::scale(glm::vec3(-1.0f, 1.0f, 1.0f));
-	gModelMatrix["RefBase"] = reflectX * gModelMatrix["Base"];
-	gModelMatrix["RefArm1"] = reflectX * gModelMatrix["Arm1"];
-	gModelMatrix["RefArm2"] = reflectX * gModelMatrix["Arm2"];
+	// update Arm 1's local matrix relative to Base
+	if (arm1Changed)
+	{
+		glm::mat4 arm1 = glm::translate(glm::vec3(0.0f, 0.2f, 0.0f))
+			* glm::rotate(rotateAngle2, glm::vec3(0.0f, 0.0f, 1.0f))
+			* glm::translate(glm::vec3(0.0f, 0.2f, 0.0f));
+		gTransforms.setLocalMatrix(gArm1, arm1);
+		gTransforms.setLocalMatrix(gRefArm1, arm1);
+	}
+
+	// update Arm 2's local matrix relative to Arm 1
+	if (arm2Changed)
+	{
+		glm::mat4 arm2 = glm::translate(glm::vec3(0.0f, 0.2f, 0.0f))
+			* glm::rotate(rotateAngle3, glm::vec3(0.0f, 0.0f, 1.0f))
+			* glm::translate(glm::vec3(0.0f, 0.2f, 0.0f));
+		gTransforms.setLocalMatrix(gArm2, arm2);
+		gTransforms.setLocalMatrix(gRefArm2, arm2);
+	}
+
+	// recompute the model matrices of changed nodes and their children
+	gTransforms.update();
 }
 
 // function to render the scene
@@ -153,27 +208,12 @@ static void render_scene()
 
 	glBindVertexArray(gVAO);			// make VAO active
 
-	// Base
-	gShader.setUniform("uModelMatrix", gModelMatrix["Base"]);	// set uniform variable
-	glDrawArrays(GL_TRIANGLES, 0, 6);							// render vertices
-
-	// Arm 1
-	gShader.setUniform("uModelMatrix", gModelMatrix["Arm1"]);	// set uniform variable
-	glDrawArrays(GL_TRIANGLES, 0, 6);							// render vertices
-
-	// Arm 2
-	gShader.setUniform("uModelMatrix", gModelMatrix["Arm2"]);	// set uniform variable
-	glDrawArrays(GL_TRIANGLES, 0, 6);							// render vertices
-
-	// reflection
-	gShader.setUniform("uModelMatrix", gModelMatrix["RefBase"]);	// set uniform variable
-	glDrawArrays(GL_TRIANGLES, 0, 6);								// render vertices
-
-	gShader.setUniform("uModelMatrix", gModelMatrix["RefArm1"]);	// set uniform variable
-	glDrawArrays(GL_TRIANGLES, 0, 6);								// render vertices
-
-	gShader.setUniform("uModelMatrix", gModelMatrix["RefArm2"]);	// set uniform variable
-	glDrawArrays(GL_TRIANGLES, 0, 6);								// render vertices
+	// Base, Arm 1, Arm 2 and their reflection
+	for (uint32_t node : gDrawNodes)
+	{
+		gShader.setUniform("uModelMatrix", gTransforms.getWorldMatrix(node));	// set uniform variable
+		glDrawArrays(GL_TRIANGLES, 0, 6);										// render vertices
+	}
 
 	// flush the graphics pipeline
 	glFlush();
@@ -0,0 +1,91 @@
+#include "TransformHierarchy.h"
+
+#include <cassert>
+
+TransformHierarchy::TransformHierarchy()
+{}
+
+TransformHierarchy::~TransformHierarchy()
+{}
+
+// add a node (parent must be an existing node or gNoParent), returns its identifier
+uint32_t TransformHierarchy::addNode(int32_t parent, const glm::mat4& localMatrix)
+{
+	// parents precede their children, which keeps the arrays topologically sorted
+	assert(parent < static_cast<int32_t>(mParent.size()));
+
+	uint32_t node = static_cast<uint32_t>(mParent.size());
+
+	mParent.push_back(parent);
+	mLocalMatrix.push_back(localMatrix);
+	mWorldMatrix.push_back(localMatrix);
+	mDirty.push_back(1);
+
+	if (mFirstDirty > node)
+		mFirstDirty = node;
+
+	return node;
+}
+
+// remove all nodes
+void TransformHierarchy::clear()
+{
+	mParent.clear();
+	mLocalMatrix.clear();
+	mWorldMatrix.clear();
+	mDirty.clear();
+	mFirstDirty = 0;
+	mNumUpdated = 0;
+}
+
+// reserve storage for a number of nodes
+void TransformHierarchy::reserve(size_t numNodes)
+{
+	mParent.reserve(numNodes);
+	mLocalMatrix.reserve(numNodes);
+	mWorldMatrix.reserve(numNodes);
+	mDirty.reserve(numNodes);
+}
+
+// set a node's transform relative to its parent
+void TransformHierarchy::setLocalMatrix(uint32_t node, const glm::mat4& localMatrix)
+{
+	mLocalMatrix[node] = localMatrix;
+	mDirty[node] = 1;
+
+	if (mFirstDirty > node)
+		mFirstDirty = node;
+}
+
+// recompute the world matrices of dirty nodes and their descendants
+void TransformHierarchy::update()
+{
+	mNumUpdated = 0;
+
+	size_t numNodes = mParent.size();
+	for (size_t node = mFirstDirty; node < numNodes; node++)
+	{
+		int32_t parent = mParent[node];
+
+		// a node is dirty if its local matrix or any ancestor changed
+		// (the parent has already been processed, so its flag covers all ancestors)
+		if (parent != gNoParent && mDirty[parent])
+			mDirty[node] = 1;
+
+		if (!mDirty[node])
+			continue;
+
+		if (parent == gNoParent)
+			mWorldMatrix[node] = mLocalMatrix[node];
+		else
+			mWorldMatrix[node] = mWorldMatrix[parent] * mLocalMatrix[node];
+
+		mNumUpdated++;
+	}
+
+	// clear dirty flags (after the pass, as children read their parent's flag)
+	for (size_t node = mFirstDirty; node < numNodes; node++)
+		mDirty[node] = 0;
+
+	mFirstDirty = numNodes;
+}
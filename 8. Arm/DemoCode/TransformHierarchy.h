@@ -0,0 +1,56 @@
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*****************************************************************
+ * flat transform hierarchy
+ * nodes are stored in arrays indexed by node identifier; a node's
+ * parent always has a smaller index (nodes are added after their
+ * parent), so one forward pass computes every world matrix
+ * local matrices that change mark their node dirty, and update()
+ * only recomputes the world matrices of dirty nodes and their
+ * descendants, starting from the first dirty node
+ *****************************************************************/
+
+// parent index of root nodes
+const int32_t gNoParent = -1;
+
+class TransformHierarchy
+{
+public:
+	TransformHierarchy();
+	~TransformHierarchy();
+
+	// add a node (parent must be an existing node or gNoParent), returns its identifier
+	uint32_t addNode(int32_t parent, const glm::mat4& localMatrix = glm::mat4(1.0f));
+	// remove all nodes
+	void clear();
+	// reserve storage for a number of nodes
+	void reserve(size_t numNodes);
+
+	// set a node's transform relative to its parent
+	void setLocalMatrix(uint32_t node, const glm::mat4& localMatrix);
+	const glm::mat4& getLocalMatrix(uint32_t node) const { return mLocalMatrix[node]; }
+	// a node's transform relative to the world (valid after update)
+	const glm::mat4& getWorldMatrix(uint32_t node) const { return mWorldMatrix[node]; }
+	int32_t getParent(uint32_t node) const { return mParent[node]; }
+	size_t getNumNodes() const { return mParent.size(); }
+
+	// recompute the world matrices of dirty nodes and their descendants
+	void update();
+	// number of world matrices recomputed by the last update
+	size_t getNumUpdated() const { return mNumUpdated; }
+
+private:
+	std::vector<int32_t> mParent;			// parent of each node (gNoParent for roots)
+	std::vector<glm::mat4> mLocalMatrix;	// transform relative to the parent
+	std::vector<glm::mat4> mWorldMatrix;	// transform relative to the world
+	std::vector<uint8_t> mDirty;			// world matrix needs to be recomputed
+	size_t mFirstDirty = 0;					// no node before this index is dirty
+	size_t mNumUpdated = 0;
+};
+
+#endif
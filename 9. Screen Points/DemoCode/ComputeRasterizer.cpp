@@ -0,0 +1,147 @@
+#include "ComputeRasterizer.h"
+
+#include <algorithm>
+
+#include "PointCloudFormat.h"
+
+// work group size of the splatting compute shaders
+const GLuint gSplatGroupSize = 256;
+
+// maximum number of work groups per dispatch (points are processed in a grid-stride loop)
+const GLuint gMaxSplatGroups = 4096;
+
+ComputeRasterizer::ComputeRasterizer()
+{}
+
+ComputeRasterizer::~ComputeRasterizer()
+{
+	release();
+}
+
+// delete the storage framebuffer
+void ComputeRasterizer::release()
+{
+	// delete buffers
+	if (mFramebufferSSBO != 0)
+		glDeleteBuffers(1, &mFramebufferSSBO);
+	if (mVAO != 0)
+		glDeleteVertexArrays(1, &mVAO);
+	mFramebufferSSBO = 0;
+	mVAO = 0;
+	mBatches.clear();
+}
+
+// whether the current context supports compute shader splatting
+// (the shaders are #version 430, so the extensions alone are not enough)
+bool ComputeRasterizer::isSupported()
+{
+	return GLEW_VERSION_4_3;
+}
+
+// compile shaders and allocate the storage framebuffer
+void ComputeRasterizer::init(int width, int height)
+{
+	mViewportSize = glm::ivec2(width, height);
+
+	// single pass with 64-bit atomics if available, otherwise depth and colour passes
+	mAtomic64 = GLEW_ARB_gpu_shader_int64 && GLEW_NV_shader_atomic_int64;
+
+	if (mAtomic64)
+	{
+		mSplatShader.compileAndLink("splatPoints.comp");
+	}
+	else
+	{
+		mSplatShader.compileAndLink("splatDepth.comp");
+		mColorShader.compileAndLink("splatColor.comp");
+	}
+	mResolveShader.compileAndLink("resolvePoints.vert", "resolvePoints.frag");
+
+	// large point buffers are bound in ranges that fit into a storage block
+	GLint maxBlockSize = 0, alignment = 0;
+	glGetIntegerv(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	mAlignPoints = std::max<GLint>(1, alignment / static_cast<GLint>(sizeof(CloudPoint)));
+	mMaxPointsPerDispatch = maxBlockSize / static_cast<GLint>(sizeof(CloudPoint)) - mAlignPoints;
+
+	// storage framebuffer: colour (low 32 bits) and depth (high 32 bits) per pixel
+	glGenBuffers(1, &mFramebufferSSBO);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mFramebufferSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(width) * height * 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+
+	// the full screen triangle is generated from gl_VertexID
+	glGenVertexArrays(1, &mVAO);
+}
+
+// clear the storage framebuffer
+void ComputeRasterizer::begin()
+{
+	// all bits set is the furthest depth (and marks empty pixels)
+	GLuint clearValue = 0xFFFFFFFF;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mFramebufferSSBO);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &clearValue);
+
+	mBatches.clear();
+}
+
+// splat count points (CloudPoint records) of a buffer starting at first
+void ComputeRasterizer::splat(GLuint pointBuffer, GLint first, GLsizei count, const glm::mat4& modelViewProjection)
+{
+	while (count > 0)
+	{
+		// bind a range starting at an aligned offset
+		GLint alignedFirst = first - first % mAlignPoints;
+		GLsizei batchCount = std::min(count, mMaxPointsPerDispatch);
+
+		Batch batch = { pointBuffer, static_cast<GLintptr>(alignedFirst) * static_cast<GLintptr>(sizeof(CloudPoint)),
+			first - alignedFirst, batchCount, modelViewProjection };
+
+		dispatch(mSplatShader, batch);
+
+		// without 64-bit atomics the colour pass runs once every depth is known
+		if (!mAtomic64)
+			mBatches.push_back(batch);
+
+		first += batchCount;
+		count -= batchCount;
+	}
+}
+
+// write the splatted points to the current framebuffer (colour and depth)
+void ComputeRasterizer::resolve()
+{
+	// colour pass over all batches after the closest depths are known
+	if (!mAtomic64 && !mBatches.empty())
+	{
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		for (const Batch& batch : mBatches)
+			dispatch(mColorShader, batch);
+	}
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// draw full screen triangle that reads the storage framebuffer
+	mResolveShader.use();
+	mResolveShader.setUniform("uViewportSize", mViewportSize);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mFramebufferSSBO);
+
+	glBindVertexArray(mVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void ComputeRasterizer::dispatch(ShaderProgram& shader, const Batch& batch)
+{
+	shader.use();
+	shader.setUniform("uModelViewProjectionMatrix", batch.modelViewProjection);
+	shader.setUniform("uViewportSize", mViewportSize);
+	shader.setUniform("uFirstPoint", static_cast<int>(batch.first));
+	shader.setUniform("uNumPoints", static_cast<int>(batch.count));
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, batch.buffer, batch.offset,
+		static_cast<GLsizeiptr>(batch.first + batch.count) * static_cast<GLsizeiptr>(sizeof(CloudPoint)));
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mFramebufferSSBO);
+
+	GLuint numGroups = (static_cast<GLuint>(batch.count) + gSplatGroupSize - 1) / gSplatGroupSize;
+	glDispatchCompute(numGroups < gMaxSplatGroups ? numGroups : gMaxSplatGroups, 1, 1);
+}
@@ -0,0 +1,66 @@
+#ifndef COMPUTE_RASTERIZER_H
+#define COMPUTE_RASTERIZER_H
+
+#include <vector>
+#include <GLEW/glew.h>
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.h"
+
+/*****************************************************************
+ * point renderer that splats points with compute shaders instead
+ * of rasterising GL_POINTS primitives
+ * each pixel of a shader storage buffer holds the closest point's
+ * depth and colour; with 64-bit atomics both are updated by a single
+ * atomicMin, otherwise a depth pass is followed by a colour pass
+ * requires OpenGL 4.3 (compute shaders and storage buffers)
+ *****************************************************************/
+class ComputeRasterizer
+{
+public:
+	ComputeRasterizer();
+	~ComputeRasterizer();
+
+	// whether the current context supports compute shader splatting
+	static bool isSupported();
+
+	// compile shaders and allocate the storage framebuffer
+	void init(int width, int height);
+	// clear the storage framebuffer
+	void begin();
+	// splat count points (CloudPoint records) of a buffer starting at first
+	void splat(GLuint pointBuffer, GLint first, GLsizei count, const glm::mat4& modelViewProjection);
+	// write the splatted points to the current framebuffer (colour and depth)
+	void resolve();
+	// delete the storage framebuffer
+	void release();
+
+	bool usesAtomic64() const { return mAtomic64; }
+
+private:
+	struct Batch
+	{
+		GLuint buffer;
+		GLintptr offset;			// bound range of the point buffer
+		GLint first;				// first point relative to the bound range
+		GLsizei count;
+		glm::mat4 modelViewProjection;
+	};
+
+	bool mAtomic64 = false;			// 64-bit atomics available
+	GLint mMaxPointsPerDispatch = 0;	// limited by the maximum storage block size
+	GLint mAlignPoints = 1;			// storage buffer offset alignment (in points)
+	glm::ivec2 mViewportSize;
+	GLuint mFramebufferSSBO = 0;	// one (colour, depth) pair per pixel
+	GLuint mVAO = 0;				// empty VAO for the full screen triangle
+
+	ShaderProgram mSplatShader;		// 64-bit: depth and colour, otherwise: depth pass
+	ShaderProgram mColorShader;		// colour pass (without 64-bit atomics)
+	ShaderProgram mResolveShader;	// copies the storage framebuffer to the screen
+
+	std::vector<Batch> mBatches;	// splatted since begin (needed for the colour pass)
+
+	void dispatch(ShaderProgram& shader, const Batch& batch);
+};
+
+#endif
@@ -0,0 +1,765 @@
+#include "OctreeBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <sstream>
+#include <unordered_set>
+
+// number of subsampling grid cells along each edge of a node
+const uint32_t gSubsampleGrid = 128;
+
+// deepest level created (guards against piles of duplicate points)
+const uint32_t gMaxOctreeLevel = 24;
+
+// number of points read from the input at once
+const size_t gReadBatchSize = 1 << 20;
+
+// number of points buffered per chunk before appending to its chunk file
+const size_t gChunkFlushSize = 4096;
+
+/*****************************************************************
+ * point reader for raw binary and PLY files
+ *****************************************************************/
+class PointReader
+{
+public:
+	// open a point cloud file (.ply or raw binary CloudPoint records)
+	bool open(const std::string& filename);
+	// read up to maxPoints points, returns the number of points read
+	size_t read(std::vector<CloudPoint>& points, size_t maxPoints);
+	// restart reading from the first point
+	void rewind();
+
+	uint64_t getNumPoints() const { return mNumPoints; }
+
+private:
+	enum class Format { RAW, PLY_ASCII, PLY_BINARY };
+	enum class Type { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+	std::ifstream mFile;
+	Format mFormat = Format::RAW;
+	uint64_t mNumPoints = 0;			// number of points in the file
+	uint64_t mNumRead = 0;				// number of points read so far
+	std::streampos mDataStart = 0;		// file position of the first point
+	size_t mStride = 0;					// bytes per vertex (binary PLY)
+	size_t mNumProperties = 0;			// properties per vertex (ASCII PLY)
+	int mIndex[6] = { -1, -1, -1, -1, -1, -1 };	// property index of x, y, z, red, green, blue
+	size_t mOffset[6] = { 0 };			// byte offset of x, y, z, red, green, blue
+	Type mType[6] = {};					// type of x, y, z, red, green, blue
+	std::vector<char> mBuffer;			// binary PLY read buffer
+
+	bool readPlyHeader(const std::string& filename);
+	static bool parseType(const std::string& name, Type& type, size_t& size);
+	static double readValue(const char* data, Type type);
+	static GLubyte toColor(double value, Type type);
+};
+
+bool PointReader::parseType(const std::string& name, Type& type, size_t& size)
+{
+	if (name == "char" || name == "int8") { type = Type::INT8; size = 1; }
+	else if (name == "uchar" || name == "uint8") { type = Type::UINT8; size = 1; }
+	else if (name == "short" || name == "int16") { type = Type::INT16; size = 2; }
+	else if (name == "ushort" || name == "uint16") { type = Type::UINT16; size = 2; }
+	else if (name == "int" || name == "int32") { type = Type::INT32; size = 4; }
+	else if (name == "uint" || name == "uint32") { type = Type::UINT32; size = 4; }
+	else if (name == "float" || name == "float32") { type = Type::FLOAT32; size = 4; }
+	else if (name == "double" || name == "float64") { type = Type::FLOAT64; size = 8; }
+	else return false;
+
+	return true;
+}
+
+double PointReader::readValue(const char* data, Type type)
+{
+	switch (type)
+	{
+	case Type::INT8: { int8_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+	case Type::UINT8: { uint8_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+	case Type::INT16: { int16_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+	case Type::UINT16: { uint16_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+	case Type::INT32: { int32_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+	case Type::UINT32: { uint32_t v; std::memcpy(&v, data, sizeof(v)); return v; }
+	case Type::FLOAT32: { float v; std::memcpy(&v, data, sizeof(v)); return v; }
+	case Type::FLOAT64: { double v; std::memcpy(&v, data, sizeof(v)); return v; }
+	}
+	return 0.0;
+}
+
+GLubyte PointReader::toColor(double value, Type type)
+{
+	// floating point colours are in [0, 1], 16-bit colours in [0, 65535]
+	if (type == Type::FLOAT32 || type == Type::FLOAT64)
+		value *= 255.0;
+	else if (type == Type::UINT16)
+		value /= 257.0;
+
+	return static_cast<GLubyte>(std::min(std::max(value, 0.0), 255.0));
+}
+
+bool PointReader::readPlyHeader(const std::string& filename)
+{
+	std::string line;
+	bool inVertexElement = false;
+	bool vertexElementFound = false;
+	size_t propertyOffset = 0;
+
+	while (std::getline(mFile, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		std::istringstream stream(line);
+		std::string keyword;
+		stream >> keyword;
+
+		if (keyword == "format")
+		{
+			std::string format;
+			stream >> format;
+
+			if (format == "ascii")
+				mFormat = Format::PLY_ASCII;
+			else if (format == "binary_little_endian")
+				mFormat = Format::PLY_BINARY;
+			else
+			{
+				std::cerr << "Unsupported PLY format (" << format << "): " << filename << std::endl;
+				return false;
+			}
+		}
+		else if (keyword == "element")
+		{
+			std::string name;
+			uint64_t count;
+			stream >> name >> count;
+
+			inVertexElement = (name == "vertex");
+			if (inVertexElement)
+			{
+				mNumPoints = count;
+				vertexElementFound = true;
+			}
+			else if (!vertexElementFound && count > 0)
+			{
+				std::cerr << "PLY vertex element must come first: " << filename << std::endl;
+				return false;
+			}
+		}
+		else if (keyword == "property" && inVertexElement)
+		{
+			std::string typeName, name;
+			stream >> typeName >> name;
+
+			Type type;
+			size_t size;
+			if (!parseType(typeName, type, size))
+			{
+				std::cerr << "Unsupported PLY vertex property (" << typeName << "): " << filename << std::endl;
+				return false;
+			}
+
+			// find the attributes used by the renderer
+			const char* names[6][2] = { { "x", "x" }, { "y", "y" }, { "z", "z" },
+				{ "red", "r" }, { "green", "g" }, { "blue", "b" } };
+
+			for (int i = 0; i < 6; i++)
+			{
+				if (name == names[i][0] || name == names[i][1])
+				{
+					mIndex[i] = static_cast<int>(mNumProperties);
+					mOffset[i] = propertyOffset;
+					mType[i] = type;
+				}
+			}
+
+			propertyOffset += size;
+			mNumProperties++;
+		}
+		else if (keyword == "end_header")
+		{
+			mStride = propertyOffset;
+
+			if (mIndex[0] < 0 || mIndex[1] < 0 || mIndex[2] < 0)
+			{
+				std::cerr << "PLY file has no vertex positions: " << filename << std::endl;
+				return false;
+			}
+			return true;
+		}
+	}
+
+	std::cerr << "Invalid PLY header: " << filename << std::endl;
+	return false;
+}
+
+// open a point cloud file (.ply or raw binary CloudPoint records)
+bool PointReader::open(const std::string& filename)
+{
+	mFile.open(filename, std::ios::in | std::ios::binary);
+
+	if (!mFile.is_open())
+	{
+		std::cerr << "Failed to open: " << filename << std::endl;
+		return false;
+	}
+
+	// check for the PLY magic number
+	char magic[4] = { 0 };
+	mFile.read(magic, 3);
+
+	if (std::strncmp(magic, "ply", 3) == 0)
+	{
+		if (!readPlyHeader(filename))
+			return false;
+	}
+	else
+	{
+		// raw binary file of CloudPoint records
+		mFormat = Format::RAW;
+		mFile.seekg(0, std::ios::end);
+		mNumPoints = static_cast<uint64_t>(mFile.tellg()) / sizeof(CloudPoint);
+		mFile.seekg(0, std::ios::beg);
+	}
+
+	mDataStart = mFile.tellg();
+	mNumRead = 0;
+	return true;
+}
+
+// restart reading from the first point
+void PointReader::rewind()
+{
+	mFile.clear();
+	mFile.seekg(mDataStart);
+	mNumRead = 0;
+}
+
+// read up to maxPoints points, returns the number of points read
+size_t PointReader::read(std::vector<CloudPoint>& points, size_t maxPoints)
+{
+	size_t count = static_cast<size_t>(std::min<uint64_t>(maxPoints, mNumPoints - mNumRead));
+	points.resize(count);
+
+	if (mFormat == Format::RAW)
+	{
+		mFile.read(reinterpret_cast<char*>(points.data()), count * sizeof(CloudPoint));
+	}
+	else if (mFormat == Format::PLY_BINARY)
+	{
+		mBuffer.resize(count * mStride);
+		mFile.read(mBuffer.data(), mBuffer.size());
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const char* vertex = &mBuffer[i * mStride];
+
+			for (int j = 0; j < 3; j++)
+				points[i].position[j] = static_cast<GLfloat>(readValue(vertex + mOffset[j], mType[j]));
+
+			for (int j = 0; j < 3; j++)
+				points[i].color[j] = mIndex[3 + j] < 0 ? 255 : toColor(readValue(vertex + mOffset[3 + j], mType[3 + j]), mType[3 + j]);
+
+			points[i].color[3] = 255;
+		}
+	}
+	else
+	{
+		std::vector<double> values(mNumProperties);
+		std::string line;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			for (size_t j = 0; j < mNumProperties; j++)
+				mFile >> values[j];
+
+			for (int j = 0; j < 3; j++)
+				points[i].position[j] = static_cast<GLfloat>(values[mIndex[j]]);
+
+			for (int j = 0; j < 3; j++)
+				points[i].color[j] = mIndex[3 + j] < 0 ? 255 : toColor(values[mIndex[3 + j]], mType[3 + j]);
+
+			points[i].color[3] = 255;
+		}
+	}
+
+	if (!mFile)
+	{
+		std::cerr << "Unexpected end of point data" << std::endl;
+		mNumRead = mNumPoints;
+		points.clear();
+		return 0;
+	}
+
+	mNumRead += count;
+	return count;
+}
+
+/*****************************************************************
+ * octree builder
+ *****************************************************************/
+OctreeBuilder::OctreeBuilder() : mRandom(12345)
+{}
+
+// build octree file from a point cloud file
+bool OctreeBuilder::build(const std::string& inputFilename, const std::string& outputFilename)
+{
+	PointReader reader;
+	if (!reader.open(inputFilename))
+		return false;
+
+	if (reader.getNumPoints() == 0)
+	{
+		std::cerr << "No points in: " << inputFilename << std::endl;
+		return false;
+	}
+
+	std::vector<CloudPoint> batch;
+
+/****************************************************************
+ * Step 1: compute the bounds of the point cloud
+ ****************************************************************/
+	std::cout << "Reading bounds of " << reader.getNumPoints() << " points" << std::endl;
+
+	float minimum[3] = { INFINITY, INFINITY, INFINITY };
+	float maximum[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+	while (reader.read(batch, gReadBatchSize) > 0)
+	{
+		for (const CloudPoint& point : batch)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				minimum[i] = std::min(minimum[i], point.position[i]);
+				maximum[i] = std::max(maximum[i], point.position[i]);
+			}
+		}
+	}
+
+	// cubic bounds, slightly enlarged so the maximum lies inside
+	mBoundsSize = std::max({ maximum[0] - minimum[0], maximum[1] - minimum[1], maximum[2] - minimum[2] });
+	mBoundsSize = std::max(mBoundsSize * 1.0001f, 1.0e-6f);
+	std::copy(minimum, minimum + 3, mBoundsMin);
+
+/****************************************************************
+ * Step 2: distribute the points into chunk files
+ ****************************************************************/
+	// choose chunk level so that each chunk (on average) fits the budget
+	mChunkLevel = 0;
+	while (mChunkLevel < 4 && reader.getNumPoints() >> (3 * mChunkLevel) > mChunkPointBudget)
+		mChunkLevel++;
+
+	const size_t chunksPerAxis = size_t(1) << mChunkLevel;
+	const size_t numChunks = chunksPerAxis * chunksPerAxis * chunksPerAxis;
+	const float chunkSize = mBoundsSize / chunksPerAxis;
+
+	std::cout << "Distributing points into " << numChunks << " chunks" << std::endl;
+
+	std::vector<std::vector<CloudPoint>> chunkBuffers(numChunks);
+	std::vector<bool> chunkUsed(numChunks, false);
+
+	// append buffered points to a chunk file
+	auto flushChunk = [&](size_t chunk)
+	{
+		FILE* file = std::fopen(chunkFilename(outputFilename, chunk).c_str(), chunkUsed[chunk] ? "ab" : "wb");
+		if (file == nullptr)
+			return false;
+
+		std::fwrite(chunkBuffers[chunk].data(), sizeof(CloudPoint), chunkBuffers[chunk].size(), file);
+		std::fclose(file);
+		chunkBuffers[chunk].clear();
+		chunkUsed[chunk] = true;
+		return true;
+	};
+
+	reader.rewind();
+	while (reader.read(batch, gReadBatchSize) > 0)
+	{
+		for (const CloudPoint& point : batch)
+		{
+			size_t cell[3];
+			for (int i = 0; i < 3; i++)
+				cell[i] = std::min(static_cast<size_t>((point.position[i] - mBoundsMin[i]) / chunkSize), chunksPerAxis - 1);
+
+			size_t chunk = (cell[0] * chunksPerAxis + cell[1]) * chunksPerAxis + cell[2];
+			chunkBuffers[chunk].push_back(point);
+
+			if (chunkBuffers[chunk].size() >= gChunkFlushSize && !flushChunk(chunk))
+			{
+				std::cerr << "Failed to write chunk file: " << chunkFilename(outputFilename, chunk) << std::endl;
+				return false;
+			}
+		}
+	}
+
+	for (size_t chunk = 0; chunk < numChunks; chunk++)
+	{
+		if (!chunkBuffers[chunk].empty() && !flushChunk(chunk))
+		{
+			std::cerr << "Failed to write chunk file: " << chunkFilename(outputFilename, chunk) << std::endl;
+			return false;
+		}
+	}
+	chunkBuffers.clear();
+
+/****************************************************************
+ * Step 3: build the subtree of each chunk in memory
+ ****************************************************************/
+	mOutput.open(outputFilename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!mOutput.is_open())
+	{
+		std::cerr << "Failed to open: " << outputFilename << std::endl;
+		return false;
+	}
+
+	// reserve space for the header (written once the node table is known)
+	OctreeFileHeader header = {};
+	mOutput.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	mWriteOffset = sizeof(header);
+	mNodes.clear();
+	mNumPoints = 0;
+	mNumDropped = 0;
+
+	std::vector<int32_t> chunkRoots(numChunks, -1);
+
+	for (size_t chunk = 0; chunk < numChunks; chunk++)
+	{
+		if (!chunkUsed[chunk])
+			continue;
+
+		// load chunk points
+		std::string filename = chunkFilename(outputFilename, chunk);
+		FILE* file = std::fopen(filename.c_str(), "rb");
+		if (file == nullptr)
+		{
+			std::cerr << "Failed to open: " << filename << std::endl;
+			return false;
+		}
+
+		std::fseek(file, 0, SEEK_END);
+		std::vector<CloudPoint> points(std::ftell(file) / sizeof(CloudPoint));
+		std::fseek(file, 0, SEEK_SET);
+		size_t numRead = std::fread(points.data(), sizeof(CloudPoint), points.size(), file);
+		std::fclose(file);
+		std::remove(filename.c_str());
+		points.resize(numRead);
+
+		size_t x = chunk / (chunksPerAxis * chunksPerAxis);
+		size_t y = (chunk / chunksPerAxis) % chunksPerAxis;
+		size_t z = chunk % chunksPerAxis;
+		float chunkMin[3] = { mBoundsMin[0] + x * chunkSize, mBoundsMin[1] + y * chunkSize, mBoundsMin[2] + z * chunkSize };
+
+		// chunk roots keep their points, the upper levels take points from them
+		chunkRoots[chunk] = buildSubtree(points, chunkMin, chunkSize, mChunkLevel, true);
+
+		std::cout << "Built chunk " << chunk + 1 << "/" << numChunks << " (" << numRead << " points)" << std::endl;
+	}
+
+/****************************************************************
+ * Step 4: build the levels above the chunks and write node table
+ ****************************************************************/
+	buildUpperLevels(chunkRoots);
+
+	int32_t root = chunkRoots[0];
+	if (!writeNodeTable(root))
+		return false;
+
+	if (mNumDropped > 0)
+		std::cout << "Dropped " << mNumDropped << " duplicate points" << std::endl;
+
+	std::cout << "Wrote " << mNumPoints << " points in " << mNodes.size() << " nodes to " << outputFilename << std::endl;
+
+	mNodes.clear();
+	mOutput.close();
+	return true;
+}
+
+int32_t OctreeBuilder::createNode(const float boundsMin[3], float size, uint32_t level)
+{
+	BuildNode node;
+	std::copy(boundsMin, boundsMin + 3, node.boundsMin);
+	node.size = size;
+	node.level = level;
+	std::fill(node.children, node.children + 8, -1);
+
+	mNodes.push_back(std::move(node));
+	return static_cast<int32_t>(mNodes.size() - 1);
+}
+
+// accept at most one candidate per subsampling grid cell (up to the node's point limit)
+void OctreeBuilder::subsample(std::vector<CloudPoint>& candidates, BuildNode& node, std::vector<bool>& accepted)
+{
+	accepted.assign(candidates.size(), false);
+
+	// leaf nodes and nodes at the maximum depth take everything that fits
+	bool hasChildren = std::any_of(node.children, node.children + 8, [](int32_t c) { return c >= 0; });
+	if ((!hasChildren && candidates.size() <= mMaxPointsPerNode) || node.level >= gMaxOctreeLevel)
+	{
+		size_t count = std::min<size_t>(candidates.size(), mMaxPointsPerNode);
+		std::fill(accepted.begin(), accepted.begin() + count, true);
+		node.points.insert(node.points.end(), candidates.begin(), candidates.begin() + count);
+		return;
+	}
+
+	const float cellSize = node.size / gSubsampleGrid;
+	std::unordered_set<uint32_t> occupied;
+	occupied.reserve(mMaxPointsPerNode * 2);
+
+	for (size_t i = 0; i < candidates.size() && node.points.size() < mMaxPointsPerNode; i++)
+	{
+		uint32_t cell[3];
+		for (int j = 0; j < 3; j++)
+		{
+			float offset = (candidates[i].position[j] - node.boundsMin[j]) / cellSize;
+			cell[j] = std::min(static_cast<uint32_t>(std::max(offset, 0.0f)), gSubsampleGrid - 1);
+		}
+
+		uint32_t key = (cell[0] * gSubsampleGrid + cell[1]) * gSubsampleGrid + cell[2];
+		if (occupied.insert(key).second)
+		{
+			accepted[i] = true;
+			node.points.push_back(candidates[i]);
+		}
+	}
+}
+
+int32_t OctreeBuilder::buildSubtree(std::vector<CloudPoint>& points, const float boundsMin[3], float size, uint32_t level, bool keepPoints)
+{
+	int32_t index = createNode(boundsMin, size, level);
+
+	// random order so that the subsample is spread evenly
+	std::shuffle(points.begin(), points.end(), mRandom);
+
+	std::vector<bool> accepted;
+	subsample(points, mNodes[index], accepted);
+
+	// distribute the remaining points between the children
+	std::vector<CloudPoint> childPoints[8];
+	const float childSize = size * 0.5f;
+
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		if (accepted[i])
+			continue;
+
+		if (level >= gMaxOctreeLevel)
+		{
+			mNumDropped++;
+			continue;
+		}
+
+		int child = 0;
+		for (int j = 0; j < 3; j++)
+		{
+			if (points[i].position[j] >= boundsMin[j] + childSize)
+				child |= 4 >> j;
+		}
+		childPoints[child].push_back(points[i]);
+	}
+
+	// free the input before recursing
+	std::vector<CloudPoint>().swap(points);
+
+	if (!keepPoints)
+		writeNodePoints(mNodes[index]);
+
+	for (int child = 0; child < 8; child++)
+	{
+		if (childPoints[child].empty())
+			continue;
+
+		float childMin[3] = {
+			boundsMin[0] + ((child & 4) ? childSize : 0.0f),
+			boundsMin[1] + ((child & 2) ? childSize : 0.0f),
+			boundsMin[2] + ((child & 1) ? childSize : 0.0f) };
+
+		int32_t childIndex = buildSubtree(childPoints[child], childMin, childSize, level + 1, false);
+		mNodes[index].children[child] = childIndex;
+	}
+
+	return index;
+}
+
+// build nodes above the chunk level by moving a subsample of the children's points up
+void OctreeBuilder::buildUpperLevels(std::vector<int32_t>& chunkRoots)
+{
+	std::vector<int32_t> childGrid = chunkRoots;
+
+	for (int level = static_cast<int>(mChunkLevel) - 1; level >= 0; level--)
+	{
+		const size_t childDim = size_t(1) << (level + 1);
+		const size_t dim = size_t(1) << level;
+		const float size = mBoundsSize / dim;
+		std::vector<int32_t> grid(dim * dim * dim, -1);
+
+		for (size_t x = 0; x < dim; x++)
+		for (size_t y = 0; y < dim; y++)
+		for (size_t z = 0; z < dim; z++)
+		{
+			// gather candidate points from the children
+			std::vector<CloudPoint> candidates;
+			std::vector<std::pair<int, size_t>> origin;	// (child, index in child)
+			int32_t children[8];
+
+			for (int child = 0; child < 8; child++)
+			{
+				size_t cx = 2 * x + ((child & 4) ? 1 : 0);
+				size_t cy = 2 * y + ((child & 2) ? 1 : 0);
+				size_t cz = 2 * z + ((child & 1) ? 1 : 0);
+				children[child] = childGrid[(cx * childDim + cy) * childDim + cz];
+
+				if (children[child] < 0)
+					continue;
+
+				const std::vector<CloudPoint>& childPoints = mNodes[children[child]].points;
+				for (size_t i = 0; i < childPoints.size(); i++)
+				{
+					candidates.push_back(childPoints[i]);
+					origin.emplace_back(child, i);
+				}
+			}
+
+			if (std::none_of(children, children + 8, [](int32_t c) { return c >= 0; }))
+				continue;
+
+			float boundsMin[3] = { mBoundsMin[0] + x * size, mBoundsMin[1] + y * size, mBoundsMin[2] + z * size };
+			int32_t index = createNode(boundsMin, size, level);
+			std::copy(children, children + 8, mNodes[index].children);
+
+			// shuffle candidates (together with their origin)
+			for (size_t i = candidates.size(); i > 1; i--)
+			{
+				size_t j = std::uniform_int_distribution<size_t>(0, i - 1)(mRandom);
+				std::swap(candidates[i - 1], candidates[j]);
+				std::swap(origin[i - 1], origin[j]);
+			}
+
+			// a parent never takes more points than its children hold
+			std::vector<bool> accepted;
+			subsample(candidates, mNodes[index], accepted);
+
+			// remove the accepted points from the children
+			std::vector<std::vector<bool>> removed(8);
+			for (int child = 0; child < 8; child++)
+			{
+				if (children[child] >= 0)
+					removed[child].assign(mNodes[children[child]].points.size(), false);
+			}
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				if (accepted[i])
+					removed[origin[i].first][origin[i].second] = true;
+			}
+
+			for (int child = 0; child < 8; child++)
+			{
+				if (children[child] < 0)
+					continue;
+
+				std::vector<CloudPoint>& childPoints = mNodes[children[child]].points;
+				std::vector<CloudPoint> remaining;
+				for (size_t i = 0; i < childPoints.size(); i++)
+				{
+					if (!removed[child][i])
+						remaining.push_back(childPoints[i]);
+				}
+				childPoints.swap(remaining);
+
+				// the child is final now
+				writeNodePoints(mNodes[children[child]]);
+			}
+
+			grid[(x * dim + y) * dim + z] = index;
+		}
+
+		childGrid.swap(grid);
+	}
+
+	// write the root's points
+	writeNodePoints(mNodes[childGrid[0]]);
+	chunkRoots.assign(1, childGrid[0]);
+}
+
+void OctreeBuilder::writeNodePoints(BuildNode& node)
+{
+	node.dataOffset = mWriteOffset;
+	node.numPoints = static_cast<uint32_t>(node.points.size());
+
+	mOutput.write(reinterpret_cast<const char*>(node.points.data()), node.points.size() * sizeof(CloudPoint));
+	mWriteOffset += node.points.size() * sizeof(CloudPoint);
+	mNumPoints += node.points.size();
+
+	std::vector<CloudPoint>().swap(node.points);
+}
+
+// write the nodes in breadth-first order followed by the header
+bool OctreeBuilder::writeNodeTable(int32_t root)
+{
+	// breadth-first order (parents before children)
+	std::vector<int32_t> order;
+	std::vector<int32_t> newIndex(mNodes.size(), -1);
+	std::queue<int32_t> queue;
+	queue.push(root);
+
+	while (!queue.empty())
+	{
+		int32_t index = queue.front();
+		queue.pop();
+
+		newIndex[index] = static_cast<int32_t>(order.size());
+		order.push_back(index);
+
+		for (int32_t child : mNodes[index].children)
+		{
+			if (child >= 0)
+				queue.push(child);
+		}
+	}
+
+	uint64_t nodeTableOffset = mWriteOffset;
+
+	for (int32_t index : order)
+	{
+		const BuildNode& node = mNodes[index];
+
+		OctreeFileNode fileNode = {};
+		fileNode.dataOffset = node.dataOffset;
+		fileNode.numPoints = node.numPoints;
+		fileNode.level = node.level;
+		for (int child = 0; child < 8; child++)
+			fileNode.children[child] = node.children[child] < 0 ? -1 : newIndex[node.children[child]];
+		std::copy(node.boundsMin, node.boundsMin + 3, fileNode.boundsMin);
+		fileNode.size = node.size;
+		fileNode.spacing = node.size / gSubsampleGrid;
+
+		mOutput.write(reinterpret_cast<const char*>(&fileNode), sizeof(fileNode));
+	}
+
+	OctreeFileHeader header = {};
+	std::memcpy(header.magic, gOctreeMagic, sizeof(header.magic));
+	header.version = gOctreeVersion;
+	header.numNodes = static_cast<uint32_t>(order.size());
+	header.maxPointsPerNode = mMaxPointsPerNode;
+	header.numPoints = mNumPoints;
+	header.nodeTableOffset = nodeTableOffset;
+	std::copy(mBoundsMin, mBoundsMin + 3, header.boundsMin);
+	header.boundsSize = mBoundsSize;
+
+	mOutput.seekp(0);
+	mOutput.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	if (!mOutput)
+	{
+		std::cerr << "Failed to write octree file" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+std::string OctreeBuilder::chunkFilename(const std::string& outputFilename, size_t chunk) const
+{
+	return outputFilename + ".chunk" + std::to_string(chunk) + ".tmp";
+}
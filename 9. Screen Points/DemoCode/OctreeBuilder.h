@@ -0,0 +1,70 @@
+#ifndef OCTREE_BUILDER_H
+#define OCTREE_BUILDER_H
+
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "PointCloudFormat.h"
+
+/*****************************************************************
+ * offline octree builder for large point clouds
+ * reads a PLY file (ASCII or binary little endian) or a raw binary
+ * file of CloudPoint records and writes an octree point cloud file
+ *
+ * the input is processed out-of-core: points are first distributed
+ * into chunk files on disk, each chunk's subtree is then built in
+ * memory, and finally the upper levels are built by subsampling
+ * the chunk roots
+ *****************************************************************/
+class OctreeBuilder
+{
+public:
+	OctreeBuilder();
+
+	// maximum number of points stored in one node
+	void setMaxPointsPerNode(uint32_t maxPoints) { mMaxPointsPerNode = maxPoints; }
+	// approximate number of points processed in memory at once
+	void setChunkPointBudget(uint64_t budget) { mChunkPointBudget = budget; }
+
+	// build octree file from a point cloud file
+	bool build(const std::string& inputFilename, const std::string& outputFilename);
+
+private:
+	struct BuildNode
+	{
+		float boundsMin[3];
+		float size;
+		uint32_t level;
+		int32_t children[8];
+		std::vector<CloudPoint> points;
+		uint64_t dataOffset = 0;
+		uint32_t numPoints = 0;
+	};
+
+	uint32_t mMaxPointsPerNode = 20000;
+	uint64_t mChunkPointBudget = 4000000;
+
+	std::vector<BuildNode> mNodes;	// all nodes built so far
+	std::ofstream mOutput;			// output octree file
+	uint64_t mWriteOffset = 0;		// current end of the output file
+	uint64_t mNumPoints = 0;		// points written to the output file
+	uint64_t mNumDropped = 0;		// duplicate points dropped at the maximum depth
+	std::mt19937 mRandom;			// random order for subsampling
+
+	float mBoundsMin[3] = { 0.0f, 0.0f, 0.0f };
+	float mBoundsSize = 0.0f;
+	uint32_t mChunkLevel = 0;		// octree level of the chunk roots
+
+	int32_t createNode(const float boundsMin[3], float size, uint32_t level);
+	int32_t buildSubtree(std::vector<CloudPoint>& points, const float boundsMin[3], float size, uint32_t level, bool keepPoints);
+	void subsample(std::vector<CloudPoint>& candidates, BuildNode& node, std::vector<bool>& accepted);
+	void buildUpperLevels(std::vector<int32_t>& chunkRoots);
+	void writeNodePoints(BuildNode& node);
+	bool writeNodeTable(int32_t root);
+	std::string chunkFilename(const std::string& outputFilename, size_t chunk) const;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "PointBuffer.h"
+
+#include <cstring>
+
+PointBuffer::PointBuffer()
+{}
+
+PointBuffer::~PointBuffer()
+{
+	release();
+}
+
+// create the vertex buffer object for vertices of the given size (in bytes)
+void PointBuffer::create(GLsizei vertexSize, GLsizei initialCapacity)
+{
+	mVertexSize = vertexSize;
+	mCapacity = initialCapacity > 0 ? initialCapacity : 1;
+	mCount = 0;
+	mUploaded = 0;
+	mBytesUploaded = 0;
+	mData.clear();
+	mData.reserve(static_cast<size_t>(mCapacity) * mVertexSize);
+
+	// generate identifier for VBO and allocate storage (no data yet)
+	glGenBuffers(1, &mVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(mCapacity) * mVertexSize, nullptr, GL_DYNAMIC_DRAW);
+}
+
+// append vertices to the CPU copy (uploaded on the next call to upload)
+void PointBuffer::append(const void* vertices, GLsizei count)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+	mData.insert(mData.end(), bytes, bytes + static_cast<size_t>(count) * mVertexSize);
+	mCount += count;
+}
+
+// copy any pending vertices to the GPU, growing the buffer if necessary
+void PointBuffer::upload()
+{
+	// nothing new to upload
+	if (mUploaded == mCount)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+
+	// if out of space, double the capacity and copy everything
+	// (happens O(log n) times, so the cost is amortised over all appends)
+	if (mCount > mCapacity)
+	{
+		while (mCapacity < mCount)
+			mCapacity *= 2;
+
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(mCapacity) * mVertexSize, nullptr, GL_DYNAMIC_DRAW);
+		mUploaded = 0;
+	}
+
+	GLintptr offset = static_cast<GLintptr>(mUploaded) * mVertexSize;
+	GLsizeiptr size = static_cast<GLsizeiptr>(mCount - mUploaded) * mVertexSize;
+
+	// map only the new range; the GPU never reads past the vertices already drawn (clear and
+	// growing orphan the storage), so the write does not need to wait for previous draws to finish
+	void* dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+
+	if (dst != nullptr)
+	{
+		std::memcpy(dst, &mData[offset], size);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	else
+	{
+		// fall back to a plain sub-data copy if mapping is not available
+		glBufferSubData(GL_ARRAY_BUFFER, offset, size, &mData[offset]);
+	}
+
+	mBytesUploaded += size;
+	mUploaded = mCount;
+}
+
+// delete the vertex buffer and the CPU copy
+void PointBuffer::release()
+{
+	// delete vertex buffer
+	if (mVBO != 0)
+		glDeleteBuffers(1, &mVBO);
+	mVBO = 0;
+
+	mData.clear();
+	mCapacity = 0;
+	mCount = 0;
+	mUploaded = 0;
+}
+
+// remove all vertices (keeps the allocated capacity)
+void PointBuffer::clear()
+{
+	mData.clear();
+	mCount = 0;
+	mUploaded = 0;
+
+	// orphan the storage, so the next unsynchronised upload at offset 0 cannot overwrite
+	// vertices that draws still in flight are reading
+	if (mVBO != 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(mCapacity) * mVertexSize, nullptr, GL_DYNAMIC_DRAW);
+	}
+}
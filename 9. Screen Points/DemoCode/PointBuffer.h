@@ -0,0 +1,46 @@
+#ifndef POINT_BUFFER_H
+#define POINT_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+#include <GLEW/glew.h>
+
+/*****************************************************************
+ * growable vertex buffer for appending points
+ * the GPU buffer capacity doubles when it runs out of space and
+ * only vertices appended since the last upload are copied to the
+ * GPU, so each append costs amortised O(1) upload bandwidth
+ *****************************************************************/
+class PointBuffer
+{
+public:
+	PointBuffer();
+	~PointBuffer();
+
+	// create the vertex buffer object for vertices of the given size (in bytes)
+	void create(GLsizei vertexSize, GLsizei initialCapacity = 1024);
+	// append vertices to the CPU copy (uploaded on the next call to upload)
+	void append(const void* vertices, GLsizei count);
+	// copy any pending vertices to the GPU, growing the buffer if necessary
+	void upload();
+	// remove all vertices (keeps the allocated capacity)
+	void clear();
+	// delete the vertex buffer and the CPU copy
+	void release();
+
+	GLuint getBufferID() const { return mVBO; }
+	GLsizei getCount() const { return mCount; }
+	GLsizei getCapacity() const { return mCapacity; }
+	size_t getBytesUploaded() const { return mBytesUploaded; }
+
+private:
+	GLuint mVBO = 0;					// vertex buffer object identifier
+	GLsizei mVertexSize = 0;			// size of one vertex in bytes
+	GLsizei mCapacity = 0;				// number of vertices the GPU buffer can hold
+	GLsizei mCount = 0;					// number of vertices appended
+	GLsizei mUploaded = 0;				// number of vertices already on the GPU
+	size_t mBytesUploaded = 0;			// total bytes copied to the GPU (statistics)
+	std::vector<unsigned char> mData;	// CPU copy of the vertex data (used when the buffer grows)
+};
+
+#endif
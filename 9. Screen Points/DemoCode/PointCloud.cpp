@@ -0,0 +1,398 @@
+#include "PointCloud.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <queue>
+#include <utility>
+
+#include "ComputeRasterizer.h"
+
+// maximum number of node loads queued at once
+const size_t gMaxRequests = 16;
+
+// maximum number of loaded nodes waiting to be uploaded
+const size_t gMaxLoadedNodes = 32;
+
+// maximum number of nodes uploaded to the GPU per frame
+const size_t gMaxUploadsPerFrame = 8;
+
+PointCloud::PointCloud()
+{}
+
+PointCloud::~PointCloud()
+{
+	release();
+}
+
+// stop loading and delete the GPU slot pool
+void PointCloud::release()
+{
+	// stop the loader thread
+	if (mLoader.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mQuit = true;
+		}
+		mCondition.notify_all();
+		mLoader.join();
+	}
+	mRequests.clear();
+	mLoaded.clear();
+
+	// delete buffers
+	if (mVBO != 0)
+		glDeleteBuffers(1, &mVBO);
+	if (mVAO != 0)
+		glDeleteVertexArrays(1, &mVAO);
+	mVBO = 0;
+	mVAO = 0;
+
+	mHeader = {};
+	mNodes.clear();
+	mSlotNode.clear();
+	mDrawList.clear();
+	mNumResident = 0;
+	mNumPointsDrawn = 0;
+}
+
+// open an octree file, gpuBudget is the GPU memory (in bytes) used for points
+bool PointCloud::load(const std::string& filename, size_t gpuBudget)
+{
+	release();
+
+	std::ifstream file(filename, std::ios::in | std::ios::binary);
+
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to open: " << filename << std::endl;
+		return false;
+	}
+
+	// read header
+	file.read(reinterpret_cast<char*>(&mHeader), sizeof(mHeader));
+
+	if (!file || std::memcmp(mHeader.magic, gOctreeMagic, sizeof(gOctreeMagic)) != 0
+		|| mHeader.version != gOctreeVersion || mHeader.numNodes == 0 || mHeader.maxPointsPerNode == 0)
+	{
+		std::cerr << "Not an octree point cloud file: " << filename << std::endl;
+		mHeader = {};
+		return false;
+	}
+
+	// read node hierarchy (the points are loaded on demand)
+	std::vector<OctreeFileNode> fileNodes(mHeader.numNodes);
+	file.seekg(mHeader.nodeTableOffset);
+	file.read(reinterpret_cast<char*>(fileNodes.data()), fileNodes.size() * sizeof(OctreeFileNode));
+
+	if (!file)
+	{
+		std::cerr << "Failed to read octree nodes: " << filename << std::endl;
+		mHeader = {};
+		return false;
+	}
+
+	// every node must fit in a GPU slot and only reference nodes of the table
+	for (const OctreeFileNode& node : fileNodes)
+	{
+		bool valid = node.numPoints <= mHeader.maxPointsPerNode;
+		for (int32_t child : node.children)
+			valid = valid && child < static_cast<int32_t>(mHeader.numNodes);
+
+		if (!valid)
+		{
+			std::cerr << "Corrupt octree node table: " << filename << std::endl;
+			mHeader = {};
+			return false;
+		}
+	}
+
+	mNodes.resize(fileNodes.size());
+	for (size_t i = 0; i < fileNodes.size(); i++)
+		mNodes[i].file = fileNodes[i];
+
+	mFilename = filename;
+
+	// allocate GPU slot pool
+	GLsizeiptr slotSize = static_cast<GLsizeiptr>(mHeader.maxPointsPerNode) * sizeof(CloudPoint);
+	size_t numSlots = std::max<size_t>(1, gpuBudget / slotSize);
+	mSlotNode.assign(numSlots, -1);
+
+	glGenBuffers(1, &mVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferData(GL_ARRAY_BUFFER, slotSize * numSlots, nullptr, GL_DYNAMIC_DRAW);
+
+	// create VAO, specify VBO data and format of the data
+	glGenVertexArrays(1, &mVAO);
+	glBindVertexArray(mVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(CloudPoint),
+		reinterpret_cast<void*>(offsetof(CloudPoint, position)));	// specify format of position data
+	glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CloudPoint),
+		reinterpret_cast<void*>(offsetof(CloudPoint, color)));		// specify format of colour data (normalised)
+
+	glEnableVertexAttribArray(0);	// enable vertex attributes
+	glEnableVertexAttribArray(1);
+
+	glBindVertexArray(0);
+
+	std::cout << "Loaded octree with " << mHeader.numPoints << " points in " << mHeader.numNodes << " nodes, "
+		<< numSlots << " GPU slots (" << (slotSize * numSlots) / (1024 * 1024) << " MB)" << std::endl;
+
+	// start background loading
+	mQuit = false;
+	mLoader = std::thread(&PointCloud::loaderThread, this);
+
+	return true;
+}
+
+glm::vec3 PointCloud::getCenter() const
+{
+	return glm::vec3(mHeader.boundsMin[0], mHeader.boundsMin[1], mHeader.boundsMin[2]) + glm::vec3(mHeader.boundsSize * 0.5f);
+}
+
+// select the nodes to draw and request missing nodes
+void PointCloud::update(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, float fieldOfView, int viewportHeight)
+{
+	if (mNodes.empty())
+		return;
+
+	mFrame++;
+
+	// upload nodes loaded since the last frame
+	uploadLoadedNodes();
+
+	// extract frustum planes (a, b, c, d) from the view-projection matrix
+	glm::mat4 viewProjection = projectionMatrix * viewMatrix;
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	glm::vec4 planes[6] = { row[3] + row[0], row[3] - row[0], row[3] + row[1],
+		row[3] - row[1], row[3] + row[2], row[3] - row[2] };
+
+	glm::vec3 cameraPos = glm::vec3(glm::inverse(viewMatrix)[3]);
+
+	// scale from world size at distance 1 to pixels
+	float pixelScale = viewportHeight * 0.5f / std::tan(fieldOfView * 0.5f);
+
+	// traverse the octree in order of decreasing screen-space error
+	std::priority_queue<std::pair<float, uint32_t>> queue;
+	std::vector<uint32_t> missing;
+	queue.emplace(INFINITY, 0);
+
+	mDrawList.clear();
+	mNumPointsDrawn = 0;
+
+	while (!queue.empty())
+	{
+		uint32_t index = queue.top().second;
+		queue.pop();
+
+		Node& node = mNodes[index];
+		glm::vec3 boundsMin(node.file.boundsMin[0], node.file.boundsMin[1], node.file.boundsMin[2]);
+		glm::vec3 boundsMax = boundsMin + glm::vec3(node.file.size);
+
+		// frustum culling (test the corner furthest along each plane normal)
+		bool visible = true;
+		for (const glm::vec4& plane : planes)
+		{
+			glm::vec3 corner(plane.x > 0.0f ? boundsMax.x : boundsMin.x,
+				plane.y > 0.0f ? boundsMax.y : boundsMin.y,
+				plane.z > 0.0f ? boundsMax.z : boundsMin.z);
+
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+			{
+				visible = false;
+				break;
+			}
+		}
+		if (!visible)
+			continue;
+
+		// nodes without points need no GPU slot
+		if (node.slot < 0 && node.file.numPoints > 0)
+		{
+			missing.push_back(index);
+			continue;	// children add detail to this node, so wait until it is loaded
+		}
+
+		if (mNumPointsDrawn + node.file.numPoints > mPointBudget)
+			break;
+
+		if (node.file.numPoints > 0)
+		{
+			mDrawList.push_back(index);
+			mNumPointsDrawn += node.file.numPoints;
+		}
+		node.lastUsed = mFrame;
+
+		// refine if the node's point spacing covers too many pixels
+		for (int32_t child : node.file.children)
+		{
+			if (child < 0)
+				continue;
+
+			const OctreeFileNode& childNode = mNodes[child].file;
+			glm::vec3 center = glm::vec3(childNode.boundsMin[0], childNode.boundsMin[1], childNode.boundsMin[2]) + glm::vec3(childNode.size * 0.5f);
+			float radius = childNode.size * 0.8660254f;	// half diagonal
+			float distance = std::max(glm::length(center - cameraPos) - radius, 1.0e-4f);
+			float error = node.file.spacing / distance * pixelScale;
+
+			if (error > mErrorThreshold)
+				queue.emplace(error, child);
+		}
+	}
+
+	// replace the load queue with the most important missing nodes
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		for (uint32_t index : mRequests)
+			mNodes[index].requested = false;
+		mRequests.clear();
+
+		for (uint32_t index : missing)
+		{
+			if (mRequests.size() >= gMaxRequests)
+				break;
+			if (mNodes[index].requested)
+				continue;	// already being loaded
+
+			mNodes[index].requested = true;
+			mRequests.push_back(index);
+		}
+	}
+	mCondition.notify_one();
+}
+
+// draw the selected nodes that are loaded
+void PointCloud::draw()
+{
+	if (mVAO == 0)
+		return;
+
+	glBindVertexArray(mVAO);	// make VAO active
+
+	for (uint32_t index : mDrawList)
+	{
+		const Node& node = mNodes[index];
+		glDrawArrays(GL_POINTS, node.slot * mHeader.maxPointsPerNode, node.file.numPoints);
+	}
+}
+
+// splat the selected nodes that are loaded with the compute rasteriser
+void PointCloud::splat(ComputeRasterizer& rasterizer, const glm::mat4& modelViewProjection)
+{
+	for (uint32_t index : mDrawList)
+	{
+		const Node& node = mNodes[index];
+		rasterizer.splat(mVBO, node.slot * mHeader.maxPointsPerNode, node.file.numPoints, modelViewProjection);
+	}
+}
+
+// read requested nodes from the file in the background
+void PointCloud::loaderThread()
+{
+	std::ifstream file(mFilename, std::ios::in | std::ios::binary);
+
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mCondition.wait(lock, [this] { return mQuit || (!mRequests.empty() && mLoaded.size() < gMaxLoadedNodes); });
+
+		if (mQuit)
+			return;
+
+		uint32_t index = mRequests.front();
+		mRequests.pop_front();
+		lock.unlock();
+
+		// node file data is never modified after loading, so it can be read without the lock
+		const OctreeFileNode& fileNode = mNodes[index].file;
+
+		LoadedNode loaded;
+		loaded.node = index;
+		loaded.points.resize(fileNode.numPoints);
+		file.seekg(fileNode.dataOffset);
+		file.read(reinterpret_cast<char*>(loaded.points.data()), loaded.points.size() * sizeof(CloudPoint));
+
+		if (!file)
+		{
+			std::cerr << "Failed to read octree node " << index << std::endl;
+			file.clear();
+			loaded.points.clear();
+		}
+
+		lock.lock();
+		mLoaded.push_back(std::move(loaded));
+	}
+}
+
+// copy loaded nodes into GPU slots
+void PointCloud::uploadLoadedNodes()
+{
+	std::deque<LoadedNode> loaded;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		size_t count = std::min(mLoaded.size(), gMaxUploadsPerFrame);
+		loaded.insert(loaded.end(), std::make_move_iterator(mLoaded.begin()), std::make_move_iterator(mLoaded.begin() + count));
+		mLoaded.erase(mLoaded.begin(), mLoaded.begin() + count);
+
+		for (LoadedNode& item : loaded)
+			mNodes[item.node].requested = false;
+	}
+	mCondition.notify_one();
+
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+
+	for (LoadedNode& item : loaded)
+	{
+		if (item.points.empty())
+			continue;
+
+		int32_t slot = findSlot();
+		if (slot < 0)
+			break;	// every slot is in use; the nodes will be requested again
+
+		// evict the previous occupant
+		if (mSlotNode[slot] >= 0)
+		{
+			mNodes[mSlotNode[slot]].slot = -1;
+			mNumResident--;
+		}
+
+		GLintptr offset = static_cast<GLintptr>(slot) * mHeader.maxPointsPerNode * sizeof(CloudPoint);
+		glBufferSubData(GL_ARRAY_BUFFER, offset, item.points.size() * sizeof(CloudPoint), item.points.data());
+
+		// mark the node as used this frame, so later uploads of the batch do not evict it again
+		mNodes[item.node].slot = slot;
+		mNodes[item.node].lastUsed = mFrame;
+		mSlotNode[slot] = item.node;
+		mNumResident++;
+	}
+}
+
+// find a free slot or the least recently used slot not drawn last frame
+int32_t PointCloud::findSlot()
+{
+	int32_t best = -1;
+	uint64_t bestFrame = mFrame - 1;
+
+	for (size_t slot = 0; slot < mSlotNode.size(); slot++)
+	{
+		if (mSlotNode[slot] < 0)
+			return static_cast<int32_t>(slot);
+
+		uint64_t lastUsed = mNodes[mSlotNode[slot]].lastUsed;
+		if (lastUsed < bestFrame)
+		{
+			bestFrame = lastUsed;
+			best = static_cast<int32_t>(slot);
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,101 @@
+#ifndef POINT_CLOUD_H
+#define POINT_CLOUD_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GLEW/glew.h>
+#include <glm/glm.hpp>
+
+#include "PointCloudFormat.h"
+
+class ComputeRasterizer;
+
+/*****************************************************************
+ * out-of-core octree point cloud renderer
+ * only the node hierarchy is kept in memory; the points of a node
+ * are loaded by a background thread when its screen-space error
+ * is large enough, and uploaded into a fixed pool of GPU slots
+ * (least recently used slots are reused when the pool is full)
+ *****************************************************************/
+class PointCloud
+{
+public:
+	PointCloud();
+	~PointCloud();
+
+	// open an octree file, gpuBudget is the GPU memory (in bytes) used for points
+	bool load(const std::string& filename, size_t gpuBudget);
+	// stop loading and delete the GPU slot pool (a loaded cloud is released by the next load)
+	void release();
+	// select the nodes to draw and request missing nodes
+	void update(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, float fieldOfView, int viewportHeight);
+	// draw the selected nodes that are loaded
+	void draw();
+	// splat the selected nodes that are loaded with the compute rasteriser
+	void splat(ComputeRasterizer& rasterizer, const glm::mat4& modelViewProjection);
+
+	// centre and edge length of the point cloud's bounds
+	glm::vec3 getCenter() const;
+	float getSize() const { return mHeader.boundsSize; }
+
+	// nodes are refined until their point spacing is below this size (in pixels)
+	float mErrorThreshold = 1.5f;
+	// maximum number of points drawn per frame
+	uint32_t mPointBudget = 5000000;
+
+	// statistics of the last update
+	uint32_t getNumVisibleNodes() const { return static_cast<uint32_t>(mDrawList.size()); }
+	uint32_t getNumResidentNodes() const { return mNumResident; }
+	uint64_t getNumPointsDrawn() const { return mNumPointsDrawn; }
+	uint64_t getNumPoints() const { return mHeader.numPoints; }
+
+private:
+	struct Node
+	{
+		OctreeFileNode file;		// node description from the file
+		int32_t slot = -1;			// GPU slot holding the node's points (-1 if not resident)
+		uint64_t lastUsed = 0;		// frame the node was last drawn
+		bool requested = false;		// queued or being loaded
+	};
+
+	struct LoadedNode
+	{
+		uint32_t node;
+		std::vector<CloudPoint> points;
+	};
+
+	OctreeFileHeader mHeader = {};
+	std::vector<Node> mNodes;
+	std::string mFilename;
+
+	// GPU slot pool (one vertex buffer, each slot holds one node)
+	GLuint mVBO = 0;
+	GLuint mVAO = 0;
+	std::vector<int32_t> mSlotNode;		// node stored in each slot (-1 if free)
+
+	// nodes selected by the last update
+	std::vector<uint32_t> mDrawList;
+	uint64_t mFrame = 0;
+	uint32_t mNumResident = 0;
+	uint64_t mNumPointsDrawn = 0;
+
+	// background loading
+	std::thread mLoader;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	std::deque<uint32_t> mRequests;			// nodes to load (highest priority first)
+	std::deque<LoadedNode> mLoaded;			// nodes loaded but not yet uploaded
+	bool mQuit = false;
+
+	void loaderThread();
+	void uploadLoadedNodes();
+	int32_t findSlot();
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef POINT_CLOUD_FORMAT_H
+#define POINT_CLOUD_FORMAT_H
+
+#include <cstdint>
+#include <GLEW/glew.h>
+
+/*****************************************************************
+ * on-disk layout of an octree point cloud file
+ *
+ *   OctreeFileHeader
+ *   point data of every node (CloudPoint records)
+ *   OctreeFileNode table (numNodes entries, breadth-first order)
+ *
+ * each node stores a subsample of the points inside its bounds;
+ * the points of a node's children add detail (the points are not
+ * repeated), so drawing any connected set of nodes starting from
+ * the root gives a complete, progressively refined point cloud
+ *****************************************************************/
+
+// vertex attribute format of a point cloud point
+struct CloudPoint
+{
+	GLfloat position[3];
+	GLubyte color[4];
+};
+
+const char gOctreeMagic[8] = { 'P', 'C', 'O', 'C', 'T', 'R', 'E', 'E' };
+const uint32_t gOctreeVersion = 1;
+
+struct OctreeFileHeader
+{
+	char magic[8];				// gOctreeMagic
+	uint32_t version;			// gOctreeVersion
+	uint32_t numNodes;			// number of entries in the node table
+	uint32_t maxPointsPerNode;	// upper limit of points stored in one node
+	uint32_t reserved;
+	uint64_t numPoints;			// total number of points
+	uint64_t nodeTableOffset;	// file offset of the node table
+	float boundsMin[3];			// minimum corner of the (cubic) root bounds
+	float boundsSize;			// edge length of the root bounds
+};
+
+struct OctreeFileNode
+{
+	uint64_t dataOffset;		// file offset of the node's points
+	uint32_t numPoints;			// number of points stored in the node
+	uint32_t level;				// depth in the octree (root = 0)
+	int32_t children[8];		// node table index of each child (-1 if none)
+	float boundsMin[3];			// minimum corner of the node's cubic bounds
+	float size;					// edge length of the node's bounds
+	float spacing;				// minimum distance between the node's points
+};
+
+#endif
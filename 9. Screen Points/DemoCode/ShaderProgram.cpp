@@ -148,6 +148,98 @@ void ShaderProgram::compileAndLink(const std::string vShaderFilename, const std:
 	glDeleteShader(fShaderID);
 }
 
+// compile and link a compute shader (requires OpenGL 4.3)
+void ShaderProgram::compileAndLink(const std::string cShaderFilename)
+{
+	GLint status;	// used for checking compile and link status
+
+/****************************************************************
+ * Step 1: read compute shader source code from file
+ ****************************************************************/
+	std::string cShaderString;	// to store compute shader code
+	std::ifstream cShaderFile(cShaderFilename, std::ios::in); 	// open file
+
+	// if file successfully opened, get the shader source code
+	if (cShaderFile.is_open())
+	{
+		std::stringstream stream;
+		stream << cShaderFile.rdbuf();	// read buffer contents
+		cShaderString = stream.str();	// convert stream into string
+		cShaderFile.close();			// close file
+	}
+	else
+	{
+		// output error message and exit
+		std::cerr << "Failed to open: " << cShaderFilename << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+/****************************************************************
+ * Step 2: Create and compile shader object
+ ****************************************************************/
+	GLuint cShaderID = glCreateShader(GL_COMPUTE_SHADER);
+
+	// provide source code for shader
+	const GLchar *cShaderCode = cShaderString.c_str();
+	glShaderSource(cShaderID, 1, &cShaderCode, nullptr);
+
+	// compile shader
+	glCompileShader(cShaderID);
+
+	// check compute shader compile status
+	status = GL_FALSE;
+	glGetShaderiv(cShaderID, GL_COMPILE_STATUS, &status);
+
+	if (status == GL_FALSE)
+	{
+		// output error message
+		std::cerr << "Failed to compile " << cShaderFilename << std::endl;
+
+		// output error log
+		int infoLogLength;
+		glGetShaderiv(cShaderID, GL_INFO_LOG_LENGTH, &infoLogLength);
+		std::string errorMessage(infoLogLength, ' ');
+		glGetShaderInfoLog(cShaderID, infoLogLength, nullptr, &errorMessage[0]);
+		std::cerr << errorMessage << std::endl;
+
+		exit(EXIT_FAILURE);
+	}
+
+/****************************************************************
+ * Step 3: Attach shader to program object and link
+ ****************************************************************/
+	// create program object
+	mProgramID = glCreateProgram();
+
+	// attach shader to the program object
+	glAttachShader(mProgramID, cShaderID);
+
+	// link program object
+	glLinkProgram(mProgramID);
+
+	// check link status
+	status = GL_FALSE;
+	glGetProgramiv(mProgramID, GL_LINK_STATUS, &status);
+
+	if (status == GL_FALSE)
+	{
+		// output error message
+		std::cerr << "Failed to link shader program." << std::endl;
+
+		// output error log
+		int infoLogLength;
+		glGetProgramiv(mProgramID, GL_INFO_LOG_LENGTH, &infoLogLength);
+		std::string errorMessage(infoLogLength, ' ');
+		glGetProgramInfoLog(mProgramID, infoLogLength, nullptr, &errorMessage[0]);
+		std::cerr << errorMessage << std::endl;
+
+		exit(EXIT_FAILURE);
+	}
+
+	// flag shader for deletion (will not actually be deleted until detached from program)
+	glDeleteShader(cShaderID);
+}
+
 // use the shader program
 void ShaderProgram::use()
 {
@@ -160,6 +252,11 @@ void ShaderProgram::setUniform(const char *name, const glm::vec2& vector)
 	glUniform2fv(getUniformLocation(name), 1, &vector[0]);
 }
 
+void ShaderProgram::setUniform(const char *name, const glm::ivec2& vector)
+{
+	glUniform2iv(getUniformLocation(name), 1, &vector[0]);
+}
+
 void ShaderProgram::setUniform(const char *name, const glm::vec3& vector)
 {
 	glUniform3fv(getUniformLocation(name), 1, &vector[0]);
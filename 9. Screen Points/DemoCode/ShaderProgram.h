@@ -17,11 +17,14 @@ public:
 
 	// compile and link a vertex and fragment shader pair
 	void compileAndLink(const std::string vShaderFilename, const std::string fShaderFilename);
+	// compile and link a compute shader (requires OpenGL 4.3)
+	void compileAndLink(const std::string cShaderFilename);
 	// use the shader program
 	void use();
 
 	// functions to set shader uniform variables
 	void setUniform(const char *name, const glm::vec2& vector);
+	void setUniform(const char *name, const glm::ivec2& vector);
 	void setUniform(const char *name, const glm::vec3& vector);
 	void setUniform(const char *name, const glm::vec4& vector);
 	void setUniform(const char* name, const glm::mat3& matrix);
@@ -0,0 +1,24 @@
+#version 330 core
+
+// input data
+layout(location = 0) in vec3 aPosition;
+layout(location = 1) in vec3 aColor;
+
+// uniform input data
+uniform mat4 uModelViewProjectionMatrix;
+uniform float uPointSize;
+
+// output data
+out vec3 vColor;
+
+void main()
+{
+	// set point size
+	gl_PointSize = uPointSize;
+
+	// set vertex position
+    gl_Position = uModelViewProjectionMatrix * vec4(aPosition, 1.0f);
+
+	// set vertex shader output color
+	vColor = aColor;
+}
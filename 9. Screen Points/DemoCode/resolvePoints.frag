@@ -0,0 +1,33 @@
+#version 430 core
+
+// colour and depth of each pixel written by the splatting compute shaders
+struct Pixel
+{
+	uint color;
+	uint depth;
+};
+
+layout(std430, binding = 1) readonly buffer Framebuffer
+{
+	Pixel pixels[];
+};
+
+// uniform input data
+uniform ivec2 uViewportSize;
+
+// output data
+out vec3 fColor;
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	Pixel p = pixels[pixel.y * uViewportSize.x + pixel.x];
+
+	// no point in this pixel
+	if (p.depth == 0xFFFFFFFFu)
+		discard;
+
+	// set output color and depth
+	fColor = unpackUnorm4x8(p.color).rgb;
+	gl_FragDepth = uintBitsToFloat(p.depth);
+}
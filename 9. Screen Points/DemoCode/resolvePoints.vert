@@ -0,0 +1,8 @@
+#version 330 core
+
+void main()
+{
+	// full screen triangle from the vertex index (no vertex data needed)
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(position * 2.0f - 1.0f, 0.0f, 1.0f);
+}
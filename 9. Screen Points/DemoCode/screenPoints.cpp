@@ -1,6 +1,7 @@
 // include C++ headers
 #include <cstdio>
 #include <iostream>
+#include <string>
 #include <vector>
 //using namespace std;	// to avoid having to use std::
 
@@ -12,6 +13,10 @@
 //using namespace glm;	// to avoid having to use glm::
 
 #include "ShaderProgram.h"
+#include "PointBuffer.h"
+#include "PointCloud.h"
+#include "OctreeBuilder.h"
+#include "ComputeRasterizer.h"
 
 // vertex attribute format
 struct VertexColor
@@ -25,15 +30,32 @@ struct VertexColor
 unsigned int gWindowWidth = 800;
 unsigned int gWindowHeight = 600;
 
+// frame stats
+float gFrameRate = 60.0f;
+float gFrameTime = 1 / gFrameRate;
+
 // scene content
 ShaderProgram gShader;	// shader program object
-GLuint gVBO = 0;		// vertex buffer object identifier
+PointBuffer gPoints;	// growable vertex buffer of point positions and colours
 GLuint gVAO = 0;		// vertex array object identifier
 
-std::vector<VertexColor> gVertices;	// vertex positions and colours
 glm::mat4 gViewMatrix;				// view matrix
 glm::mat4 gProjectionMatrix;		// projection matrix
 
+// point cloud mode (enabled by passing an octree file on the command line)
+std::string gCloudFilename;			// octree point cloud file
+PointCloud gCloud;					// out-of-core point cloud
+const size_t gCloudGPUBudget = 256 * 1024 * 1024;	// GPU memory used for point cloud nodes
+const float gFieldOfView = glm::radians(45.0f);		// vertical field of view
+float gCameraYaw = 0.0f;			// orbit camera angles and distance (relative to cloud size)
+float gCameraPitch = 0.3f;
+float gCameraDistance = 1.5f;
+
+// compute shader point rasteriser (requires OpenGL 4.3)
+ComputeRasterizer gRasterizer;
+bool gRasterizerSupported = false;
+bool gUseRasterizer = false;		// splat points with compute shaders instead of GL_POINTS
+
 // function initialise scene and render settings
 static void init(GLFWwindow* window)
 {
@@ -52,16 +74,13 @@ static void init(GLFWwindow* window)
 	// initialise projection matrix
 	gProjectionMatrix = glm::ortho(0.0f, static_cast<float>(gWindowWidth), 0.0f, static_cast<float>(gWindowHeight), 0.01f, 10.0f);
 
-	// initialise empty vertex list
-	gVertices.clear();
-
-	// create VBO
-	glGenBuffers(1, &gVBO);					// generate unused VBO identifier
+	// create growable VBO (initially empty)
+	gPoints.create(sizeof(VertexColor));
 
 	// create VAO, specify VBO data and format of the data
 	glGenVertexArrays(1, &gVAO);			// generate unused VAO identifier
 	glBindVertexArray(gVAO);				// create VAO
-	glBindBuffer(GL_ARRAY_BUFFER, gVBO);	// bind the VBO
+	glBindBuffer(GL_ARRAY_BUFFER, gPoints.getBufferID());	// bind the VBO
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexColor),
 		reinterpret_cast<void*>(offsetof(VertexColor, position)));	// specify format of position data
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexColor),
@@ -71,6 +90,65 @@ static void init(GLFWwindow* window)
 	glEnableVertexAttribArray(1);
 }
 
+// function initialise point cloud scene and render settings
+static void init_point_cloud(GLFWwindow* window)
+{
+	// set the color the color buffer should be cleared to
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+	glEnable(GL_DEPTH_TEST);			// enable depth buffer test
+	glEnable(GL_PROGRAM_POINT_SIZE);	// enable point size
+
+	// compile and link a vertex and fragment shader pair
+	gShader.compileAndLink("pointCloud.vert", "color.frag");
+
+	// open octree file (points are streamed in while rendering)
+	if (!gCloud.load(gCloudFilename, gCloudGPUBudget))
+		exit(EXIT_FAILURE);
+
+	// initialise projection matrix based on the size of the point cloud
+	gProjectionMatrix = glm::perspective(gFieldOfView, static_cast<float>(gWindowWidth) / gWindowHeight,
+		gCloud.getSize() * 0.001f, gCloud.getSize() * 10.0f);
+
+	// compute shader splatting is optional (toggled with the R key)
+	gRasterizerSupported = ComputeRasterizer::isSupported();
+	if (gRasterizerSupported)
+		gRasterizer.init(gWindowWidth, gWindowHeight);
+}
+
+// function used to update the point cloud scene
+static void update_point_cloud(GLFWwindow* window)
+{
+	// orbit the camera around the point cloud based on keyboard input
+	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+		gCameraYaw -= gFrameTime;
+	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+		gCameraYaw += gFrameTime;
+	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+		gCameraPitch = glm::min(gCameraPitch + gFrameTime, 1.5f);
+	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+		gCameraPitch = glm::max(gCameraPitch - gFrameTime, -1.5f);
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+		gCameraDistance = glm::max(gCameraDistance * (1.0f - gFrameTime), 0.01f);
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+		gCameraDistance = glm::min(gCameraDistance * (1.0f + gFrameTime), 5.0f);
+
+	// adjust level of detail (screen-space error threshold in pixels)
+	if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS)
+		gCloud.mErrorThreshold = glm::max(gCloud.mErrorThreshold * (1.0f - gFrameTime), 0.25f);
+	if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS)
+		gCloud.mErrorThreshold = glm::min(gCloud.mErrorThreshold * (1.0f + gFrameTime), 64.0f);
+
+	// update view matrix
+	glm::vec3 target = gCloud.getCenter();
+	glm::vec3 direction(std::cos(gCameraPitch) * std::sin(gCameraYaw), std::sin(gCameraPitch),
+		std::cos(gCameraPitch) * std::cos(gCameraYaw));
+	gViewMatrix = glm::lookAt(target + direction * gCameraDistance * gCloud.getSize(), target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+	// select visible nodes and stream in missing ones
+	gCloud.update(gViewMatrix, gProjectionMatrix, gFieldOfView, gWindowHeight);
+}
+
 // function used to update the scene
 static void update_scene(GLFWwindow* window)
 {
@@ -95,11 +173,10 @@ static void update_scene(GLFWwindow* window)
 		point.color[2] = static_cast<double>(rand()) / RAND_MAX;
 
 		// add to vertex list
-		gVertices.push_back(point);
+		gPoints.append(&point, 1);
 
-		// update VBO
-		glBindBuffer(GL_ARRAY_BUFFER, gVBO);
-		glBufferData(GL_ARRAY_BUFFER, gVertices.size() * sizeof(VertexColor), &gVertices[0], GL_DYNAMIC_DRAW);
+		// update VBO (only the new point is copied to the GPU)
+		gPoints.upload();
 	}
 }
 
@@ -116,12 +193,214 @@ static void render_scene()
 	// set model-view-project matrix
 	glm::mat4 modelViewProjection = gProjectionMatrix * gViewMatrix;
 	gShader.setUniform("uModelViewProjectionMatrix", modelViewProjection);
-	glDrawArrays(GL_POINTS, 0, gVertices.size());	// display the points
+	glDrawArrays(GL_POINTS, 0, gPoints.getCount());	// display the points
 
 	// flush the graphics pipeline
 	glFlush();
 }
 
+// function to render the point cloud scene
+static void render_point_cloud()
+{
+	// clear colour buffer and depth buffer
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glm::mat4 modelViewProjection = gProjectionMatrix * gViewMatrix;
+
+	if (gUseRasterizer)
+	{
+		// splat the loaded nodes into the storage framebuffer and copy it to the screen
+		gRasterizer.begin();
+		gCloud.splat(gRasterizer, modelViewProjection);
+		gRasterizer.resolve();
+	}
+	else
+	{
+		gShader.use();					// use the shaders associated with the shader program
+
+		// set uniform variables
+		gShader.setUniform("uModelViewProjectionMatrix", modelViewProjection);
+		gShader.setUniform("uPointSize", 2.0f);
+
+		gCloud.draw();					// display the loaded nodes
+	}
+
+	// flush the graphics pipeline
+	glFlush();
+}
+
+// measure point append throughput of the full re-upload and growable buffer paths
+static void benchmark_appends()
+{
+	const GLsizei batchSize = 16;	// points appended per simulated frame
+	const GLsizei counts[] = { 10000, 100000, 1000000 };
+
+	// create batch of random points
+	std::vector<VertexColor> batch(batchSize);
+	for (VertexColor& point : batch)
+	{
+		point.position[0] = static_cast<float>(rand() % gWindowWidth);
+		point.position[1] = static_cast<float>(rand() % gWindowHeight);
+		point.position[2] = 0.0f;
+		point.color[0] = point.color[1] = point.color[2] = 1.0f;
+	}
+
+	std::cout << "Append benchmark (" << batchSize << " points per upload)" << std::endl;
+
+	for (GLsizei count : counts)
+	{
+		// full re-upload of all vertices after every batch (O(n) per append)
+		// skipped for large counts as the total cost grows quadratically
+		if (count <= 100000)
+		{
+			std::vector<VertexColor> vertices;
+			GLuint vbo = 0;
+			glGenBuffers(1, &vbo);
+			glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+			double startTime = glfwGetTime();
+			for (GLsizei i = 0; i < count; i += batchSize)
+			{
+				vertices.insert(vertices.end(), batch.begin(), batch.end());
+				glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VertexColor), &vertices[0], GL_DYNAMIC_DRAW);
+			}
+			glFinish();
+			double elapsed = glfwGetTime() - startTime;
+
+			std::cout << "  re-upload   " << count << " points: " << elapsed * 1000.0 << " ms, "
+				<< count / elapsed / 1.0e6 << " M points/s" << std::endl;
+
+			glDeleteBuffers(1, &vbo);
+		}
+
+		// growable buffer, only new points uploaded
+		{
+			PointBuffer points;
+			points.create(sizeof(VertexColor));
+
+			double startTime = glfwGetTime();
+			for (GLsizei i = 0; i < count; i += batchSize)
+			{
+				points.append(&batch[0], batchSize);
+				points.upload();
+			}
+			glFinish();
+			double elapsed = glfwGetTime() - startTime;
+
+			std::cout << "  growable    " << count << " points: " << elapsed * 1000.0 << " ms, "
+				<< count / elapsed / 1.0e6 << " M points/s, "
+				<< points.getBytesUploaded() / (1024.0 * 1024.0) << " MB uploaded" << std::endl;
+		}
+	}
+}
+
+// measure point rendering throughput of GL_POINTS and compute shader splatting
+static void benchmark_splatting()
+{
+	const GLsizei chunkSize = 1000000;	// points generated and uploaded at a time
+	const GLsizei counts[] = { 10000000, 30000000, 100000000 };
+	const int numFrames = 10;			// frames rendered per measurement
+
+	if (!ComputeRasterizer::isSupported())
+	{
+		std::cerr << "Compute shaders not supported (OpenGL 4.3 required)" << std::endl;
+		return;
+	}
+
+	ShaderProgram pointShader;
+	pointShader.compileAndLink("pointCloud.vert", "color.frag");
+
+	ComputeRasterizer rasterizer;
+	rasterizer.init(gWindowWidth, gWindowHeight);
+
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_PROGRAM_POINT_SIZE);
+
+	// view a unit cube of random points that fills the window
+	glm::mat4 modelViewProjection = glm::perspective(glm::radians(45.0f), static_cast<float>(gWindowWidth) / gWindowHeight, 0.1f, 10.0f)
+		* glm::lookAt(glm::vec3(0.0f, 0.0f, 1.7f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	std::cout << "Splat benchmark (" << gWindowWidth << "x" << gWindowHeight << ", "
+		<< (rasterizer.usesAtomic64() ? "64-bit atomics" : "32-bit atomics, two passes") << ")" << std::endl;
+
+	std::vector<CloudPoint> chunk(chunkSize);
+
+	for (GLsizei count : counts)
+	{
+		// allocate point buffer
+		GLuint vbo = 0;
+		glGenBuffers(1, &vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(count) * sizeof(CloudPoint), nullptr, GL_STATIC_DRAW);
+
+		if (glGetError() == GL_OUT_OF_MEMORY)
+		{
+			std::cout << "  " << count << " points: out of GPU memory" << std::endl;
+			glDeleteBuffers(1, &vbo);
+			break;
+		}
+
+		// fill with random points
+		for (GLsizei first = 0; first < count; first += chunkSize)
+		{
+			for (CloudPoint& point : chunk)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					point.position[i] = static_cast<float>(rand()) / RAND_MAX - 0.5f;
+					point.color[i] = static_cast<GLubyte>(rand() % 256);
+				}
+				point.color[3] = 255;
+			}
+			glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(first) * sizeof(CloudPoint), chunk.size() * sizeof(CloudPoint), &chunk[0]);
+		}
+
+		GLuint vao = 0;
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(CloudPoint),
+			reinterpret_cast<void*>(offsetof(CloudPoint, position)));
+		glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CloudPoint),
+			reinterpret_cast<void*>(offsetof(CloudPoint, color)));
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glFinish();
+
+		// GL_POINTS
+		double startTime = glfwGetTime();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			pointShader.use();
+			pointShader.setUniform("uModelViewProjectionMatrix", modelViewProjection);
+			pointShader.setUniform("uPointSize", 1.0f);
+			glBindVertexArray(vao);
+			glDrawArrays(GL_POINTS, 0, count);
+		}
+		glFinish();
+		double pointsTime = (glfwGetTime() - startTime) / numFrames;
+
+		// compute shader splatting
+		startTime = glfwGetTime();
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			rasterizer.begin();
+			rasterizer.splat(vbo, 0, count, modelViewProjection);
+			rasterizer.resolve();
+		}
+		glFinish();
+		double splatTime = (glfwGetTime() - startTime) / numFrames;
+
+		std::cout << "  " << count << " points: GL_POINTS " << pointsTime * 1000.0 << " ms ("
+			<< count / pointsTime / 1.0e6 << " M points/s), compute " << splatTime * 1000.0 << " ms ("
+			<< count / splatTime / 1.0e6 << " M points/s)" << std::endl;
+
+		glDeleteVertexArrays(1, &vao);
+		glDeleteBuffers(1, &vbo);
+	}
+}
+
 // key press or release callback function
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
@@ -132,6 +411,30 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 		glfwSetWindowShouldClose(window, GL_TRUE);
 		return;
 	}
+
+	// run the point append benchmark when the B key is pressed
+	if (key == GLFW_KEY_B && action == GLFW_PRESS)
+	{
+		benchmark_appends();
+		return;
+	}
+
+	// clear all points when the C key is pressed
+	if (key == GLFW_KEY_C && action == GLFW_PRESS)
+	{
+		gPoints.clear();
+		return;
+	}
+
+	// toggle compute shader splatting of the point cloud when the R key is pressed
+	if (key == GLFW_KEY_R && action == GLFW_PRESS && !gCloudFilename.empty())
+	{
+		if (gRasterizerSupported)
+			gUseRasterizer = !gUseRasterizer;
+		else
+			std::cerr << "Compute shaders not supported (OpenGL 4.3 required)" << std::endl;
+		return;
+	}
 }
 
 // error callback function
@@ -140,10 +443,24 @@ static void error_callback(int error, const char* description)
 	std::cerr << description << std::endl;	// output error description
 }
 
-int main(void)
+int main(int argc, char* argv[])
 {
 	GLFWwindow* window = nullptr;	// GLFW window handle
 
+	// build an octree file offline: DemoCode --build <input.ply|input.bin> <output file>
+	if (argc == 4 && std::string(argv[1]) == "--build")
+	{
+		OctreeBuilder builder;
+		exit(builder.build(argv[2], argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// compare GL_POINTS with compute shader splatting: DemoCode --splat-benchmark
+	bool splatBenchmark = (argc == 2 && std::string(argv[1]) == "--splat-benchmark");
+
+	// view an octree file: DemoCode <octree file>
+	if (argc == 2 && !splatBenchmark)
+		gCloudFilename = argv[1];
+
 	glfwSetErrorCallback(error_callback);	// set GLFW error callback function
 
 	// initialise GLFW
@@ -153,8 +470,8 @@ int main(void)
 		exit(EXIT_FAILURE);
 	}
 
-	// minimum OpenGL version 3.3
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	// minimum OpenGL version 3.3 (4.3 for the splat benchmark)
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, splatBenchmark ? 4 : 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -180,25 +497,76 @@ int main(void)
 		exit(EXIT_FAILURE);
 	}
 
+	// run the splat benchmark without entering the rendering loop
+	if (splatBenchmark)
+	{
+		benchmark_splatting();
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		exit(EXIT_SUCCESS);
+	}
+
 	// set GLFW callback functions
 	glfwSetKeyCallback(window, key_callback);
 
 	// initialise scene and render settings
-	init(window);
+	bool pointCloudMode = !gCloudFilename.empty();
+	if (pointCloudMode)
+		init_point_cloud(window);
+	else
+		init(window);
+
+	// timing data
+	double lastUpdateTime = glfwGetTime();	// last update time
+	double elapsedTime = lastUpdateTime;	// time since last update
+	int frameCount = 0;						// number of frames since last update
 
 	// the rendering loop
 	while (!glfwWindowShouldClose(window))
 	{
-		update_scene(window);	// update the scene
-		render_scene();			// render the scene
+		if (pointCloudMode)
+		{
+			update_point_cloud(window);	// update the point cloud
+			render_point_cloud();		// render the point cloud
+		}
+		else
+		{
+			update_scene(window);	// update the scene
+			render_scene();			// render the scene
+		}
 
 		glfwSwapBuffers(window);	// swap buffers
 		glfwPollEvents();			// poll for events
+
+		frameCount++;
+		elapsedTime = glfwGetTime() - lastUpdateTime;	// time since last update
+
+		// if elapsed time since last update > 1 second
+		if (elapsedTime > 1.0)
+		{
+			gFrameTime = elapsedTime / frameCount;	// average time per frame
+			gFrameRate = 1 / gFrameTime;			// frames per second
+			lastUpdateTime = glfwGetTime();			// set last update time to current time
+			frameCount = 0;							// reset frame counter
+
+			// show point cloud statistics in the window title
+			if (pointCloudMode)
+			{
+				std::string title = std::string(gUseRasterizer ? "Point Cloud (compute) - " : "Point Cloud - ")
+					+ std::to_string(static_cast<int>(gFrameRate)) + " fps, "
+					+ std::to_string(gCloud.getNumVisibleNodes()) + " nodes, "
+					+ std::to_string(gCloud.getNumPointsDrawn()) + " of " + std::to_string(gCloud.getNumPoints()) + " points";
+				glfwSetWindowTitle(window, title.c_str());
+			}
+		}
 	}
 
 	// clean up
-	glDeleteBuffers(1, &gVBO);
+	// (the globals would only be destroyed after the context is gone)
+	gPoints.release();
 	glDeleteVertexArrays(1, &gVAO);
+	gCloud.release();
+	gRasterizer.release();
 
 	// close the window and terminate GLFW
 	glfwDestroyWindow(window);